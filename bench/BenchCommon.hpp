@@ -0,0 +1,172 @@
+#pragma once
+// Helpers shared by the headless benchmarks.
+// Nothing here opens a window or creates a Vulkan device: only the CPU side of the engine is used.
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <json.hpp>
+
+#include "modules/Scene.hpp"
+#include "modules/Animations.hpp"
+#include "character/char_manager.hpp"
+
+using BenchClock = std::chrono::steady_clock;
+
+/** Milliseconds elapsed between two time points. */
+inline double elapsedMs(BenchClock::time_point from, BenchClock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+/** Keeps the compiler from optimizing away the computation of a value. */
+template <typename T>
+inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+#endif
+}
+
+/**
+ * Reads and parses a json file, exiting on error.
+ */
+inline nlohmann::json readJsonFile(const std::string& file) {
+    nlohmann::json j;
+    std::ifstream ifs(file);
+    if (!ifs.is_open()) {
+        std::cout << "Error! File >" << file << "< not found!\n";
+        exit(-1);
+    }
+    ifs >> j;
+    return j;
+}
+
+/**
+ * Parses a comma separated list of numbers (e.g. "--counts 1,10,100"); empty items are skipped.
+ * Throws std::invalid_argument on an item that is not a T.
+ */
+template <typename T>
+std::vector<T> parseList(const std::string& list) {
+    std::vector<T> values;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        std::istringstream in(item);
+        T value;
+        if (!(in >> value) || !(in >> std::ws).eof()) throw std::invalid_argument(item);
+        values.push_back(value);
+    }
+    return values;
+}
+
+/** Options of the json report, shared by every benchmark: --json file, --label text. */
+struct BenchReport {
+    std::string jsonFile;           // empty: no report
+    std::string label = "local";    // tells the runs apart (machine, commit, ...)
+
+    /** Consumes argv[i] (and its value) if it is a report option. @return true if consumed. */
+    bool parseArg(int argc, char* argv[], int& i) {
+        const std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) jsonFile = argv[++i];
+        else if (arg == "--label" && i + 1 < argc) label = argv[++i];
+        else return false;
+        return true;
+    }
+};
+
+/**
+ * Writes {"benchmark", "label", the fields of info, "results"} to report.jsonFile, if set.
+ * @param results Array built by the benchmark, one object per run.
+ * @return Status code (0 for success or no report, -1 if the file cannot be written).
+ */
+inline int writeJsonReport(const BenchReport& report, const std::string& benchmark, const nlohmann::json& results,
+                           const nlohmann::json& info = nlohmann::json::object()) {
+    if (report.jsonFile.empty()) return 0;
+    nlohmann::json j = info;
+    j["benchmark"] = benchmark;
+    j["label"] = report.label;
+    j["results"] = results;
+    std::ofstream out(report.jsonFile);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write >" << report.jsonFile << "<\n";
+        return -1;
+    }
+    out << j.dump(2) << "\n";
+    return 0;
+}
+
+/**
+ * Loads only the asset files referenced by the characters of a scene file.
+ * @return One entry per element of the "assetfiles" array of the scene; the ones not needed
+ *         by the characters are left to nullptr.
+ */
+inline std::vector<AssetFile*> loadCharacterAssets(const std::string& sceneFile) {
+    nlohmann::json sceneJson = readJsonFile(sceneFile);
+
+    std::unordered_set<std::string> needed;
+    for (const auto& charJson : sceneJson["characters"]) {
+        for (const auto& anim : charJson.value("animList", std::vector<std::string>{})) {
+            needed.insert(anim);
+        }
+    }
+
+    std::vector<AssetFile*> assets;
+    for (const auto& assetJson : sceneJson["assetfiles"]) {
+        AssetFile* af = nullptr;
+        if (needed.count(assetJson["id"].get<std::string>()) > 0) {
+            af = new AssetFile();
+            af->init(assetJson["file"].get<std::string>(), GLTF);
+        }
+        assets.push_back(af);
+    }
+    return assets;
+}
+
+/** Releases the asset files returned by loadCharacterAssets(). */
+inline void freeAssets(std::vector<AssetFile*>& assets) {
+    for (AssetFile* af : assets) {
+        if (af != nullptr) {
+            af->cleanup();
+            delete af;
+        }
+    }
+    assets.clear();
+}
+
+/**
+ * Creates an independent copy of a character: it has its own animation blender, skeleton state and
+ * palettes, but shares the (read-only) animation tracks and state machine with the original.
+ */
+inline std::shared_ptr<Character> cloneCharacter(Character& src, const std::string& name) {
+    return std::make_shared<Character>(name, src.getPosition(),
+                                       std::make_shared<AnimBlender>(*src.getAnimBlender()),
+                                       std::make_shared<SkeletalAnimation>(*src.getSkeletalAnimation()),
+                                       src.getStateMachine());
+}
+
+/**
+ * Fills `out` with `count` characters, cycling over the templates loaded from the scene.
+ * Each copy starts from a different time of its animation, so they do not all sample the same keyframes.
+ */
+inline void spawnCrowd(CharManager& templates, int count, std::vector<std::shared_ptr<Character>>& out) {
+    const auto& src = templates.getCharacters();
+    out.clear();
+    out.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Character& t = *src[i % src.size()];
+        auto c = cloneCharacter(t, t.getName() + "#" + std::to_string(i));
+        AnimBlender* AB = c->getAnimBlender();
+        AB->segments[AB->cur].t = 0.137f * static_cast<float>(i);
+        out.push_back(c);
+    }
+}
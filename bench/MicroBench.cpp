@@ -0,0 +1,109 @@
+#include "MicroBench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+void MicroBench::addResult(const std::string& name, std::vector<double>& nsPerOp, double allocsPerOp,
+                           int64_t iterations) {
+    MicroResult r{};
+    r.name = name;
+    r.samples = static_cast<int>(nsPerOp.size());
+    r.iterations = iterations;
+    r.allocsPerOp = allocsPerOp;
+
+    double sum = 0.0;
+    for (double ns : nsPerOp) sum += ns;
+    r.meanNs = sum / r.samples;
+    double squares = 0.0;
+    for (double ns : nsPerOp) squares += (ns - r.meanNs) * (ns - r.meanNs);
+    r.stddevNs = r.samples > 1 ? std::sqrt(squares / (r.samples - 1)) : 0.0;
+    r.cv = r.meanNs > 0.0 ? r.stddevNs / r.meanNs : 0.0;
+
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+    r.minNs = nsPerOp.front();
+    r.nsPerOp = (r.samples % 2 == 1) ? nsPerOp[r.samples / 2]
+                                     : 0.5 * (nsPerOp[r.samples / 2 - 1] + nsPerOp[r.samples / 2]);
+    results.push_back(r);
+
+    std::cout << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << r.nsPerOp << " ns/op  +-" << std::setw(5) << r.cv * 100.0 << "%"
+              << std::setprecision(2) << std::setw(10) << r.allocsPerOp << " allocs/op\n";
+}
+
+int MicroBench::writeJson(const std::string& file, const std::string& label) const {
+    nlohmann::json j;
+    j["benchmark"] = "micro_bench";
+    j["label"] = label;
+    j["results"] = nlohmann::json::array();
+    for (const auto& r : results) {
+        j["results"].push_back({
+            {"name", r.name},
+            {"ns_per_op", r.nsPerOp},
+            {"ns_mean", r.meanNs},
+            {"ns_stddev", r.stddevNs},
+            {"cv", r.cv},
+            {"ns_min", r.minNs},
+            {"allocs_per_op", r.allocsPerOp},
+            {"iterations", r.iterations},
+            {"samples", r.samples}
+        });
+    }
+    std::ofstream out(file);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write >" << file << "<\n";
+        return -1;
+    }
+    out << j.dump(2) << "\n";
+    return 0;
+}
+
+int MicroBench::compare(const std::string& baselineFile, double threshold) const {
+    std::ifstream ifs(baselineFile);
+    if (!ifs.is_open()) {
+        std::cout << "Error! Baseline >" << baselineFile << "< not found!\n";
+        return -1;
+    }
+    std::unordered_map<std::string, nlohmann::json> baseline;
+    std::string label;
+    try {
+        nlohmann::json j;
+        ifs >> j;
+        label = j.value("label", "");
+        for (const auto& r : j.at("results")) baseline[r.at("name").get<std::string>()] = r;
+    } catch (const nlohmann::json::exception& e) {
+        std::cout << "Error! Invalid baseline >" << baselineFile << "<: " << e.what() << "\n";
+        return -1;
+    }
+
+    std::cout << "\nCompared with >" << baselineFile << "< (" << label << "), threshold "
+              << threshold * 100.0 << "%\n";
+    int regressions = 0;
+    for (const auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            std::cout << std::left << std::setw(28) << r.name << " not in the baseline\n";
+            continue;
+        }
+        const double baseNs = it->second.at("ns_per_op").get<double>();
+        const double baseAllocs = it->second.value("allocs_per_op", 0.0);
+        const double change = baseNs > 0.0 ? r.nsPerOp / baseNs - 1.0 : 0.0;
+        // Allocations do not depend on the machine: more than the threshold and half an allocation is a regression
+        const bool slower = change > threshold;
+        const bool allocates = r.allocsPerOp > baseAllocs * (1.0 + threshold) + 0.5;
+        std::cout << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << baseNs << " -> " << std::setw(12) << r.nsPerOp << " ns/op "
+                  << std::showpos << std::setw(7) << change * 100.0 << "%" << std::noshowpos;
+        if (slower) std::cout << "  SLOWER";
+        if (allocates) std::cout << "  ALLOCATES MORE (" << baseAllocs << " -> " << r.allocsPerOp << ")";
+        // A noisy case may pass or fail by chance: its spread is reported along
+        if ((slower || allocates) && r.cv > threshold) std::cout << "  (noisy: +-" << r.cv * 100.0 << "%)";
+        std::cout << "\n";
+        if (slower || allocates) regressions++;
+    }
+    std::cout << regressions << " regressions\n";
+    return regressions;
+}
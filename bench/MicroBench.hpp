@@ -0,0 +1,105 @@
+#pragma once
+// Micro benchmark harness of micro_bench: no external library, only the standard one, json.hpp and keep()
+// of BenchCommon.hpp.
+//
+// Each case times one operation: the number of iterations of a sample is calibrated so that a sample lasts
+// about sampleMs, then `samples` samples are taken. The report of a case has the median ns/op (the figure
+// compared with the baseline), mean, standard deviation and coefficient of variation of the samples, and the
+// heap allocations per operation, counted by the replaced global operator new (see MicroBenchAlloc.cpp).
+//
+// Results are written as json (--json) in the same format read as baseline (--baseline): a case is a
+// regression if its median is slower than the baseline by more than the threshold, or if it allocates more.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "BenchCommon.hpp"
+
+/** Heap allocations (operator new) since the start of the process, from any thread. */
+uint64_t allocationCount();
+
+struct MicroResult {
+    std::string name;
+    double nsPerOp;         // median of the samples
+    double meanNs;
+    double stddevNs;
+    double cv;              // stddevNs / meanNs
+    double minNs;
+    double allocsPerOp;
+    int64_t iterations;     // per sample
+    int samples;
+};
+
+class MicroBench {
+public:
+    struct Options {
+        int samples = 15;
+        double sampleMs = 20.0;
+        std::string filter;         // only the cases whose name contains it
+    };
+
+    explicit MicroBench(const Options& options) : options(options) {}
+
+    /** Whether the case is run (see Options::filter); to skip the setup of the cases filtered out. */
+    bool selected(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    /** Times op(), one operation per call, and prints a line of the report. */
+    template <typename F>
+    void run(const std::string& name, F&& op) {
+        if (!selected(name)) return;
+        op();   // warm-up: first allocations, caches
+
+        // Iterations of a sample: doubled until a batch lasts 1/10 of a sample, then scaled
+        int64_t iterations = 1;
+        double batchNs = timeBatch(op, iterations);
+        while (batchNs < options.sampleMs * 1e5 && iterations < (int64_t(1) << 40)) {
+            iterations *= 2;
+            batchNs = timeBatch(op, iterations);
+        }
+        iterations = std::max<int64_t>(1, static_cast<int64_t>(iterations * options.sampleMs * 1e6 / batchNs));
+
+        std::vector<double> nsPerOp;
+        nsPerOp.reserve(options.samples);
+        const uint64_t allocationsBefore = allocationCount();
+        for (int s = 0; s < options.samples; s++) {
+            nsPerOp.push_back(timeBatch(op, iterations) / iterations);
+        }
+        const double allocs = static_cast<double>(allocationCount() - allocationsBefore) /
+                              (static_cast<double>(iterations) * options.samples);
+        addResult(name, nsPerOp, allocs, iterations);
+    }
+
+    const std::vector<MicroResult>& getResults() const { return results; }
+
+    /** @return Status code (0 for success, -1 if the file cannot be written). */
+    int writeJson(const std::string& file, const std::string& label) const;
+
+    /**
+     * Compares the results with a baseline written by writeJson().
+     * @param threshold Relative slowdown of the median tolerated (0.1: 10%).
+     * @return Number of regressions, or -1 if the baseline cannot be read.
+     */
+    int compare(const std::string& baselineFile, double threshold) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    template <typename F>
+    static double timeBatch(F& op, int64_t iterations) {
+        auto start = Clock::now();
+        for (int64_t i = 0; i < iterations; i++) op();
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    void addResult(const std::string& name, std::vector<double>& nsPerOp, double allocsPerOp, int64_t iterations);
+
+    Options options;
+    std::vector<MicroResult> results;
+};
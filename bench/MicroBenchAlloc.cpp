@@ -0,0 +1,33 @@
+#include "MicroBench.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Allocation counting of micro_bench (see MicroBench.hpp): the global operator new is replaced in it only.
+// The aligned and nothrow forms are not replaced; the engine uses none of them on the benchmarked paths.
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+}
+
+uint64_t allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,66 @@
+// Headless throughput benchmark of the animation evaluation stage (AnimationSystem).
+// It loads the characters of the scene, replicates them into a crowd and reports how many
+// characters per millisecond are evaluated using from 1 to N threads.
+//
+// Usage: anim_throughput [scene.json] [--chars N] [--frames F] [--threads T]
+// Run it from the directory containing the "assets" folder.
+
+#include "BenchCommon.hpp"
+#include "character/anim_system.hpp"
+
+#include <thread>
+
+int main(int argc, char* argv[]) {
+    std::string sceneFile = "assets/scene.json";
+    int charCount = 256;
+    int frames = 200;
+    int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--chars" && i + 1 < argc) charCount = std::stoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc) frames = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) maxThreads = std::stoi(argv[++i]);
+        else sceneFile = arg;
+    }
+
+    std::vector<AssetFile*> assets = loadCharacterAssets(sceneFile);
+    CharManager templates;
+    if (templates.init(sceneFile, assets.data(), {}) != 0) {
+        std::cout << "ERROR LOADING CHARACTERS\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::shared_ptr<Character>> crowd;
+    const float dt = 1.0f / 60.0f;
+
+    std::cout << "\nAnimation throughput: " << charCount << " characters, " << frames << " frames\n";
+    std::cout << "threads\tms/frame\tchars/ms\tspeedup\n";
+    double baseline = 0.0;
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        spawnCrowd(templates, charCount, crowd);
+        AnimationSystem animSystem;
+        animSystem.init(threads - 1);
+
+        // Warm-up: first samples allocate the palettes
+        for (int f = 0; f < 5; f++) {
+            animSystem.evaluate(crowd, dt);
+        }
+
+        auto start = BenchClock::now();
+        for (int f = 0; f < frames; f++) {
+            animSystem.evaluate(crowd, dt);
+        }
+        double ms = elapsedMs(start, BenchClock::now());
+        animSystem.cleanup();
+
+        double charsPerMs = static_cast<double>(charCount) * frames / ms;
+        if (threads == 1) baseline = charsPerMs;
+        std::cout << threads << "\t" << ms / frames << "\t" << charsPerMs << "\t" << charsPerMs / baseline << "\n";
+    }
+
+    crowd.clear();
+    templates.cleanup();
+    freeAssets(assets);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+// Benchmark of the per frame update of AnimatedProps.
+// For each count it builds that many props, a mix of rotators, oscillators (rotating and translating) and
+// looping keyframed paths, each moving two instances of a synthetic scene, and times update() over a
+// number of frames. No asset is loaded: the instances only carry their world matrix.
+//
+// Usage: animated_props [--counts 100,1000,10000] [--frames F] [--json file] [--label text]
+
+#include "BenchCommon.hpp"
+#include "AnimatedProps.hpp"
+
+#include <algorithm>
+
+struct PropsResult {
+    int props;
+    int instances;
+    double frameUs;     // mean update() time
+    double frameP95Us;
+    double instanceNs;  // per moved instance
+};
+
+static PropsResult runCount(int props, int frames) {
+    // Two instances per prop, spread on a line
+    const int instanceCount = 2 * props;
+    std::vector<Instance> instances(instanceCount);
+    std::vector<Instance*> refs(instanceCount);
+    std::vector<std::string> ids(instanceCount);
+    Scene scene;
+    for (int i = 0; i < instanceCount; i++) {
+        instances[i] = Instance{};
+        instances[i].Wm = glm::translate(glm::mat4(1.0f), glm::vec3(i * 2.0f, 0.0f, 0.0f));
+        refs[i] = &instances[i];
+        ids[i] = "prop-" + std::to_string(i);
+        scene.InstanceIds[ids[i]] = i;
+    }
+    scene.I = refs.data();
+    scene.InstanceCount = instanceCount;
+
+    nlohmann::json json = nlohmann::json::array();
+    for (int p = 0; p < props; p++) {
+        nlohmann::json prop = {{"id", "prop." + std::to_string(p)}, {"instances", {ids[2 * p], ids[2 * p + 1]}},
+                               {"axis", {0, 1, 0}}, {"pivot", {0.5, 0, 0}}};
+        switch (p % 4) {
+            case 0: prop["type"] = "rotator"; prop["rate"] = 30 + p % 7; break;
+            case 1: prop["type"] = "oscillator"; prop["amplitude"] = 20; prop["frequency"] = 0.5; prop["phase"] = p; break;
+            case 2: prop["type"] = "oscillator"; prop["mode"] = "translate"; prop["amplitude"] = 0.3; prop["frequency"] = 1.5; break;
+            default:
+                prop["type"] = "path";
+                prop["keys"] = {{{"time", 0}, {"offset", {0, 0, 0}}, {"angle", 0}},
+                                {{"time", 1}, {"offset", {0, 1, 0}}, {"angle", 45}},
+                                {{"time", 2}, {"offset", {1, 1, 0}}, {"angle", 90}},
+                                {{"time", 4}, {"offset", {0, 0, 0}}, {"angle", 0}}};
+        }
+        json.push_back(prop);
+    }
+
+    InteractableState state;
+    AnimatedProps animated(nullptr, &state, &scene);
+    if (animated.init(json) != 0) {
+        std::cout << "ERROR INITIALIZING ANIMATED PROPS\n";
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<double> frameUs;
+    frameUs.reserve(frames);
+    const float dt = 1.0f / 60.0f;
+    for (int f = 0; f < frames; f++) {
+        auto start = BenchClock::now();
+        animated.update(dt);
+        frameUs.push_back(elapsedMs(start, BenchClock::now()) * 1000.0);
+    }
+
+    PropsResult r{};
+    r.props = props;
+    r.instances = instanceCount;
+    if (frames > 0) {
+        double total = 0.0;
+        for (double us : frameUs) total += us;
+        r.frameUs = total / frames;
+        std::sort(frameUs.begin(), frameUs.end());
+        r.frameP95Us = frameUs[static_cast<size_t>(0.95 * (frames - 1))];
+        r.instanceNs = instanceCount > 0 ? r.frameUs * 1000.0 / instanceCount : 0.0;
+    }
+    return r;
+}
+
+static nlohmann::json resultsJson(const std::vector<PropsResult>& results) {
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& r : results) {
+        json.push_back({
+            {"props", r.props},
+            {"instances", r.instances},
+            {"frame_us_mean", r.frameUs},
+            {"frame_us_p95", r.frameP95Us},
+            {"instance_ns", r.instanceNs}
+        });
+    }
+    return json;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> counts = {100, 1000, 10000};
+    int frames = 600;
+    BenchReport report;
+
+    for (int i = 1; i < argc; i++) {
+        if (report.parseArg(argc, argv, i)) continue;
+        std::string arg = argv[i];
+        if (arg == "--counts" && i + 1 < argc) counts = parseList<int>(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc) frames = std::stoi(argv[++i]);
+        else {
+            std::cout << "Unknown argument: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<PropsResult> results;
+    std::cout << "\nprops\tinstances\tframe us\tp95 us\tns/instance\n";
+    for (int count : counts) {
+        PropsResult r = runCount(count, frames);
+        results.push_back(r);
+        std::cout << r.props << "\t" << r.instances << "\t" << r.frameUs << "\t" << r.frameP95Us << "\t" << r.instanceNs << "\n";
+    }
+
+    if (writeJsonReport(report, "animated_props", resultsJson(results)) != 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
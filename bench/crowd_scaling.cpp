@@ -0,0 +1,215 @@
+// Headless crowd-scaling benchmark of the character pipeline.
+// It loads the characters of the scene, replicates them into crowds of growing size, with random clips
+// and blend transitions, and times separately the stages that each frame goes through:
+//   advance   - AnimBlender::Advance()
+//   sample    - SkeletalAnimation::SampleTracks(): local transform of each animated node
+//   hierarchy - SkeletalAnimation::ComposeHierarchy() and getTransformMatrices(): joint matrices
+//   pack      - packJointPalette(): the 3x4 palette uploaded to the GPU by main.cpp
+// Every stage runs over all the characters before the next one starts, on a single thread.
+//
+// Besides the time per character of each stage, it reports the memory owned by a character and, as a
+// proxy of the cache misses, how much slower the sample stage gets when the characters are visited in
+// random order instead of allocation order (a ratio close to 1 means the working set still fits in cache).
+//
+// Usage: crowd_scaling [scene.json] [--counts 1,10,100,1000,10000] [--frames F] [--seed S]
+//                      [--switch-rate P] [--csv file] [--json file] [--label text]
+// Run it from the directory containing the "assets" folder.
+
+#include "BenchCommon.hpp"
+#include "character/joint_palette.hpp"
+
+#include <algorithm>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+struct CrowdResult {
+    int chars;
+    int frames;
+    double advanceNs;       // per character per frame
+    double sampleNs;
+    double hierarchyNs;
+    double packNs;
+    double totalMsPerFrame;
+    double bytesPerChar;
+    double shuffledSampleRatio;
+};
+
+/** Starts a random clip of the character, with a blend transition if requested. */
+static void startRandomClip(Character& c, std::mt19937& rng, float blendTime) {
+    AnimBlender* AB = c.getAnimBlender();
+    std::uniform_int_distribution<int> seg(0, static_cast<int>(AB->segments.size()) - 1);
+    AB->Start(seg(rng), blendTime);
+}
+
+/** Memory owned by a character (shared animation tracks excluded). */
+static size_t characterMemory(Character& c) {
+    size_t bytes = sizeof(Character) + sizeof(AnimBlender);
+    bytes += c.getAnimBlender()->segments.capacity() * sizeof(AnimBlendSegment);
+    bytes += c.getSkeletalAnimation()->getMemoryUsage();
+    // Double-buffered palette
+    bytes += 2 * c.getSkeletalAnimation()->getNTMs() * sizeof(glm::mat4);
+    return bytes;
+}
+
+static CrowdResult runCrowd(CharManager& templates, int charCount, int frames, float switchRate, std::mt19937& rng) {
+    std::vector<std::shared_ptr<Character>> crowd;
+    spawnCrowd(templates, charCount, crowd);
+
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (auto& c : crowd) {
+        startRandomClip(*c, rng, 0.0f);
+        AnimBlender* AB = c->getAnimBlender();
+        AB->segments[AB->cur].t = 5.0f * unit(rng);
+    }
+
+    const glm::mat4 AdaptMat =
+        glm::scale(glm::mat4(1.0f), glm::vec3(0.01f)) *
+        glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    std::vector<JointAffine> packed(static_cast<size_t>(charCount) * MAX_JOINTS);
+    std::vector<std::vector<glm::mat4>*> joints(charCount);
+
+    const float dt = 1.0f / 60.0f;
+    double advanceMs = 0.0, sampleMs = 0.0, hierarchyMs = 0.0, packMs = 0.0;
+    for (int f = 0; f < frames; f++) {
+        // Random transitions, outside of the measured stages
+        for (auto& c : crowd) {
+            if (unit(rng) < switchRate) startRandomClip(*c, rng, 0.3f);
+        }
+
+        auto t0 = BenchClock::now();
+        for (auto& c : crowd) {
+            c->getAnimBlender()->Advance(dt);
+        }
+        auto t1 = BenchClock::now();
+        for (auto& c : crowd) {
+            c->getSkeletalAnimation()->SampleTracks(*c->getAnimBlender());
+        }
+        auto t2 = BenchClock::now();
+        for (int i = 0; i < charCount; i++) {
+            SkeletalAnimation* SKA = crowd[i]->getSkeletalAnimation();
+            SKA->ComposeHierarchy();
+            joints[i] = SKA->getTransformMatrices();
+        }
+        auto t3 = BenchClock::now();
+        for (int i = 0; i < charCount; i++) {
+            int count = std::min(static_cast<int>(joints[i]->size()), MAX_JOINTS);
+            packJointPalette(*joints[i], AdaptMat, &packed[static_cast<size_t>(i) * MAX_JOINTS], count);
+        }
+        auto t4 = BenchClock::now();
+
+        advanceMs += elapsedMs(t0, t1);
+        sampleMs += elapsedMs(t1, t2);
+        hierarchyMs += elapsedMs(t2, t3);
+        packMs += elapsedMs(t3, t4);
+    }
+
+    // Cache-miss proxy: same sample stage, visiting the characters in allocation and in random order
+    std::vector<int> order(charCount);
+    for (int i = 0; i < charCount; i++) order[i] = i;
+    std::vector<int> shuffled = order;
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+    auto sampleInOrder = [&](const std::vector<int>& o) {
+        auto start = BenchClock::now();
+        for (int f = 0; f < frames; f++) {
+            for (int i : o) crowd[i]->getSkeletalAnimation()->SampleTracks(*crowd[i]->getAnimBlender());
+        }
+        return elapsedMs(start, BenchClock::now());
+    };
+    double linearMs = sampleInOrder(order);
+    double shuffledMs = sampleInOrder(shuffled);
+
+    size_t bytes = 0;
+    for (auto& c : crowd) bytes += characterMemory(*c);
+
+    const double perCharNs = 1e6 / (static_cast<double>(charCount) * frames);
+    CrowdResult r{};
+    r.chars = charCount;
+    r.frames = frames;
+    r.advanceNs = advanceMs * perCharNs;
+    r.sampleNs = sampleMs * perCharNs;
+    r.hierarchyNs = hierarchyMs * perCharNs;
+    r.packNs = packMs * perCharNs;
+    r.totalMsPerFrame = (advanceMs + sampleMs + hierarchyMs + packMs) / frames;
+    r.bytesPerChar = static_cast<double>(bytes) / charCount;
+    r.shuffledSampleRatio = linearMs > 0.0 ? shuffledMs / linearMs : 0.0;
+    return r;
+}
+
+static void writeCsv(const std::string& file, const std::string& label, const std::vector<CrowdResult>& results) {
+    std::ofstream out(file);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write >" << file << "<\n";
+        return;
+    }
+    out << "label,chars,frames,advance_ns,sample_ns,hierarchy_ns,pack_ns,ms_per_frame,bytes_per_char,shuffled_sample_ratio\n";
+    for (const auto& r : results) {
+        out << label << "," << r.chars << "," << r.frames << "," << r.advanceNs << "," << r.sampleNs << ","
+            << r.hierarchyNs << "," << r.packNs << "," << r.totalMsPerFrame << "," << r.bytesPerChar << ","
+            << r.shuffledSampleRatio << "\n";
+    }
+}
+
+static nlohmann::json resultsJson(const std::vector<CrowdResult>& results) {
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& r : results) {
+        json.push_back({
+            {"chars", r.chars},
+            {"frames", r.frames},
+            {"advance_ns", r.advanceNs},
+            {"sample_ns", r.sampleNs},
+            {"hierarchy_ns", r.hierarchyNs},
+            {"pack_ns", r.packNs},
+            {"ms_per_frame", r.totalMsPerFrame},
+            {"bytes_per_char", r.bytesPerChar},
+            {"shuffled_sample_ratio", r.shuffledSampleRatio}
+        });
+    }
+    return json;
+}
+
+int main(int argc, char* argv[]) {
+    std::string sceneFile = "assets/scene.json";
+    std::vector<int> counts = {1, 10, 100, 1000, 10000};
+    int frames = 100;
+    unsigned int seed = 1234;
+    float switchRate = 0.02f;
+    std::string csvFile;
+    BenchReport report;
+
+    for (int i = 1; i < argc; i++) {
+        if (report.parseArg(argc, argv, i)) continue;
+        std::string arg = argv[i];
+        if (arg == "--counts" && i + 1 < argc) counts = parseList<int>(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc) frames = std::stoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = static_cast<unsigned int>(std::stoul(argv[++i]));
+        else if (arg == "--switch-rate" && i + 1 < argc) switchRate = std::stof(argv[++i]);
+        else if (arg == "--csv" && i + 1 < argc) csvFile = argv[++i];
+        else sceneFile = arg;
+    }
+
+    std::vector<AssetFile*> assets = loadCharacterAssets(sceneFile);
+    CharManager templates;
+    if (templates.init(sceneFile, assets.data(), {}) != 0) {
+        std::cout << "ERROR LOADING CHARACTERS\n";
+        return EXIT_FAILURE;
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<CrowdResult> results;
+    std::cout << "\nCrowd scaling: " << frames << " frames, times in ns per character\n";
+    std::cout << "chars\tadvance\tsample\thierarchy\tpack\tms/frame\tbytes/char\tshuffled/linear\n";
+    for (int count : counts) {
+        CrowdResult r = runCrowd(templates, count, frames, switchRate, rng);
+        results.push_back(r);
+        std::cout << r.chars << "\t" << r.advanceNs << "\t" << r.sampleNs << "\t" << r.hierarchyNs << "\t"
+                  << r.packNs << "\t" << r.totalMsPerFrame << "\t" << r.bytesPerChar << "\t"
+                  << r.shuffledSampleRatio << "\n";
+    }
+
+    if (!csvFile.empty()) writeCsv(csvFile, report.label, results);
+    const int status = writeJsonReport(report, "crowd_scaling", resultsJson(results));
+
+    templates.cleanup();
+    freeAssets(assets);
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
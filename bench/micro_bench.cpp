@@ -0,0 +1,277 @@
+// Micro benchmarks of the hot CPU paths, with the harness of MicroBench.hpp.
+// Cases (each timing one call):
+//    - anim_track_sample, anim_track_blend: AnimTrack::Sample() and Blend() on synthetic 60 keyframe tracks
+//    - skeletal_sample: SkeletalAnimation::Sample() of the first character of the scene
+//    - scene_json_parse: parsing of the scene file, the first step of Scene::init() (the rest of it creates
+//      Vulkan resources); the file is read once, so the disk is not timed
+//    - gltf_make_mesh: Model::makeGLTFMesh() of the largest primitive of the buildings
+//    - shape_from_model: PhysicsManager::getShapeFromModel() of the same mesh
+//    - physics_check_grounded: PhysicsManager::checkGrounded() of a walking capsule among boxes
+//    - nearest_character: CharManager::getNearestCharacter() among 256 characters spread over the village
+//    - text_measure: TextMaker::measureText() of a wrapped dialogue
+//    - wrap_text_cold, wrap_text_warm: wrapText() of a dialogue, without and with its memo
+// No window nor Vulkan device is created.
+//
+// Usage: micro_bench [scene.json] [--filter text] [--samples N] [--sample-ms MS] [--json file] [--label text]
+//                    [--baseline file] [--threshold 0.1]
+// Run it from the directory containing the "assets" folder. The exit code is 1 if a case regressed
+// with respect to the baseline; a baseline is the --json output of a reference run.
+
+#include "BenchCommon.hpp"
+#include "MicroBench.hpp"
+#include "PhysicsManager.hpp"
+#include "modules/TextMaker.hpp"
+#include "Utils.hpp"
+
+#include <random>
+
+namespace {
+
+struct BenchVertex {
+    glm::vec3 pos;
+    glm::vec3 norm;
+    glm::vec2 UV;
+};
+
+/** Two seconds at 30 FPS of a bone swinging around: random, but the same for every run. */
+AnimTrack makeTrack(unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    AnimTrack track;
+    track.nKeyFrames = 60;
+    for (int k = 0; k < track.nKeyFrames; k++) {
+        AnimFrame frame;
+        frame.time = k / 30.0f;
+        frame.T = glm::vec3(unit(rng), unit(rng), unit(rng));
+        frame.Q = glm::normalize(glm::quat(1.0f + unit(rng), unit(rng), unit(rng), unit(rng)));
+        frame.S = glm::vec3(1.0f);
+        track.Frames.push_back(frame);
+    }
+    return track;
+}
+
+void benchAnimTracks(MicroBench& bench) {
+    AnimTrack trackA = makeTrack(1);
+    AnimTrack trackB = makeTrack(2);
+    float t = 0.0f;
+    bench.run("anim_track_sample", [&]() {
+        keep(trackA.Sample(t, 0, -1, true));
+        t = t < 100.0f ? t + 0.0173f : 0.0f;
+    });
+    bench.run("anim_track_blend", [&]() {
+        keep(trackA.Blend(0.4f, t, 0, -1, t * 1.3f, 0, -1, &trackB));
+        t = t < 100.0f ? t + 0.0173f : 0.0f;
+    });
+}
+
+void benchCharacters(MicroBench& bench, const std::string& sceneFile) {
+    if (!bench.selected("skeletal_sample") && !bench.selected("nearest_character")) return;
+
+    std::vector<AssetFile*> assets = loadCharacterAssets(sceneFile);
+    CharManager templates;
+    if (templates.init(sceneFile, assets.data(), {}) != 0 || templates.getCharacters().empty()) {
+        std::cout << "ERROR LOADING CHARACTERS\n";
+        exit(EXIT_FAILURE);
+    }
+
+    Character& character = *templates.getCharacters()[0];
+    bench.run("skeletal_sample", [&]() {
+        character.getAnimBlender()->Advance(1.0f / 60.0f);
+        character.getSkeletalAnimation()->Sample(*character.getAnimBlender());
+        keep(character.getSkeletalAnimation()->getTransformMatrices()->front());
+    });
+
+    // Crowd over the village (about 200 x 200 m), queried from random points
+    std::vector<std::shared_ptr<Character>> crowd;
+    spawnCrowd(templates, 256, crowd);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+    CharManager manager;
+    for (auto& c : crowd) {
+        c->setPosition(glm::vec3(coord(rng), 0.0f, coord(rng)));
+        manager.addChar(c);
+    }
+    std::vector<glm::vec3> queries(1024);
+    for (auto& q : queries) q = glm::vec3(coord(rng), 0.0f, coord(rng));
+    size_t next = 0;
+    bench.run("nearest_character", [&]() {
+        keep(manager.getNearestCharacter(queries[next]));
+        next = (next + 1) % queries.size();
+    });
+
+    crowd.clear();
+    templates.cleanup();
+    freeAssets(assets);
+}
+
+void benchScene(MicroBench& bench, const std::string& sceneFile) {
+    if (!bench.selected("scene_json_parse")) return;
+    std::ifstream ifs(sceneFile);
+    if (!ifs.is_open()) {
+        std::cout << "Error! Scene file >" << sceneFile << "< not found!\n";
+        exit(EXIT_FAILURE);
+    }
+    const std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    bench.run("scene_json_parse", [&]() {
+        keep(nlohmann::json::parse(text).size());
+    });
+}
+
+void benchMeshes(MicroBench& bench, const std::string& assetFile) {
+    if (!bench.selected("gltf_make_mesh") && !bench.selected("shape_from_model")) return;
+
+    AssetFile asset;
+    asset.init(assetFile, GLTF);
+    tinygltf::Model* gltf = asset.getGLTFmodel();
+    const tinygltf::Primitive* largest = nullptr;
+    size_t largestCount = 0;
+    for (const auto& mesh : gltf->meshes) {
+        for (const auto& primitive : mesh.primitives) {
+            auto pos = primitive.attributes.find("POSITION");
+            if (pos == primitive.attributes.end() || primitive.indices < 0) continue;
+            const size_t count = gltf->accessors[pos->second].count;
+            if (count > largestCount) {
+                largestCount = count;
+                largest = &primitive;
+            }
+        }
+    }
+    if (largest == nullptr) {
+        std::cout << "Error! No mesh in >" << assetFile << "<\n";
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "mesh: " << largestCount << " vertices\n";
+
+    VertexDescriptor VD;
+    VD.init(nullptr, {
+            {0, sizeof(BenchVertex), VK_VERTEX_INPUT_RATE_VERTEX}
+        }, {
+            {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(BenchVertex, pos),  sizeof(glm::vec3), POSITION},
+            {0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(BenchVertex, norm), sizeof(glm::vec3), NORMAL},
+            {0, 2, VK_FORMAT_R32G32_SFLOAT,    offsetof(BenchVertex, UV),   sizeof(glm::vec2), UV}
+    });
+    Model model;
+    model.VD = &VD;
+    bench.run("gltf_make_mesh", [&]() {
+        model.vertices.clear();
+        model.indices.clear();
+        model.makeGLTFMesh(gltf, largest);
+        keep(model.vertices.size());
+    });
+
+    if (model.vertices.empty()) model.makeGLTFMesh(gltf, largest);
+    bench.run("shape_from_model", [&]() {
+        btCollisionShape* shape = PhysicsManager::getShapeFromModel(&model);
+        keep(shape);
+        if (shape != nullptr) {
+            delete static_cast<btBvhTriangleMeshShape*>(shape)->getMeshInterface();
+            delete shape;
+        }
+    });
+    asset.cleanup();
+}
+
+void benchPhysics(MicroBench& bench) {
+    if (!bench.selected("physics_check_grounded")) return;
+
+    PhysicsManager physics;
+    if (!physics.initialize(false)) {
+        std::cout << "ERROR INITIALIZING PHYSICS\n";
+        exit(EXIT_FAILURE);
+    }
+    // Crates around the player, so that the probe has some neighbours in the broadphase
+    for (int x = -3; x <= 3; x++) {
+        for (int z = -3; z <= 3; z++) {
+            if (x == 0 && z == 0) continue;
+            physics.addStaticBox(glm::vec3(x * 3.0f, 0.25f, z * 3.0f), glm::vec3(1.0f, 0.5f, 1.0f));
+        }
+    }
+    physics.addCapsulePlayer();
+    // Walking: the probe also looks for a step ahead
+    physics.movePlayer(glm::vec3(1.0f, 0.0f, 0.0f));
+    for (int i = 0; i < 30; i++) physics.update(1.0f / 60.0f);
+
+    bench.run("physics_check_grounded", [&]() {
+        keep(physics.checkGrounded());
+    });
+    physics.cleanup();
+}
+
+void benchText(MicroBench& bench, const std::string& sceneFile) {
+    if (!bench.selected("text_measure") && !bench.selected("wrap_text_cold") && !bench.selected("wrap_text_warm")) return;
+
+    nlohmann::json sceneJson = readJsonFile(sceneFile);
+    std::string dialogue;
+    for (const auto& charJson : sceneJson["characters"]) {
+        for (const auto& line : charJson.value("dialogues", std::vector<std::string>{})) {
+            dialogue += line + " ";
+        }
+    }
+    if (dialogue.empty()) dialogue = "Greetings Sir, welcome back to our village! ";
+    while (dialogue.size() < 512) dialogue += dialogue;
+    dialogue.resize(512);
+
+    TextMaker txt;
+    const std::string wrapped = wrapText(dialogue, 25);
+    std::vector<int> lineWidths;
+    std::vector<std::string> lines;
+    bench.run("text_measure", [&]() {
+        int fontId = 8, w, h, nlines, totChars;
+        lineWidths.clear();
+        lines.clear();
+        txt.measureText(wrapped, fontId, w, h, nlines, totChars, lineWidths, lines);
+        keep(w);
+    });
+
+    bench.run("wrap_text_cold", [&]() {
+        clearWrapTextMemo();
+        keep(wrapText(dialogue, 25));
+    });
+    bench.run("wrap_text_warm", [&]() {
+        keep(wrapText(dialogue, 25));
+    });
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string sceneFile = "assets/scene.json";
+    std::string meshFile = "assets/models/Buildings.gltf";
+    std::string jsonFile, baselineFile, label = "local";
+    double threshold = 0.1;
+    MicroBench::Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) options.filter = argv[++i];
+        else if (arg == "--samples" && i + 1 < argc) options.samples = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--sample-ms" && i + 1 < argc) options.sampleMs = std::stod(argv[++i]);
+        else if (arg == "--json" && i + 1 < argc) jsonFile = argv[++i];
+        else if (arg == "--label" && i + 1 < argc) label = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc) baselineFile = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc) threshold = std::stod(argv[++i]);
+        else if (arg.rfind("--", 0) != 0) sceneFile = arg;
+        else {
+            std::cout << "Unknown argument: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    MicroBench bench(options);
+    std::cout << "\nMicro benchmarks: " << options.samples << " samples of " << options.sampleMs << " ms\n";
+    benchAnimTracks(bench);
+    benchCharacters(bench, sceneFile);
+    benchScene(bench, sceneFile);
+    benchMeshes(bench, meshFile);
+    benchPhysics(bench);
+    benchText(bench, sceneFile);
+
+    if (!jsonFile.empty()) bench.writeJson(jsonFile, label);
+    if (baselineFile.empty()) return EXIT_SUCCESS;
+    std::ifstream baseline(baselineFile);
+    if (!baseline.is_open()) {
+        std::cout << "No baseline >" << baselineFile << "< yet: write it with --json on the reference machine\n";
+        return EXIT_SUCCESS;
+    }
+    return bench.compare(baselineFile, threshold) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
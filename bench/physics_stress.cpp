@@ -0,0 +1,133 @@
+// Headless stress test of the dynamics world.
+// Thousands of boxes are dropped in a loose pile on the fallback ground plane of PhysicsManager, and the
+// world is stepped at the fixed tick rate, once for each requested thread count. A thread count of 1 uses
+// the single threaded btDiscreteDynamicsWorld; higher counts use Bullet's multithreaded world and solver
+// pool (see PhysicsWorldConfig), which needs Bullet built with BT_THREADSAFE (PHYSICS_MULTITHREADING=ON):
+// without it every run is single threaded, and the report says so.
+//
+// For each run it reports the mean and 95th percentile time of a step, and how many bodies are still
+// awake at the end (sleeping bodies are skipped by the solver, so they matter for the step time).
+//
+// Usage: physics_stress [--bodies N] [--frames F] [--threads 1,2,4,8] [--seed S] [--json file] [--label text]
+
+#include "BenchCommon.hpp"
+#include "PhysicsManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+struct StressResult {
+    int threads;
+    int bodies;
+    int frames;
+    double meanMs;
+    double p95Ms;
+    int awakeAtEnd;
+};
+
+static StressResult runStress(int threads, int bodyCount, int frames, unsigned int seed) {
+    PhysicsManager physics;
+    PhysicsWorldConfig worldConfig;
+    worldConfig.solverThreads = threads > 1 ? threads : 0;
+    physics.setWorldConfig(worldConfig);
+    if (!physics.initialize(false)) {
+        std::cout << "ERROR INITIALIZING PHYSICS\n";
+        exit(EXIT_FAILURE);
+    }
+
+    // Boxes on a square grid of columns, a bit apart and randomly rotated, so that the pile collapses
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    DynamicPropConfig config;
+    config.mass = 10.0f;
+    config.startAsleep = false;
+    const float size = 0.5f;
+    const int side = std::max(1, static_cast<int>(std::ceil(std::sqrt(bodyCount / 10.0f))));
+    for (int i = 0; i < bodyCount; i++) {
+        int column = i % (side * side);
+        int layer = i / (side * side);
+        btTransform transform;
+        transform.setIdentity();
+        transform.setOrigin(btVector3((column % side - side * 0.5f) * size * 1.5f,
+                                      -1.0f + layer * size * 1.2f,
+                                      (column / side - side * 0.5f) * size * 1.5f));
+        transform.setRotation(btQuaternion(btVector3(0, 1, 0), angle(rng)));
+        physics.addDynamicBody(new btBoxShape(btVector3(size, size, size) * 0.5f), transform, config);
+    }
+
+    const float dt = 1.0f / 60.0f;
+    std::vector<double> stepMs;
+    stepMs.reserve(frames);
+    for (int f = 0; f < frames; f++) {
+        auto start = BenchClock::now();
+        physics.update(dt);
+        stepMs.push_back(elapsedMs(start, BenchClock::now()));
+    }
+
+    StressResult r{};
+    r.threads = threads;
+    r.bodies = bodyCount;
+    r.frames = frames;
+    double total = 0.0;
+    for (double ms : stepMs) total += ms;
+    r.meanMs = frames > 0 ? total / frames : 0.0;
+    std::sort(stepMs.begin(), stepMs.end());
+    r.p95Ms = frames > 0 ? stepMs[static_cast<size_t>(0.95 * (frames - 1))] : 0.0;
+    r.awakeAtEnd = physics.getAwakeDynamicCount();
+
+    physics.cleanup();
+    return r;
+}
+
+static nlohmann::json resultsJson(const std::vector<StressResult>& results) {
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& r : results) {
+        json.push_back({
+            {"threads", r.threads},
+            {"bodies", r.bodies},
+            {"frames", r.frames},
+            {"step_ms_mean", r.meanMs},
+            {"step_ms_p95", r.p95Ms},
+            {"awake_at_end", r.awakeAtEnd}
+        });
+    }
+    return json;
+}
+
+int main(int argc, char* argv[]) {
+    int bodies = 3000;
+    int frames = 600;
+    unsigned int seed = 1234;
+    std::vector<int> threadCounts = {1, 2, 4};
+    if (std::thread::hardware_concurrency() > 4) {
+        threadCounts.push_back(static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    BenchReport report;
+
+    for (int i = 1; i < argc; i++) {
+        if (report.parseArg(argc, argv, i)) continue;
+        std::string arg = argv[i];
+        if (arg == "--bodies" && i + 1 < argc) bodies = std::stoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc) frames = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) threadCounts = parseList<int>(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = static_cast<unsigned int>(std::stoul(argv[++i]));
+    }
+
+#if !BT_THREADSAFE
+    std::cout << "Note: Bullet built without BT_THREADSAFE, all the runs are single threaded\n";
+#endif
+
+    std::vector<StressResult> results;
+    std::cout << "\nPhysics stress: " << bodies << " boxes, " << frames << " frames of 1/60 s\n";
+    std::cout << "threads\tmean ms\tp95 ms\tawake at end\n";
+    for (int threads : threadCounts) {
+        StressResult r = runStress(threads, bodies, frames, seed);
+        results.push_back(r);
+        std::cout << r.threads << "\t" << r.meanMs << "\t" << r.p95Ms << "\t" << r.awakeAtEnd << "\n";
+    }
+
+    if (writeJsonReport(report, "physics_stress", resultsJson(results)) != 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+// Benchmark of the proximity queries of SpatialGrid (used by CharManager and InteractionsManager).
+// Entities are scattered on a square area with a constant density (about one every --area square meters),
+// a fraction of them tagged as "idle", and moved by a small random step before every batch of queries,
+// as the characters are each frame. For each count it times:
+//   update  - SpatialGrid::update() of every entity (the incremental refresh of a frame)
+//   nearest - nearest idle entity within 5 m of a random point (as CharManager::getNearestCharacter())
+//   knn     - the 8 nearest entities within 20 m
+//   radius  - all the entities within 10 m
+//   linear  - the nearest query done as a linear scan, as it was before the index (skipped above --max-linear)
+// Query times are per query, update times per entity.
+//
+// Usage: proximity_queries [--counts 1000,10000,50000] [--queries Q] [--area A] [--cell C] [--seed S]
+//                          [--max-linear N] [--json file] [--label text]
+
+#include "BenchCommon.hpp"
+#include "SpatialGrid.hpp"
+
+#include <cmath>
+#include <random>
+
+struct ProximityResult {
+    int entities;
+    double updateNs;
+    double nearestNs;
+    double knnNs;
+    double radiusNs;
+    double linearNs;    // < 0 if skipped
+    double meanRadiusHits;
+};
+
+static double elapsedNs(BenchClock::time_point from, BenchClock::time_point to, int count) {
+    return count > 0 ? elapsedMs(from, to) * 1.0e6 / count : 0.0;
+}
+
+static ProximityResult runCount(int entities, int queries, float area, float cellSize, int maxLinear, unsigned int seed) {
+    const uint32_t TAG_IDLE = 1u << 0, TAG_BUSY = 1u << 1;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float side = std::sqrt(entities * area);
+
+    SpatialGrid grid(cellSize);
+    std::vector<glm::vec3> positions(entities);
+    std::vector<bool> idle(entities);
+    std::vector<int> handles(entities);
+    for (int i = 0; i < entities; i++) {
+        positions[i] = glm::vec3(unit(rng) * side, unit(rng) * 2.0f, unit(rng) * side);
+        idle[i] = unit(rng) < 0.5f;
+        handles[i] = grid.insert(positions[i], idle[i] ? TAG_IDLE : TAG_BUSY);
+    }
+    std::vector<glm::vec3> points(queries);
+    for (auto& p : points) p = glm::vec3(unit(rng) * side, 1.0f, unit(rng) * side);
+
+    ProximityResult r{};
+    r.entities = entities;
+
+    // Everybody walks a few centimeters, as in a frame
+    for (auto& p : positions) p += glm::vec3(unit(rng) - 0.5f, 0.0f, unit(rng) - 0.5f) * 0.1f;
+    auto start = BenchClock::now();
+    for (int i = 0; i < entities; i++) grid.update(handles[i], positions[i]);
+    r.updateNs = elapsedNs(start, BenchClock::now(), entities);
+
+    long long checksum = 0;
+    start = BenchClock::now();
+    for (const auto& p : points) checksum += grid.nearest(p, 5.0f, TAG_IDLE);
+    r.nearestNs = elapsedNs(start, BenchClock::now(), queries);
+
+    std::vector<SpatialGrid::Hit> hits;
+    start = BenchClock::now();
+    for (const auto& p : points) {
+        grid.kNearest(p, 8, 20.0f, SpatialGrid::ALL_TAGS, hits);
+        checksum += static_cast<long long>(hits.size());
+    }
+    r.knnNs = elapsedNs(start, BenchClock::now(), queries);
+
+    long long radiusHits = 0;
+    start = BenchClock::now();
+    for (const auto& p : points) {
+        grid.queryRadius(p, 10.0f, SpatialGrid::ALL_TAGS, hits);
+        radiusHits += static_cast<long long>(hits.size());
+    }
+    r.radiusNs = elapsedNs(start, BenchClock::now(), queries);
+    r.meanRadiusHits = queries > 0 ? static_cast<double>(radiusHits) / queries : 0.0;
+
+    r.linearNs = -1.0;
+    if (entities <= maxLinear) {
+        start = BenchClock::now();
+        for (const auto& p : points) {
+            int nearest = -1;
+            float minDist = 5.0f;
+            for (int i = 0; i < entities; i++) {
+                float dist = glm::distance(positions[i], p);
+                if (dist < minDist && idle[i]) {
+                    minDist = dist;
+                    nearest = i;
+                }
+            }
+            checksum -= nearest;
+        }
+        r.linearNs = elapsedNs(start, BenchClock::now(), queries);
+    }
+    // Keeps the queries from being optimized away
+    keep(checksum);
+    return r;
+}
+
+static nlohmann::json resultsJson(const std::vector<ProximityResult>& results) {
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& r : results) {
+        nlohmann::json jr = {
+            {"entities", r.entities},
+            {"update_ns", r.updateNs},
+            {"nearest_ns", r.nearestNs},
+            {"knn_ns", r.knnNs},
+            {"radius_ns", r.radiusNs},
+            {"radius_hits", r.meanRadiusHits}
+        };
+        if (r.linearNs >= 0.0) jr["linear_ns"] = r.linearNs;
+        json.push_back(jr);
+    }
+    return json;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> counts = {1000, 10000, 50000};
+    int queries = 100000;
+    float area = 20.0f;
+    float cellSize = 8.0f;
+    int maxLinear = 50000;
+    unsigned int seed = 1234;
+    BenchReport report;
+
+    for (int i = 1; i < argc; i++) {
+        if (report.parseArg(argc, argv, i)) continue;
+        std::string arg = argv[i];
+        if (arg == "--counts" && i + 1 < argc) counts = parseList<int>(argv[++i]);
+        else if (arg == "--queries" && i + 1 < argc) queries = std::stoi(argv[++i]);
+        else if (arg == "--area" && i + 1 < argc) area = std::stof(argv[++i]);
+        else if (arg == "--cell" && i + 1 < argc) cellSize = std::stof(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = static_cast<unsigned int>(std::stoul(argv[++i]));
+        else if (arg == "--max-linear" && i + 1 < argc) maxLinear = std::stoi(argv[++i]);
+        else {
+            std::cout << "Unknown argument: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<ProximityResult> results;
+    std::cout << "\nentities\tupdate ns\tnearest ns\tknn ns\tradius ns\thits\tlinear ns\n";
+    for (int count : counts) {
+        ProximityResult r = runCount(count, queries, area, cellSize, maxLinear, seed);
+        results.push_back(r);
+        std::cout << r.entities << "\t" << r.updateNs << "\t" << r.nearestNs << "\t" << r.knnNs << "\t"
+                  << r.radiusNs << "\t" << r.meanRadiusHits << "\t";
+        if (r.linearNs >= 0.0) std::cout << r.linearNs;
+        else std::cout << "-";
+        std::cout << "\n";
+    }
+
+    if (writeJsonReport(report, "proximity_queries", resultsJson(results), {{"cell_size", cellSize}}) != 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
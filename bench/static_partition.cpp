@@ -0,0 +1,245 @@
+// Benchmark of the partition of the static collision world (see StaticWorldPartition).
+// Each world is built once for each requested cell size (0 = one collision object per instance), then:
+//   rays  - random queries through PhysicsManager::rayCast(): half of them vertical, from above the world
+//           down to the ground (as a ground snap), half horizontal at chest height (as a line of sight)
+//   step  - the capsule player walking around for a number of fixed ticks (ground probe, steps, contacts)
+//
+// The worlds are:
+//   scene     - the static world of the scene, as baked by the game in "<scene>.physcache" (run the game
+//               once to create it); the terrain heightfield is not part of the bake, the flat fallback
+//               ground is used instead
+//   synthetic - a generated village with 10 times the static instances of the scene (or --shapes), at about
+//               the same density: houses made of walls and roofs, and props scattered between them
+//
+// Usage: static_partition [scene.json] [--cells 0,16,32,64] [--rays N] [--frames F] [--shapes N]
+//                         [--seed S] [--json file] [--label text]
+// Run it from the directory containing the "assets" folder.
+
+#include "BenchCommon.hpp"
+#include "PhysicsManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+struct PartitionResult {
+    std::string world;
+    float cellSize;
+    int shapes;
+    int objects;        // collision objects in the broadphase
+    double buildMs;
+    double rayUs;       // per ray
+    double hitRate;
+    double stepMeanMs;  // per tick
+    double stepP95Ms;
+};
+
+/** A world to build: static shapes at their transforms, and the shapes owned for it. */
+struct BenchWorld {
+    std::string name;
+    std::string sceneFile;      // baked world to load (scene), or empty
+    std::vector<StaticWorldPartition::Entry> entries;
+    std::vector<std::unique_ptr<btCollisionShape>> shapes;
+};
+
+/*
+ * A village of primitives: each house is four walls and a roof, each prop a box or a cylinder (crates,
+ * barrels), spread on a square area with about the density of the scene.
+ */
+static void buildSyntheticVillage(BenchWorld& world, int shapeCount, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // A few prototypes, shared by all the instances (as the scene shares one mesh per model)
+    auto makeBox = [&](float x, float y, float z) {
+        world.shapes.push_back(std::make_unique<btBoxShape>(btVector3(x, y, z) * 0.5f));
+        return world.shapes.back().get();
+    };
+    btCollisionShape* wallLong = makeBox(8.0f, 3.0f, 0.3f);
+    btCollisionShape* wallShort = makeBox(0.3f, 3.0f, 6.0f);
+    btCollisionShape* roof = makeBox(8.6f, 0.4f, 6.6f);
+    std::vector<btCollisionShape*> props = {makeBox(0.8f, 0.8f, 0.8f), makeBox(1.2f, 0.6f, 0.8f), makeBox(2.0f, 1.0f, 0.5f)};
+    world.shapes.push_back(std::make_unique<btCylinderShape>(btVector3(0.35f, 0.5f, 0.35f)));
+    props.push_back(world.shapes.back().get());
+    world.shapes.push_back(std::make_unique<btCylinderShape>(btVector3(0.1f, 1.2f, 0.1f)));
+    props.push_back(world.shapes.back().get());
+
+    // About 40 m^2 per instance
+    const float side = std::sqrt(shapeCount * 40.0f);
+    auto place = [&](btCollisionShape* shape, const btTransform& base, const btVector3& offset) {
+        btTransform t = base;
+        t.setOrigin(base * offset);
+        world.entries.push_back({shape, t});
+    };
+    while (static_cast<int>(world.entries.size()) < shapeCount) {
+        btTransform base;
+        base.setIdentity();
+        base.setOrigin(btVector3((unit(rng) - 0.5f) * side, 0.0f, (unit(rng) - 0.5f) * side));
+        base.setRotation(btQuaternion(btVector3(0, 1, 0), unit(rng) * 6.2831853f));
+        if (unit(rng) < 0.15f) {
+            place(wallLong, base, btVector3(0.0f, 1.5f, -3.0f));
+            place(wallLong, base, btVector3(0.0f, 1.5f, 3.0f));
+            place(wallShort, base, btVector3(-4.0f, 1.5f, 0.0f));
+            place(wallShort, base, btVector3(4.0f, 1.5f, 0.0f));
+            place(roof, base, btVector3(0.0f, 3.2f, 0.0f));
+        } else {
+            btCollisionShape* prop = props[static_cast<size_t>(unit(rng) * props.size()) % props.size()];
+            btVector3 aabbMin, aabbMax;
+            btTransform identity;
+            identity.setIdentity();
+            prop->getAabb(identity, aabbMin, aabbMax);
+            place(prop, base, btVector3(0.0f, -aabbMin.y(), 0.0f));
+        }
+    }
+}
+
+static PartitionResult runWorld(const BenchWorld& world, float cellSize, int rays, int frames, unsigned int seed) {
+    PhysicsManager physics;
+    StaticWorldPartition::Config partition;
+    partition.cellSize = cellSize;
+    physics.setStaticPartitionConfig(partition);
+    if (!physics.initialize(false, world.sceneFile)) {
+        std::cout << "ERROR INITIALIZING PHYSICS\n";
+        exit(EXIT_FAILURE);
+    }
+    physics.addStaticShapes(world.entries);
+    physics.addCapsulePlayer();
+
+    PartitionResult r{};
+    r.world = world.name;
+    r.cellSize = cellSize;
+    r.shapes = physics.getStaticPartitionStats().sourceShapes;
+    r.objects = physics.getNumRigidBodies();
+    r.buildMs = physics.getStaticPartitionStats().buildMs;
+
+    glm::vec3 bMin, bMax;
+    if (!physics.getStaticWorldBounds(bMin, bMax)) {
+        return r;
+    }
+    if (cellSize <= 0.0f) {
+        r.shapes = r.objects - 2;       // without the partition every shape is a body, plus ground and player
+    }
+    // The fallback ground plane is huge: query the area of the static world around it
+    glm::vec3 qMin = bMin, qMax = bMax;
+    qMin.y = std::max(qMin.y, -10.0f);
+    qMax.y = std::max(qMax.y, qMin.y + 1.0f);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    int hits = 0;
+    auto start = BenchClock::now();
+    for (int i = 0; i < rays; i++) {
+        glm::vec3 p(qMin.x + unit(rng) * (qMax.x - qMin.x), 0.0f, qMin.z + unit(rng) * (qMax.z - qMin.z));
+        glm::vec3 from, to, hit;
+        if (i % 2 == 0) {
+            from = glm::vec3(p.x, qMax.y + 1.0f, p.z);
+            to = glm::vec3(p.x, qMin.y - 1.0f, p.z);
+        } else {
+            float a = unit(rng) * 6.2831853f;
+            from = glm::vec3(p.x, 1.2f, p.z);
+            to = from + glm::vec3(std::cos(a), 0.0f, std::sin(a)) * 30.0f;
+        }
+        if (physics.rayCast(from, to, hit)) hits++;
+    }
+    r.rayUs = rays > 0 ? elapsedMs(start, BenchClock::now()) * 1000.0 / rays : 0.0;
+    r.hitRate = rays > 0 ? static_cast<double>(hits) / rays : 0.0;
+
+    // The player walks in a slowly turning direction, from the middle of the world (or the scene start)
+    if (world.sceneFile.empty()) {
+        physics.setPlayerPosition(glm::vec3(0.5f * (qMin.x + qMax.x), 1.0f, 0.5f * (qMin.z + qMax.z)));
+    }
+    const float dt = 1.0f / 60.0f;
+    std::vector<double> stepMs;
+    stepMs.reserve(frames);
+    for (int f = 0; f < frames; f++) {
+        float a = f * dt * 0.5f;
+        physics.movePlayer(glm::vec3(std::cos(a), 0.0f, std::sin(a)), f % 240 > 120);
+        if (f % 90 == 0) physics.jumpPlayer();
+        auto tickStart = BenchClock::now();
+        physics.update(dt);
+        stepMs.push_back(elapsedMs(tickStart, BenchClock::now()));
+    }
+    if (frames > 0) {
+        double total = 0.0;
+        for (double ms : stepMs) total += ms;
+        r.stepMeanMs = total / frames;
+        std::sort(stepMs.begin(), stepMs.end());
+        r.stepP95Ms = stepMs[static_cast<size_t>(0.95 * (frames - 1))];
+    }
+
+    physics.cleanup();
+    return r;
+}
+
+static nlohmann::json resultsJson(const std::vector<PartitionResult>& results) {
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& r : results) {
+        json.push_back({
+            {"world", r.world},
+            {"cell_size", r.cellSize},
+            {"shapes", r.shapes},
+            {"broadphase_objects", r.objects},
+            {"build_ms", r.buildMs},
+            {"ray_us", r.rayUs},
+            {"ray_hit_rate", r.hitRate},
+            {"step_ms_mean", r.stepMeanMs},
+            {"step_ms_p95", r.stepP95Ms}
+        });
+    }
+    return json;
+}
+
+int main(int argc, char* argv[]) {
+    std::string sceneFile = "assets/scene.json";
+    std::vector<float> cellSizes = {0.0f, 16.0f, 32.0f, 64.0f};
+    int rays = 20000;
+    int frames = 600;
+    int shapes = 0;
+    unsigned int seed = 1234;
+    BenchReport report;
+
+    for (int i = 1; i < argc; i++) {
+        if (report.parseArg(argc, argv, i)) continue;
+        std::string arg = argv[i];
+        if (arg == "--cells" && i + 1 < argc) cellSizes = parseList<float>(argv[++i]);
+        else if (arg == "--rays" && i + 1 < argc) rays = std::stoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc) frames = std::stoi(argv[++i]);
+        else if (arg == "--shapes" && i + 1 < argc) shapes = std::stoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = static_cast<unsigned int>(std::stoul(argv[++i]));
+        else sceneFile = arg;
+    }
+
+    std::vector<PartitionResult> results;
+    std::cout << "\nworld\tcell\tshapes\tobjects\tbuild ms\tray us\thits\tstep ms\tp95 ms\n";
+    auto report = [&](const PartitionResult& r) {
+        results.push_back(r);
+        std::cout << r.world << "\t" << r.cellSize << "\t" << r.shapes << "\t" << r.objects << "\t"
+                  << r.buildMs << "\t" << r.rayUs << "\t" << r.hitRate << "\t"
+                  << r.stepMeanMs << "\t" << r.stepP95Ms << "\n";
+    };
+
+    BenchWorld scene;
+    scene.name = "scene";
+    scene.sceneFile = sceneFile;
+    int sceneShapes = 0;
+    for (float cellSize : cellSizes) {
+        PartitionResult r = runWorld(scene, cellSize, rays, frames, seed);
+        if (r.objects <= 2) {
+            std::cout << "scene: no baked collision world for >" << sceneFile << "<, run the game once to create it\n";
+            break;
+        }
+        sceneShapes = r.shapes;
+        report(r);
+    }
+
+    BenchWorld synthetic;
+    synthetic.name = "synthetic";
+    buildSyntheticVillage(synthetic, shapes > 0 ? shapes : (sceneShapes > 0 ? 10 * sceneShapes : 13000), seed);
+    for (float cellSize : cellSizes) {
+        report(runWorld(synthetic, cellSize, rays, frames, seed));
+    }
+
+    if (writeJsonReport(report, "static_partition", resultsJson(results)) != 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+// Benchmark of text layout on dialogue strings.
+// The strings are the dialogues of the characters of the scene, joined into longer texts of growing length,
+// plus the interaction prompt. For each text it times, per call:
+//    - wrapText() to 25 columns, as done for the dialogues, with its memo cleared (cold) and warm
+//    - TextMaker::layoutText() (cold) and TextMaker::getLayout() with the layout already cached (warm),
+//      wrapping at 600 font pixels
+// No window nor Vulkan device is created: only the CPU side of TextMaker is used.
+//
+// Usage: text_layout [scene.json] [--lengths 64,512,4096] [--iterations N] [--json file] [--label text]
+
+#include "BenchCommon.hpp"
+#include "modules/TextMaker.hpp"
+#include "Utils.hpp"
+
+
+struct LayoutResult {
+    std::string name;
+    int chars;
+    double wrapColdNs;      // per call
+    double wrapWarmNs;
+    double layoutColdNs;
+    double layoutWarmNs;
+    double layoutColdCharNs;    // per character
+};
+
+/** Mean time of a call of f, in ns. */
+template <typename F>
+static double timeNs(int iterations, F f) {
+    auto start = BenchClock::now();
+    for (int i = 0; i < iterations; i++) f();
+    return elapsedMs(start, BenchClock::now()) * 1e6 / std::max(iterations, 1);
+}
+
+static LayoutResult runText(TextMaker& txt, const std::string& name, const std::string& text, int iterations) {
+    const int wrapColumns = 25;
+    const int wrapPixels = 600;
+    size_t sink = 0;
+
+    LayoutResult r{};
+    r.name = name;
+    r.chars = static_cast<int>(text.size());
+    r.wrapColdNs = timeNs(iterations, [&]() {
+        clearWrapTextMemo();
+        sink += wrapText(text, wrapColumns).size();
+    });
+    r.wrapWarmNs = timeNs(iterations, [&]() { sink += wrapText(text, wrapColumns).size(); });
+    r.layoutColdNs = timeNs(iterations, [&]() {
+        sink += txt.layoutText(text, 8, 1.0f, 1.0f, TAL_CENTER, wrapPixels)->quads.size();
+    });
+    txt.getLayout(text, 8, 1.0f, 1.0f, TAL_CENTER, wrapPixels);
+    r.layoutWarmNs = timeNs(iterations, [&]() {
+        sink += txt.getLayout(text, 8, 1.0f, 1.0f, TAL_CENTER, wrapPixels)->quads.size();
+    });
+    r.layoutColdCharNs = r.chars > 0 ? r.layoutColdNs / r.chars : 0.0;
+    if (sink == 0) std::cout << "";     // keeps the calls from being optimized away
+    return r;
+}
+
+static nlohmann::json resultsJson(const std::vector<LayoutResult>& results) {
+    nlohmann::json json = nlohmann::json::array();
+    for (const auto& r : results) {
+        json.push_back({
+            {"text", r.name},
+            {"chars", r.chars},
+            {"wrap_cold_ns", r.wrapColdNs},
+            {"wrap_warm_ns", r.wrapWarmNs},
+            {"layout_cold_ns", r.layoutColdNs},
+            {"layout_warm_ns", r.layoutWarmNs},
+            {"layout_cold_char_ns", r.layoutColdCharNs}
+        });
+    }
+    return json;
+}
+
+int main(int argc, char* argv[]) {
+    std::string sceneFile = "assets/scene.json";
+    std::vector<int> lengths = {64, 512, 4096};
+    int iterations = 2000;
+    BenchReport report;
+
+    for (int i = 1; i < argc; i++) {
+        if (report.parseArg(argc, argv, i)) continue;
+        std::string arg = argv[i];
+        if (arg == "--lengths" && i + 1 < argc) lengths = parseList<int>(argv[++i]);
+        else if (arg == "--iterations" && i + 1 < argc) iterations = std::stoi(argv[++i]);
+        else if (arg.rfind("--", 0) != 0) sceneFile = arg;
+        else {
+            std::cout << "Unknown argument: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    nlohmann::json sceneJson = readJsonFile(sceneFile);
+    std::string dialogues;
+    for (const auto& charJson : sceneJson["characters"]) {
+        for (const auto& line : charJson.value("dialogues", std::vector<std::string>{})) {
+            dialogues += line + " ";
+        }
+    }
+    if (dialogues.empty()) dialogues = "Greetings Sir, welcome back to our village! ";
+
+    std::vector<std::pair<std::string, std::string>> texts;
+    texts.push_back({"prompt", "Press E to talk with Villager"});
+    for (int length : lengths) {
+        std::string text;
+        while (static_cast<int>(text.size()) < length) text += dialogues;
+        text.resize(length);
+        texts.push_back({"dialogue-" + std::to_string(length), text});
+    }
+
+    TextMaker txt;
+    std::vector<LayoutResult> results;
+    std::cout << "\ntext\tchars\twrap cold ns\twrap warm ns\tlayout cold ns\tlayout warm ns\tcold ns/char\n";
+    for (const auto& t : texts) {
+        LayoutResult r = runText(txt, t.first, t.second, iterations);
+        results.push_back(r);
+        std::cout << r.name << "\t" << r.chars << "\t" << r.wrapColdNs << "\t" << r.wrapWarmNs << "\t"
+                  << r.layoutColdNs << "\t" << r.layoutWarmNs << "\t" << r.layoutColdCharNs << "\n";
+    }
+    std::cout << "layout cache: " << txt.layoutHits << " hits, " << txt.layoutMisses << " misses\n";
+
+    if (writeJsonReport(report, "text_layout", resultsJson(results)) != 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -1,17 +1,94 @@
 #pragma once
 
 #include "InteractionsManager.hpp"
+#include <json.hpp>
 
+/**
+ * Animates scene instances as declared in the "animatedProps" array of the scene file.
+ * Each prop moves one or more instances (e.g. the two meshes of a crane wheel) with one of:
+ *    - rotator: constant rotation around an axis through a pivot, "rate" degrees per second
+ *    - oscillator: sinusoidal rotation ("mode": "rotate", amplitude in degrees) or translation along the
+ *      axis ("mode": "translate", amplitude in meters), "frequency" in Hz, "phase" in degrees
+ *    - path: keyframes {"time", "offset", "angle"} linearly interpolated, looping unless "loop" is false
+ * Axis, pivot and offsets are in the local space of the instance. A prop can be bound to an interaction
+ * point ("interaction": id), that switches it on and off through the InteractableState.
+ *
+ * Transforms are absolute: the world matrix of an instance is its matrix at load time times the transform
+ * of the prop at the current time (wrapped to its period), so nothing accumulates frame after frame.
+ * Props are stored as structure of arrays and updated in a few linear passes; instances whose matrix
+ * changed are listed in getDirtyInstances() until the next update().
+ */
 class AnimatedProps {
 
-    Scene scene;
-    InteractionsManager interactionsManager;
+    enum PropType : uint8_t { Rotator, Oscillator, Path };
+
+    Scene *scene;
+    InteractionsManager *interactionsManager;
     InteractableState *interactableState;
 
+    // Props (one entry per prop)
+    std::vector<uint8_t> type;
+    std::vector<uint8_t> active;
+    std::vector<uint8_t> changed;           // transform changed in the current update
+    std::vector<uint8_t> translate;         // oscillator: translation instead of rotation
+    std::vector<uint8_t> loop;              // path: restarts at the end
+    std::vector<glm::vec3> axis;            // normalized
+    std::vector<glm::vec3> pivot;
+    std::vector<float> rate;                // rotator: degrees per second; oscillator: amplitude
+    std::vector<float> frequency;           // oscillator: Hz
+    std::vector<float> phase;               // oscillator: radians
+    std::vector<float> period;              // seconds after which the motion repeats (0 = never)
+    std::vector<float> time;                // seconds, wrapped to the period
+    std::vector<int> firstKey;              // path: keys [firstKey, firstKey + keyCount)
+    std::vector<int> keyCount;
+    std::vector<InteractionKind> bindKind;  // Other if not bound to an interaction
+    std::vector<int> bindIdx;               // index in the InteractableState vector of bindKind
+    std::vector<glm::mat4> local;           // transform of the prop at the current time
+
+    // Path keyframes (of all the props)
+    std::vector<float> keyTime;
+    std::vector<glm::vec3> keyOffset;
+    std::vector<float> keyAngle;            // degrees around the axis, through the pivot
+
+    // Targets (one entry per instance moved by a prop)
+    std::vector<int> targetProp;
+    std::vector<int> targetInstance;        // index in Scene::I
+    std::vector<glm::mat4> targetBase;      // world matrix at load time
+
+    std::vector<int> dirtyInstances;
+
     public:
+        /**
+         * @param im Interactions of the scene, to bind the props to (can be nullptr if no prop is bound).
+         * @param is State of the interactions, read by update() for the bound props.
+         * @param SC Scene with the instances to animate.
+         */
         explicit AnimatedProps(InteractionsManager* im, InteractableState* is, Scene* SC);
+
+        /**
+         * Loads the "animatedProps" array of the scene file (a missing array means no props).
+         * @return Status code (0 for success, non-zero for failure), as other init methods in the project.
+         */
+        int init(std::string file);
+
+        /**
+         * Loads the props from a json array, as the "animatedProps" one of the scene file.
+         * @return Status code (0 for success, non-zero for failure).
+         */
+        int init(const nlohmann::json& props);
+
+        /**
+         * Advances the active props by deltaTime seconds and writes the world matrices of their instances.
+         */
         void update(float deltaTime);
 
+        /** Indices in Scene::I of the instances whose world matrix was written by the last update(). */
+        const std::vector<int>& getDirtyInstances() const { return dirtyInstances; }
+
+        size_t getPropCount() const { return type.size(); }
+        size_t getInstanceCount() const { return targetInstance.size(); }
+
     private:
-        void init();
-};
\ No newline at end of file
+        int addProp(const nlohmann::json& prop);
+        glm::mat4 evaluate(size_t i) const;
+};
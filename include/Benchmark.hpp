@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <json.hpp>
+
+/**
+ * Options of the benchmark mode, from the command line (see parseBenchmarkArgs()).
+ *
+ * In Offscreen mode the application renders into offscreen images at a fixed resolution, without a visible
+ * window nor a swapchain, so it runs also with a software Vulkan device (e.g. lavapipe) on machines without
+ * a GPU. In SimOnly mode no Vulkan device is created at all: only the simulation runs (see
+ * runSimulationBenchmark()). In both modes the camera follows a CameraPath, every frame advances the
+ * simulation by the same timeStep, and after warmupFrames + frames frames a JSON report is written.
+ *
+ * With replayInput the input comes from a log recorded by InputRecorder (--record-input), in a window or
+ * offscreen: time steps, camera and player are those of the recorded session, and the report is written
+ * when the log ends.
+ */
+struct BenchmarkOptions {
+    enum Mode { OFF, OFFSCREEN, SIM_ONLY };
+
+    Mode mode = OFF;
+    int frames = 1000;
+    int warmupFrames = 60;          // not measured: first uploads, pipeline and driver caches
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    float timeStep = 1.0f / 60.0f;  // simulated seconds per frame, whatever the frame takes
+    std::string cameraPath;         // recorded path (see CameraPath::load()); empty for the default one
+    std::string outFile = "benchmark.json";
+    bool preferCpuDevice = false;   // software device (lavapipe) even if a GPU is available
+    std::string recordInput;        // input log to write (see InputRecorder)
+    std::string replayInput;        // input log to replay instead of the camera path: the run lasts as the log
+    bool preskinCharacters = false; // characters skinned by a compute pass instead of in the vertex shaders
+};
+
+/**
+ * Reads the benchmark options:
+ * --benchmark (offscreen), --sim-only, --frames N, --warmup N, --resolution WxH, --timestep S,
+ * --camera-path file.json, --out file.json, --cpu-device, --record-input file.bin, --replay-input file.bin,
+ * --preskin (also without --benchmark).
+ * @return Status code (0 for success, -1 for an invalid argument: the usage is printed).
+ */
+int parseBenchmarkArgs(int argc, char* argv[], BenchmarkOptions& options);
+
+/**
+ * Camera path: eye and target positions at given times, interpolated by a Catmull-Rom spline.
+ * Paths are looped (the last key joins the first one), so a run can last longer than the path.
+ *
+ * File format: {"keys": [{"time": 0.0, "eye": [x, y, z], "target": [x, y, z]}, ...]}, times increasing.
+ */
+class CameraPath {
+public:
+    struct Key {
+        float time;
+        glm::vec3 eye;
+        glm::vec3 target;
+    };
+
+    /** @return Status code (0 for success, -1 if the file cannot be read or has less than 2 keys). */
+    int load(const std::string& file);
+    /** @return false if the file cannot be written. */
+    bool save(const std::string& file) const;
+
+    /**
+     * Default path over the village: keyCount keys on a circle around center, alternately at radius and
+     * at half of it, so that the camera swoops in and out of the streets. The camera looks at the center.
+     */
+    void makeOrbit(const glm::vec3& center, float radius, float height, float period, int keyCount = 8);
+
+    /** Appends a key (recording); keys must be added in increasing time. */
+    void addKey(float time, const glm::vec3& eye, const glm::vec3& target);
+    void clear() { keys.clear(); }
+    bool empty() const { return keys.empty(); }
+    size_t size() const { return keys.size(); }
+    /** Time of the loop: the time of the last key, plus the mean interval between keys to close it. */
+    float getDuration() const;
+
+    void sample(float time, glm::vec3& eye, glm::vec3& target) const;
+
+private:
+    std::vector<Key> keys;
+};
+
+/**
+ * Frame times of a benchmark run: frame() is called once per frame, the first warmupFrames are skipped,
+ * and when the run is complete writeReport() writes the percentiles, the profiler breakdown (if built with
+ * ENABLE_PROFILER) and the info added by the caller.
+ */
+class BenchmarkRecorder {
+public:
+    explicit BenchmarkRecorder(const BenchmarkOptions& options);
+
+    /** Marks the end of a frame. @return true once all the frames have been measured. */
+    bool frame();
+    bool isDone() const { return frameIndex >= options.warmupFrames + options.frames; }
+    /** Simulated time of the current frame, for the camera path. */
+    float getTime() const { return frameIndex * options.timeStep; }
+    int getFrame() const { return frameIndex; }
+
+    /** Adds a field to the report (e.g. device name, render counters). */
+    void addInfo(const std::string& key, const nlohmann::json& value) { info[key] = value; }
+
+    /** @return Status code (0 for success, -1 if the file cannot be written). */
+    int writeReport(const std::string& mode) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    BenchmarkOptions options;
+    int frameIndex = 0;
+    Clock::time_point lastFrame;
+    Clock::time_point measureStart;
+    std::vector<double> frameMs;
+    nlohmann::json info = nlohmann::json::object();
+};
+
+/**
+ * Simulation only benchmark: physics (terrain, baked static world if its cache exists, player capsule
+ * walking along the camera path) and the animation of the characters of the scene, with no window and no
+ * Vulkan device. Models are not loaded, so the static meshes are there only if a previous rendered run has
+ * written the physics cache of the scene, and the animated props are not updated (they move instances).
+ * @return Status code (0 for success, -1 on error).
+ */
+int runSimulationBenchmark(const BenchmarkOptions& options, const std::string& sceneFile, bool flyMode);
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "modules/Starter.hpp"
+
+/**
+ * Cache of the static collision shapes built from the scene models, keyed by model id (Mid).
+ * Each model is converted once: its vertices are welded (vertices differing only in normal or UV become one)
+ * and the triangles left without area are dropped. Then the model gets a collision proxy (see ProxyType),
+ * chosen by its size or forced per model: nothing for small details, a box, capsule or convex hull for props,
+ * and a triangle mesh, simplified or not, for the rest. Meshes are exposed to Bullet through a
+ * btTriangleIndexVertexArray that references them without copies, with a single BVH built over it.
+ * Every instance of the model shares that shape; instances with a non-unit scale get a scaled variant
+ * (a lightweight btScaledBvhTriangleMeshShape for meshes), one per distinct scale.
+ * The cache owns all the shapes: the physics objects using them must not delete them.
+ *
+ * The whole static world (meshes with their quantized BVHs, plus the table of the bodies using them) can be
+ * baked into a file with save(). load() maps that file in memory and uses it in place: vertices, indices and
+ * BVHs are not copied nor rebuilt, so the startup cost becomes that of reading the pages actually touched.
+ */
+class CollisionShapeCache {
+public:
+    /** Collision proxy of a model. */
+    enum ProxyType : int32_t {
+        ProxyAuto,      // chosen by the size and form of the model (see ProxyConfig)
+        ProxyNone,      // no collision
+        ProxyBox,       // box of the bounds
+        ProxyCapsule,   // vertical capsule fitted to the bounds
+        ProxyHull,      // convex hull, reduced to at most 42 vertices
+        ProxyMesh,      // triangle mesh, simplified by vertex clustering
+        ProxyFull       // triangle mesh, as rendered (welded)
+    };
+
+    /**
+     * Rules of ProxyAuto. The size of a model is the largest side of its bounds, in model space.
+     * All fields are 4 bytes, so that the struct can be hashed as raw memory.
+     */
+    struct ProxyConfig {
+        float minExtent = 0.25f;            // smaller models get no collision
+        float convexExtent = 2.0f;          // models up to this size get a box, a capsule or a hull
+        float boxTolerance = 0.05f;         // box, if every vertex is this close (fraction of the size) to the bounds
+        float capsuleAspect = 3.0f;         // capsule, if this many times taller than wide
+        float meshCellSize = 0.05f;         // larger models: vertices within the same cell of this size are merged...
+        int32_t simplifyMinTriangles = 200; // ...if the model has more triangles than this
+    };
+
+    /** A static body of the baked world: the shape of model Mid, scaled, at a rigid transform. */
+    struct BodyRecord {
+        int32_t Mid;
+        float scale[3];
+        float basis[9];     // rows of the rotation
+        float origin[3];
+    };
+
+    /** Counters describing what the cache built, and what the per-instance approach would have cost. */
+    struct Stats {
+        int requests = 0;               // shapes requested (one per instance)
+        int meshes = 0;                 // distinct models converted into a triangle mesh
+        int scaledShapes = 0;           // scaled wrappers created
+        size_t sourceVertices = 0;      // vertices of the converted models, before welding
+        size_t weldedVertices = 0;      // vertices kept after welding
+        size_t triangles = 0;           // triangles of the converted models
+        size_t instanceTriangles = 0;   // triangles summed over all the requests
+        size_t bytes = 0;               // memory of vertices, indices and BVHs
+        size_t bvhBytes = 0;            // memory of the BVHs alone
+        int droppedModels = 0;          // models without collision (ProxyNone)
+        int convexProxies = 0;          // models with a box, capsule or hull
+        int simplifiedMeshes = 0;       // models with a simplified mesh
+        size_t sourceTriangles = 0;     // triangles of the models, before welding and proxies
+        size_t removedTriangles = 0;    // of which not kept as triangles (degenerate, simplified, or replaced)
+        double buildMs = 0.0;           // time spent welding and building the BVHs
+        double loadMs = 0.0;            // time spent loading a baked world
+    };
+
+    CollisionShapeCache() = default;
+    CollisionShapeCache(const CollisionShapeCache&) = delete;
+    CollisionShapeCache& operator=(const CollisionShapeCache&) = delete;
+    ~CollisionShapeCache() { clear(); }
+
+    /**
+     * Writes the shapes built so far and the given bodies to a file.
+     * @param hash Key of the content (e.g. of the scene and model files), checked by load().
+     * @return true on success.
+     */
+    bool save(const std::string& file, uint64_t hash, const std::vector<BodyRecord>& bodies) const;
+
+    /**
+     * Replaces the content of the cache with a world baked by save(), if the file exists and has the same hash.
+     * @param bodies Filled with the bodies of the baked world.
+     * @return true on success; on failure the cache is left empty.
+     */
+    bool load(const std::string& file, uint64_t hash, std::vector<BodyRecord>& bodies);
+
+    /**
+     * Returns the collision shape of a model, building it the first time it is requested.
+     * @param Mid   Id of the model in the scene, used as cache key.
+     * @param model The model, with its vertices still in CPU memory (may be nullptr if the shape was loaded).
+     * @param scale Scale of the instance; (1,1,1) returns the shared unscaled shape.
+     * @return The shape, or nullptr if the model has no triangles.
+     */
+    btCollisionShape* getShape(int Mid, const Model* model, const glm::vec3& scale = glm::vec3(1.0f));
+
+    /** Releases all the shapes. No collision object using them may remain in a world. */
+    void clear();
+
+    /** Proxy rules and per model choices: to be set before the shapes are built (kept by clear()). */
+    void setProxyConfig(const ProxyConfig& config) { proxyConfig = config; }
+    const ProxyConfig& getProxyConfig() const { return proxyConfig; }
+    void setProxyOverride(int Mid, ProxyType type) { proxyOverrides[Mid] = type; }
+    /** Name of a model, for the report. */
+    void setModelName(int Mid, const std::string& name) { modelNames[Mid] = name; }
+
+    /** Parses a proxy name of the scene file ("auto", "none", "box", "capsule", "hull", "mesh", "full"). */
+    static bool parseProxyType(const std::string& name, ProxyType& type);
+    static const char* proxyTypeName(ProxyType type);
+
+    const Stats& getStats() const { return stats; }
+
+    /**
+     * Prints the stats, comparing them with an estimate of one triangle soup and BVH per instance,
+     * and the proxy of each model with the triangles it removed.
+     */
+    void printReport() const;
+
+private:
+    struct MeshEntry {
+        ProxyType type = ProxyFull;         // never Auto nor None
+        int sourceTriangles = 0;
+        std::vector<btScalar> vertices;     // welded positions, or hull points, xyz (empty if loaded: data is in the mapped file)
+        std::vector<int> indices;           // 3 per triangle (as above; meshes only)
+        btScalar* vertexData = nullptr;
+        int* indexData = nullptr;
+        int numVertices = 0;
+        int numTriangles = 0;
+        glm::vec3 center = glm::vec3(0.0f);         // bounds, in model space
+        glm::vec3 halfExtents = glm::vec3(0.0f);
+        std::unique_ptr<btTriangleIndexVertexArray> mesh;
+        std::unique_ptr<btBvhTriangleMeshShape> shape;  // meshes
+        std::unique_ptr<btCollisionShape> proxyShape;   // convex proxies, at unit scale
+        std::vector<std::unique_ptr<btCollisionShape>> parts;   // convex shapes wrapped into an offset compound
+        std::vector<std::pair<glm::vec3, std::unique_ptr<btCollisionShape>>> scaled;
+    };
+
+    /** Proxy chosen for a model, and how many triangles it kept, for the report. */
+    struct ModelReport {
+        int Mid;
+        ProxyType type;
+        int sourceTriangles;
+        int triangles;
+    };
+
+    std::unordered_map<int, std::unique_ptr<MeshEntry>> entries;
+    Stats stats;
+    ProxyConfig proxyConfig;
+    std::unordered_map<int, ProxyType> proxyOverrides;
+    std::unordered_map<int, std::string> modelNames;
+    std::vector<ModelReport> reports;
+
+    // Baked world in use, if any: mapped file (or, where mapping is not available, an aligned copy)
+    void* baked = nullptr;
+    size_t bakedSize = 0;
+    bool bakedMapped = false;
+    void releaseBaked();
+
+    MeshEntry* buildEntry(int Mid, const Model* model);
+    /** Creates the shape of a convex proxy at the given scale (an offset compound if not centered). */
+    btCollisionShape* createProxyShape(MeshEntry* entry, const glm::vec3& scale);
+    /** Creates the BVH shape of the mesh in vertexData / indexData. */
+    void createMeshShape(MeshEntry* entry);
+};
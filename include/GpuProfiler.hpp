@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Profiler.hpp"
+#include <vulkan/vulkan.h>
+#include <vector>
+
+/**
+ * GPU time of regions of a command buffer (e.g. render passes), measured with Vulkan timestamp queries and
+ * recorded in the Profiler as GPU events.
+ *
+ * Every swapchain image has its own queries, so that the command buffers of the images can be recorded
+ * once: reset() and the begin()/end() pairs are recorded in them, and collect(image) reads the results of
+ * the previous submission of the image, once its fence has been waited (e.g. at the beginning of
+ * updateUniformBuffer). GPU events are placed on the CPU timeline starting from the time of the submission.
+ *
+ * Without ENABLE_PROFILER every method is empty.
+ */
+#ifdef ENABLE_PROFILER
+
+class GpuProfiler {
+public:
+    /**
+     * @param regions Names of the regions (string literals), identified by their index in begin()/end().
+     *                Every region must be begun and ended in every frame, in any order: a frame with a query
+     *                never written is not available, and none of its regions is recorded.
+     * @return Status code (0 for success, non-zero if timestamps are not supported: the methods do nothing).
+     */
+    int init(VkPhysicalDevice physicalDevice, VkDevice device, int imageCount, const std::vector<const char*>& regions);
+    void cleanup();
+
+    /** Resets the queries of the image (outside of any render pass, before the first region). */
+    void reset(VkCommandBuffer commandBuffer, int image);
+    void begin(VkCommandBuffer commandBuffer, int image, int region);
+    void end(VkCommandBuffer commandBuffer, int image, int region);
+
+    /** Records the regions of the previous submission of the image, and marks it as submitted again. */
+    void collect(int image);
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool pool = VK_NULL_HANDLE;
+    std::vector<const char*> regionNames;
+    float nsPerTick = 1.0f;
+    uint64_t validMask = ~0ull;
+    std::vector<bool> pending;          // for each image: submitted with queries not read yet
+    std::vector<uint64_t> submitNs;     // for each image: CPU time of the submission
+    std::vector<uint64_t> results;
+
+    uint32_t query(int image, int region, int edge) const {
+        return static_cast<uint32_t>((image * regionNames.size() + region) * 2 + edge);
+    }
+};
+
+#else
+
+class GpuProfiler {
+public:
+    int init(VkPhysicalDevice, VkDevice, int, const std::vector<const char*>&) { return 0; }
+    void cleanup() {}
+    void reset(VkCommandBuffer, int) {}
+    void begin(VkCommandBuffer, int, int) {}
+    void end(VkCommandBuffer, int, int) {}
+    void collect(int) {}
+};
+
+#endif
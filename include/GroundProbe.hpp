@@ -0,0 +1,73 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+/** What a GroundProbe found under (and in front of) a capsule. */
+struct GroundProbeResult {
+    bool hit = false;                       // some surface is within reach below the capsule
+    bool walkable = false;                  // hit, and not steeper than the maximum slope
+    glm::vec3 normal = glm::vec3(0, 1, 0);  // normal of the ground (up if nothing was hit)
+    glm::vec3 point = glm::vec3(0);         // contact point with the ground
+    float slopeAngle = 0.0f;                // angle between the normal and the up axis, in radians
+    float distance = 0.0f;                  // gap between the bottom of the capsule and the ground
+    bool step = false;                      // a climbable step is ahead, in the direction of motion
+    float stepHeight = 0.0f;                // height of that step above the bottom of the capsule
+};
+
+/**
+ * Ground and step query for capsule characters (the player, and NPCs walking on the same world).
+ * A probe sweeps the bottom sphere of the capsule down, to find the ground with its normal, slope and
+ * distance, and, if the capsule is moving, sweeps the same sphere down from one step height in front of it,
+ * to find a step to climb. Both sweeps run against the candidates of a single broadphase query covering the
+ * two of them, so each probe costs one broadphase traversal plus the narrow phase of the few objects nearby.
+ * A sphere sweep also finds edges and thin objects that a handful of rays would miss.
+ */
+class GroundProbe {
+public:
+    struct Config {
+        float radius = 0.15f;               // radius of the capsule
+        float footOffset = 0.65f;           // from the center of the capsule to the center of its bottom sphere
+        float probeDistance = 0.1f;         // how far below the capsule the ground is still considered touched
+        float maxSlopeAngle = 0.785398f;    // steepest walkable slope, in radians (45 degrees)
+        float minStepHeight = 0.05f;        // lower obstacles are just walked over
+        float maxStepHeight = 0.3f;         // higher obstacles are walls
+        float stepCheckDistance = 0.25f;    // how far in front of the center steps are searched
+    };
+
+    /** Counters for profiling, accumulated until resetStats(). */
+    struct Stats {
+        int probes = 0;             // calls of probe()
+        int broadphaseQueries = 0;  // broadphase traversals (one per probe)
+        int candidates = 0;         // objects returned by the broadphase
+        int sweeps = 0;             // narrow phase sweeps against single objects
+        double totalMs = 0.0;
+    };
+
+    GroundProbe() = default;
+    void init(btCollisionWorld* world, const Config& config);
+
+    /**
+     * Probes the ground under a capsule.
+     * @param self     Collision object of the capsule, ignored by the query (may be nullptr).
+     * @param position Center of the capsule.
+     * @param motion   Horizontal direction of motion; the step is searched only if it is not zero.
+     */
+    GroundProbeResult probe(const btCollisionObject* self, const btVector3& position, const btVector3& motion);
+
+    const Config& getConfig() const { return config; }
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+
+private:
+    btCollisionWorld* world = nullptr;
+    Config config;
+    Stats stats;
+    std::unique_ptr<btSphereShape> footShape;       // a bit smaller than the capsule, to start outside the ground
+    std::vector<btCollisionObject*> candidates;     // reused by every probe
+
+    /** Sweeps the foot sphere from -> to against the candidates; returns the closest hit fraction (1 if none). */
+    btScalar sweep(const btVector3& from, const btVector3& to, btVector3& hitNormal, btVector3& hitPoint);
+};
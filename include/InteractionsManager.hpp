@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include "modules/Scene.hpp"
+#include "SpatialGrid.hpp"
 
 /**
  * Represents the state of interactable points in the scene.
@@ -19,6 +20,15 @@ struct InteractableState{
     std::vector<bool> craneWheelsRotating;
 };
 
+/**
+ * Kinds of interactable points, resolved from their ids at load time.
+ */
+enum class InteractionKind {
+    Torch,          // id "torch_fire.NN": toggles InteractableState::torchesOn[NN]
+    CraneWheel,     // id "crane_wheel.NN": toggles InteractableState::craneWheelsRotating[NN]
+    Other           // not handled by interact()
+};
+
 /**
  * Represents an interactable point in the scene.
  * @param id Unique identifier for the interaction.
@@ -28,12 +38,17 @@ struct InteractableState{
  * @param position 3D position of the interaction point.
  *  May not be the position of an actual instance, but only the position where the interaction should become available.
  * @param label Text label to show when the player is near the interaction point.
+ * @param kind Kind of interaction, resolved from the id.
+ * @param stateIdx Index of the point in the InteractableState vector of its kind (the numeric suffix of the id),
+ *  -1 if the kind has no state.
  */
 struct InteractionPoint {
     std::string id;                      // Id of interaction
     std::vector<std::string> instaceIds; // IDs of instances associated with this interaction
     glm::vec3 position;                  // Position of interaction
     std::string label;                   // Label to show when near the interaction point
+    InteractionKind kind = InteractionKind::Other;
+    int stateIdx = -1;                   // Index in the InteractableState vector of the kind
 };
 
 /**
@@ -42,6 +57,14 @@ struct InteractionPoint {
  */
 class InteractionsManager {
 public:
+    /**
+     * Kinds of interaction points, as tags of the spatial index (they can be or-ed in the queries).
+     * See tagOf() for the mapping from InteractionKind.
+     */
+    static constexpr uint32_t TAG_TORCH = 1u << 0;
+    static constexpr uint32_t TAG_CRANE_WHEEL = 1u << 1;
+    static constexpr uint32_t TAG_OTHER = 1u << 2;
+
     /**
      * Initializes the manager by loading interaction points from the scene file.
      * @param file Path to the file containing interaction point data.
@@ -56,6 +79,15 @@ public:
      */
     void updateNearInteractable(const glm::vec3& playerPos);
 
+    /**
+     * Finds the nearest interaction point of the given kinds, without changing the internal state.
+     * @param position Center of the search.
+     * @param maxDist Maximum distance from position.
+     * @param tags Kinds of points to consider (TAG_* values, or-ed).
+     * @return Index of the point in getAllInteractions(), or -1 if none within maxDist.
+     */
+    int findNearest(const glm::vec3& position, float maxDist, uint32_t tags = SpatialGrid::ALL_TAGS) const;
+
     /**
      * Returns whether there is an interactable point near the player.
      * It checks internal state (no recomputation).
@@ -66,15 +98,24 @@ public:
     /**
      * Retrieves the nearest interactable point.
      * It checks internal state (no recomputation).
-     * @return The nearest InteractionObj.
+     * @return The nearest InteractionObj (an empty point if none).
+     */
+    const InteractionPoint& getNearInteractable() const;
+
+    /**
+     * Counts the interaction points of a kind.
+     * The InteractableState vector of the kind needs one entry for each of them.
      */
-    InteractionPoint getNearInteractable() const;
+    int countInteractions(InteractionKind kind) const;
+
+    /** Tag of the spatial index for the points of a kind. */
+    static uint32_t tagOf(InteractionKind kind);
 
     /**
      * Returns a reference to all interaction points managed by this class.
      * @return Reference to the vector of InteractionObj.
      */
-    inline const std::vector<InteractionPoint>& getAllInteractions() { return interactionPoints; }
+    inline const std::vector<InteractionPoint>& getAllInteractions() const { return interactionPoints; }
 
     /**
      * Executes the interaction with the nearest interactable point, if any.
@@ -95,9 +136,15 @@ private:
      */
     std::vector<InteractionPoint> interactionPoints;
 
+    /**
+     * Spatial index of the interaction points, tagged by kind.
+     * Points are never removed, so the handle of each point is its index in interactionPoints.
+     */
+    SpatialGrid grid;
+
     /**
      * Index of the currently interactable point.
      * -1 if no point is currently interactable (withing maxDistance).
      */
-    int interactableIdx;
+    int interactableIdx = -1;
 };
\ No newline at end of file
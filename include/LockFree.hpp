@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Bounded single-producer single-consumer queue.
+ * One thread may only push() and one other thread may only pop(): under this rule no lock is needed,
+ * each side owning one of the two indices and reading the other one with acquire semantics.
+ * Capacity must be a power of two; the queue holds at most Capacity - 1 items.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /** Producer side. @return false if the queue is full (the item is not enqueued). */
+    bool push(const T& item) {
+        const size_t head = writeIndex.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) & (Capacity - 1);
+        if (next == readIndex.load(std::memory_order_acquire)) return false;
+        items[head] = item;
+        writeIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer side. @return false if the queue is empty. */
+    bool pop(T& item) {
+        const size_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == writeIndex.load(std::memory_order_acquire)) return false;
+        item = items[tail];
+        readIndex.store((tail + 1) & (Capacity - 1), std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> items{};
+    // On separate cache lines, so that producer and consumer do not invalidate each other's index
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+};
+
+/**
+ * Triple buffer publishing the latest value of a single writer to a single reader.
+ * The writer fills its back buffer and publishes it by swapping it with the middle one; the reader takes
+ * the middle buffer, if a new one was published, by swapping it with its front buffer. Neither side ever
+ * waits: the writer can publish any number of times between two reads (only the last value is seen), and
+ * the reader keeps the last value it took until a newer one is available.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    /** Writer side: the buffer to fill before publish(). */
+    T& back() { return buffers[backIndex]; }
+
+    /** Writer side: makes the back buffer the latest value. */
+    void publish() {
+        uint8_t old = middle.exchange(static_cast<uint8_t>(backIndex | FRESH_BIT), std::memory_order_acq_rel);
+        backIndex = old & INDEX_MASK;
+    }
+
+    /**
+     * Reader side: takes the latest published value, if newer than the one already held.
+     * @return true if the front buffer changed.
+     */
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+        uint8_t old = middle.exchange(static_cast<uint8_t>(frontIndex), std::memory_order_acq_rel);
+        frontIndex = old & INDEX_MASK;
+        return true;
+    }
+
+    /** Reader side: the value taken by the last update(). */
+    const T& front() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr uint8_t FRESH_BIT = 0x4;
+    static constexpr uint8_t INDEX_MASK = 0x3;
+
+    std::array<T, 3> buffers{};
+    uint8_t backIndex = 0;                  // owned by the writer
+    uint8_t frontIndex = 1;                 // owned by the reader
+    std::atomic<uint8_t> middle{2};         // index of the middle buffer, plus FRESH_BIT if not read yet
+};
@@ -5,8 +5,20 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 #include <memory>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <unordered_set>
 #include "modules/Starter.hpp"
 #include "modules/Scene.hpp"
+#include "CollisionShapeCache.hpp"
+#include "TerrainCollision.hpp"
+#include "StaticWorldPartition.hpp"
+#include "GroundProbe.hpp"
+#include "LockFree.hpp"
+#include "PhysicsStats.hpp"
 
 // Structure to hold Bullet Physics objects
 struct PhysicsObject {
@@ -14,8 +26,9 @@ struct PhysicsObject {
     btCollisionShape* shape;
     btDefaultMotionState* motionState;
     glm::vec3 initialPosition;
+    bool ownsShape;     // false if the shape is shared (e.g. owned by the CollisionShapeCache)
 
-    PhysicsObject() : body(nullptr), shape(nullptr), motionState(nullptr) {}
+    PhysicsObject() : body(nullptr), shape(nullptr), motionState(nullptr), ownsShape(true) {}
     ~PhysicsObject();
 };
 
@@ -42,6 +55,67 @@ struct BackgroundTerrainConfig {
     glm::vec3 position = glm::vec3(0, 0, 0);
 };
 
+// Configuration of the dynamics world, to be set before initialize()
+struct PhysicsWorldConfig {
+    // > 0: use Bullet's multithreaded world, with a pool of solvers, on a task scheduler with this many
+    // threads. It needs Bullet built with BT_THREADSAFE (the PHYSICS_MULTITHREADING CMake option);
+    // otherwise the world stays single threaded.
+    int solverThreads = 0;
+};
+
+// Physical parameters of a dynamic prop, as declared in the "dynamicProps" array of the scene file:
+//   {"model": "pf_bucket_01-00", "shape": "cylinder", "mass": 4.0, "friction": 0.6, "restitution": 0.1,
+//    "linearSleep": 0.8, "angularSleep": 1.0, "startAsleep": true}
+// Every instance of the model becomes a dynamic body; its shape is fitted to the bounds of the model.
+struct DynamicPropConfig {
+    enum Shape { Box, Sphere, Cylinder, Capsule, Hull };
+    Shape shape = Box;
+    float mass = 10.0f;
+    float friction = 0.6f;
+    float restitution = 0.1f;
+    float linearSleepThreshold = 0.8f;      // below these velocities for 2 s, the body goes to sleep
+    float angularSleepThreshold = 1.0f;
+    bool startAsleep = true;                // sleeps until touched (props may rest on non-colliding meshes)
+};
+
+// A dynamic body, and the instance rendered with its transform
+struct DynamicProp {
+    std::unique_ptr<PhysicsObject> object;
+    Instance* instance = nullptr;           // nullptr for bodies without a rendered instance
+    glm::mat4 bodyToInstance = glm::mat4(1.0f);    // from the body frame (center of the bounds) to Wm
+    bool wasActive = false;                 // awake at the previous tick (physics side)
+    uint64_t movedTick = 0;                 // last tick it was awake (physics side, threaded mode)
+    uint64_t appliedTick = 0;               // tick of the snapshot last copied to the instance (render side)
+};
+
+// Command sent by the render thread to the physics thread
+struct PhysicsCommand {
+    enum Type { Move, Jump, SetPosition };
+    Type type;
+    glm::vec3 vec;      // move direction or position
+    bool running;       // for Move
+};
+
+// State of the simulation after a tick, published by the physics thread
+struct PhysicsSnapshot {
+    glm::vec3 previousPosition = glm::vec3(0);  // player position at the tick before
+    glm::vec3 playerPosition = glm::vec3(0);
+    glm::vec3 playerVelocity = glm::vec3(0);
+    bool grounded = false;
+    std::vector<glm::mat4> props;               // transform of every dynamic prop (body frame)...
+    std::vector<uint64_t> propsMovedTick;       // ...and the last tick it was awake
+    uint64_t tick = 0;
+    std::chrono::steady_clock::time_point tickTime;
+};
+
+// Time spent on physics, to compare the inline and the threaded mode
+struct PhysicsTimings {
+    double renderThreadMs = 0.0;    // in update(), on the render thread
+    int updates = 0;
+    double tickMs = 0.0;            // simulating ticks (on the physics thread, if running)
+    int ticks = 0;
+};
+
 class PhysicsManager {
 private:
     // Bullet Physics core objects
@@ -55,10 +129,30 @@ private:
     std::unique_ptr<PhysicsObject> player;
     std::unique_ptr<PhysicsObject> terrain;
     std::vector<std::unique_ptr<PhysicsObject>> staticObjects;
+    std::vector<DynamicProp> dynamicProps;
+    std::unordered_set<const Instance*> dynamicInstances;  // instances of dynamic props, skipped by addStaticMeshes
+    CollisionShapeCache shapeCache;     // Shapes of the static meshes, shared by the instances of a model
+
+    // Baked static world (see CollisionShapeCache::save): file, key of the scene it was built from,
+    // and whether the static bodies already come from it
+    std::string bakedWorldFile;
+    uint64_t sceneHash;
+    bool staticWorldLoaded;
+
+    // Heightfield built from the instances of the Terrain technique (cellSize <= 0 disables it,
+    // and the terrain goes through the generic mesh path)
+    TerrainCollision terrainCollision;
+    TerrainCollision::Config terrainCollisionConfig;
+
+    // Static bodies merged into one compound per grid cell (cellSize <= 0 keeps one body per instance)
+    StaticWorldPartition staticPartition;
+    StaticWorldPartition::Config staticPartitionConfig;
 
     // Configuration
     PlayerConfig playerConfig;
     BackgroundTerrainConfig terrainConfig;
+    PhysicsWorldConfig worldConfig;
+    btConstraintSolver* solverPool;     // multithreaded world only
 
     // Internal state
     bool isGrounded;
@@ -71,12 +165,58 @@ private:
     float velocitySmoothing;
     glm::vec3 groundNormal;
     glm::vec3 lastVelocity;
+    GroundProbe groundProbe;
+    GroundProbeResult ground;       // result of the last probe, from checkGrounded()
+
+    // Fixed rate stepping: tick length, cap of ticks per update() and ticks run by the last update()
+    float fixedTimeStep;
+    int maxSubSteps;
+    int lastStepCount;
+
+    // Player input, consumed by the fixed ticks
+    glm::vec3 moveInput;
+    bool runInput;
+    bool jumpRequested;
+
+    // Physics thread: while it runs, the world belongs to it, and the render thread only pushes commands
+    // and reads snapshots
+    std::thread physicsThread;
+    std::atomic<bool> threadRunning;
+    SpscQueue<PhysicsCommand, 256> commands;
+    std::deque<PhysicsCommand> pendingCommands;    // render thread: not queued yet, the queue being full
+    int deferredCommands;               // flushes that left commands pending
+    TripleBuffer<PhysicsSnapshot> snapshots;   // the front one is the latest taken by the render thread
+    PhysicsTimings timings;             // renderThread* written by the render thread, tick* by the one simulating
+    bool timingsThreaded;               // whether the timings were taken with the physics thread running
+
+    // Per step counters, recorded by the render thread. If threaded, the physics thread queues the counters
+    // of every tick, and update() merges those queued since the previous frame into one step
+    PhysicsStats physicsStats;
+    SpscQueue<PhysicsStepStats, 256> tickStats;
+    PhysicsStepStats unqueuedTickStats;     // physics thread: ticks not queued yet, the queue being full
+    mutable std::atomic<int> rayQueries;    // rayCast() calls since the last step (counted and reset by any thread)
 
     // Helper methods
     void initializePhysicsWorld();
     void createTerrain();
-    bool checkGrounded();
-    static btCollisionShape * getShapeFromModel(const Model* modelRef);
+    bool loadBakedWorld();
+    void loadCollisionProxies(const std::string& sceneFile);
+    void addStaticBody(btCollisionShape* shape, const btTransform& transform);
+    void addStaticWorld(const std::vector<StaticWorldPartition::Entry>& entries);
+    bool addTerrainHeightfield(Model **modelRefs, Instance **instanceRefs, int instanceCount);
+    static void preTickCallback(btDynamicsWorld* world, btScalar timeStep);
+    void fixedTick(float timeStep);
+    void applyPlayerMovement(float timeStep);
+    void applyJump();
+    void applyPlayerPosition(const glm::vec3& position);
+    void physicsThreadLoop();
+    void applyCommand(const PhysicsCommand& command);
+    void sendCommand(const PhysicsCommand& command);
+    void flushCommands();
+    void runThreadTick();
+    void updateDynamicInstances();
+    PhysicsStepStats collectStepStats(double stepMs, int substeps, const GroundProbe::Stats& probeBefore);
+    void drainTickStats();
     glm::vec3 projectMovementOntoSlope(const glm::vec3& movement);
     void handleSlopeMovement(float deltaTime);
     void handleStepClimbing(float deltaTime);
@@ -92,29 +232,123 @@ public:
     // Initialization
     bool initialize(bool flyMode_, const PlayerConfig& playerCfg = PlayerConfig(),
                    const BackgroundTerrainConfig& terrainCfg = BackgroundTerrainConfig());
+    /**
+     * As above, also enabling the baked static world of the scene: if a cache built from the same scene
+     * and model files exists, the static bodies are loaded from it here and addStaticMeshes() does nothing;
+     * otherwise addStaticMeshes() builds them and writes the cache for the next run.
+     * The "collisionProxies" array of the scene file, if any, forces the collision proxy of some models
+     * (see CollisionShapeCache::ProxyType): [{"model": "prop_torch_01-00", "proxy": "capsule"}, ...]
+     * @param sceneFile Scene file; the cache is written next to it, with the ".physcache" extension.
+     */
+    bool initialize(bool flyMode_, const std::string& sceneFile, const PlayerConfig& playerCfg = PlayerConfig(),
+                   const BackgroundTerrainConfig& terrainCfg = BackgroundTerrainConfig());
     void cleanup();
 
     // Update
+    /**
+     * Advances the simulation by the frame time, in fixed ticks (see setFixedTimestep()).
+     * The controller logic (ground probe, movement, slopes, steps, jumps) runs once per tick, with the tick
+     * length as time step, so the outcome does not depend on the frame rate.
+     */
     void update(float deltaTime);
+    /**
+     * @param tickRate    Ticks per second (default 60).
+     * @param maxSubSteps Most ticks run by one update() (default 4); the frame time beyond them is dropped.
+     */
+    void setFixedTimestep(float tickRate, int maxSubSteps);
+    int getLastStepCount() const { return lastStepCount; }
+
+    /**
+     * Moves the simulation to a dedicated thread, ticking at the fixed rate. Must be called after the
+     * world is populated. From then on update() only takes the latest snapshot and the counters of the
+     * ticks run since the previous frame (see PhysicsStats), the player commands are queued to the physics
+     * thread, and the player state getters read the snapshot (the position being interpolated between its
+     * last two ticks).
+     */
+    void startThread();
+    /** Stops the physics thread (called by cleanup()); the simulation goes back to update(). */
+    void stopThread();
+    bool isThreaded() const { return physicsThread.joinable(); }
+    const PhysicsTimings& getTimings() const { return timings; }
+    void printTimings() const;
+    /**
+     * Counters of the physics steps (time, substeps, broadphase pairs, manifolds, solver iterations,
+     * queries), with rolling histograms. Inline, one step is an update() with the ticks it ran. With the
+     * physics thread running, every tick is queued to the render thread (merged with the next ones while the
+     * queue is full), and each update() records the ticks queued since the previous one as a single step:
+     * no tick is dropped, substeps counts them and maxTickMs keeps the longest.
+     */
+    const PhysicsStats& getPhysicsStats() const { return physicsStats; }
+    void resetPhysicsStats() { physicsStats.reset(); }
 
-    // Player control
+    // Player control: commands are stored and applied by the next fixed ticks
     void movePlayer(const glm::vec3& moveDirection, bool isRunning = false);
     void jumpPlayer();
+    /** Position for rendering: interpolated between the last two ticks by the motion state. */
     glm::vec3 getPlayerPosition() const;
     glm::vec3 getPlayerVelocity() const;
-    bool isPlayerGrounded() const { return isGrounded; }
+    bool isPlayerGrounded() const { return isThreaded() ? snapshots.front().grounded : isGrounded; }
 
     // Object management
     PhysicsObject* addStaticBox(const glm::vec3& position, const glm::vec3& size);
     PhysicsObject* addStaticSphere(const glm::vec3& position, float radius);
     void addStaticMeshes(Model **modelRefs, Instance **instanceRefs, int instanceCount);
+    /** Must be called before initialize(): the configuration is part of the key of the baked world. */
+    void setTerrainCollisionConfig(const TerrainCollision::Config& config) { terrainCollisionConfig = config; }
+    /** Must be called before initialize(): the rules are part of the key of the baked world. */
+    void setCollisionProxyConfig(const CollisionShapeCache::ProxyConfig& config) { shapeCache.setProxyConfig(config); }
+    /** Must be called before initialize(): part of the key of the baked world, partitioned while loading it. */
+    void setStaticPartitionConfig(const StaticWorldPartition::Config& config) { staticPartitionConfig = config; }
+    /**
+     * Adds static shapes, not owned by the manager, going through the same partition of the scene meshes.
+     * Meant for tests and benchmarks: the shapes must outlive the manager (or its cleanup()).
+     */
+    void addStaticShapes(const std::vector<StaticWorldPartition::Entry>& entries) { addStaticWorld(entries); }
     void addPlayerFromModel(const Model* modelRef);
     void addCapsulePlayer();
 
+    /**
+     * Ground probe of the player, run by every fixed tick: updates the ground normal and slope.
+     * Public for the micro benchmarks (bench/micro_bench.cpp), like getShapeFromModel().
+     * @return Whether the player stands on walkable ground.
+     */
+    bool checkGrounded();
+    /** Triangle mesh shape of a model, nullptr if too small; the caller owns it and its getMeshInterface(). */
+    static btCollisionShape * getShapeFromModel(const Model* modelRef);
+
+    /**
+     * Creates a dynamic body, owning the shape.
+     * @return The body, also added to the dynamic props (without a rendered instance).
+     */
+    PhysicsObject* addDynamicBody(btCollisionShape* shape, const btTransform& transform, const DynamicPropConfig& config);
+    /**
+     * Makes dynamic the instances of the models listed in the "dynamicProps" array of the scene file (if any).
+     * Must be called before addStaticMeshes(), which then skips them. Their Wm is updated by update(), only
+     * while the bodies are awake.
+     * @return 0 on success, -1 if an entry refers to an unknown model or shape.
+     */
+    int addDynamicProps(const std::string& sceneFile, const Scene& scene);
+    int getDynamicPropCount() const { return static_cast<int>(dynamicProps.size()); }
+    /** Dynamic bodies currently awake (reads the world: inline mode only). */
+    int getAwakeDynamicCount() const;
+
     // Utility
+    /** Must be called before initialize(). */
+    void setWorldConfig(const PhysicsWorldConfig& config) { worldConfig = config; }
     void setGravity(const glm::vec3& gravity);
     void setPlayerPosition(const glm::vec3& position);
+    /**
+     * Casts a ray against the world, ignoring the player (reads the world: inline mode only, asserted;
+     * with the physics thread running it returns false).
+     * @return true if something was hit, with the closest hit point.
+     */
+    bool rayCast(const glm::vec3& from, const glm::vec3& to, glm::vec3& hitPoint) const;
 
     // Debug
     int getNumRigidBodies() const;
+    /** Bounds of the static bodies (including the terrain heightfield); false if there are none. */
+    bool getStaticWorldBounds(glm::vec3& bMin, glm::vec3& bMax) const;
+    const StaticWorldPartition::Stats& getStaticPartitionStats() const { return staticPartition.getStats(); }
+    const GroundProbe::Stats& getGroundProbeStats() const { return groundProbe.getStats(); }
+    void resetGroundProbeStats() { groundProbe.resetStats(); }
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+/**
+ * What a physics step (one update(), with the ticks it ran inline or those the physics thread ran since the
+ * previous update()) did and cost.
+ */
+struct PhysicsStepStats {
+    double stepMs = 0.0;            // stepSimulation(), all its ticks included
+    double maxTickMs = 0.0;         // longest tick (inline, the ticks of a stepSimulation() are not timed apart)
+    int substeps = 0;               // fixed ticks run
+    int overlappingPairs = 0;       // broadphase pairs, after the step
+    int manifolds = 0;              // narrowphase contact manifolds, after the step
+    int contacts = 0;               // contact points in those manifolds
+    int solverIterations = 0;       // configured iterations times ticks (Bullet does not report early exits)
+    int groundProbes = 0;           // probes of checkGrounded() (which also serve handleStepClimbing())
+    int broadphaseQueries = 0;      // aabb queries issued by the probes
+    int sweeps = 0;                 // narrowphase sweeps issued by the probes
+    int rayQueries = 0;             // rayCast() calls since the previous step
+
+    /** Merges a later tick into the step: times and counts add up, the world counters are the latest. */
+    void add(const PhysicsStepStats& tick);
+};
+
+/**
+ * Histogram over the last N values of a quantity (a ring buffer: older values are forgotten).
+ * Percentiles and bins are computed on request, from a sorted copy of the window.
+ */
+class RollingHistogram {
+public:
+    explicit RollingHistogram(size_t capacity = 600);
+
+    void add(double value);
+    void clear();
+
+    size_t count() const { return full ? values.size() : next; }
+    double mean() const;
+    double max() const;
+    /** @param p In [0, 1]. */
+    double percentile(double p) const;
+
+    /** {"count", "mean", "p50", "p95", "p99", "max", "bins": [{"lo", "hi", "count"}, ...]} over the window. */
+    nlohmann::json toJson(int bins = 16) const;
+
+private:
+    std::vector<double> values;
+    size_t next = 0;
+    bool full = false;
+};
+
+/**
+ * Per step physics counters, with rolling histograms of the last steps, to tell whether frame spikes come
+ * from physics and from which part of it. Exported as JSON, or summarized in a few lines for an overlay.
+ */
+class PhysicsStats {
+public:
+    explicit PhysicsStats(size_t window = 600);
+
+    void record(const PhysicsStepStats& step);
+    void reset();
+
+    const PhysicsStepStats& last() const { return lastStep; }
+    uint64_t getSteps() const { return steps; }
+    const RollingHistogram& getStepMs() const { return stepMs; }
+
+    nlohmann::json toJson() const;
+    /** @return true on success. */
+    bool writeJson(const std::string& file) const;
+    /** Last step and percentiles of the window, a few lines of text (e.g. for TextMaker). */
+    std::string summary() const;
+
+private:
+    PhysicsStepStats lastStep;
+    uint64_t steps = 0;
+    double worstStepMs = 0.0;       // since the last reset
+    double worstTickMs = 0.0;
+    RollingHistogram stepMs;
+    RollingHistogram maxTickMs;
+    RollingHistogram substeps;
+    RollingHistogram overlappingPairs;
+    RollingHistogram manifolds;
+    RollingHistogram contacts;
+    RollingHistogram solverIterations;
+    RollingHistogram queries;       // probes' broadphase queries and sweeps, plus ray casts
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Frame profiler: CPU scopes (PROFILE_SCOPE) and GPU regions (see GpuProfiler) are recorded as events in a
+ * lock-free ring, shown per scope in an overlay (overlayText()) and exported as a Chrome trace
+ * (writeChromeTrace(), to be opened in chrome://tracing or https://ui.perfetto.dev).
+ *
+ * Any thread can record: a slot of the ring is claimed with one atomic increment and published with a
+ * sequence number, so writers never wait for each other nor for the reader. When the ring is full the oldest
+ * events are overwritten. Reading (newFrame(), overlayText(), writeChromeTrace()) is done by the main thread.
+ *
+ * Everything is compiled only if ENABLE_PROFILER is defined (CMake option ENABLE_PROFILER): otherwise the
+ * macros expand to nothing and the class does not exist.
+ */
+
+#ifdef ENABLE_PROFILER
+
+class Profiler {
+public:
+    enum EventKind : uint8_t { Cpu, Gpu };
+
+    /** The profiler of the process. */
+    static Profiler& get();
+
+    /** Nanoseconds since the profiler was created. */
+    static uint64_t nowNs();
+
+    /** Records an event; name must outlive the profiler (a string literal). */
+    void record(const char* name, uint64_t startNs, uint64_t endNs, EventKind kind = Cpu);
+
+    /** Names the calling thread in the trace. */
+    void setThreadName(const char* name);
+
+    /** Marks the beginning of a frame: the events of the previous one are added to the overlay statistics. */
+    void newFrame();
+
+    /**
+     * Per scope milliseconds per frame (mean and worst frame) since the previous call, which starts a new window.
+     */
+    std::string overlayText();
+
+    /** Statistics of a scope over the frames since the last resetTotals(), not affected by overlayText(). */
+    struct ScopeTotal {
+        std::string name;
+        double meanMs;          // per frame
+        double worstMs;         // worst frame
+        double callsPerFrame;
+    };
+    /** Per scope totals (e.g. for the report of a benchmark run), sorted by name. */
+    std::vector<ScopeTotal> totals() const;
+    void resetTotals();
+
+    /** Writes the events still in the ring as a Chrome trace. @return false if the file cannot be written. */
+    bool writeChromeTrace(const std::string& file) const;
+
+private:
+    static constexpr size_t CAPACITY = 1 << 16;     // events, a power of two
+
+    // Fields are atomics so that a slot overwritten while read is a detected race (see read()), not UB
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};          // index of the event + 1 when complete, 0 while written
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> startNs{0};
+        std::atomic<uint64_t> endNs{0};
+        std::atomic<uint32_t> thread{0};
+        std::atomic<uint8_t> kind{Cpu};
+    };
+    struct Event {
+        const char* name;
+        uint64_t startNs, endNs;
+        uint32_t thread;
+        uint8_t kind;
+    };
+    struct ScopeStats {
+        uint64_t frameNs = 0;       // in the current frame
+        uint64_t totalNs = 0;       // in the window
+        uint64_t worstFrameNs = 0;
+        uint32_t calls = 0;
+        uint64_t runNs = 0;         // since resetTotals()
+        uint64_t runWorstFrameNs = 0;
+        uint64_t runCalls = 0;
+    };
+
+    Profiler() = default;
+    bool read(uint64_t index, Event& event) const;
+    uint32_t threadIndex();
+
+    std::vector<Slot> ring = std::vector<Slot>(CAPACITY);
+    alignas(64) std::atomic<uint64_t> head{0};     // events ever recorded
+
+    std::atomic<uint32_t> threadCount{0};
+    mutable std::mutex namesMutex;                  // names are set once per thread, outside of the hot path
+    std::unordered_map<uint32_t, std::string> threadNames;
+
+    // Main thread only
+    uint64_t readCursor = 0;
+    uint32_t windowFrames = 0;
+    uint64_t runFrames = 0;
+    std::unordered_map<const char*, ScopeStats> scopes;
+};
+
+/** Times the enclosing scope. */
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), startNs(Profiler::nowNs()) {}
+    ~ProfileScope() { Profiler::get().record(name, startNs, Profiler::nowNs()); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t startNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::get().newFrame()
+#define PROFILE_THREAD(name) Profiler::get().setThreadName(name)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FRAME()
+#define PROFILE_THREAD(name)
+
+#endif
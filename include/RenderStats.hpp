@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Work of a pass: commands recorded in the command buffers, and instances drawn or skipped.
+ * Instances are skipped when their technique has no pipeline for the pass (e.g. no shadow): there is no
+ * culling yet, so culledInstances counts only those.
+ */
+struct PassStats {
+    uint32_t drawCalls = 0;
+    uint64_t triangles = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorBinds = 0;
+    uint32_t vertexBufferBinds = 0;
+    uint32_t drawnInstances = 0;
+    uint32_t culledInstances = 0;
+
+    PassStats& operator+=(const PassStats& o) {
+        drawCalls += o.drawCalls;
+        triangles += o.triangles;
+        pipelineBinds += o.pipelineBinds;
+        descriptorBinds += o.descriptorBinds;
+        vertexBufferBinds += o.vertexBufferBinds;
+        drawnInstances += o.drawnInstances;
+        culledInstances += o.culledInstances;
+        return *this;
+    }
+};
+
+/** Everything a frame generated: the commands of the command buffers it submitted, and its uploads. */
+struct FrameStats {
+    static constexpr int MAX_PASSES = 4;
+    static constexpr int OTHER_PASS = MAX_PASSES;   // commands outside of Scene passes (text, compute)
+
+    uint64_t frame = 0;
+    std::array<PassStats, MAX_PASSES + 1> passes{};
+    uint32_t commandBuffers = 0;
+    uint32_t mapCalls = 0;
+    uint64_t uboBytes = 0;          // DescriptorSet::map
+    uint64_t storageBytes = 0;      // StorageBuffer::map
+    uint32_t textGlyphs = 0;        // glyphs drawn by the indirect draw of TextMaker
+
+    PassStats total() const {
+        PassStats t;
+        for (const PassStats& p : passes) t += p;
+        return t;
+    }
+};
+
+/**
+ * Per frame render statistics.
+ *
+ * Command buffers are recorded once and submitted every frame, so the commands are counted while a command
+ * buffer is recorded (beginRecording() and the count* methods, called by Pipeline, DescriptorSet, Model,
+ * Scene and TextMaker) and added to the frame each time it is submitted (submitted(), by drawFrame). Uploads
+ * are counted as they happen. endFrame() closes the frame: it becomes getLastFrame(), and a line of the CSV
+ * file, if one is open.
+ *
+ * Counters are plain increments: everything must be called from the render thread.
+ */
+class RenderStats {
+public:
+    static RenderStats& get() {
+        static RenderStats stats;
+        return stats;
+    }
+
+    // Recording (the command buffer is any Vulkan handle, VkCommandBuffer)
+    void beginRecording(const void* commandBuffer) {
+        recording = &recorded[commandBuffer];
+        recordingBuffer = commandBuffer;
+        *recording = Recorded();
+    }
+    void forget(const void* commandBuffer) {
+        recorded.erase(commandBuffer);
+        if (recordingBuffer == commandBuffer) {
+            recording = nullptr;
+            recordingBuffer = nullptr;
+        }
+    }
+    /** Scene pass the next commands of the command buffer belong to; -1 for none. */
+    void setPass(const void* commandBuffer, int pass) {
+        target(commandBuffer).pass = (pass >= 0 && pass < FrameStats::MAX_PASSES) ? pass : FrameStats::OTHER_PASS;
+    }
+    void countPipelineBind(const void* commandBuffer) { current(commandBuffer).pipelineBinds++; }
+    void countDescriptorBind(const void* commandBuffer) { current(commandBuffer).descriptorBinds++; }
+    void countVertexBufferBind(const void* commandBuffer) { current(commandBuffer).vertexBufferBinds++; }
+    void countDraw(const void* commandBuffer, uint32_t indexCount, uint32_t instanceCount = 1) {
+        PassStats& p = current(commandBuffer);
+        p.drawCalls++;
+        p.triangles += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+        p.drawnInstances += instanceCount;
+    }
+    void countIndirectDraw(const void* commandBuffer) { current(commandBuffer).drawCalls++; }
+    void countCulled(const void* commandBuffer) { current(commandBuffer).culledInstances++; }
+
+    // Per frame
+    void countUboUpload(uint64_t bytes) { frame.mapCalls++; frame.uboBytes += bytes; }
+    void countStorageUpload(uint64_t bytes) { frame.mapCalls++; frame.storageBytes += bytes; }
+    void countTextGlyphs(uint32_t glyphs) {
+        frame.textGlyphs += glyphs;
+        frame.passes[FrameStats::OTHER_PASS].triangles += 2ull * glyphs;
+    }
+    /** Adds the commands recorded in the command buffer to the frame. */
+    void submitted(const void* commandBuffer);
+    void endFrame();
+
+    const FrameStats& getLastFrame() const { return last; }
+
+    /** The last frame, as text for the overlay. */
+    std::string summary() const;
+
+    /** Starts writing a line per frame and pass to a CSV file. @return false if it cannot be opened. */
+    bool startCsv(const std::string& file);
+    void stopCsv();
+    bool isWritingCsv() const { return csv.is_open(); }
+
+private:
+    struct Recorded {
+        std::array<PassStats, FrameStats::MAX_PASSES + 1> passes{};
+        int pass = FrameStats::OTHER_PASS;
+    };
+
+    RenderStats() = default;
+
+    Recorded& target(const void* commandBuffer) {
+        if (recordingBuffer != commandBuffer) {
+            recording = &recorded[commandBuffer];
+            recordingBuffer = commandBuffer;
+        }
+        return *recording;
+    }
+    PassStats& current(const void* commandBuffer) {
+        Recorded& r = target(commandBuffer);
+        return r.passes[r.pass];
+    }
+
+    std::unordered_map<const void*, Recorded> recorded;
+    Recorded* recording = nullptr;          // entry of recordingBuffer (the map never moves its values)
+    const void* recordingBuffer = nullptr;
+
+    FrameStats frame;
+    FrameStats last;
+    uint64_t frameCount = 0;
+    std::ofstream csv;
+};
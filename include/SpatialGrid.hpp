@@ -0,0 +1,221 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Spatial index of points (characters, interaction points, ...) for proximity queries.
+ * Points live in a uniform grid of square cells on the XZ plane, stored sparsely in a hash map, so the
+ * covered area is unbounded and empty space costs nothing. Distances are measured in 3D.
+ *
+ * Every point has a handle, returned by insert(), and a mask of tags (user defined categories, such as
+ * "torch" or "NPC"). Queries take a mask, matching the points with at least one of its tags, and optionally
+ * a predicate on the handle, for conditions that change often and are cheaper to check than to keep in the
+ * tags (e.g. "idle"). Moving a point within its cell only rewrites its position.
+ *
+ * Nearest and k-nearest queries visit the cells in rings of growing distance and stop as soon as no farther
+ * ring can hold a closer point, so their cost depends on the local density, not on the total count.
+ * The cell size should be about the typical query radius.
+ */
+class SpatialGrid {
+public:
+    static constexpr uint32_t ALL_TAGS = 0xffffffffu;
+
+    struct Hit {
+        int handle;
+        float distance;
+    };
+
+    explicit SpatialGrid(float cellSize = 8.0f);
+
+    /** @return Handle of the new point. */
+    int insert(const glm::vec3& position, uint32_t tags = 1);
+    void update(int handle, const glm::vec3& position);
+    void setTags(int handle, uint32_t tags);
+    void remove(int handle);
+    void clear();
+
+    size_t size() const { return count; }
+    const glm::vec3& getPosition(int handle) const { return item(handle).position; }
+    uint32_t getTags(int handle) const { return item(handle).tags; }
+
+    /**
+     * Nearest point within maxDistance, with one of the tags and accepted by the predicate.
+     * @return Its handle, or -1 if none.
+     */
+    template <typename Accept>
+    int nearest(const glm::vec3& position, float maxDistance, uint32_t tags, Accept accept, float* distance = nullptr) const;
+    int nearest(const glm::vec3& position, float maxDistance, uint32_t tags = ALL_TAGS, float* distance = nullptr) const {
+        return nearest(position, maxDistance, tags, [](int) { return true; }, distance);
+    }
+
+    /** The k nearest points within maxDistance, closest first (out is replaced). */
+    template <typename Accept>
+    void kNearest(const glm::vec3& position, size_t k, float maxDistance, uint32_t tags, Accept accept, std::vector<Hit>& out) const;
+    void kNearest(const glm::vec3& position, size_t k, float maxDistance, uint32_t tags, std::vector<Hit>& out) const {
+        kNearest(position, k, maxDistance, tags, [](int) { return true; }, out);
+    }
+
+    /** All the points within radius, in no particular order (out is replaced). */
+    template <typename Accept>
+    void queryRadius(const glm::vec3& position, float radius, uint32_t tags, Accept accept, std::vector<Hit>& out) const;
+    void queryRadius(const glm::vec3& position, float radius, uint32_t tags, std::vector<Hit>& out) const {
+        queryRadius(position, radius, tags, [](int) { return true; }, out);
+    }
+
+private:
+    // Points are stored inside their cell, so that a query scans contiguous memory
+    struct Item {
+        glm::vec3 position;
+        uint32_t tags;
+        int handle;
+    };
+    struct Slot {
+        uint64_t cell;
+        int index;          // in the items of the cell; -1 if the handle is free
+    };
+
+    float cellSize;
+    float invCellSize;
+    std::unordered_map<uint64_t, std::vector<Item>> cells;
+    std::vector<Slot> slots;            // by handle
+    std::vector<int> freeHandles;
+    size_t count = 0;
+
+    int cellCoord(float v) const { return static_cast<int>(std::floor(v * invCellSize)); }
+    static uint64_t cellKey(int x, int z) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z);
+    }
+    const Item& item(int handle) const { return cells.at(slots[handle].cell)[slots[handle].index]; }
+    void unlink(int handle);
+
+    static float distance(const glm::vec3& a, const glm::vec3& b) {
+        const glm::vec3 d = a - b;
+        return std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+
+    /*
+     * Calls visit(items) for every cell at Chebyshev distance ring from the cell of position, skipping the
+     * cells farther than bound on the XZ plane (bound is read before each cell, so it can shrink meanwhile).
+     * When the cells of the ring are more than the occupied ones, the occupied ones are filtered instead.
+     */
+    template <typename Visit>
+    void forEachCellInRing(const glm::vec3& position, int ring, const float& bound, Visit visit) const;
+};
+
+template <typename Visit>
+void SpatialGrid::forEachCellInRing(const glm::vec3& position, int ring, const float& bound, Visit visit) const {
+    const int cx = cellCoord(position.x), cz = cellCoord(position.z);
+    auto inBound = [&](int x, int z) {
+        // Distance on XZ from the position to the square of the cell
+        const float x0 = x * cellSize, z0 = z * cellSize;
+        const float dx = std::max(std::max(x0 - position.x, position.x - (x0 + cellSize)), 0.0f);
+        const float dz = std::max(std::max(z0 - position.z, position.z - (z0 + cellSize)), 0.0f);
+        return dx * dx + dz * dz <= bound * bound;
+    };
+    auto tryCell = [&](int x, int z) {
+        if (!inBound(x, z)) return;
+        auto it = cells.find(cellKey(x, z));
+        if (it != cells.end()) visit(it->second);
+    };
+    if (ring == 0) {
+        tryCell(cx, cz);
+        return;
+    }
+    if (static_cast<size_t>(8 * ring) > cells.size()) {
+        for (const auto& kv : cells) {
+            const int x = static_cast<int>(static_cast<uint32_t>(kv.first >> 32));
+            const int z = static_cast<int>(static_cast<uint32_t>(kv.first & 0xffffffffu));
+            if (std::max(std::abs(x - cx), std::abs(z - cz)) == ring && inBound(x, z)) visit(kv.second);
+        }
+        return;
+    }
+    for (int i = -ring; i <= ring; i++) {
+        // Top and bottom rows, then the left and right columns without their corners
+        tryCell(cx + i, cz - ring);
+        tryCell(cx + i, cz + ring);
+        if (i == -ring || i == ring) continue;
+        tryCell(cx - ring, cz + i);
+        tryCell(cx + ring, cz + i);
+    }
+}
+
+template <typename Accept>
+int SpatialGrid::nearest(const glm::vec3& position, float maxDistance, uint32_t tags, Accept accept, float* distanceOut) const {
+    int best = -1;
+    float bestDistance = maxDistance;
+    const int rings = static_cast<int>(std::ceil(maxDistance * invCellSize));
+    for (int ring = 0; ring <= rings && count > 0; ring++) {
+        forEachCellInRing(position, ring, bestDistance, [&](const std::vector<Item>& items) {
+            for (const Item& it : items) {
+                if ((it.tags & tags) == 0) continue;
+                const float d = distance(it.position, position);
+                if (d <= bestDistance && accept(it.handle)) {
+                    bestDistance = d;
+                    best = it.handle;
+                }
+            }
+        });
+        // Every cell of the next ring is at least ring cells away from the query point
+        if (best >= 0 && bestDistance <= ring * cellSize) break;
+    }
+    if (distanceOut != nullptr && best >= 0) *distanceOut = bestDistance;
+    return best;
+}
+
+template <typename Accept>
+void SpatialGrid::kNearest(const glm::vec3& position, size_t k, float maxDistance, uint32_t tags, Accept accept,
+                           std::vector<Hit>& out) const {
+    out.clear();
+    if (k == 0) return;
+    // Max-heap on the distance: the farthest of the k best is on top
+    auto farther = [](const Hit& a, const Hit& b) { return a.distance < b.distance; };
+    float bound = maxDistance;      // distance of the k-th best so far
+    const int rings = static_cast<int>(std::ceil(maxDistance * invCellSize));
+    for (int ring = 0; ring <= rings && count > 0; ring++) {
+        forEachCellInRing(position, ring, bound, [&](const std::vector<Item>& items) {
+            for (const Item& it : items) {
+                if ((it.tags & tags) == 0) continue;
+                const float d = distance(it.position, position);
+                if (d > bound || (out.size() == k && d >= out.front().distance) || !accept(it.handle)) continue;
+                if (out.size() == k) {
+                    std::pop_heap(out.begin(), out.end(), farther);
+                    out.pop_back();
+                }
+                out.push_back({it.handle, d});
+                std::push_heap(out.begin(), out.end(), farther);
+                if (out.size() == k) bound = out.front().distance;
+            }
+        });
+        if (out.size() == k && out.front().distance <= ring * cellSize) break;
+    }
+    std::sort_heap(out.begin(), out.end(), farther);
+}
+
+template <typename Accept>
+void SpatialGrid::queryRadius(const glm::vec3& position, float radius, uint32_t tags, Accept accept, std::vector<Hit>& out) const {
+    out.clear();
+    const int x0 = cellCoord(position.x - radius), x1 = cellCoord(position.x + radius);
+    const int z0 = cellCoord(position.z - radius), z1 = cellCoord(position.z + radius);
+    auto visit = [&](const std::vector<Item>& items) {
+        for (const Item& it : items) {
+            if ((it.tags & tags) == 0) continue;
+            const float d = distance(it.position, position);
+            if (d <= radius && accept(it.handle)) out.push_back({it.handle, d});
+        }
+    };
+    if (static_cast<size_t>(x1 - x0 + 1) * static_cast<size_t>(z1 - z0 + 1) > cells.size()) {
+        for (const auto& kv : cells) visit(kv.second);
+        return;
+    }
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            auto it = cells.find(cellKey(x, z));
+            if (it != cells.end()) visit(it->second);
+        }
+    }
+}
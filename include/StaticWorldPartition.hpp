@@ -0,0 +1,68 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <memory>
+#include <vector>
+
+/**
+ * Partition of the static collision world into a grid of cells on the XZ plane.
+ * Every static shape is assigned to the cell containing the center of its world aabb, and all the shapes of
+ * a cell become the children of one btCompoundShape, placed at the center of the cell. Each cell is then a
+ * single collision object, so the broadphase holds one object per occupied cell instead of one per prop:
+ * its size depends on the area of the world, not on how densely it is furnished. Inside a cell, queries and
+ * contacts go through the dynamic aabb tree of the compound, which only visits the children they touch.
+ *
+ * The children are the shapes passed in (e.g. the shared meshes of the CollisionShapeCache): no triangle is
+ * copied. Cells with fewer shapes than Config::minChildren keep them as they are, without a compound.
+ * The object owns the compound shapes only: the shapes passed in must outlive it.
+ */
+class StaticWorldPartition {
+public:
+    struct Config {
+        float cellSize = 32.0f;     // side of a cell, in meters; <= 0 disables the partition
+        int minChildren = 2;        // smaller cells keep their shapes as separate objects
+    };
+
+    /** A static shape at a rigid transform, as it would be added to the world. */
+    struct Entry {
+        btCollisionShape* shape;
+        btTransform transform;
+    };
+
+    /** A collision object to create: a compound cell, or a shape left alone. */
+    struct Cell {
+        btCollisionShape* shape;                    // the compound, or the original shape
+        btTransform transform;
+        std::unique_ptr<btCompoundShape> compound;  // owner of the shape, if a compound
+    };
+
+    struct Stats {
+        int sourceShapes = 0;       // entries partitioned (by all the calls of add())
+        int cells = 0;              // occupied cells
+        int compounds = 0;          // cells merged into a compound
+        int objects = 0;            // collision objects to create (compounds plus shapes left alone)
+        int largestCell = 0;        // children of the most crowded cell
+        double buildMs = 0.0;
+    };
+
+    StaticWorldPartition() = default;
+    StaticWorldPartition(const StaticWorldPartition&) = delete;
+    StaticWorldPartition& operator=(const StaticWorldPartition&) = delete;
+
+    /**
+     * Partitions the entries and appends their cells to the ones built so far (the cells of separate calls
+     * are not merged with each other, even where they overlap).
+     */
+    void add(const std::vector<Entry>& entries, const Config& config = Config());
+
+    /** Releases the compound shapes. No collision object using them may remain in a world. */
+    void clear();
+
+    const std::vector<Cell>& getCells() const { return cells; }
+    const Stats& getStats() const { return stats; }
+    void printReport() const;
+
+private:
+    std::vector<Cell> cells;
+    Stats stats;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "modules/Starter.hpp"
+
+/**
+ * Collision of the terrain as a heightfield.
+ * The terrain meshes are resampled, in world space, into a regular grid of heights on the XZ plane: each
+ * sample takes the highest terrain surface above it, which is what a downward ray against the meshes would
+ * hit. The grid is split into square chunks, each one a btHeightfieldTerrainShape; chunks not touched by any
+ * terrain triangle are dropped, so sparse maps (e.g. far mountains around a small playable area) do not pay
+ * for the empty space between them. Adjacent chunks share their border samples, so there are no seams.
+ *
+ * Ray tests and contacts against a heightfield only visit the cells under the query, without traversing a
+ * BVH, and each sample costs one float (or one short, if quantized) instead of vertices, indices and nodes.
+ * Overhangs and vertical walls cannot be represented: terrain is expected to be a height map.
+ * The object owns the height data and the shapes: the physics objects using them must not delete them.
+ */
+class TerrainCollision {
+public:
+    struct Config {
+        float cellSize = 1.0f;      // distance between two samples, in meters
+        int chunkSamples = 128;     // cells per chunk side; 0 puts the whole grid in a single chunk
+        bool quantize = false;      // store the heights as 16 bits integers, scaled per chunk
+    };
+
+    /** A piece of the heightfield, positioned in world space. */
+    struct Chunk {
+        std::unique_ptr<btHeightfieldTerrainShape> shape;
+        btTransform transform;
+        std::vector<float> heights;         // one of the two, depending on Config::quantize
+        std::vector<int16_t> quantized;
+    };
+
+    struct Stats {
+        size_t sourceTriangles = 0;     // terrain triangles resampled
+        int gridWidth = 0;              // samples along x of the whole grid
+        int gridLength = 0;             // samples along z of the whole grid
+        int chunks = 0;                 // chunks kept
+        int emptyChunks = 0;            // chunks dropped because no triangle covers them
+        size_t samples = 0;             // samples stored in the kept chunks
+        size_t bytes = 0;               // memory of the stored samples
+        double buildMs = 0.0;
+    };
+
+    TerrainCollision() = default;
+    TerrainCollision(const TerrainCollision&) = delete;
+    TerrainCollision& operator=(const TerrainCollision&) = delete;
+
+    /**
+     * Builds the heightfield from terrain meshes.
+     * @param models     Models of the terrain instances, with their vertices still in CPU memory.
+     * @param transforms World matrix of each instance (same size as models).
+     * @return 0 on success, -1 if the meshes contain no triangles.
+     */
+    int build(const std::vector<const Model*>& models, const std::vector<glm::mat4>& transforms, const Config& config = Config());
+
+    /** Releases the shapes and the height data. No collision object using them may remain in a world. */
+    void clear();
+
+    const std::vector<Chunk>& getChunks() const { return chunks; }
+    const Stats& getStats() const { return stats; }
+    void printReport() const;
+
+private:
+    std::vector<Chunk> chunks;
+    Stats stats;
+};
@@ -16,6 +16,7 @@
  *
  * When the specified key is pressed, the action is executed only once until the key is released.
  * This prevents multiple triggers from a single key press.
+ * Keys are read from the input of the frame (see InputRecorder), so they can be recorded and replayed.
  */
 void handleKeyToggle(GLFWwindow* window, int key, bool& debounce, int& curDebounce, const std::function<void()>& action);
 
@@ -28,6 +29,7 @@ void handleKeyToggle(GLFWwindow* window, int key, bool& debounce, int& curDeboun
  * @param onPress      Function to execute when the key is pressed.
  * @param onRelease    Function to execute when the key is released.
  *
+ * Keys are read from the input of the frame (see InputRecorder), as in handleKeyToggle().
  */
 void handleKeyStateChange(GLFWwindow* window, int key, bool& prevState, std::function<void()> onPress, std::function<void()> onRelease);
 
@@ -75,5 +77,19 @@ float shortestAngularDiff(float from, float to);
  * Wraps the input text to ensure that no line exceeds the specified maximum line length.
  * This function breaks lines at spaces to avoid splitting words, and inserts newline
  * characters as needed.
+ * Results are memoized (per thread, up to a bound), so wrapping the same text again is a lookup.
  */
 std::string wrapText(const std::string& text, size_t maxWidth);
+
+/**
+ * Forgets the texts wrapped by wrapText on the calling thread.
+ */
+void clearWrapTextMemo();
+
+/**
+ * Parses the numeric suffix of a scene id, after its last '.' (e.g. "torch_fire.03" -> 3).
+ * Meant for load time resolution of ids into indices, not for per frame use.
+ *
+ * @return The index, or -1 if the id has no numeric suffix or it does not fit in an int.
+ */
+int parseIdIndex(const std::string& id);
@@ -40,6 +40,11 @@ public:
 	 * It computes both the new world matrix and the view-projection matrix.
 	 */
 	void updateFrame(float deltaT, glm::vec3 moveInput, glm::vec3 rotInput, bool isRunning);
+	/**
+	 * Updates the camera from a scripted position (e.g. a benchmark camera path) instead of the input:
+	 * perspective projection from eye towards target, whatever the view mode. The player does not move.
+	 */
+	void updateScripted(const glm::vec3& eye, const glm::vec3& target);
 	/**
 	 * Cycles to the next camera view mode.
 	 */
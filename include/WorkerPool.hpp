@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small fixed-size pool of worker threads used to split per-frame work (e.g. animation sampling)
+ * across cores.
+ * A job is a range [0, count) that is processed in chunks of `grain` items: the workers (and,
+ * for parallelFor, the calling thread too) pull chunks from a shared atomic counter until the
+ * range is exhausted.
+ * Only one job can be in flight at a time: dispatching a new job first waits for the previous one.
+ */
+class WorkerPool {
+public:
+    /**
+     * Creates the pool and starts its worker threads.
+     * @param workerCount Number of background threads. A negative value means
+     *                    "hardware concurrency - 1" (the calling thread being the remaining one).
+     */
+    explicit WorkerPool(int workerCount = -1);
+
+    /** Waits for the job in flight (if any) and joins all the workers. */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * Starts processing [0, count) on the background workers and returns immediately.
+     * If the pool has no workers, the job is executed synchronously on the calling thread.
+     * @param count Number of items to process.
+     * @param job   Function called with sub-ranges [begin, end) of the items.
+     * @param grain Number of items taken by a thread at once.
+     */
+    void dispatch(int count, std::function<void(int, int)> job, int grain = 1);
+
+    /**
+     * Processes [0, count) using both the workers and the calling thread, and returns
+     * when all the items have been processed.
+     */
+    void parallelFor(int count, std::function<void(int, int)> job, int grain = 1);
+
+    /** Blocks until the job in flight (if any) is completed. */
+    void wait();
+
+    /** Returns the number of background worker threads. */
+    int getWorkerCount() const { return static_cast<int>(workers.size()); }
+
+private:
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeCv;     // signals workers a new job is available (or the pool is stopping)
+    std::condition_variable doneCv;     // signals waiters that all the workers are done with the current job
+
+    std::function<void(int, int)> job;
+    int jobCount = 0;
+    int jobGrain = 1;
+    std::atomic<int> nextIndex{0};
+    unsigned int generation = 0;        // incremented for each dispatched job
+    int busyWorkers = 0;                // workers still processing the current job
+    bool stopping = false;
+};
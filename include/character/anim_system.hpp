@@ -0,0 +1,58 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "character.hpp"
+#include "WorkerPool.hpp"
+
+/**
+ * Animation evaluation stage: advances the blenders and samples the skeletons of all the characters,
+ * spreading them over a pool of worker threads.
+ * Each character writes into the back buffer of its own joint palette, so the results of the previous
+ * evaluation can be read (e.g. packed into the UBOs) while the next one is still running.
+ *
+ * Typical per-frame usage:
+ *   wait()       -> palettes sampled during the previous frame become readable via Character::getPalette()
+ *   ...          -> game logic, which may Start() new animation segments, and UBO packing
+ *   dispatch(dt) -> the next palettes are sampled in background while the frame is submitted
+ */
+class AnimationSystem {
+public:
+    /**
+     * Creates the worker threads.
+     * @param workerCount Number of background workers; negative means "hardware concurrency - 1".
+     */
+    void init(int workerCount = -1);
+
+    /** Waits for the evaluation in flight and stops the worker threads. */
+    void cleanup();
+
+    /**
+     * Starts evaluating the given characters in background and returns immediately.
+     * Neither the characters list nor their animation blenders may be changed until wait() is called.
+     * @param chars Characters to evaluate.
+     * @param dt    Animation time step, in seconds.
+     */
+    void dispatch(const std::vector<std::shared_ptr<Character>>& chars, float dt);
+
+    /**
+     * Waits for the evaluation started by dispatch() (if any) and publishes its palettes.
+     */
+    void wait();
+
+    /**
+     * Evaluates the given characters using the workers and the calling thread, publishing the palettes
+     * before returning.
+     */
+    void evaluate(const std::vector<std::shared_ptr<Character>>& chars, float dt);
+
+    /** Returns the number of threads used by evaluate() (workers + calling thread). */
+    int getThreadCount() const { return pool ? pool->getWorkerCount() + 1 : 1; }
+
+private:
+    void prepare(const std::vector<std::shared_ptr<Character>>& chars);
+    void publish();
+
+    std::unique_ptr<WorkerPool> pool;
+    std::vector<Character*> pending;        // characters of the evaluation in flight
+    bool inFlight = false;
+};
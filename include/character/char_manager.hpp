@@ -1,6 +1,7 @@
 #pragma once
 #include "character.hpp"
 #include "Utils.hpp"
+#include "SpatialGrid.hpp"
 #include <vector>
 #include <memory>
 #include <glm/glm.hpp>
@@ -19,25 +20,48 @@ public:
      */
     void addChar(const std::shared_ptr<Character>& character) {
         characters.push_back(character);
+        int handle = grid.insert(character->getPosition());
+        gridHandles.push_back(handle);
+        if (handleToChar.size() <= static_cast<size_t>(handle)) handleToChar.resize(handle + 1, -1);
+        handleToChar[handle] = static_cast<int>(characters.size()) - 1;
     }
 
     /**
      * Finds the nearest Character in "Idle" state to the given player position within a specified maximum distance.
+     * Characters are looked up in the spatial index, at their positions as of the last update().
      * @param playerPos The current position of the player.
      * @return A shared pointer to the nearest Character in "Idle" state within maxDistance, or nullptr if none found.
      */
     std::shared_ptr<Character> getNearestCharacter(const glm::vec3& playerPos) const {
-        std::shared_ptr<Character> nearest = nullptr;
-        float minDist = maxDistance;
-        for (const auto& charac : characters) {
-            float dist = glm::distance(charac->getPosition(), playerPos);
-            if (dist < minDist && charac->getCurrentState() == "Idle") {
-                minDist = dist;
-                nearest = charac;
-            }
+        int handle = grid.nearest(playerPos, maxDistance, SpatialGrid::ALL_TAGS, [this](int h) {
+            return characters[handleToChar[h]]->isIdle();
+        });
+        return handle >= 0 ? characters[handleToChar[handle]] : nullptr;
+    }
+
+    /**
+     * Spatial index of the characters, for custom proximity queries (e.g. all the characters around a point).
+     * Handles are converted to characters by getCharacterByHandle(). Positions are refreshed by update().
+     */
+    const SpatialGrid& getSpatialIndex() const {
+        return grid;
+    }
+
+    const std::shared_ptr<Character>& getCharacterByHandle(int handle) const {
+        return characters[handleToChar[handle]];
+    }
+
+    /**
+     * Delivers the animation events (end of an animation loop) to the state machines of the characters.
+     * To be called once per frame by the game logic, after the animations evaluation is complete.
+     */
+    void update() {
+        for (size_t i = 0; i < characters.size(); i++) {
+            characters[i]->pollAnimationEvents();
+            grid.update(gridHandles[i], characters[i]->getPosition());
         }
-        return nearest;
     }
+
     /**
      * Returns the collection of managed Character instances.
      */
@@ -50,7 +74,23 @@ public:
      * Initializes characters from a json (scene) file.
      */
     int init(std::string file, Scene SC) {
-        AssetFile** af = SC.As;
+        // Creates a map string (instance id) -> Instance*
+        std::unordered_map<std::string, Instance*> instanceIdToInstanceRef;
+        for (auto kv : SC.InstanceIds) {
+            Instance *inst = SC.I[kv.second];
+            instanceIdToInstanceRef.insert({kv.first, inst});
+        }
+        return init(file, SC.As, instanceIdToInstanceRef);
+    }
+
+    /**
+     * Initializes characters from a json (scene) file, using asset files already loaded.
+     * No Vulkan resource is needed, so this can be used also by headless tools (e.g. benchmarks).
+     * @param af Asset files, in the same order of the "assetfiles" array of the scene file.
+     *           Entries not referenced by the characters animations can be nullptr.
+     * @param instanceIdToInstanceRef Map instance id -> Instance* used to link the characters to their instances.
+     */
+    int init(std::string file, AssetFile** af, const std::unordered_map<std::string, Instance*>& instanceIdToInstanceRef) {
         nlohmann::json sceneJson;
         std::ifstream ifs(file);
         if (!ifs.is_open()) {
@@ -80,13 +120,6 @@ public:
             assetFileIdx++;
         }
 
-        // Creates a map string (instance id) -> Instance*
-        std::unordered_map<std::string, Instance*> instanceIdToInstanceRef;
-        for (auto kv : SC.InstanceIds) {
-            Instance *inst = SC.I[kv.second];
-            instanceIdToInstanceRef.insert({kv.first, inst});
-        }
-
         for (const auto& charJson : sceneJson["characters"]) {
             std::string name = charJson.value("name", "Unknown");
             std::vector<std::string> instancesIds = charJson.value("instanceIds", std::vector<std::string>{});
@@ -123,7 +156,7 @@ public:
 
                 // Find the corresponding AssetFile for the animation ID
                 const std::string& idToSeek = animList[ian];
-                if (assetFileIdToIndex.find(idToSeek) != assetFileIdToIndex.end()) {
+                if (assetFileIdToIndex.find(idToSeek) != assetFileIdToIndex.end() && af[assetFileIdToIndex[idToSeek]] != nullptr) {
                     assetFileIdx = assetFileIdToIndex[idToSeek];
                 } else {
                     std::cout << "Error! Animation ID >" << idToSeek << "< not found in asset files list.\n";
@@ -149,9 +182,20 @@ public:
             auto SKA = std::make_shared<SkeletalAnimation>();
             SKA->init(Anims[skinId].data(), animCount, baseTrack);
             skinId++;
+            // Segment durations let the blender report the end of each animation loop
+            for (auto& seg : ab->segments) {
+                seg.duration = SKA->getSegmentDuration(seg);
+            }
+
+            // State machine: states interned from "charStates", transitions from the optional "charTransitions"
+            auto stateMachine = std::make_shared<CharStateMachine>();
+            if (stateMachine->init(charStates, charJson.value("charTransitions", nlohmann::json::array())) != 0) {
+                std::cout << "Error! Invalid state transitions for character " << name << "\n";
+                return -1;
+            }
 
             // Creates the Character and adds it to the manager
-            auto charac = std::make_shared<Character>(name, pos, ab, SKA, charStates);
+            auto charac = std::make_shared<Character>(name, pos, ab, SKA, stateMachine);
             if (!dialogues.empty()) {
 				for(int i=0 ; i<dialogues.size(); i++)
 					dialogues[i] = wrapText(dialogues[i], 25);
@@ -209,6 +253,14 @@ private:
      */
     std::vector<std::shared_ptr<Character>> characters;
 
+    /**
+     * Positions of the characters, indexed for the proximity queries.
+     * gridHandles[i] is the handle of characters[i], handleToChar the inverse mapping.
+     */
+    SpatialGrid grid;
+    std::vector<int> gridHandles;
+    std::vector<int> handleToChar;
+
     /**
      * 2D vector of Animations for cleanup purposes.
      * Outer vector indexed by skin ID, inner vector contains Animations for that skin.
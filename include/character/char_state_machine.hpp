@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+/**
+ * Events that can make a character change state.
+ */
+enum class CharEvent {
+    Interact,       // the player talks to the character
+    Reset,          // the interaction is over (e.g. the player walked away)
+    AnimationEnd,   // the animation of the current state completed a loop
+    Count
+};
+
+/**
+ * Compiled state machine of a character.
+ * State names (the "charStates" of the scene file) are interned once, at load time, into integer ids:
+ * the id of a state is its index in "charStates", which is also the index of its animation segment.
+ * Transitions are stored in a dense (state, event) table, so at run time every query is an array lookup
+ * and an integer comparison. A machine never changes after init(), so it can be shared by many characters.
+ *
+ * Default transitions, matching the original behaviour:
+ *  - Idle --Interact--> the second state of the list (if it is not Idle itself)
+ *  - any  --Reset-->    Idle (Character::setIdle() goes to Idle directly, without this table)
+ * They can be overridden or extended by the optional "charTransitions" array of the character, e.g.
+ *   {"from": "Idle", "event": "interact", "to": "Talking", "blend": 0.5}
+ * where "from" can also be "*" (any state) and "event" one of "interact", "reset", "animationEnd".
+ */
+class CharStateMachine {
+public:
+    static constexpr int NO_STATE = -1;
+
+    /** A transition: target state and blending time of the animation, in seconds. */
+    struct Transition {
+        int to = NO_STATE;
+        float blend = 0.5f;
+    };
+
+    /**
+     * Builds the state table.
+     * @param stateNames Names of the states, in the order of the animation segments.
+     * @param transitionsJson Optional "charTransitions" array (see the class description).
+     * @return 0 on success, -1 if a transition refers to an unknown state or event.
+     */
+    int init(const std::vector<std::string>& stateNames, const nlohmann::json& transitionsJson = nlohmann::json::array());
+
+    /** Id of the state with the given name, or NO_STATE. Meant for load time: it compares strings. */
+    int getStateId(const std::string& name) const;
+
+    /** Name of a state (a reference to the interned string, nothing is allocated). */
+    const std::string& getStateName(int state) const;
+
+    const std::vector<std::string>& getStateNames() const { return names; }
+    int getStateCount() const { return static_cast<int>(names.size()); }
+    int getIdleState() const { return idle; }
+
+    /** Transition triggered by an event in a state; its target is NO_STATE if the event is ignored. */
+    const Transition& getTransition(int state, CharEvent event) const;
+
+private:
+    std::vector<std::string> names;
+    std::vector<Transition> table;      // getStateCount() x CharEvent::Count
+    int idle = NO_STATE;
+
+    Transition& at(int state, CharEvent event);
+};
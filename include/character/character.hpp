@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <glm/glm.hpp>
 #include "modules/Animations.hpp"
+#include "char_state_machine.hpp"
 
 struct Instance;
 
@@ -24,14 +25,36 @@ public:
      */
     Character(const std::string& name, const glm::vec3& pos, std::shared_ptr<AnimBlender> AB, std::shared_ptr<SkeletalAnimation> SKA, const std::vector<std::string>& stateNames);
 
+    /** Constructor sharing an already built state machine (e.g. among the copies of a character).
+     * @param stateMachine Compiled states and transitions of the character.
+     */
+    Character(const std::string& name, const glm::vec3& pos, std::shared_ptr<AnimBlender> AB, std::shared_ptr<SkeletalAnimation> SKA, std::shared_ptr<const CharStateMachine> stateMachine);
+
     // State and Position
     void setPosition(const glm::vec3& pos);
     glm::vec3 getPosition() const;
     void setState(const std::string& stateName);
-    std::string getCurrentState() const;
+    void setState(int stateId);
+    const std::string& getCurrentState() const;
     int getStateIndex() const;
     int getStateIndex(const std::string& stateName) const;
-    std::vector<std::string> getStateNames() const;
+    const std::vector<std::string>& getStateNames() const;
+    std::shared_ptr<const CharStateMachine> getStateMachine() const { return stateMachine; }
+
+    /** True if the character is in its "Idle" state (an integer comparison). */
+    bool isIdle() const { return currentStateIdx != CharStateMachine::NO_STATE && currentStateIdx == stateMachine->getIdleState(); }
+
+    /**
+     * Applies the transition of the current state for an event, if any, starting the animation of the new state.
+     * @return true if the state changed.
+     */
+    bool handleEvent(CharEvent event);
+
+    /**
+     * Turns the end of the current animation loop, recorded by the animation blender, into a CharEvent::AnimationEnd.
+     * It must be called from the thread that owns the game logic, when no animation evaluation is running.
+     */
+    void pollAnimationEvents();
 
     // Dialogues
     void setDialogues(const std::vector<std::string>& dialogues);
@@ -57,17 +80,37 @@ public:
     std::string charStateToString(const std::string& stateName) const;
     std::vector<glm::mat4>* getTransformMatrices();
 
-    // Sets the character state to "Idle" and resets dialogue index and animation
+    /**
+     * Advances the animation blender and samples the skeleton, writing the joint matrices
+     * into the back buffer of the joint palette.
+     * It touches only data owned by this character, so different characters can be evaluated
+     * concurrently. It must not run while the animation blender is being changed (e.g. by interact()).
+     * @param dt Animation time step, in seconds.
+     */
+    void evaluateAnimation(float dt);
+
+    /** Makes the palette written by the last evaluateAnimation() the one returned by getPalette(). */
+    void publishPalette();
+
+    /** Returns the last published joint palette (one matrix per joint, in skin joint order). */
+    const std::vector<glm::mat4>& getPalette() const { return palettes[frontPalette]; }
+
+    // Sets the character state to "Idle" and resets dialogue index and animation, whatever the transitions
+    // of the state machine (use handleEvent(CharEvent::Reset) to follow them)
     void setIdle();
 
 private:
     std::string name;
     glm::vec3 position;
-    std::vector<std::string> stateNames;
+    std::shared_ptr<const CharStateMachine> stateMachine;
     int currentStateIdx;
     std::vector<std::string> dialogues;
     size_t currentDialogue;
     std::shared_ptr<AnimBlender> AB;
     std::shared_ptr<SkeletalAnimation> SKA;
     std::vector<Instance*> instances;
+
+    // Double-buffered joint palette: the front one is read while the back one is being sampled
+    std::vector<glm::mat4> palettes[2];
+    int frontPalette = 0;
 };
\ No newline at end of file
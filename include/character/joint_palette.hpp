@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+/** Joints of a palette (size of the joint palette storage buffer of a character, in JointAffine). */
+#define MAX_JOINTS 100
+
+/**
+ * Compact skinning matrix: the three rows of an affine 4x4 matrix (the fourth row is always 0,0,0,1).
+ * It is 48 bytes instead of 64, and matches the JointAffine struct (std430) read by the character shaders.
+ */
+struct JointAffine {
+    glm::vec4 rows[3];
+};
+
+/**
+ * Packs a joint palette into 3x4 affine matrices, pre-multiplying each joint by a common transform.
+ * @param joints    Joint matrices, as returned by Character::getPalette().
+ * @param pre       Transform applied on the left of every joint (e.g. the model adaptation matrix).
+ * @param out       Destination, with room for at least `count` elements.
+ * @param count     Number of joints to pack.
+ */
+inline void packJointPalette(const std::vector<glm::mat4>& joints, const glm::mat4& pre, JointAffine* out, int count) {
+    for (int j = 0; j < count; j++) {
+        const glm::mat4 m = pre * joints[j];
+        // glm is column-major: m[c][r]
+        for (int r = 0; r < 3; r++) {
+            out[j].rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+        }
+    }
+}
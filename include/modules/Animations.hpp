@@ -15,6 +15,7 @@ struct AnimTrack {
 	void getSampleTransforms(glm::vec3 &T, glm::quat &Q, glm::vec3 &S, float t, int sf, int ef, bool loop);
 	glm::mat4 Sample(float t, int sf, int ef, bool loop);
 	glm::mat4 Blend(float bf, float tinA, int sfA, int efA, float tinB, int sfB, int efB, AnimTrack *B = nullptr);
+	float getDuration(int sf, int ef);
 };
 
 struct AnimBlendSegment {
@@ -22,6 +23,7 @@ struct AnimBlendSegment {
 	int en;
 	float t;
 	int clip = 0;
+	float duration = 0;		// length of one loop, in seconds (0 if unknown: no end is reported)
 };
 
 struct AnimBlender {
@@ -32,9 +34,11 @@ struct AnimBlender {
 	int prev;
 	float blendTime;
 	float blendPos;
+	int endedSegment;		// segment that completed a loop during Advance(), -1 if none
 	
 	void init(std::vector<AnimBlendSegment> seg);
 	void Advance(float dt);
+	bool PollSegmentEnd(int &seg);
 	void Start(int seg, float blendT);
 	glm::mat4 Sample(AnimTrack *AT, AnimTrack *AT2 = nullptr);
 	glm::mat4 Sample(std::vector<AnimTrack *> *AT);
@@ -78,7 +82,12 @@ class SkeletalAnimation {
 	void cleanup();
 	std::vector<glm::mat4> *getTransformMatrices();
 	void Sample(AnimBlender &AB);
+	// The two stages of Sample(): local transforms of the animated nodes, then joint hierarchy and inverse bind matrices
+	void SampleTracks(AnimBlender &AB);
+	void ComposeHierarchy();
 	int getNTMs();
+	size_t getMemoryUsage();
+	float getSegmentDuration(const AnimBlendSegment &S);
 };
 
 
@@ -148,6 +157,16 @@ glm::mat4 AnimTrack::Sample(float tin, int sf=0, int ef=-1, bool loop = false) {
 	return out;
 }
 
+// Length in seconds of a loop between frames sf and ef, as used by getSampleTransforms()
+float AnimTrack::getDuration(int sf, int ef) {
+	if(ef < 0) {
+		ef = ef + nKeyFrames + 1;
+	}
+	ef = ((ef < nKeyFrames) ? ef : nKeyFrames);
+	float lastT = (ef >= nKeyFrames) ? 2 * Frames[nKeyFrames-1].time - Frames[nKeyFrames-2].time : Frames[ef].time;
+	return lastT - Frames[sf].time;
+}
+
 glm::mat4 AnimTrack::Blend(float bf, float tinA, int sfA, int efA, float tinB, int sfB, int efB, AnimTrack *B) {
 	if(B == nullptr) {
 		B = this;
@@ -177,9 +196,11 @@ void AnimBlender::init(std::vector<AnimBlendSegment> seg) {
 	cur = 0;
 	prev = 0;
 	blendTime = 0;
+	endedSegment = -1;
 }
 
 void AnimBlender::Advance(float dt) {
+	float t0 = segments[cur].t;
 	if(blending) {
 		segments[cur].t += dt;
 		segments[prev].t += dt;
@@ -190,6 +211,21 @@ void AnimBlender::Advance(float dt) {
 	} else {
 		segments[cur].t += dt;
 	}
+	float d = segments[cur].duration;
+	if((d > 0) && (floor(segments[cur].t / d) > floor(t0 / d))) {
+		endedSegment = cur;
+	}
+}
+
+// Returns true (once) if the current segment completed a loop since the last call.
+// Advance() only records the event, so that it can run on a worker thread: the owner of the blender polls it
+bool AnimBlender::PollSegmentEnd(int &seg) {
+	if(endedSegment < 0) {
+		return false;
+	}
+	seg = endedSegment;
+	endedSegment = -1;
+	return true;
 }
 
 void AnimBlender::Start(int seg, float blendT) {
@@ -197,6 +233,7 @@ void AnimBlender::Start(int seg, float blendT) {
 		prev = cur;
 		cur = seg;
 		segments[cur].t = 0;
+		endedSegment = -1;
 		if(blendT > 0) {
 			blendPos = 0;
 			blendTime = blendT;
@@ -480,6 +517,11 @@ std::vector<glm::mat4> *SkeletalAnimation::getTransformMatrices() {
 }
 
 void SkeletalAnimation::Sample(AnimBlender &AB) {
+	SampleTracks(AB);
+	ComposeHierarchy();
+}
+
+void SkeletalAnimation::SampleTracks(AnimBlender &AB) {
 	for(int i = 0; i < NATs; i++) {
 		BaseTMs[ATsNodeId[i]] = AB.Sample(&ATs[i]);
 /*std::cout << ATs[i]->nKeyFrames << " = \n";
@@ -506,7 +548,9 @@ std::cout << ATT->Frames[frm].S.z << "\n";
 exit(0);
 }*/
 	}
-	
+}
+
+void SkeletalAnimation::ComposeHierarchy() {
 	for(int i = 0; i < NTMs; i++) {
 		TMs[i] = BaseTMs[i];
 	}
@@ -540,4 +584,25 @@ int SkeletalAnimation::getNTMs() {
 	return NTMs;
 }
 
+// Duration of a blender segment, taken from the first animated track of its clip (all tracks of a clip share the timing)
+float SkeletalAnimation::getSegmentDuration(const AnimBlendSegment &S) {
+	if((NATs == 0) || (S.clip >= ATs[0].size())) {
+		return 0;
+	}
+	return ATs[0][S.clip]->getDuration(S.st, S.en);
+}
+
+// Approximate heap memory owned by this instance (the animation tracks are shared, and not counted)
+size_t SkeletalAnimation::getMemoryUsage() {
+	size_t bytes = sizeof(SkeletalAnimation);
+	bytes += (oTMs.capacity() + TMs.capacity() + BaseTMs.capacity() + IBMs.capacity()) * sizeof(glm::mat4);
+	bytes += ATs.capacity() * sizeof(std::vector<AnimTrack *>);
+	for(const auto &v : ATs) {
+		bytes += v.capacity() * sizeof(AnimTrack *);
+	}
+	bytes += ATsNodeId.capacity() * sizeof(int);
+	bytes += NidDec.size() * (sizeof(std::pair<const int, int>) + sizeof(void *)) + NidDec.bucket_count() * sizeof(void *);
+	return bytes;
+}
+
 #endif
\ No newline at end of file
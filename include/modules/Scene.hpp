@@ -13,6 +13,12 @@ struct Instance {
 	std::vector<DescriptorSetLayout *> **D;
 	int *NDs;
 
+	// Storage buffers linked by the Descriptor Sets of the instance (set by the application, may be shared)
+	StorageBuffer **SBs;
+	int NSBs;
+	// If not null, the vertices are taken from this buffer instead of the model (e.g. pre-skinned by a compute shader)
+	StorageBuffer *VBoverride;
+
     bool usedForPhysics;
 
     glm::vec3 diffuseFactor;
@@ -508,7 +514,8 @@ void Scene::pipelinesAndDescriptorSetsInit() {
 
 				I[i]->DS[ipas][j] = new DescriptorSet();
 //std::cout << "Allocating DS for DSL: " << (*I[i]->D[ipas])[j] << ", with " << Tids.size() << " textures\n";
-				I[i]->DS[ipas][j]->init(BP, (*I[i]->D[ipas])[j], Tids);
+				std::vector<StorageBuffer *> SBs(I[i]->SBs, I[i]->SBs + I[i]->NSBs);
+				I[i]->DS[ipas][j]->init(BP, (*I[i]->D[ipas])[j], Tids, SBs);
 //std::cout << "DSs " << j << " for pass " << ipas << " done!\n";
 			}
 		}
@@ -565,6 +572,7 @@ void Scene::populateCommandBuffer(VkCommandBuffer commandBuffer, int passId, int
 	}
 	
 //std::cout << "Generating draw calls for pass " << passId << "\n";
+	RenderStats::get().setPass(commandBuffer, passId);
 	for(int k = 0; k < TechniqueInstanceCount; k++) {
 //std::cout << "Considering technique " << k << "\n";
 		for(int i = 0; i < TI[k].InstanceCount; i++) {
@@ -573,7 +581,11 @@ void Scene::populateCommandBuffer(VkCommandBuffer commandBuffer, int passId, int
 				P->bind(commandBuffer);
 
 //std::cout << "Drawing Instance " << i << "\n";
-				M[TI[k].I[i].Mid]->bind(commandBuffer);
+				if(TI[k].I[i].VBoverride != nullptr) {
+					M[TI[k].I[i].Mid]->bind(commandBuffer, TI[k].I[i].VBoverride->getBuffer(currentImage));
+				} else {
+					M[TI[k].I[i].Mid]->bind(commandBuffer);
+				}
 				for(int j = 0; j < TI[k].I[i].NDs[passId]; j++) {
 //std::cout << "Binding DS: set " << j << "\n";
 					TI[k].I[i].DS[passId][j]->bind(commandBuffer, *P, j, currentImage);
@@ -581,9 +593,13 @@ void Scene::populateCommandBuffer(VkCommandBuffer commandBuffer, int passId, int
 //std::cout << "Draw Call\n";						
 				vkCmdDrawIndexed(commandBuffer,
 						static_cast<uint32_t>(M[TI[k].I[i].Mid]->indices.size()), 1, 0, 0, 0);
+				RenderStats::get().countDraw(commandBuffer, M[TI[k].I[i].Mid]->indices.size());
+			} else {
+				RenderStats::get().countCulled(commandBuffer);
 			}
 		}
 	}
+	RenderStats::get().setPass(commandBuffer, -1);
 }
 
 #endif
\ No newline at end of file
@@ -18,6 +18,10 @@
 #include <unordered_map>
 #include <map>
 
+#include "Profiler.hpp"
+#include "RenderStats.hpp"
+#include "InputRecorder.hpp"
+
 #ifdef STARTER_IMPLEMENTATION
 // to allow splitting header and implementation
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -76,6 +80,8 @@
 
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
+// Images rendered in turn in headless mode, in place of the swapchain ones
+const int OFFSCREEN_IMAGE_COUNT = 3;
 
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
@@ -179,12 +185,14 @@ class Model {
 	void loadModelGLTF(std::string file, bool encoded);
 	void createIndexBuffer();
 	void createVertexBuffer();
+	VkDescriptorBufferInfo getVertexBufferInfo();
 
 	void init(BaseProject *bp, VertexDescriptor *VD, std::string file, ModelType MT);
 	void initFromAsset(BaseProject *bp, VertexDescriptor *VD, AssetFile *AF, std::string AN, int Mid = 0, std::string NN = "");
 	void initMesh(BaseProject *bp, VertexDescriptor *VD, bool printDebug = true);
 	void cleanup();
   	void bind(VkCommandBuffer commandBuffer);
+  	void bind(VkCommandBuffer commandBuffer, VkBuffer vertexBufferOverride);
 };
 
 class AssetFile {
@@ -390,6 +398,50 @@ struct Pipeline {
 	void cleanup();
 };
 
+// Compute pipeline: a single compute shader, with its Descriptor Set Layouts and push constants.
+// As for Pipeline, cleanup() destroys the pipeline and its layout, destroy() the shader module
+struct ComputePipeline {
+	BaseProject *BP;
+	VkPipeline computePipeline;
+	VkPipelineLayout pipelineLayout;
+
+	VkShaderModule compShaderModule;
+	std::vector<DescriptorSetLayout *> D;
+	std::vector<VkPushConstantRange> PK;
+
+	void init(BaseProject *bp, const std::string& CompShader,
+			  std::vector<DescriptorSetLayout *> d,
+			  std::vector<VkPushConstantRange> pk = {});
+	void create();
+	void destroy();
+	void bind(VkCommandBuffer commandBuffer);
+	void cleanup();
+};
+
+// Host-visible storage buffer, replicated for each swap chain image and kept persistently mapped.
+// It is not owned by a DescriptorSet: the same buffer can be linked to several Descriptor Sets
+// (e.g. of different passes), by listing it in the storage buffers passed to DescriptorSet::init()
+// and using its index as the linkSize of a VK_DESCRIPTOR_TYPE_STORAGE_BUFFER binding.
+// With hostVisible = false the buffers are device local and can only be written by the GPU
+// (e.g. by a compute shader); extraUsage adds usages such as VK_BUFFER_USAGE_VERTEX_BUFFER_BIT.
+// initFromBuffer() wraps an existing buffer (the same for every image), that is not freed by cleanup()
+struct StorageBuffer {
+	BaseProject *BP;
+	VkDeviceSize size;
+	bool owned;
+
+	std::vector<VkBuffer> buffers;
+	std::vector<VkDeviceMemory> buffersMemory;
+	std::vector<void *> mapped;
+
+	void init(BaseProject *bp, VkDeviceSize size, VkBufferUsageFlags extraUsage = 0, bool hostVisible = true);
+	void initFromBuffer(BaseProject *bp, VkBuffer buffer, VkDeviceSize size);
+	void cleanup();
+	void map(int currentImage, const void *src, VkDeviceSize size, VkDeviceSize offset = 0);
+	VkDescriptorBufferInfo getBufferInfo(int currentImage);
+	VkBuffer getBuffer(int currentImage);
+};
+
 struct DescriptorSet {
 	BaseProject *BP;
 
@@ -401,9 +453,11 @@ struct DescriptorSet {
 	std::vector<bool> toFree;
 
 	void init(BaseProject *bp, DescriptorSetLayout *L,
-						 std::vector<VkDescriptorImageInfo>VaSs);
+						 std::vector<VkDescriptorImageInfo>VaSs,
+						 std::vector<StorageBuffer *>SBs = {});
 	void cleanup();
   	void bind(VkCommandBuffer commandBuffer, Pipeline &P, int setId, int currentImage);
+  	void bind(VkCommandBuffer commandBuffer, ComputePipeline &P, int setId, int currentImage);
   	void map(int currentImage, void *src, int slot);
 };
 
@@ -411,6 +465,7 @@ struct DescriptorSet {
 struct PoolSizes {
 	int uniformBlocksInPool = 0;
 	int texturesInPool = 0;
+	int storageBuffersInPool = 0;
 	int setsInPool = 0;
 };
 
@@ -444,12 +499,22 @@ class BaseProject {
 	friend class FrameBufferAttachment;
 	friend class RenderPass;
 	friend class Pipeline;
+	friend class ComputePipeline;
 	friend class DescriptorSetLayout;
 	friend class DescriptorSet;
+	friend class StorageBuffer;
 
 public:
 	virtual void setWindowParameters() = 0;
     void run(); 
+	/**
+	 * Headless mode, to be set before run(): no visible window nor surface, and the frames are rendered
+	 * into OFFSCREEN_IMAGE_COUNT offscreen images of windowWidth x windowHeight, in place of the swapchain
+	 * ones (nothing is presented). Validation layers are used only if available, and any device with a
+	 * graphics queue is accepted, so it runs also on software devices (e.g. lavapipe).
+	 * @param preferCpuDevice Picks a CPU (software) device first, if there is one.
+	 */
+	void setHeadless(bool preferCpuDevice = false) { headless = true; this->preferCpuDevice = preferCpuDevice; }
 
 	PoolSizes DPSZs;
 
@@ -463,7 +528,11 @@ protected:
     GLFWwindow* window;
     VkInstance instance;
 
-	VkSurfaceKHR surface;
+	bool headless = false;
+	bool preferCpuDevice = false;
+	bool validationEnabled = true;
+
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
     VkQueue graphicsQueue;
@@ -479,6 +548,9 @@ protected:
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 	std::vector<VkImageView> swapChainImageViews;
+	// Headless mode: memory of the offscreen swapChainImages, and the next one to render
+	std::vector<VkDeviceMemory> offscreenImagesMemory;
+	uint32_t nextOffscreenImage = 0;
 		
  	VkDescriptorPool descriptorPool;
 
@@ -541,6 +613,8 @@ protected:
 	VkPresentModeKHR chooseSwapPresentMode(
 		const std::vector<VkPresentModeKHR>& availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+	void createOffscreenImages();
+	void cleanupOffscreenImages();
 	void createImageViews();
 	VkImageView createImageView(VkImage image, VkFormat format,
 							VkImageAspectFlags aspectFlags,
@@ -778,10 +852,21 @@ void BaseProject::run() {
 }
 
 void BaseProject::initWindow() {
-	glfwInit();
+	if (headless) {
+#ifdef GLFW_PLATFORM_NULL
+		// GLFW 3.4: a window without any display, so that also machines without one can run
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+	}
+	if (!glfwInit()) {
+		throw std::runtime_error("failed to initialize GLFW!");
+	}
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, windowResizable);
+	if (headless) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 
 	window = glfwCreateWindow(windowWidth, windowHeight, windowTitle.c_str(), nullptr, nullptr);
 
@@ -800,10 +885,16 @@ void BaseProject::framebufferResizeCallback(GLFWwindow* window, int width, int h
 void BaseProject::initVulkan() {
 	createInstance();				
 	setupDebugMessenger();			
-	createSurface();				
+	if (!headless) {
+		createSurface();
+	}
 	pickPhysicalDevice();			
 	createLogicalDevice();			
-	createSwapChain();				
+	if (headless) {
+		createOffscreenImages();
+	} else {
+		createSwapChain();
+	}
 	createImageViews();				
 
 	createCommandPool();			
@@ -839,18 +930,24 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 
 	createInfo.enabledLayerCount = 0;
 
+	if (!checkValidationLayerSupport()) {
+		if (!headless) {
+			throw std::runtime_error("validation layers requested, but not available!");
+		}
+		// Headless runs (e.g. on CI machines) go on without them
+		std::cout << "Validation layers not available: disabled\n";
+		validationEnabled = false;
+	}
+
 	auto extensions = getRequiredExtensions();
 	createInfo.enabledExtensionCount =
 		static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();		
 
 	createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
-	
-	if (!checkValidationLayerSupport()) {
-		throw std::runtime_error("validation layers requested, but not available!");
-	}
 
 	VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
+	if (validationEnabled) {
 		createInfo.enabledLayerCount =
 			static_cast<uint32_t>(validationLayers.size());
 		createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -858,6 +955,7 @@ std::cout << "Starting createInstance()\n"  << std::flush;
 		populateDebugMessengerCreateInfo(debugCreateInfo);
 		createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)
 								&debugCreateInfo;
+	}
 	
 	VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
 	
@@ -873,10 +971,15 @@ std::vector<const char*> BaseProject::getRequiredExtensions() {
 	glfwExtensions =
 		glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	std::vector<const char*> extensions(glfwExtensions,
-		glfwExtensions + glfwExtensionCount);
+	std::vector<const char*> extensions;
+	// Headless: no surface, so none of the window system extensions
+	if (!headless && glfwExtensions != nullptr) {
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 		
-	extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);		
+	if (validationEnabled) {
+		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
 	
 	if(checkIfItHasExtension(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME)) {
 		extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
@@ -978,6 +1081,10 @@ VKAPI_ATTR VkBool32 VKAPI_CALL BaseProject::debugCallback(
 }
 
 void BaseProject::setupDebugMessenger() {
+	if (!validationEnabled) {
+		debugMessenger = VK_NULL_HANDLE;
+		return;
+	}
 
 	VkDebugUtilsMessengerCreateInfoEXT createInfo{};
 	populateDebugMessengerCreateInfo(createInfo);
@@ -1021,6 +1128,20 @@ void BaseProject::pickPhysicalDevice() {
 	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 	
 	std::cout << "Physical devices found: " << deviceCount << "\n";
+
+	if (preferCpuDevice) {
+		std::stable_partition(devices.begin(), devices.end(), [](VkPhysicalDevice d) {
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(d, &properties);
+			return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+		});
+	}
+	if (headless) {
+		// Nothing is presented: the swapchain extension is not required (see below)
+		deviceExtensions.erase(std::remove_if(deviceExtensions.begin(), deviceExtensions.end(),
+				[](const char *ext) { return strcmp(ext, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; }),
+				deviceExtensions.end());
+	}
 	
 	for (const auto& device : devices) {
 		if(checkIfItHasDeviceExtension(device, "VK_KHR_portability_subset")) {
@@ -1042,6 +1163,14 @@ void BaseProject::pickPhysicalDevice() {
 	if (physicalDevice == VK_NULL_HANDLE) {
 		throw std::runtime_error("failed to find a suitable GPU!");
 	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	std::cout << "Using device: " << properties.deviceName << "\n";
+	// Still enabled if available, for the PRESENT_SRC_KHR final layout of the render passes
+	if (headless && checkIfItHasDeviceExtension(physicalDevice, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
+		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
 }
 
 bool BaseProject::isDeviceSuitable(VkPhysicalDevice device, deviceReport &devRep) {
@@ -1049,8 +1178,8 @@ bool BaseProject::isDeviceSuitable(VkPhysicalDevice device, deviceReport &devRep
 
 	devRep.extensionsSupported = checkDeviceExtensionSupport(device, devRep);
 
-	devRep.swapChainAdequate = false;
-	if (devRep.extensionsSupported) {
+	devRep.swapChainAdequate = headless;		// no swapchain in headless mode
+	if (devRep.extensionsSupported && !headless) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		devRep.swapChainFormatSupport = swapChainSupport.formats.empty();
 		devRep.swapChainPresentModeSupport = swapChainSupport.presentModes.empty();
@@ -1085,10 +1214,15 @@ QueueFamilyIndices BaseProject::findQueueFamilies(VkPhysicalDevice device) {
 			indices.graphicsFamily = i;
 		}
 			
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-		if (presentSupport) {
-			indices.presentFamily = i;
+		if (headless) {
+			// No surface: the present queue is just the graphics one
+			indices.presentFamily = indices.graphicsFamily;
+		} else {
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+			if (presentSupport) {
+				indices.presentFamily = i;
+			}
 		}
 
 		if (indices.isComplete()) {
@@ -1201,9 +1335,11 @@ void BaseProject::createLogicalDevice() {
 			static_cast<uint32_t>(deviceExtensions.size());
 	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
+	if (validationEnabled) {
 		createInfo.enabledLayerCount = 
 				static_cast<uint32_t>(validationLayers.size());
 		createInfo.ppEnabledLayerNames = validationLayers.data();
+	}
 	
 	VkResult result = vkCreateDevice(physicalDevice, &createInfo, nullptr, &device);
 	
@@ -1319,6 +1455,29 @@ VkExtent2D BaseProject::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabil
 	}
 }
 
+void BaseProject::createOffscreenImages() {
+	swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+	swapChainExtent = {windowWidth, windowHeight};
+	swapChainImages.resize(OFFSCREEN_IMAGE_COUNT);
+	offscreenImagesMemory.resize(OFFSCREEN_IMAGE_COUNT);
+	for (int i = 0; i < OFFSCREEN_IMAGE_COUNT; i++) {
+		createImage(swapChainExtent.width, swapChainExtent.height, 1, 1, VK_SAMPLE_COUNT_1_BIT,
+					swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+					VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 0,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i], offscreenImagesMemory[i]);
+	}
+	nextOffscreenImage = 0;
+}
+
+void BaseProject::cleanupOffscreenImages() {
+	for (size_t i = 0; i < swapChainImages.size(); i++) {
+		vkDestroyImage(device, swapChainImages[i], nullptr);
+		vkFreeMemory(device, offscreenImagesMemory[i], nullptr);
+	}
+	swapChainImages.clear();
+	offscreenImagesMemory.clear();
+}
+
 void BaseProject::createImageViews() {
 	swapChainImageViews.resize(swapChainImages.size());
 	
@@ -1701,11 +1860,17 @@ uint32_t BaseProject::findMemoryType(uint32_t typeFilter,
 }
 
 void BaseProject::createDescriptorPool() {
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	std::vector<VkDescriptorPoolSize> poolSizes(2);
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[0].descriptorCount = static_cast<uint32_t>(DPSZs.uniformBlocksInPool * swapChainImages.size());
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	poolSizes[1].descriptorCount = static_cast<uint32_t>(DPSZs.texturesInPool * swapChainImages.size());
+	if(DPSZs.storageBuffersInPool > 0) {
+		VkDescriptorPoolSize sbSize{};
+		sbSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		sbSize.descriptorCount = static_cast<uint32_t>(DPSZs.storageBuffersInPool * swapChainImages.size());
+		poolSizes.push_back(sbSize);
+	}
 														 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1761,6 +1926,7 @@ void BaseProject::removeBuffer(std::string name) {
 
 void BaseProject::clearNamedCommandBufferForImage(NamedCommandBuffer *ncb, int img) {
 	if(ncb->inQueue[img]) {
+		RenderStats::get().forget(*ncb->cb[img]);
 		vkFreeCommandBuffers(device, commandPool, 1,
 						 ncb->cb[img]);
 		free(ncb->cb[img]);
@@ -1804,6 +1970,7 @@ void BaseProject::resetCommandBuffers() {
 		if(v.second.current != nullptr) {
 			for(int i = 0; i < sz; i++) {
 				if(v.second.current->inQueue[i]) {
+					RenderStats::get().forget(*v.second.current->cb[i]);
 					vkFreeCommandBuffers(device, commandPool, 1,
 									 v.second.current->cb[i]);
 					free(v.second.current->cb[i]);
@@ -1887,6 +2054,7 @@ void BaseProject::createCommandBuffer(NamedCommandBuffer *ncb, int imageIndex) {
 	}
 	
 //std::cout << "Filling\n";
+	RenderStats::get().beginRecording(*cb);
 	ncb->filler(*cb, imageIndex, ncb->params);
 	
 //std::cout << "Finishing\n";
@@ -1965,31 +2133,54 @@ void BaseProject::updateCommandBuffers(std::vector<VkCommandBuffer> &buffers, in
 }
 
 void BaseProject::drawFrame() {
-	vkWaitForFences(device, 1, &inFlightFences[currentFrame],
-					VK_TRUE, UINT64_MAX);
+	PROFILE_FRAME();
+	PROFILE_SCOPE("BaseProject::drawFrame");
+	{
+		PROFILE_SCOPE("drawFrame.waitFence");
+		vkWaitForFences(device, 1, &inFlightFences[currentFrame],
+						VK_TRUE, UINT64_MAX);
+	}
 	
 	uint32_t imageIndex;
+	VkResult result;
 	
-	VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
-			imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		recreateSwapChain();
-		return;
-	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-		throw std::runtime_error("failed to acquire swap chain image!");
+	if (headless) {
+		// Offscreen images in turn: ready as soon as the fence of their last frame (below)
+		imageIndex = nextOffscreenImage;
+		nextOffscreenImage = (nextOffscreenImage + 1) % swapChainImages.size();
+	} else {
+		result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX,
+				imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			recreateSwapChain();
+			return;
+		} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			throw std::runtime_error("failed to acquire swap chain image!");
+		}
 	}
 
 	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+		PROFILE_SCOPE("drawFrame.waitImage");
 		vkWaitForFences(device, 1, &imagesInFlight[imageIndex],
 						VK_TRUE, UINT64_MAX);
 	}
 	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 	
-	updateUniformBuffer(imageIndex);
+	{
+		PROFILE_SCOPE("updateUniformBuffer");
+		// Input of the frame (live, recorded or replayed), read by getSixAxis() and the key handlers
+		if (!InputRecorder::get().newFrame(window)) {
+			glfwSetWindowShouldClose(window, GLFW_TRUE);	// end of the replayed input
+		}
+		updateUniformBuffer(imageIndex);
+	}
 	
 	std::vector<VkCommandBuffer> buffers = {};
 	updateCommandBuffers(buffers, imageIndex);
+	for(VkCommandBuffer cb : buffers) {
+		RenderStats::get().submitted(cb);
+	}
 	
 	VkSubmitInfo submitInfo{};
 	
@@ -1997,44 +2188,60 @@ void BaseProject::drawFrame() {
 	VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
 	VkPipelineStageFlags waitStages[] =
 		{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	submitInfo.waitSemaphoreCount = 1;
+	// Headless: no image to acquire nor to present, hence no semaphore
+	submitInfo.waitSemaphoreCount = headless ? 0 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = buffers.size();
 	submitInfo.pCommandBuffers = buffers.data();
 	VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 	
 	vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo,
-			inFlightFences[currentFrame]) != VK_SUCCESS) {
-		throw std::runtime_error("failed to submit draw command buffer!");
+	{
+		PROFILE_SCOPE("drawFrame.submit");
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo,
+				inFlightFences[currentFrame]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
 	}
 	
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
-	
-	VkSwapchainKHR swapChains[] = {swapChain};
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
-	presentInfo.pImageIndices = &imageIndex;
-	presentInfo.pResults = nullptr; // Optional
-	
-	result = vkQueuePresentKHR(presentQueue, &presentInfo);
+	if (headless) {
+		// Nothing to present
+		if (framebufferResized) {
+			framebufferResized = false;
+			recreateSwapChain();
+		}
+	} else {
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = signalSemaphores;
+		
+		VkSwapchainKHR swapChains[] = {swapChain};
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = swapChains;
+		presentInfo.pImageIndices = &imageIndex;
+		presentInfo.pResults = nullptr; // Optional
+		
+		{
+			PROFILE_SCOPE("drawFrame.present");
+			result = vkQueuePresentKHR(presentQueue, &presentInfo);
+		}
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-		framebufferResized) {
-		framebufferResized = false;
-		recreateSwapChain();
-	} else if (result != VK_SUCCESS) {
-		throw std::runtime_error("failed to present swap chain image!");
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+			framebufferResized) {
+			framebufferResized = false;
+			recreateSwapChain();
+		} else if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to present swap chain image!");
+		}
 	}
 	
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	RenderStats::get().endFrame();
 }
 
 void BaseProject::recreateSwapChain() {
@@ -2050,7 +2257,11 @@ void BaseProject::recreateSwapChain() {
 	
 	cleanupSwapChain();
 
-	createSwapChain();
+	if (headless) {
+		createOffscreenImages();
+	} else {
+		createSwapChain();
+	}
 	createImageViews();
 
 	createDescriptorPool();			
@@ -2068,7 +2279,11 @@ void BaseProject::cleanupSwapChain() {
 		vkDestroyImageView(device, swapChainImageViews[i], nullptr);
 	}
 	
-	vkDestroySwapchainKHR(device, swapChain, nullptr);
+	if (headless) {
+		cleanupOffscreenImages();
+	} else {
+		vkDestroySwapchainKHR(device, swapChain, nullptr);
+	}
 
 	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 }
@@ -2088,9 +2303,13 @@ void BaseProject::cleanup() {
 	
 	vkDestroyDevice(device, nullptr);
 	
-	DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+	if (validationEnabled) {
+		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+	}
 	
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	if (surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
 	vkDestroyInstance(instance, nullptr);
 
 	glfwDestroyWindow(window);
@@ -2139,68 +2358,62 @@ void BaseProject::getSixAxis(float &deltaT,
 				glm::vec3 &r,
 				bool &fire) {
 					
-	static auto startTime = std::chrono::high_resolution_clock::now();
-	static float lastTime = 0.0f;
-	
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	float time = std::chrono::duration<float, std::chrono::seconds::period>
-				(currentTime - startTime).count();
-	deltaT = time - lastTime;
-	lastTime = time;
+	// Sampled by drawFrame(), so that it can be recorded and replayed (see InputRecorder)
+	const InputRecorder& input = InputRecorder::get();
+	deltaT = input.getDeltaT();
 
 	static double old_xpos = 0, old_ypos = 0;
 	double xpos, ypos;
-	glfwGetCursorPos(window, &xpos, &ypos);
+	input.getCursorPos(xpos, ypos);
 	double m_dx = xpos - old_xpos;
 	double m_dy = ypos - old_ypos;
 	old_xpos = xpos; old_ypos = ypos;
 
 	const float MOUSE_RES = 10.0f;				
-	glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GLFW_TRUE);
-	if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+	if(input.isMouseLeftPressed()) {
 		r.y = -m_dx / MOUSE_RES;
 		r.x = -m_dy / MOUSE_RES;
 	}
 
-	if(glfwGetKey(window, GLFW_KEY_LEFT)) {
+	if(input.isKeyPressed(GLFW_KEY_LEFT)) {
 		r.y = -1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_RIGHT)) {
+	if(input.isKeyPressed(GLFW_KEY_RIGHT)) {
 		r.y = 1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_UP)) {
+	if(input.isKeyPressed(GLFW_KEY_UP)) {
 		r.x = -1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_DOWN)) {
+	if(input.isKeyPressed(GLFW_KEY_DOWN)) {
 		r.x = 1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_Q)) {
+	if(input.isKeyPressed(GLFW_KEY_Q)) {
 		r.z = 1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_E)) {
+	if(input.isKeyPressed(GLFW_KEY_E)) {
 		r.z = -1.0f;
 	}
 
-	if(glfwGetKey(window, GLFW_KEY_A)) {
+	if(input.isKeyPressed(GLFW_KEY_A)) {
 		m.x = -1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_D)) {
+	if(input.isKeyPressed(GLFW_KEY_D)) {
 		m.x = 1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_S)) {
+	if(input.isKeyPressed(GLFW_KEY_S)) {
 		m.z = 1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_W)) {
+	if(input.isKeyPressed(GLFW_KEY_W)) {
 		m.z = -1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_R)) {
+	if(input.isKeyPressed(GLFW_KEY_R)) {
 		m.y = 1.0f;
 	}
-	if(glfwGetKey(window, GLFW_KEY_F)) {
+	if(input.isKeyPressed(GLFW_KEY_F)) {
 		m.y = -1.0f;
 	}
 	
-	fire = (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS);
+	fire = input.isKeyPressed(GLFW_KEY_LEFT_SHIFT);
 	/* The following are resetting fire to false for some reason */
 	// handleGamePad(GLFW_JOYSTICK_1,m,r,fire);
 	// handleGamePad(GLFW_JOYSTICK_2,m,r,fire);
@@ -3304,7 +3517,8 @@ void Model::createVertexBuffer() {
 //	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 	VkDeviceSize bufferSize = vertices.size();
 
-	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+	// Storage usage allows compute shaders to read the vertices (e.g. for skinning)
+	BP->createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 						VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 						vertexBuffer, vertexBufferMemory);
@@ -3315,6 +3529,14 @@ void Model::createVertexBuffer() {
 	vkUnmapMemory(BP->device, vertexBufferMemory);			
 }
 
+VkDescriptorBufferInfo Model::getVertexBufferInfo() {
+	VkDescriptorBufferInfo info{};
+	info.buffer = vertexBuffer;
+	info.offset = 0;
+	info.range = vertices.size();
+	return info;
+}
+
 void Model::createIndexBuffer() {
 	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
@@ -3422,6 +3644,7 @@ void Model::cleanup() {
 }
 
 void Model::bind(VkCommandBuffer commandBuffer) {
+	RenderStats::get().countVertexBufferBind(commandBuffer);
 	VkBuffer vertexBuffers[] = {vertexBuffer};
 	// property .vertexBuffer of models, contains the VkBuffer handle to its vertex buffer
 	VkDeviceSize offsets[] = {0};
@@ -3431,6 +3654,17 @@ void Model::bind(VkCommandBuffer commandBuffer) {
 							VK_INDEX_TYPE_UINT32);
 }
 
+// Binds the index buffer of the model, but takes the vertices from another buffer
+// (with the same number of vertices, possibly in a different format)
+void Model::bind(VkCommandBuffer commandBuffer, VkBuffer vertexBufferOverride) {
+	RenderStats::get().countVertexBufferBind(commandBuffer);
+	VkBuffer vertexBuffers[] = {vertexBufferOverride};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0,
+							VK_INDEX_TYPE_UINT32);
+}
+
 
 
 
@@ -4321,6 +4555,7 @@ void Pipeline::destroy() {
 }	
 
 void Pipeline::bind(VkCommandBuffer commandBuffer) {
+	RenderStats::get().countPipelineBind(commandBuffer);
 	vkCmdBindPipeline(commandBuffer,
 					  VK_PIPELINE_BIND_POINT_GRAPHICS,
 					  graphicsPipeline);
@@ -4350,6 +4585,90 @@ void Pipeline::cleanup() {
 		vkDestroyPipelineLayout(BP->device, pipelineLayout, nullptr);
 }
 
+void ComputePipeline::init(BaseProject *bp, const std::string& CompShader,
+						   std::vector<DescriptorSetLayout *> d,
+						   std::vector<VkPushConstantRange> pk) {
+	BP = bp;
+
+	auto compShaderCode = readFile(CompShader);
+	std::cout << "Compute shader <" << CompShader << "> len: " <<
+				compShaderCode.size() << "\n";
+
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = compShaderCode.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(compShaderCode.data());
+
+	VkResult result = vkCreateShaderModule(BP->device, &createInfo, nullptr,
+					&compShaderModule);
+	if (result != VK_SUCCESS) {
+	 	PrintVkError(result);
+		throw std::runtime_error("failed to create shader module!");
+	}
+
+	D = d;
+	PK = pk;
+}
+
+void ComputePipeline::create() {
+	VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+	compShaderStageInfo.sType =
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	compShaderStageInfo.module = compShaderModule;
+	compShaderStageInfo.pName = "main";
+
+	std::vector<VkDescriptorSetLayout> DSL(D.size());
+	for(int i = 0; i < D.size(); i++) {
+		DSL[i] = D[i]->descriptorSetLayout;
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = DSL.size();
+	pipelineLayoutInfo.pSetLayouts = DSL.data();
+	pipelineLayoutInfo.pushConstantRangeCount = PK.size();
+	pipelineLayoutInfo.pPushConstantRanges = PK.data();
+
+	VkResult result = vkCreatePipelineLayout(BP->device, &pipelineLayoutInfo, nullptr,
+				&pipelineLayout);
+	if (result != VK_SUCCESS) {
+	 	PrintVkError(result);
+		throw std::runtime_error("failed to create compute pipeline layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = compShaderStageInfo;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+	pipelineInfo.basePipelineIndex = -1; // Optional
+
+	result = vkCreateComputePipelines(BP->device, VK_NULL_HANDLE, 1,
+			&pipelineInfo, nullptr, &computePipeline);
+	if (result != VK_SUCCESS) {
+	 	PrintVkError(result);
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+}
+
+void ComputePipeline::destroy() {
+	vkDestroyShaderModule(BP->device, compShaderModule, nullptr);
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
+	RenderStats::get().countPipelineBind(commandBuffer);
+	vkCmdBindPipeline(commandBuffer,
+					  VK_PIPELINE_BIND_POINT_COMPUTE,
+					  computePipeline);
+}
+
+void ComputePipeline::cleanup() {
+		vkDestroyPipeline(BP->device, computePipeline, nullptr);
+		vkDestroyPipelineLayout(BP->device, pipelineLayout, nullptr);
+}
+
 void DescriptorSetLayout::init(BaseProject *bp, std::vector<DescriptorSetLayoutBinding> B) {
 	BP = bp;
 	Bindings = B;
@@ -4386,7 +4705,8 @@ void DescriptorSetLayout::cleanup() {
 }
 
 void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
-						 std::vector<VkDescriptorImageInfo>VaSs) {
+						 std::vector<VkDescriptorImageInfo>VaSs,
+						 std::vector<StorageBuffer *>SBs) {
 	BP = bp;
 	Layout = DSL;
 	
@@ -4476,6 +4796,17 @@ void DescriptorSet::init(BaseProject *bp, DescriptorSetLayout *DSL,
 											VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 				descriptorWrites[j].descriptorCount = DSL->Bindings[j].count;
 				descriptorWrites[j].pImageInfo = &imageInfo[DSL->Bindings[j].linkSize];
+			} else if(DSL->Bindings[j].type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+				// linkSize is the index of the buffer in the SBs vector
+				bufferInfo[j] = SBs[DSL->Bindings[j].linkSize]->getBufferInfo(i);
+
+				descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				descriptorWrites[j].dstSet = descriptorSets[i];
+				descriptorWrites[j].dstBinding = DSL->Bindings[j].binding;
+				descriptorWrites[j].dstArrayElement = 0;
+				descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				descriptorWrites[j].descriptorCount = 1;
+				descriptorWrites[j].pBufferInfo = &bufferInfo[j];
 			}
 		}		
 //std::cout << "Updating descriptor sets\n";	
@@ -4499,12 +4830,22 @@ void DescriptorSet::cleanup() {
 void DescriptorSet::bind(VkCommandBuffer commandBuffer, Pipeline &P, int setId,
 						 int currentImage) {
 //std::cout << "DS[ci]: " << &descriptorSets[currentImage] << "\n";
+	RenderStats::get().countDescriptorBind(commandBuffer);
 	vkCmdBindDescriptorSets(commandBuffer,
 					VK_PIPELINE_BIND_POINT_GRAPHICS,
 					P.pipelineLayout, setId, 1, &descriptorSets[currentImage],
 					0, nullptr);
 }
 
+void DescriptorSet::bind(VkCommandBuffer commandBuffer, ComputePipeline &P, int setId,
+						 int currentImage) {
+	RenderStats::get().countDescriptorBind(commandBuffer);
+	vkCmdBindDescriptorSets(commandBuffer,
+					VK_PIPELINE_BIND_POINT_COMPUTE,
+					P.pipelineLayout, setId, 1, &descriptorSets[currentImage],
+					0, nullptr);
+}
+
 void DescriptorSet::map(int currentImage, void *src, int slot) {
 	void* data;
 
@@ -4514,6 +4855,79 @@ void DescriptorSet::map(int currentImage, void *src, int slot) {
 						size, 0, &data);
 	memcpy(data, src, size);
 	vkUnmapMemory(BP->device, uniformBuffersMemory[slot][currentImage]);	
+	RenderStats::get().countUboUpload(size);
+}
+
+void StorageBuffer::init(BaseProject *bp, VkDeviceSize sz, VkBufferUsageFlags extraUsage, bool hostVisible) {
+	BP = bp;
+	size = sz;
+	owned = true;
+
+	int n = BP->swapChainImages.size();
+	buffers.resize(n);
+	buffersMemory.resize(n);
+	mapped.assign(n, nullptr);
+	for(int i = 0; i < n; i++) {
+		BP->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage,
+						 hostVisible ? (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+										VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) :
+									   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+						 buffers[i], buffersMemory[i]);
+		if(hostVisible) {
+			vkMapMemory(BP->device, buffersMemory[i], 0, size, 0, &mapped[i]);
+		}
+	}
+}
+
+void StorageBuffer::initFromBuffer(BaseProject *bp, VkBuffer buffer, VkDeviceSize sz) {
+	BP = bp;
+	size = sz;
+	owned = false;
+
+	int n = BP->swapChainImages.size();
+	buffers.assign(n, buffer);
+	buffersMemory.assign(n, VK_NULL_HANDLE);
+	mapped.assign(n, nullptr);
+}
+
+void StorageBuffer::cleanup() {
+	if(owned) {
+		for(int i = 0; i < buffers.size(); i++) {
+			if(mapped[i] != nullptr) {
+				vkUnmapMemory(BP->device, buffersMemory[i]);
+			}
+			vkDestroyBuffer(BP->device, buffers[i], nullptr);
+			vkFreeMemory(BP->device, buffersMemory[i], nullptr);
+		}
+	}
+	buffers.clear();
+	buffersMemory.clear();
+	mapped.clear();
+}
+
+void StorageBuffer::map(int currentImage, const void *src, VkDeviceSize sz, VkDeviceSize offset) {
+	if(mapped[currentImage] == nullptr) {
+		std::cout << "StorageBuffer: the buffer is not host visible\n";
+		return;
+	}
+	if(offset + sz > size) {
+		std::cout << "StorageBuffer: write of " << sz << " bytes at " << offset << " exceeds size " << size << "\n";
+		sz = (offset < size) ? size - offset : 0;
+	}
+	memcpy((char *)mapped[currentImage] + offset, src, sz);
+	RenderStats::get().countStorageUpload(sz);
+}
+
+VkDescriptorBufferInfo StorageBuffer::getBufferInfo(int currentImage) {
+	VkDescriptorBufferInfo info{};
+	info.buffer = buffers[currentImage];
+	info.offset = 0;
+	info.range = size;
+	return info;
+}
+
+VkBuffer StorageBuffer::getBuffer(int currentImage) {
+	return buffers[currentImage];
 }
 
 #endif
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <list>
+#include <memory>
+
 struct CharData {
 	int x;
 	int y;
@@ -29,6 +32,43 @@ enum TextAlignment {TAL_LEFT, TAL_CENTER, TAL_RIGHT};
 enum TextRegistrationH {TRH_LEFT, TRH_CENTER, TRH_RIGHT};
 enum TextRegistrationV {TRV_TOP, TRV_MIDDLE, TRV_BOTTOM};
 
+// Glyphs of a text laid out in pixels, relative to the top-left corner of its block.
+// Depends only on the string, the font, the scale, the alignment and the wrap width: the
+// position and registration of the block are applied when its vertices are written.
+struct TextLayout {
+	int w, h;	// size of the text area (unscaled)
+	int nlines;	// lines of text
+	std::vector<int> linew;	// width of each line (unscaled)
+	std::vector<glm::vec4> quads;	// for each glyph: x0, y0, x1, y1 (scaled)
+	std::vector<glm::vec4> uvs;	// for each glyph: u0, v0, u1, v1
+};
+
+struct TextLayoutKey {
+	std::string Text;
+	size_t textHash;
+	int fontId;
+	float sx, sy;
+	int Alignment;
+	int wrap;
+	
+	bool operator==(const TextLayoutKey &o) const {
+		return (textHash == o.textHash) && (fontId == o.fontId) && (sx == o.sx) && (sy == o.sy) &&
+			   (Alignment == o.Alignment) && (wrap == o.wrap) && (Text == o.Text);
+	}
+};
+
+struct TextLayoutKeyHash {
+	size_t operator()(const TextLayoutKey &k) const {
+		size_t h = k.textHash;
+		auto combine = [&h](size_t v) { h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+		combine(std::hash<int>()(k.fontId));
+		combine(std::hash<float>()(k.sx));
+		combine(std::hash<float>()(k.sy));
+		combine(std::hash<int>()(k.Alignment * 65536 + k.wrap));
+		return h;
+	}
+};
+
 struct TextBlock {
 	// What to write
 	std::string Text;
@@ -55,29 +95,28 @@ struct TextBlock {
 	TextRegistrationH RegH;
 	TextRegistrationV RegV;
 	
+	// Wrapping (maximum line width in font pixels, 0 = only at '\n')
+	int wrap;
+	
 	// Computed values
 	int w, h;	// size of the text area
 	int nlines;	// lines of text
-	int totChars;	// total number of characters
-	std::vector<int> linew;	// width of each line
-	std::vector<std::string> lines; // substring of each line
+	int totChars;	// total number of glyphs
+	std::shared_ptr<const TextLayout> layout;	// shared with the layout cache
 	int fontId;	// font id
-	int start, len; // start index, and len of the block
+	int start, len; // first glyph in the vertex buffer, and glyphs written
+	int capacity;	// glyphs reserved in the vertex buffer (the block is rewritten in place while it fits)
+	int slot;		// entry of the block table
 };
 
 struct TextVertex {
 	glm::vec2 pos;
 	glm::vec2 texCoord;
+	uint32_t block;	// entry of the block table (colors)
 };
 
-struct TextMaker;
-
-struct TextMakerAndModel {
-	TextMaker *txt;
-	Model *M;
-};
-
-struct TextColorPushConstant {
+// Entry of the block table, read by the fragment shader
+struct TextBlockColors {
 	alignas(16) glm::vec4 Fill;
 	alignas(16) glm::vec4 Stroke;
 	alignas(16) glm::vec4 Shadow;
@@ -2500,7 +2539,6 @@ struct TextMaker {
 	DescriptorSetLayout DSL;
 	RenderPass RP;
 	Pipeline P;
-	Model *M, *oldM = nullptr;
 	Texture T;
 	DescriptorSet DS;
 	
@@ -2509,7 +2547,30 @@ struct TextMaker {
 	
 	Font fnt = mainFont;
 	
-	bool commandBufferMustUpdate = false;
+	// The text is drawn from persistent buffers (one copy per swap chain image) by a command buffer
+	// recorded once: each block owns a range of glyph quads and an entry of the block table, and only
+	// the ranges of the blocks that changed are copied again, once for each image.
+	// Unused quads are degenerate (all zeros), so the whole used range is drawn with a single indirect draw.
+	int maxGlyphs = 8192;		// capacity of the vertex buffer, in glyphs (to be set before init)
+	int maxBlocks = 64;			// capacity of the block table (to be set before init)
+	StorageBuffer VB;			// TextVertex, 4 per glyph
+	StorageBuffer IB;			// indices of the glyph quads (constant)
+	StorageBuffer BT;			// block table: TextBlockColors
+	StorageBuffer DC;			// VkDrawIndexedIndirectCommand of the text
+	std::vector<TextVertex> vertices;				// copy of VB
+	std::vector<TextBlockColors> blockTable;		// copy of BT
+	std::vector<std::pair<int, int>> freeGlyphs;	// free ranges of glyphs (start, count), sorted by start
+	std::vector<int> freeSlots;						// free entries of the block table
+	int usedGlyphs = 0;								// glyphs up to the end of the last used range
+	std::vector<std::vector<std::pair<int, int>>> dirtyGlyphs;	// for each image, ranges of glyphs to copy
+	std::vector<bool> tableDirty, drawDirty;		// for each image
+	bool commandBufferSubmitted = false;
+	
+	// Layouts of the last printed texts, least recently used first out
+	size_t layoutCacheSize = 256;	// 0 disables the cache
+	std::list<std::pair<TextLayoutKey, std::shared_ptr<const TextLayout>>> layoutLRU;	// most recent first
+	std::unordered_map<TextLayoutKey, decltype(layoutLRU)::iterator, TextLayoutKeyHash> layoutIndex;
+	size_t layoutHits = 0, layoutMisses = 0;
 	
 	void measureText(std::string Text, int &fontId, int &w, int &h, int &nlines, int &totChars, std::vector<int> &linew, std::vector<std::string> &lines);
 	int print(float x, float y, std::string Text, int id = -1,
@@ -2520,7 +2581,7 @@ struct TextMaker {
 			  glm::vec4 Fill = {1.0f,1.0f,1.0f,1.0f},
 			  glm::vec4 Stroke = {0.0f,0.0f,0.0f,1.0f},
 			  glm::vec4 Shadow = {0.0f,0.0f,0.0f,0.0f},
-			  float sx = 1.0f, float sy = 1.0f);
+			  float sx = 1.0f, float sy = 1.0f, int wrap = 0);
 	void removeText(int id);
 	void removeAllText();
 	void init(BaseProject *_BP, int sW, int sH, int so = 10000);
@@ -2528,8 +2589,19 @@ struct TextMaker {
 	void createTextDescriptorSetAndVertexLayout();
  	void createTextPipeline();
 	void pixelToScr(float x, float y, float &sx, float &sy);
-	void atlasToUV(int x, int y, Font &Fnt, float &u, float &v);void makeVertex(TextVertex *V, Font &Fnt, int px, int py, int tx, int ty);
-	void createTextMesh();
+	void atlasToUV(int x, int y, Font &Fnt, float &u, float &v);
+	void makeVertex(TextVertex *V, Font &Fnt, int px, int py, int tx, int ty, uint32_t block);
+	int allocGlyphs(int count);
+	void releaseGlyphs(int start, int count);
+	void markGlyphsDirty(int start, int count);
+	void writeBlockColors(TextBlock &Blk);
+	void writeBlockMesh(TextBlock &Blk);
+	std::shared_ptr<TextLayout> layoutText(const std::string &Text, int fontId, float sx, float sy,
+										   TextAlignment Alignment, int wrap);
+	std::shared_ptr<const TextLayout> getLayout(const std::string &Text, int fontId, float sx, float sy,
+												TextAlignment Alignment, int wrap);
+	void clearLayoutCache();
+	void releaseBlock(TextBlock &Blk);
 	void createTextDescriptorSets();
 	void pipelinesAndDescriptorSetsInit();
 	void pipelinesAndDescriptorSetsCleanup();
@@ -2537,8 +2609,8 @@ struct TextMaker {
 	static void populateCommandBufferAccess(VkCommandBuffer commandBuffer, int currentImage, void *Params);
 	// This is the real place where the Command Buffer is written
     void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage);
-	static void freeCommandBuffer(void *Params);
-	void updateCommandBuffer();
+	// Copies the changes of the text to the buffers of the image (to be called every frame, in updateUniformBuffer)
+	void update(int currentImage);
 };
 
 
@@ -2592,12 +2664,9 @@ int TextMaker::print(float x, float y, std::string Text, int id,
 		  glm::vec4 Fill,
 		  glm::vec4 Stroke,
 		  glm::vec4 Shadow,
-		  float sx, float sy) {
+		  float sx, float sy, int wrap) {
+	PROFILE_SCOPE("TextMaker::print");
 
-	int w = 0, h = 0, nlines = 0, totChars, fontId;
-	std::vector<int> linew = {};
-	std::vector<std::string> lines = {};
-	
 	if(id == -1) {
 		id = maxTextId;
 		maxTextId++;
@@ -2606,29 +2675,76 @@ int TextMaker::print(float x, float y, std::string Text, int id,
 		maxTextId = id;
 	}
 	
-	fontId = (FontFace == "SS" ? 8 : (FontFace == "SR" ? 16 : 0)) +
+	int fontId = (FontFace == "SS" ? 8 : (FontFace == "SR" ? 16 : 0)) +
 			 (Bold   ? 2 : 0) + (Italic ? 1 : 0) +(Small  ? 4 : 0);
 
-	measureText(Text, fontId, w, h, nlines, totChars, linew, lines);
-//std::cout << id << "\n";
-//std::cout << w << " " << h << " " << nlines  << "\n";
-//for(int i = 0; i < nlines; i++) {std::cout << linew[i] << " ";}std::cout << "\n";
-	Blocks[id] = {Text, FontFace, Italic, Bold, Small, x, y, sx, sy, Fill, Stroke, Shadow, Alignment, RegH, RegV, w, h, nlines,totChars, linew, lines, fontId, 0, 0};
-/*		std::string FaceName = FontFace + (Bold   ? "B" : "") +
-									  (Italic ? "I" : "") +
-									  (Small  ? "S" : "");*/
-	commandBufferMustUpdate = true;
+	auto found = Blocks.find(id);
+	if(found == Blocks.end()) {
+		if(freeSlots.empty()) {
+			std::cout << "Error! Too many text blocks (max " << maxBlocks << "), text " << id << " not shown\n";
+			return id;
+		}
+		TextBlock Blk{};
+		Blk.start = -1;
+		Blk.slot = freeSlots.back();
+		freeSlots.pop_back();
+		found = Blocks.emplace(id, Blk).first;
+	}
+	TextBlock &Blk = found->second;
+	
+	// Colors only change the block table
+	if((Blk.Fill != Fill) || (Blk.Stroke != Stroke) || (Blk.Shadow != Shadow) || (Blk.layout == nullptr)) {
+		Blk.Fill = Fill;
+		Blk.Stroke = Stroke;
+		Blk.Shadow = Shadow;
+		writeBlockColors(Blk);
+	}
+	
+	// The same layout at the same place needs nothing else, the same layout elsewhere is only moved
+	bool sameLayout = (Blk.layout != nullptr) && (Blk.Text == Text) && (Blk.fontId == fontId) &&
+					  (Blk.sx == sx) && (Blk.sy == sy) && (Blk.Alignment == Alignment) && (Blk.wrap == wrap);
+	if(sameLayout && (Blk.x == x) && (Blk.y == y) && (Blk.RegH == RegH) && (Blk.RegV == RegV)) {
+		return id;
+	}
+	if(!sameLayout) {
+		Blk.Text = Text;
+		Blk.FontFace = FontFace;
+		Blk.Italic = Italic;
+		Blk.Bold = Bold;
+		Blk.Small = Small;
+		Blk.fontId = fontId;
+		Blk.sx = sx;
+		Blk.sy = sy;
+		Blk.Alignment = Alignment;
+		Blk.wrap = wrap;
+		Blk.layout = getLayout(Text, fontId, sx, sy, Alignment, wrap);
+		Blk.w = Blk.layout->w;
+		Blk.h = Blk.layout->h;
+		Blk.nlines = Blk.layout->nlines;
+		Blk.totChars = Blk.layout->quads.size();
+	}
+	Blk.x = x;
+	Blk.y = y;
+	Blk.RegH = RegH;
+	Blk.RegV = RegV;
+	writeBlockMesh(Blk);
 	return id;
 }
 
 void TextMaker::removeText(int id) {
-	Blocks.erase(id);
-	commandBufferMustUpdate = true;
+	auto found = Blocks.find(id);
+	if(found == Blocks.end()) {
+		return;
+	}
+	releaseBlock(found->second);
+	Blocks.erase(found);
 }
 
 void TextMaker::removeAllText() {
+	for(auto& Blk : Blocks) {
+		releaseBlock(Blk.second);
+	}
 	Blocks.clear();
-	commandBufferMustUpdate = true;
 }
 
 void TextMaker::init(BaseProject *_BP, int sW, int sH, int so) {
@@ -2648,8 +2764,41 @@ void TextMaker::init(BaseProject *_BP, int sW, int sH, int so) {
 
 	T.init(BP, fnt.textureFile);
 	
-	BP->DPSZs.texturesInPool += 2;	// Since text can be written before the old is released
-	BP->DPSZs.setsInPool += 2;		// we need twice the descriptors (old + new)
+	// Persistent buffers: the indices of the quads never change, the rest starts empty
+	VB.init(BP, 4 * maxGlyphs * sizeof(TextVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	IB.init(BP, 6 * maxGlyphs * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	BT.init(BP, maxBlocks * sizeof(TextBlockColors));
+	DC.init(BP, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	int nImages = VB.buffers.size();
+	
+	std::vector<uint32_t> indices(6 * maxGlyphs);
+	for(int k = 0; k < maxGlyphs; k++) {
+		indices[6 * k + 0] = 4 * k + 0;
+		indices[6 * k + 1] = 4 * k + 1;
+		indices[6 * k + 2] = 4 * k + 2;
+		indices[6 * k + 3] = 4 * k + 1;
+		indices[6 * k + 4] = 4 * k + 2;
+		indices[6 * k + 5] = 4 * k + 3;
+	}
+	vertices.assign(4 * maxGlyphs, TextVertex{});
+	blockTable.assign(maxBlocks, TextBlockColors{});
+	for(int i = 0; i < nImages; i++) {
+		IB.map(i, indices.data(), indices.size() * sizeof(uint32_t));
+		VB.map(i, vertices.data(), vertices.size() * sizeof(TextVertex));
+	}
+	freeGlyphs = {{0, maxGlyphs}};
+	freeSlots.clear();
+	for(int b = maxBlocks - 1; b >= 0; b--) {
+		freeSlots.push_back(b);
+	}
+	usedGlyphs = 0;
+	dirtyGlyphs.assign(nImages, {});
+	tableDirty.assign(nImages, true);
+	drawDirty.assign(nImages, true);
+	
+	BP->DPSZs.texturesInPool += 1;
+	BP->DPSZs.storageBuffersInPool += 1;
+	BP->DPSZs.setsInPool += 1;
 }
 
 void TextMaker::resizeScreen(int sW, int sH) {
@@ -2657,7 +2806,10 @@ void TextMaker::resizeScreen(int sW, int sH) {
 	screenH = sH;
 	RP.width = sW;
 	RP.height = sH;
-	commandBufferMustUpdate = true;
+	// Positions are in screen space: every block is laid out again
+	for(auto& Blk : Blocks) {
+		writeBlockMesh(Blk.second);
+	}
 }
 
 void TextMaker::createTextDescriptorSetAndVertexLayout() {
@@ -2667,16 +2819,18 @@ void TextMaker::createTextDescriptorSetAndVertexLayout() {
 			  {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(TextVertex, pos),
 					 sizeof(glm::vec2), OTHER},
 			  {0, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(TextVertex, texCoord),
-					 sizeof(glm::vec2), UV}
+					 sizeof(glm::vec2), UV},
+			  {0, 2, VK_FORMAT_R32_UINT, offsetof(TextVertex, block),
+					 sizeof(uint32_t), OTHER}
 			});
 	DSL.init(BP,
-			{{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1}});
+			{{0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1},
+			 {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1}});	// block table
 }
 
 
 void TextMaker::createTextPipeline() {
-	P.init(BP, &VD, "shaders/Text.vert.spv", "shaders/Text.frag.spv", {&DSL},
-		{{VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(TextColorPushConstant)}});
+	P.init(BP, &VD, "shaders/Text.vert.spv", "shaders/Text.frag.spv", {&DSL});
 	P.setCompareOp(VK_COMPARE_OP_LESS_OR_EQUAL);
 	P.setCullMode(VK_CULL_MODE_NONE);
 	P.setTransparency(true);
@@ -2692,103 +2846,239 @@ void TextMaker::atlasToUV(int x, int y, Font &Fnt, float &u, float &v) {
 	v = ((float)y + 0.5f) / (float)Fnt.texH;
 }
 
-void TextMaker::makeVertex(TextVertex *V, Font &Fnt, int px, int py, int tx, int ty) {
+void TextMaker::makeVertex(TextVertex *V, Font &Fnt, int px, int py, int tx, int ty, uint32_t block) {
 	pixelToScr(px, py, V->pos.x, V->pos.y);
 	atlasToUV(tx, ty, Fnt, V->texCoord.x, V->texCoord.y);
+	V->block = block;
 }
 
-void TextMaker::createTextMesh() {
-	M = new Model();
-	Font fnt = mainFont;
-	int totLen = 0;
+// First fit in the free ranges; returns the first glyph, or -1 if there is no room
+int TextMaker::allocGlyphs(int count) {
+	for(auto it = freeGlyphs.begin(); it != freeGlyphs.end(); it++) {
+		if(it->second >= count) {
+			int start = it->first;
+			it->first += count;
+			it->second -= count;
+			if(it->second == 0) {
+				freeGlyphs.erase(it);
+			}
+			int end = (!freeGlyphs.empty() && (freeGlyphs.back().first + freeGlyphs.back().second == maxGlyphs)) ?
+					  freeGlyphs.back().first : maxGlyphs;
+			if(end != usedGlyphs) {
+				usedGlyphs = end;
+				std::fill(drawDirty.begin(), drawDirty.end(), true);
+			}
+			return start;
+		}
+	}
+	return -1;
+}
+
+// Returns a range to the free ones (merging it with its neighbours), and clears its quads
+void TextMaker::releaseGlyphs(int start, int count) {
+	if(count <= 0) {
+		return;
+	}
+	std::fill(vertices.begin() + 4 * start, vertices.begin() + 4 * (start + count), TextVertex{});
+	markGlyphsDirty(start, count);
 	
-	for(auto& Blk : Blocks) {
-		totLen += Blk.second.totChars;
-//std::cout << Blk.first << ", characters: " << Blk.second.totChars << ", lines:" << Blk.second.nlines << ", w: " << Blk.second.w << ", h:" << Blk.second.h << "\n";
+	auto it = std::lower_bound(freeGlyphs.begin(), freeGlyphs.end(), std::make_pair(start, 0));
+	it = freeGlyphs.insert(it, {start, count});
+	if((it + 1 != freeGlyphs.end()) && (it->first + it->second == (it + 1)->first)) {
+		it->second += (it + 1)->second;
+		freeGlyphs.erase(it + 1);
+	}
+	if((it != freeGlyphs.begin()) && ((it - 1)->first + (it - 1)->second == it->first)) {
+		(it - 1)->second += it->second;
+		freeGlyphs.erase(it);
+	}
+	int end = (freeGlyphs.back().first + freeGlyphs.back().second == maxGlyphs) ? freeGlyphs.back().first : maxGlyphs;
+	if(end != usedGlyphs) {
+		usedGlyphs = end;
+		std::fill(drawDirty.begin(), drawDirty.end(), true);
+	}
+}
+
+void TextMaker::markGlyphsDirty(int start, int count) {
+	for(auto& ranges : dirtyGlyphs) {
+		ranges.push_back({start, count});
+	}
+}
+
+void TextMaker::writeBlockColors(TextBlock &Blk) {
+	blockTable[Blk.slot] = {Blk.Fill, Blk.Stroke, Blk.Shadow};
+	std::fill(tableDirty.begin(), tableDirty.end(), true);
+}
+
+// Writes the glyphs of a block into its range of the vertex buffer (moving it if it no longer fits)
+void TextMaker::writeBlockMesh(TextBlock &Blk) {
+	if(Blk.totChars > Blk.capacity) {
+		if(Blk.start >= 0) {
+			releaseGlyphs(Blk.start, Blk.capacity);
+		}
+		// Some room to grow in place (e.g. counters)
+		Blk.capacity = std::max(16, (Blk.totChars + 15) & ~15);
+		Blk.start = allocGlyphs(Blk.capacity);
+		if(Blk.start < 0) {
+			std::cout << "Error! Text buffer full (" << maxGlyphs << " glyphs), text not shown\n";
+			Blk.capacity = 0;
+			Blk.len = 0;
+			return;
+		}
+	} else if(Blk.start < 0) {
+		return;
 	}
-	int mainStride = VD.Bindings[0].stride;
 	
-//std::cout << "Total characters: " << totLen << "\n";
-	M->indices.resize(6 * totLen);
-	M->vertices.resize(4 * totLen * mainStride);
+	// Top-left corner of the block, in pixels
+	float ox = (Blk.x + 1.0f)/2.0f * screenW - Blk.sx * (
+			(Blk.RegH == TRH_RIGHT  ? (float)Blk.w      : 0.0f) +
+			(Blk.RegH == TRH_CENTER ? (float)Blk.w/2.0f : 0.0f))
+		   ;
+	float oy = (Blk.y + 1.0f)/2.0f * screenH - Blk.sy * (
+			(Blk.RegV == TRV_BOTTOM ? (float)Blk.h      : 0.0f) +
+			(Blk.RegV == TRV_MIDDLE ? (float)Blk.h/2.0f : 0.0f))
+		   ;
+	
+	const TextLayout &L = *Blk.layout;
+	int k = std::min((int)L.quads.size(), Blk.capacity);
+	TextVertex *V_vertex = &vertices[4 * Blk.start];
+	for(int g = 0; g < k; g++) {
+		const glm::vec4 &q = L.quads[g];
+		const glm::vec4 &uv = L.uvs[g];
+		// Corners snapped to the pixel, as makeVertex() does
+		int x0 = (int)(ox + q.x), y0 = (int)(oy + q.y), x1 = (int)(ox + q.z), y1 = (int)(oy + q.w);
+		pixelToScr(x0, y0, V_vertex[0].pos.x, V_vertex[0].pos.y);
+		pixelToScr(x1, y0, V_vertex[1].pos.x, V_vertex[1].pos.y);
+		pixelToScr(x0, y1, V_vertex[2].pos.x, V_vertex[2].pos.y);
+		pixelToScr(x1, y1, V_vertex[3].pos.x, V_vertex[3].pos.y);
+		V_vertex[0].texCoord = {uv.x, uv.y};
+		V_vertex[1].texCoord = {uv.z, uv.y};
+		V_vertex[2].texCoord = {uv.x, uv.w};
+		V_vertex[3].texCoord = {uv.z, uv.w};
+		for(int v = 0; v < 4; v++) {
+			V_vertex[v].block = Blk.slot;
+		}
+		V_vertex += 4;
+	}
+	// The quads left over from a longer text become degenerate
+	std::fill(V_vertex, vertices.data() + 4 * (Blk.start + Blk.capacity), TextVertex{});
+	markGlyphsDirty(Blk.start, std::max(k, Blk.len));
+	Blk.len = k;
+}
 
-	float btpx = 0;
-	float tpx = 0;
-	float tpy = 0;
+// Lays out a text (uncached): lines are broken at '\n' and, if wrap > 0, at the last space
+// before a line gets wider than wrap font pixels
+std::shared_ptr<TextLayout> TextMaker::layoutText(const std::string &Text, int fontId, float sx, float sy,
+												  TextAlignment Alignment, int wrap) {
+	auto L = std::make_shared<TextLayout>();
+	const FontDef &F = fnt.faces[fontId];
+	const int nGlyphs = fnt.maxChar - fnt.minChar;
+	auto advance = [&](char ch) {
+		int c = ((int)ch) - fnt.minChar;
+		return ((c >= 0) && (c <= nGlyphs)) ? F.P[c].xadvance : 0;
+	};
 	
-	int k = 0;
-	int ib = 0;
-	TextVertex *V_vertex = (TextVertex *)(&M->vertices[0]);
-	for(auto& B : Blocks) {
-		auto& Blk = B.second;
-		Blk.start = ib;
-		btpx = (Blk.x + 1.0f)/2.0f * screenW - Blk.sx * (
-				(Blk.RegH == TRH_RIGHT  ? (float)Blk.w      : 0.0f) +
-				(Blk.RegH == TRH_CENTER ? (float)Blk.w/2.0f : 0.0f))
-			   ;
-		tpy = (Blk.y + 1.0f)/2.0f * screenH - Blk.sy * (
-				(Blk.RegV == TRV_BOTTOM ? (float)Blk.h      : 0.0f) +
-				(Blk.RegV == TRV_MIDDLE ? (float)Blk.h/2.0f : 0.0f))
-			   ;
-		for(int i = 0; i < Blk.nlines; i++) {
-			tpx = btpx + (float)(Blk.w - Blk.linew[i]) *
-				(Blk.Alignment == TAL_LEFT ? 0.0f :
-				(Blk.Alignment == TAL_CENTER ? 0.5f : 1.0f)) * Blk.sx
-			   ;
-			for(int j = 0; j < Blk.lines[i].length(); j++) {
-				int c = ((int)Blk.lines[i][j]) - fnt.minChar;
-//std::cout << "]>" << Blk.lines[i][j] << "<[ (" << ((int)Blk.lines[i][j]) << ") - c: " << c << " (< " << (fnt.maxChar - fnt.minChar) << ")\n";
-				if((c >= 0) && (c <= fnt.maxChar - fnt.minChar)) {
-					CharData d = fnt.faces[Blk.fontId].P[c];
-					
-					makeVertex(V_vertex, fnt,
-							   tpx + (float)d.xoffset * Blk.sx,
-							   tpy + (float)d.yoffset * Blk.sy,
-							   d.x, d.y);
-					V_vertex++;
-
-					makeVertex(V_vertex, fnt,
-							   tpx + (float)(d.xoffset + d.width) * Blk.sx,
-							   tpy + (float) d.yoffset * Blk.sy,
-							   d.x + d.width, d.y);
-					V_vertex++;
-					
-					makeVertex(V_vertex, fnt,
-							   tpx + (float) d.xoffset * Blk.sx,
-							   tpy + (float)(d.yoffset + d.height) * Blk.sy,
-							   d.x, d.y + d.height);
-					V_vertex++;
-
-					makeVertex(V_vertex, fnt,
-							   tpx + (float)(d.xoffset + d.width)  * Blk.sx,
-							   tpy + (float)(d.yoffset + d.height) * Blk.sy,
-							   d.x + d.width, d.y + d.height);
-					V_vertex++;
-					
-					M->indices[ib + 0] = 4 * k + 0;
-					M->indices[ib + 1] = 4 * k + 1;
-					M->indices[ib + 2] = 4 * k + 2;
-					M->indices[ib + 3] = 4 * k + 1;
-					M->indices[ib + 4] = 4 * k + 2;
-					M->indices[ib + 5] = 4 * k + 3;
-
-					ib += 6;
-					tpx += (float)d.xadvance * Blk.sx;
-					k++;
-				}
+	// Line breaks: [begin, end) of each line in Text, and its width
+	std::vector<std::pair<size_t, size_t>> ranges;
+	size_t n = Text.length();
+	size_t lineBegin = 0, lastSpace = std::string::npos;
+	int width = 0, widthAtSpace = 0;
+	for(size_t j = 0; j <= n; j++) {
+		if((j == n) || (Text[j] == '\n')) {
+			if((j < n) || (width > 0)) {
+				ranges.push_back({lineBegin, j});
+				L->linew.push_back(width);
 			}
-			tpy += (float)fnt.faces[Blk.fontId].lineHeight * Blk.sy;
+			lineBegin = j + 1;
+			width = 0;
+			lastSpace = std::string::npos;
+			continue;
 		}
-		Blk.len = ib - Blk.start;
+		int adv = advance(Text[j]);
+		if((wrap > 0) && (Text[j] == ' ')) {
+			lastSpace = j;
+			widthAtSpace = width;
+		} else if((wrap > 0) && (width + adv > wrap) && (lastSpace != std::string::npos)) {
+			ranges.push_back({lineBegin, lastSpace});
+			L->linew.push_back(widthAtSpace);
+			width -= widthAtSpace + advance(' ');
+			lineBegin = lastSpace + 1;
+			lastSpace = std::string::npos;
+		}
+		width += adv;
+	}
+	L->nlines = ranges.size();
+	L->w = 0;
+	for(int lw : L->linew) {
+		L->w = std::max(L->w, lw);
 	}
-	M->initMesh(BP, &VD, false);
+	L->h = L->nlines * F.lineHeight;
 	
-/*std::cout << "[Text] Vertices: " << (M->vertices.size()/VD.Bindings[0].stride)
-			  << ", Indices: " << M->indices.size() << "\n";*/
+	// Glyph quads, relative to the top-left corner of the block
+	L->quads.reserve(n);
+	L->uvs.reserve(n);
+	float align = (Alignment == TAL_LEFT ? 0.0f : (Alignment == TAL_CENTER ? 0.5f : 1.0f));
+	for(int i = 0; i < L->nlines; i++) {
+		float px = (float)(L->w - L->linew[i]) * align;
+		float py = (float)(i * F.lineHeight);
+		for(size_t j = ranges[i].first; j < ranges[i].second; j++) {
+			int c = ((int)Text[j]) - fnt.minChar;
+			if((c < 0) || (c > nGlyphs)) {
+				continue;
+			}
+			const CharData &d = F.P[c];
+			L->quads.push_back({(px + d.xoffset) * sx, (py + d.yoffset) * sy,
+								(px + d.xoffset + d.width) * sx, (py + d.yoffset + d.height) * sy});
+			glm::vec4 uv;
+			atlasToUV(d.x, d.y, fnt, uv.x, uv.y);
+			atlasToUV(d.x + d.width, d.y + d.height, fnt, uv.z, uv.w);
+			L->uvs.push_back(uv);
+			px += d.xadvance;
+		}
+	}
+	return L;
+}
+
+// Layout of a text from the cache, laid out and added (evicting the least recently used) if missing
+std::shared_ptr<const TextLayout> TextMaker::getLayout(const std::string &Text, int fontId, float sx, float sy,
+													   TextAlignment Alignment, int wrap) {
+	if(layoutCacheSize == 0) {
+		layoutMisses++;
+		return layoutText(Text, fontId, sx, sy, Alignment, wrap);
+	}
+	TextLayoutKey key{Text, std::hash<std::string>()(Text), fontId, sx, sy, (int)Alignment, wrap};
+	auto found = layoutIndex.find(key);
+	if(found != layoutIndex.end()) {
+		layoutLRU.splice(layoutLRU.begin(), layoutLRU, found->second);
+		layoutHits++;
+		return found->second->second;
+	}
+	layoutMisses++;
+	std::shared_ptr<const TextLayout> L = layoutText(Text, fontId, sx, sy, Alignment, wrap);
+	layoutLRU.emplace_front(key, L);
+	layoutIndex.emplace(std::move(key), layoutLRU.begin());
+	if(layoutLRU.size() > layoutCacheSize) {
+		layoutIndex.erase(layoutLRU.back().first);
+		layoutLRU.pop_back();
+	}
+	return L;
+}
+
+void TextMaker::clearLayoutCache() {
+	layoutIndex.clear();
+	layoutLRU.clear();
+}
+
+void TextMaker::releaseBlock(TextBlock &Blk) {
+	if(Blk.start >= 0) {
+		releaseGlyphs(Blk.start, Blk.capacity);
+		Blk.start = -1;
+	}
+	freeSlots.push_back(Blk.slot);
 }
 
 void TextMaker::createTextDescriptorSets() {
-	DS.init(BP, &DSL, {T.getViewAndSampler()});
+	DS.init(BP, &DSL, {T.getViewAndSampler()}, {&BT});
 }
 
 void TextMaker::pipelinesAndDescriptorSetsInit() {
@@ -2806,9 +3096,10 @@ void TextMaker::pipelinesAndDescriptorSetsCleanup() {
 void TextMaker::localCleanup() {
 	T.cleanup();
 	
-	if(M != nullptr) {
-		M->cleanup();
-	}
+	VB.cleanup();
+	IB.cleanup();
+	BT.cleanup();
+	DC.cleanup();
 	DSL.cleanup();
 	
 	P.destroy();
@@ -2817,60 +3108,65 @@ void TextMaker::localCleanup() {
 
 void TextMaker::populateCommandBufferAccess(VkCommandBuffer commandBuffer, int currentImage, void *Params) {
 //std::cout << "Populating access (" << commandBuffer << ") for image: " << currentImage << "\n";
-	TextMaker *T = ((TextMakerAndModel *)Params)->txt;
+	TextMaker *T = (TextMaker *)Params;
 	T->populateCommandBuffer(commandBuffer, currentImage);
 }
 // This is the real place where the Command Buffer is written
+// It does not depend on the text: the draw reads its size, and the fragments their colors, from the buffers
 void TextMaker::populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage) {
 //std::cout << "Populating for image: " << currentImage << "\n";
 	RP.begin(commandBuffer, currentImage);
 	P.bind(commandBuffer);
-	M->bind(commandBuffer);
+	VkBuffer vertexBuffers[] = {VB.getBuffer(currentImage)};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	RenderStats::get().countVertexBufferBind(commandBuffer);
+	vkCmdBindIndexBuffer(commandBuffer, IB.getBuffer(currentImage), 0, VK_INDEX_TYPE_UINT32);
 	DS.bind(commandBuffer, P, 0, currentImage);
 	
-	for(auto& Blk : Blocks) {
-//std::cout << Blk.second.start << " " << Blk.second.len << "\n";
-		// Sends the Push-Constant with the colors
-		TextColorPushConstant PKv;
-		PKv.Fill   = Blk.second.Fill;
-		PKv.Stroke = Blk.second.Stroke;
-		PKv.Shadow = Blk.second.Shadow;
-		vkCmdPushConstants(
-			commandBuffer,
-			P.pipelineLayout,
-			VK_SHADER_STAGE_FRAGMENT_BIT,
-			0,
-			sizeof(PKv),
-			&PKv);
-				
-		vkCmdDrawIndexed(commandBuffer,
-						static_cast<uint32_t>(Blk.second.len), 1,
-						static_cast<uint32_t>(Blk.second.start), 0, 0);
-	}
+	vkCmdDrawIndexedIndirect(commandBuffer, DC.getBuffer(currentImage), 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+	RenderStats::get().countIndirectDraw(commandBuffer);
 	RP.end(commandBuffer);			
 }
 
-void TextMaker::freeCommandBuffer(void *Params) {
-	Model *M = ((TextMakerAndModel *)Params)->M;
-	M->cleanup();
-	
-	free(Params);
-}	
-
-void TextMaker::updateCommandBuffer() {
-	if(commandBufferMustUpdate) {
-//std::cout << "Creating text mesh\n";
-		createTextMesh();	// creates the new mesh
-		
-//std::cout << "Submitting command buffer\n";
-		TextMakerAndModel *tm = (TextMakerAndModel *)malloc(sizeof(TextMakerAndModel));
-		tm->txt = this;
-		tm->M = M;
+void TextMaker::update(int currentImage) {
+	PROFILE_SCOPE("TextMaker::update");
+	if(!commandBufferSubmitted) {
 		BP->submitCommandBuffer("text", submitOrder,
-							TextMaker::populateCommandBufferAccess,tm,
-							TextMaker::freeCommandBuffer);
-//std::cout << "Submitted\n";							
-		commandBufferMustUpdate = false;
+							TextMaker::populateCommandBufferAccess, this);
+		commandBufferSubmitted = true;
 	}
+	
+	// Copies the changed glyphs (merging overlapping and adjacent ranges)
+	auto& ranges = dirtyGlyphs[currentImage];
+	if(!ranges.empty()) {
+		std::sort(ranges.begin(), ranges.end());
+		int from = ranges[0].first, to = ranges[0].first + ranges[0].second;
+		for(size_t r = 1; r <= ranges.size(); r++) {
+			if((r < ranges.size()) && (ranges[r].first <= to)) {
+				to = std::max(to, ranges[r].first + ranges[r].second);
+				continue;
+			}
+			VB.map(currentImage, &vertices[4 * from], 4 * (to - from) * sizeof(TextVertex), 4 * from * sizeof(TextVertex));
+			if(r < ranges.size()) {
+				from = ranges[r].first;
+				to = ranges[r].first + ranges[r].second;
+			}
+		}
+		ranges.clear();
+	}
+	if(tableDirty[currentImage]) {
+		BT.map(currentImage, blockTable.data(), blockTable.size() * sizeof(TextBlockColors));
+		tableDirty[currentImage] = false;
+	}
+	if(drawDirty[currentImage]) {
+		VkDrawIndexedIndirectCommand draw{};
+		draw.indexCount = 6 * usedGlyphs;
+		draw.instanceCount = 1;
+		DC.map(currentImage, &draw, sizeof(draw));
+		drawDirty[currentImage] = false;
+	}
+	// Drawn every frame, whatever was copied
+	RenderStats::get().countTextGlyphs(usedGlyphs);
 }
-#endif    
+#endif
@@ -0,0 +1,60 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/**
+ * Vertex shader of the characters when they are skinned by CharacterSkinning.comp.
+ * It has the same uniforms and outputs of CharacterVertex.vert, so it is used with the same fragment shaders,
+ * but the vertices (VDtan) are already skinned in model space: only the world matrix is applied.
+ * The joint palette of set 1 is still linked, but not read here.
+ */
+
+layout(set = 1, binding = 0) uniform CharUBO {
+	mat4 vpMat;			// view-projection matrix
+	mat4 mMat;			// world matrix of the instance
+	int jointsCount;
+} charUbo;
+
+layout(set = 1, binding = 1) uniform ShadowClipUBO {
+	mat4 lightVP;
+	vec4 debug;			// see CharacterVertex.vert
+} shadowClipUbo;
+
+// VDtan Vertex Descriptor
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNorm;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec4 inTangent;
+
+layout(location = 0) out vec3 fragPos;
+layout(location = 1) out vec3 fragNorm;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) out vec4 fragTan;
+layout(location = 4) out int toBeDiscarded;
+
+layout(location = 5) out vec4 fragPosLightSpace;
+layout(location = 6) out vec4 debug;
+
+void main() {
+	// The compute pass writes a null tangent for the vertices with invalid joints
+	if(inTangent.w == 0.0) {
+		toBeDiscarded = 1;
+		return;
+	} else
+		toBeDiscarded = 0;
+
+	vec4 worldPos = charUbo.mMat * vec4(inPosition, 1.0);
+
+	gl_Position = charUbo.vpMat * worldPos;
+	fragPos = worldPos.xyz;
+	fragPosLightSpace = shadowClipUbo.lightVP * worldPos;
+	debug = shadowClipUbo.debug;
+
+	mat3 M = mat3(charUbo.mMat);
+	mat3 nMat = mat3(cross(M[1], M[2]), cross(M[2], M[0]), cross(M[0], M[1]));
+	nMat *= sign(dot(M[0], nMat[0]));
+	fragNorm = normalize(nMat * inNorm);
+
+	fragUV = inUV;
+
+	fragTan = vec4(normalize(M * inTangent.xyz), inTangent.w);
+}
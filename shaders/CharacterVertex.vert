@@ -1,11 +1,9 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-#define MAX_JOINTS 100
 layout(set = 1, binding = 0) uniform CharUBO {
-	mat4 mvpMat[MAX_JOINTS];
-	mat4 mMat[MAX_JOINTS];
-	mat4 nMat[MAX_JOINTS];
+	mat4 vpMat;			// view-projection matrix
+	mat4 mMat;			// world matrix of the instance
 	int jointsCount;
 } charUbo;
 
@@ -20,6 +18,18 @@ layout(set = 1, binding = 1) uniform ShadowClipUBO {
 	vec4 debug;
 } shadowClipUbo;
 
+/** Skinning palette of the character, shared with the shadow map pass (see shadowMapShaderChar.vert).
+ * Each joint is a 3x4 affine matrix, stored as its three rows, in model space of the character.
+ */
+struct JointAffine {
+	vec4 r0;
+	vec4 r1;
+	vec4 r2;
+};
+layout(std430, set = 1, binding = 2) readonly buffer JointPalette {
+	JointAffine joints[];
+} palette;
+
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNorm;
@@ -48,36 +58,34 @@ void main() {
 	} else
 		toBeDiscarded = 0;
 
-	gl_Position = inJointWeight.x * charUbo.mvpMat[inJointIndex.x] * vec4(inPosition, 1.0);
-	fragPos = inJointWeight.x * (charUbo.mMat[inJointIndex.x] * vec4(inPosition, 1.0)).xyz;
-	fragNorm = inJointWeight.x * (charUbo.nMat[inJointIndex.x] * vec4(inNorm, 0.0)).xyz;
-
-	gl_Position += inJointWeight.y * charUbo.mvpMat[inJointIndex.y] * vec4(inPosition, 1.0);
-	fragPos += inJointWeight.y * (charUbo.mMat[inJointIndex.y] * vec4(inPosition, 1.0)).xyz;
-	fragNorm += inJointWeight.y * (charUbo.nMat[inJointIndex.y] * vec4(inNorm, 0.0)).xyz;
+	// Linear blend of the joint matrices (equivalent to blending the transformed positions)
+	JointAffine jx = palette.joints[inJointIndex.x];
+	JointAffine jy = palette.joints[inJointIndex.y];
+	JointAffine jz = palette.joints[inJointIndex.z];
+	JointAffine jw = palette.joints[inJointIndex.w];
+	vec4 r0 = inJointWeight.x * jx.r0 + inJointWeight.y * jy.r0 + inJointWeight.z * jz.r0 + inJointWeight.w * jw.r0;
+	vec4 r1 = inJointWeight.x * jx.r1 + inJointWeight.y * jy.r1 + inJointWeight.z * jz.r1 + inJointWeight.w * jw.r1;
+	vec4 r2 = inJointWeight.x * jx.r2 + inJointWeight.y * jy.r2 + inJointWeight.z * jz.r2 + inJointWeight.w * jw.r2;
 
-	gl_Position += inJointWeight.z * charUbo.mvpMat[inJointIndex.z] * vec4(inPosition, 1.0);
-	fragPos += inJointWeight.z * (charUbo.mMat[inJointIndex.z] * vec4(inPosition, 1.0)).xyz;
-	fragNorm += inJointWeight.z * (charUbo.nMat[inJointIndex.z] * vec4(inNorm, 0.0)).xyz;
+	vec4 skinnedPos = vec4(dot(r0, vec4(inPosition, 1.0)),
+						   dot(r1, vec4(inPosition, 1.0)),
+						   dot(r2, vec4(inPosition, 1.0)), 1.0);
+	vec4 worldPos = charUbo.mMat * skinnedPos;
 
-	gl_Position += inJointWeight.w * charUbo.mvpMat[inJointIndex.w] * vec4(inPosition, 1.0);
-	fragPos += inJointWeight.w * (charUbo.mMat[inJointIndex.w] * vec4(inPosition, 1.0)).xyz;
-	fragNorm += inJointWeight.w * (charUbo.nMat[inJointIndex.w] * vec4(inNorm, 0.0)).xyz;
+	gl_Position = charUbo.vpMat * worldPos;
+	fragPos = worldPos.xyz;
+	fragPosLightSpace = shadowClipUbo.lightVP * worldPos;
+	debug = shadowClipUbo.debug;
 
-	fragPosLightSpace =
-		inJointWeight.x * shadowClipUbo.lightVP * charUbo.mMat[inJointIndex.x] * vec4(inPosition, 1.0) +
-		inJointWeight.y * shadowClipUbo.lightVP * charUbo.mMat[inJointIndex.y] * vec4(inPosition, 1.0) +
-		inJointWeight.z * shadowClipUbo.lightVP * charUbo.mMat[inJointIndex.z] * vec4(inPosition, 1.0) +
-		inJointWeight.w * shadowClipUbo.lightVP * charUbo.mMat[inJointIndex.w] * vec4(inPosition, 1.0);
-    debug = shadowClipUbo.debug;
+	// Linear part of the whole model transform (mat3 takes columns, the palette stores rows)
+	mat3 M = mat3(charUbo.mMat) * transpose(mat3(r0.xyz, r1.xyz, r2.xyz));
+	// Normal matrix as the cofactor matrix of M: it is the inverse transpose up to a scale factor,
+	// which is removed by the normalization (the sign of the determinant keeps the orientation)
+	mat3 nMat = mat3(cross(M[1], M[2]), cross(M[2], M[0]), cross(M[0], M[1]));
+	nMat *= sign(dot(M[0], nMat[0]));
+	fragNorm = normalize(nMat * inNorm);
 
 	fragUV = inUV;
 
-	vec3 tanTmp = vec3(0.0);
-	tanTmp += inJointWeight.x * (mat3(charUbo.mMat[inJointIndex.x]) * inTangent.xyz);
-	tanTmp += inJointWeight.y * (mat3(charUbo.mMat[inJointIndex.y]) * inTangent.xyz);
-	tanTmp += inJointWeight.z * (mat3(charUbo.mMat[inJointIndex.z]) * inTangent.xyz);
-	tanTmp += inJointWeight.w * (mat3(charUbo.mMat[inJointIndex.w]) * inTangent.xyz);
-	tanTmp = normalize(tanTmp);
-	fragTan = vec4(tanTmp, inTangent.w);
-}
\ No newline at end of file
+	fragTan = vec4(normalize(M * inTangent.xyz), inTangent.w);
+}
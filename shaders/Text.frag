@@ -1,16 +1,27 @@
-#version 450#extension GL_ARB_separate_shader_objects : enable
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
 
 layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) flat in uint fragBlock;
 
 layout(location = 0) out vec4 outColor;
 
 layout(binding = 0) uniform sampler2D texSampler;
 
-layout(push_constant) uniform PushConsts {	vec4 FGcolor;
+// Colors of each text block (TextBlockColors in TextMaker.hpp)
+struct BlockColors {
+	vec4 FGcolor;
 	vec4 BGcolor;
-	vec4 SHcolor;} pushConsts;
+	vec4 SHcolor;
+};
+layout(std430, binding = 1) readonly buffer BlockTable {
+	BlockColors blocks[];
+};
 
 void main() {
 	vec4 Tx = texture(texSampler, fragTexCoord);
-	outColor = Tx.r * pushConsts.FGcolor +			   Tx.g * pushConsts.BGcolor +			   Tx.b * pushConsts.SHcolor;
-}
\ No newline at end of file
+	BlockColors C = blocks[fragBlock];
+	outColor = Tx.r * C.FGcolor +
+			   Tx.g * C.BGcolor +
+			   Tx.b * C.SHcolor;
+}
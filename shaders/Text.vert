@@ -1,10 +1,13 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
-layout(location = 0) in vec2 inPos;
+layout(location = 0) in vec2 inPos;
 layout(location = 1) in vec2 inUV;
+layout(location = 2) in uint inBlock;
 
 layout(location = 0) out vec2 fragTexCoord;
-void main() {
+layout(location = 1) flat out uint fragBlock;
+void main() {
 	gl_Position = vec4(inPos, 0.0, 1.0);
 	fragTexCoord = inUV;
-}
\ No newline at end of file
+	fragBlock = inBlock;
+}
@@ -34,7 +34,9 @@ layout(set = 2, binding = 1) uniform sampler2D burningText;
 
 const float glowStrength = 35.0;
 void main() {
-    vec3 torchColor = lightUbo.pointLightColors[indexUbo.index].rgb;
+    // Index -1: a pin with no torch (see torchPinIdx in main.cpp), never lit
+    vec3 torchColor = indexUbo.index >= 0 && indexUbo.index < lightUbo.nPointLights ?
+                      lightUbo.pointLightColors[indexUbo.index].rgb : vec3(0.0);
 
     // Distortion effect based on time and UV coordinates, to simulate shimmering flames
     vec2 offset = 0.0075 * (1-fragUV.y) * vec2(sin(timeUbo.time*0.5 + fragUV.y*0.5), cos(timeUbo.time*1.0 + fragUV.x*1.0));
@@ -5,10 +5,9 @@
  * Shadow Map Vertex Shader, specific for Character.
  *
  * It has same structure and purpose of shadowMapShader.vert for VDtan vertex descriptor. See it for greater details
- * Besides the input variables, the greater difference is the uniform
- * For characters with multiple joints, each of its joint has its own model matrix
- * Hence the model is now an array of model matrices, and the computation of gl_Position
- * takes into account the weights of each coordinate (see CharacterVertex.vert)
+ * Besides the input variables, the greater difference is the skinning:
+ * each joint of the character has its own transform, read from the joint palette storage buffer
+ * shared with the main pass (see CharacterVertex.vert), and weighted to compute gl_Position
  */
 
 // VDchar Vertex Descriptor
@@ -21,18 +20,35 @@ layout(location = 5) in vec4 inJointWeight;
 
 layout(location = 0) out vec2 fragUV;
 
-#define MAX_JOINTS 100
-layout(set = 0, binding = 0) uniform ShdaowMapUBOChar {
+layout(set = 0, binding = 0) uniform ShadowMapUBOChar {
     mat4 lightVP;
-    mat4 model[MAX_JOINTS];
+    mat4 model;     // world matrix of the instance
 } ubo;
 
+// Skinning palette: one 3x4 affine matrix (its three rows) per joint
+struct JointAffine {
+    vec4 r0;
+    vec4 r1;
+    vec4 r2;
+};
+layout(std430, set = 0, binding = 2) readonly buffer JointPalette {
+    JointAffine joints[];
+} palette;
+
 void main() {
+    JointAffine jx = palette.joints[inJointIndex.x];
+    JointAffine jy = palette.joints[inJointIndex.y];
+    JointAffine jz = palette.joints[inJointIndex.z];
+    JointAffine jw = palette.joints[inJointIndex.w];
+    vec4 r0 = inJointWeight.x * jx.r0 + inJointWeight.y * jy.r0 + inJointWeight.z * jz.r0 + inJointWeight.w * jw.r0;
+    vec4 r1 = inJointWeight.x * jx.r1 + inJointWeight.y * jy.r1 + inJointWeight.z * jz.r1 + inJointWeight.w * jw.r1;
+    vec4 r2 = inJointWeight.x * jx.r2 + inJointWeight.y * jy.r2 + inJointWeight.z * jz.r2 + inJointWeight.w * jw.r2;
+
+    vec4 skinnedPos = vec4(dot(r0, vec4(inPosition, 1.0)),
+                           dot(r1, vec4(inPosition, 1.0)),
+                           dot(r2, vec4(inPosition, 1.0)), 1.0);
+
     // Transform vertex position from model space to light clip space
-    gl_Position = inJointWeight.x *
-                  ubo.lightVP * ubo.model[inJointIndex.x] * vec4(inPosition, 1.0);
-    gl_Position += inJointWeight.y *
-                  ubo.lightVP * ubo.model[inJointIndex.y] * vec4(inPosition, 1.0);
-    gl_Position += inJointWeight.z *
-                    ubo.lightVP * ubo.model[inJointIndex.z] * vec4(inPosition, 1.0);
+    gl_Position = ubo.lightVP * ubo.model * skinnedPos;
+    fragUV = inUV;
 }
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+/**
+ * Shadow Map Vertex Shader for the characters skinned by CharacterSkinning.comp.
+ *
+ * Same Descriptor Set Layout of shadowMapShaderChar.vert (the joint palette is linked but not read),
+ * but the VDtan vertices are already skinned in model space, so only the world matrix is applied.
+ */
+
+// VDtan Vertex Descriptor
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNorm;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec4 inTan;
+
+layout(location = 0) out vec2 fragUV;
+
+layout(set = 0, binding = 0) uniform ShadowMapUBOChar {
+    mat4 lightVP;
+    mat4 model;     // world matrix of the instance
+} ubo;
+
+void main() {
+    // Transform vertex position from model space to light clip space
+    gl_Position = ubo.lightVP * ubo.model * vec4(inPosition, 1.0);
+    fragUV = inUV;
+}
@@ -1,40 +1,230 @@
 #include "AnimatedProps.hpp"
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 
-#define CRANE_WHEELS_COUNT 3
-#define CRANE_WHEELS_SPEED 0.5f // degrees per frame
+namespace {
 
-std::ostringstream oss;
+/** Rotation of angle radians around axis (normalized), through pivot, followed by a translation. */
+glm::mat4 rotationAround(const glm::vec3& axis, float angle, const glm::vec3& pivot, const glm::vec3& offset) {
+    glm::mat4 m = glm::rotate(glm::mat4(1.0f), angle, axis);
+    m[3] = glm::vec4(pivot - glm::mat3(m) * pivot + offset, 1.0f);
+    return m;
+}
+
+glm::vec3 readVec3(const nlohmann::json& j, const char* key, const glm::vec3& def) {
+    if (!j.contains(key)) return def;
+    const nlohmann::json& v = j[key];
+    if (!v.is_array() || v.size() != 3) return def;
+    return glm::vec3(v[0].get<float>(), v[1].get<float>(), v[2].get<float>());
+}
+
+}
 
 AnimatedProps::AnimatedProps(InteractionsManager *im, InteractableState* is, Scene *SC) {
-    this->interactionsManager = *im;
+    this->interactionsManager = im;
     this->interactableState = is;
-    this->scene = *SC;
+    this->scene = SC;
+}
+
+int AnimatedProps::init(std::string file) {
+    nlohmann::json js;
+    std::ifstream ifs(file);
+    if (!ifs.is_open()) {
+        std::cout << "Error! Scene file >" << file << "< not found!";
+        return -1;
+    }
+    try {
+        ifs >> js;
+    } catch (const nlohmann::json::exception& e) {
+        std::cout << "Exception while parsing JSON file: " << file << "\n" << e.what() << "\n";
+        return -1;
+    }
+    if (!js.contains("animatedProps")) return 0;
+    return init(js["animatedProps"]);
+}
 
-    init();
+int AnimatedProps::init(const nlohmann::json& props) {
+    if (!props.is_array()) {
+        std::cout << "Error! \"animatedProps\" must be an array\n";
+        return -1;
+    }
+    for (const auto& prop : props) {
+        if (addProp(prop) != 0) return -1;
+    }
+    changed.assign(type.size(), 0);
+    local.assign(type.size(), glm::mat4(1.0f));
+    dirtyInstances.reserve(targetInstance.size());
+    std::cout << "Animated props: " << type.size() << " props moving " << targetInstance.size() << " instances\n";
+    return 0;
 }
 
+int AnimatedProps::addProp(const nlohmann::json& prop) {
+    const std::string id = prop.value("id", "unnamed");
+    const std::string typeName = prop.value("type", "");
+    PropType t;
+    if (typeName == "rotator") t = Rotator;
+    else if (typeName == "oscillator") t = Oscillator;
+    else if (typeName == "path") t = Path;
+    else {
+        std::cout << "Error! Unknown type >" << typeName << "< of animated prop " << id << "\n";
+        return -1;
+    }
+
+    // Instances moved by the prop, resolved once to indices of Scene::I
+    const int propIdx = static_cast<int>(type.size());
+    for (const auto& instanceId : prop.value("instances", std::vector<std::string>{})) {
+        auto it = scene->InstanceIds.find(instanceId);
+        if (it == scene->InstanceIds.end()) {
+            std::cout << "Error! Instance >" << instanceId << "< of animated prop " << id << " not found\n";
+            return -1;
+        }
+        targetProp.push_back(propIdx);
+        targetInstance.push_back(it->second);
+        targetBase.push_back(scene->I[it->second]->Wm);
+    }
+
+    glm::vec3 a = readVec3(prop, "axis", glm::vec3(0, 0, 1));
+    if (glm::length(a) < 1e-6f) {
+        std::cout << "Error! Null axis for animated prop " << id << "\n";
+        return -1;
+    }
+    const float r = prop.value("rate", 0.0f);
+    const float f = prop.value("frequency", 0.0f);
+    float p = 0.0f;
+    if (t == Rotator) p = std::abs(r) > 0.0f ? 360.0f / std::abs(r) : 0.0f;
+    else if (t == Oscillator) p = f > 0.0f ? 1.0f / f : 0.0f;
+
+    // Keyframes of paths, sorted by time
+    int first = static_cast<int>(keyTime.size());
+    int keys = 0;
+    if (t == Path) {
+        std::vector<nlohmann::json> sorted = prop.value("keys", std::vector<nlohmann::json>{});
+        std::stable_sort(sorted.begin(), sorted.end(), [](const nlohmann::json& x, const nlohmann::json& y) {
+            return x.value("time", 0.0f) < y.value("time", 0.0f);
+        });
+        for (const auto& key : sorted) {
+            keyTime.push_back(key.value("time", 0.0f));
+            keyOffset.push_back(readVec3(key, "offset", glm::vec3(0.0f)));
+            keyAngle.push_back(key.value("angle", 0.0f));
+        }
+        keys = static_cast<int>(sorted.size());
+        if (keys == 0) {
+            std::cout << "Error! Path animated prop " << id << " has no keys\n";
+            return -1;
+        }
+        p = keyTime[first + keys - 1];
+    }
+
+    // Optional binding to an interaction point, which switches the prop on and off
+    InteractionKind kind = InteractionKind::Other;
+    int stateIdx = -1;
+    bool isActive = prop.value("active", true);
+    if (prop.contains("interaction")) {
+        const std::string interactionId = prop["interaction"].get<std::string>();
+        if (interactionsManager != nullptr) {
+            for (const auto& interaction : interactionsManager->getAllInteractions()) {
+                if (interaction.id == interactionId) {
+                    kind = interaction.kind;
+                    stateIdx = interaction.stateIdx;
+                    break;
+                }
+            }
+        }
+        if (kind == InteractionKind::Other) {
+            std::cout << "Error! Interaction >" << interactionId << "< of animated prop " << id << " not found or not bindable\n";
+            return -1;
+        }
+        // The interaction starts in the state declared by the prop
+        std::vector<bool>& state = kind == InteractionKind::Torch ? interactableState->torchesOn : interactableState->craneWheelsRotating;
+        if (state.size() <= static_cast<size_t>(stateIdx)) state.resize(stateIdx + 1, false);
+        state[stateIdx] = isActive;
+    }
+
+    type.push_back(t);
+    active.push_back(isActive ? 1 : 0);
+    translate.push_back(t == Oscillator && prop.value("mode", "rotate") == "translate" ? 1 : 0);
+    loop.push_back(prop.value("loop", true) ? 1 : 0);
+    axis.push_back(glm::normalize(a));
+    pivot.push_back(readVec3(prop, "pivot", glm::vec3(0.0f)));
+    rate.push_back(t == Oscillator ? prop.value("amplitude", 0.0f) : r);
+    frequency.push_back(f);
+    phase.push_back(glm::radians(prop.value("phase", 0.0f)));
+    period.push_back(p);
+    time.push_back(0.0f);
+    firstKey.push_back(first);
+    keyCount.push_back(keys);
+    bindKind.push_back(kind);
+    bindIdx.push_back(stateIdx);
+    return 0;
+}
 
-void AnimatedProps::init() {
-    // Initialize crane wheel interaction states
-    for (int craneWheelIdx = 0; craneWheelIdx < CRANE_WHEELS_COUNT; craneWheelIdx++) {
-        interactableState->craneWheelsRotating.push_back(true);
+/*
+ * Transform of prop i at its current time, in the local space of its instances.
+ */
+glm::mat4 AnimatedProps::evaluate(size_t i) const {
+    switch (type[i]) {
+        case Rotator:
+            return rotationAround(axis[i], glm::radians(rate[i] * time[i]), pivot[i], glm::vec3(0.0f));
+        case Oscillator: {
+            const float s = std::sin(2.0f * glm::pi<float>() * frequency[i] * time[i] + phase[i]);
+            if (translate[i]) {
+                glm::mat4 m(1.0f);
+                m[3] = glm::vec4(axis[i] * (rate[i] * s), 1.0f);
+                return m;
+            }
+            return rotationAround(axis[i], glm::radians(rate[i] * s), pivot[i], glm::vec3(0.0f));
+        }
+        default: {
+            // Segment of the path containing the current time (keys are few: a linear search is enough)
+            const int first = firstKey[i], last = firstKey[i] + keyCount[i] - 1;
+            int k = first;
+            while (k < last && keyTime[k + 1] <= time[i]) k++;
+            float w = 0.0f;
+            if (k < last && keyTime[k + 1] > keyTime[k]) w = (time[i] - keyTime[k]) / (keyTime[k + 1] - keyTime[k]);
+            const int n = std::min(k + 1, last);
+            const glm::vec3 offset = glm::mix(keyOffset[k], keyOffset[n], w);
+            const float angle = keyAngle[k] + (keyAngle[n] - keyAngle[k]) * w;
+            return rotationAround(axis[i], glm::radians(angle), pivot[i], offset);
+        }
     }
 }
 
 void AnimatedProps::update(float deltaTime) {
-    for (int wheelId = 0; wheelId < 3; wheelId++) {
-        if (interactableState->craneWheelsRotating[wheelId]) {
-            // Get the instances related to the wheel
-            oss << std::setw(2) << std::setfill('0') << wheelId;
-            std::string wheelIdStr = oss.str();
-            oss.str(""); // Clear the stream for next use
-            auto craneWheelInstanceA = scene.InstanceIds.at("build_crane_01_wheel-00." + wheelIdStr);
-            auto craneWheelInstanceB = scene.InstanceIds.at("build_crane_01_wheel-01." + wheelIdStr);
-            // Rotate the wheel
-            scene.I[craneWheelInstanceA]->Wm = glm::rotate(scene.I[craneWheelInstanceA]->Wm, glm::radians(CRANE_WHEELS_SPEED), glm::vec3(0,0,1));
-            scene.I[craneWheelInstanceB]->Wm = glm::rotate(scene.I[craneWheelInstanceB]->Wm, glm::radians(CRANE_WHEELS_SPEED), glm::vec3(0,0,1));
-        }
-    }
-}
\ No newline at end of file
+    dirtyInstances.clear();
+    const size_t count = type.size();
+
+    // Interactions switch their props on and off
+    for (size_t i = 0; i < count; i++) {
+        if (bindKind[i] == InteractionKind::Torch) active[i] = interactableState->torchesOn[bindIdx[i]];
+        else if (bindKind[i] == InteractionKind::CraneWheel) active[i] = interactableState->craneWheelsRotating[bindIdx[i]];
+    }
+
+    // Clocks, wrapped to the period so that the angles keep their precision
+    for (size_t i = 0; i < count; i++) {
+        changed[i] = active[i];
+        if (!active[i]) continue;
+        float t = time[i] + deltaTime;
+        if (period[i] > 0.0f && t >= period[i]) {
+            if (type[i] == Path && !loop[i]) {
+                t = period[i];
+                active[i] = 0;      // stays at the last key
+            } else {
+                t = std::fmod(t, period[i]);
+            }
+        }
+        time[i] = t;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (changed[i]) local[i] = evaluate(i);
+    }
+
+    // World matrices of the instances
+    const size_t targets = targetInstance.size();
+    for (size_t t = 0; t < targets; t++) {
+        if (!changed[targetProp[t]]) continue;
+        scene->I[targetInstance[t]]->Wm = targetBase[t] * local[targetProp[t]];
+        dirtyInstances.push_back(targetInstance[t]);
+    }
+}
@@ -0,0 +1,376 @@
+#include "Benchmark.hpp"
+#include "Profiler.hpp"
+#include "PhysicsManager.hpp"
+#include "modules/Scene.hpp"
+#include "modules/Animations.hpp"
+#include "character/char_manager.hpp"
+#include "character/anim_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+
+namespace {
+
+void printBenchmarkUsage() {
+    std::cout << "Benchmark options:\n"
+                 "  --benchmark             render offscreen (no window, no swapchain) and write a report\n"
+                 "  --sim-only              run the simulation only, without a Vulkan device\n"
+                 "  --frames N              measured frames (default 1000)\n"
+                 "  --warmup N              frames run before measuring (default 60)\n"
+                 "  --resolution WxH        offscreen resolution (default 1280x720)\n"
+                 "  --timestep S            simulated seconds per frame (default 1/60)\n"
+                 "  --camera-path FILE      recorded camera path (default: orbit over the village)\n"
+                 "  --out FILE              report file (default benchmark.json)\n"
+                 "  --cpu-device            prefer a software Vulkan device (e.g. lavapipe)\n"
+                 "  --preskin               skin the characters in a compute pass (also when playing)\n"
+                 "  --record-input FILE     play and record the input to FILE\n"
+                 "  --replay-input FILE     replay the input recorded in FILE and write a report\n";
+}
+
+glm::vec3 readVec3(const nlohmann::json& j) {
+    return glm::vec3(j[0].get<float>(), j[1].get<float>(), j[2].get<float>());
+}
+
+glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    const double rank = p * (sorted.size() - 1);
+    const size_t lo = static_cast<size_t>(rank);
+    const size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+}
+
+/** Loads only the asset files of the characters animations (the others stay nullptr), without a device. */
+std::vector<AssetFile*> loadAnimationAssets(const nlohmann::json& sceneJson) {
+    std::unordered_set<std::string> needed;
+    for (const auto& charJson : sceneJson["characters"]) {
+        for (const auto& anim : charJson.value("animList", std::vector<std::string>{})) {
+            needed.insert(anim);
+        }
+    }
+    std::vector<AssetFile*> assets;
+    for (const auto& assetJson : sceneJson["assetfiles"]) {
+        AssetFile* af = nullptr;
+        if (needed.count(assetJson.value("id", "")) > 0) {
+            af = new AssetFile();
+            af->init(assetJson["file"].get<std::string>(), GLTF);
+        }
+        assets.push_back(af);
+    }
+    return assets;
+}
+
+/** Releases the asset files returned by loadAnimationAssets(). */
+void freeAnimationAssets(std::vector<AssetFile*>& assets) {
+    for (AssetFile* af : assets) {
+        if (af != nullptr) {
+            af->cleanup();
+            delete af;
+        }
+    }
+    assets.clear();
+}
+
+}
+
+int parseBenchmarkArgs(int argc, char* argv[], BenchmarkOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        try {
+            if (arg == "--benchmark") options.mode = BenchmarkOptions::OFFSCREEN;
+            else if (arg == "--sim-only") options.mode = BenchmarkOptions::SIM_ONLY;
+            else if (arg == "--cpu-device") options.preferCpuDevice = true;
+            else if (arg == "--preskin") options.preskinCharacters = true;
+            else if (arg == "--frames" && hasValue) options.frames = std::stoi(argv[++i]);
+            else if (arg == "--warmup" && hasValue) options.warmupFrames = std::stoi(argv[++i]);
+            else if (arg == "--timestep" && hasValue) options.timeStep = std::stof(argv[++i]);
+            else if (arg == "--camera-path" && hasValue) options.cameraPath = argv[++i];
+            else if (arg == "--out" && hasValue) options.outFile = argv[++i];
+            else if (arg == "--record-input" && hasValue) options.recordInput = argv[++i];
+            else if (arg == "--replay-input" && hasValue) options.replayInput = argv[++i];
+            else if (arg == "--resolution" && hasValue) {
+                const std::string res = argv[++i];
+                const size_t x = res.find('x');
+                if (x == std::string::npos) throw std::invalid_argument(res);
+                options.width = static_cast<uint32_t>(std::stoul(res.substr(0, x)));
+                options.height = static_cast<uint32_t>(std::stoul(res.substr(x + 1)));
+            } else {
+                std::cout << "Error! Unknown argument >" << arg << "<\n";
+                printBenchmarkUsage();
+                return -1;
+            }
+        } catch (const std::exception&) {
+            std::cout << "Error! Invalid value for >" << arg << "<\n";
+            printBenchmarkUsage();
+            return -1;
+        }
+    }
+    if (options.frames <= 0 || options.warmupFrames < 0 || options.timeStep <= 0.0f ||
+        options.width == 0 || options.height == 0) {
+        std::cout << "Error! Frames, resolution and time step must be positive\n";
+        return -1;
+    }
+    if (!options.recordInput.empty() && (options.mode != BenchmarkOptions::OFF || !options.replayInput.empty())) {
+        std::cout << "Error! The input can be recorded only while playing\n";
+        return -1;
+    }
+    if (!options.replayInput.empty() && options.mode == BenchmarkOptions::SIM_ONLY) {
+        std::cout << "Error! The input cannot be replayed in the simulation only benchmark\n";
+        return -1;
+    }
+    return 0;
+}
+
+// ---------- CameraPath ----------
+
+int CameraPath::load(const std::string& file) {
+    std::ifstream ifs(file);
+    if (!ifs.is_open()) {
+        std::cout << "Error! Camera path >" << file << "< not found!\n";
+        return -1;
+    }
+    keys.clear();
+    try {
+        nlohmann::json j;
+        ifs >> j;
+        for (const auto& key : j.at("keys")) {
+            addKey(key.at("time").get<float>(), readVec3(key.at("eye")), readVec3(key.at("target")));
+        }
+    } catch (const nlohmann::json::exception& e) {
+        std::cout << "Error! Invalid camera path >" << file << "<: " << e.what() << "\n";
+        keys.clear();
+        return -1;
+    }
+    if (keys.size() < 2) {
+        std::cout << "Error! Camera path >" << file << "< needs at least 2 keys\n";
+        return -1;
+    }
+    return 0;
+}
+
+bool CameraPath::save(const std::string& file) const {
+    nlohmann::json j = {{"keys", nlohmann::json::array()}};
+    for (const Key& key : keys) {
+        j["keys"].push_back({{"time", key.time},
+                             {"eye", {key.eye.x, key.eye.y, key.eye.z}},
+                             {"target", {key.target.x, key.target.y, key.target.z}}});
+    }
+    std::ofstream out(file);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write >" << file << "<\n";
+        return false;
+    }
+    out << j.dump(2) << "\n";
+    return out.good();
+}
+
+void CameraPath::makeOrbit(const glm::vec3& center, float radius, float height, float period, int keyCount) {
+    keys.clear();
+    const glm::vec3 target = center + glm::vec3(0.0f, 2.0f, 0.0f);
+    for (int k = 0; k < keyCount; k++) {
+        const float angle = 6.2831853f * k / keyCount;
+        const float r = (k % 2 == 0) ? radius : radius * 0.5f;
+        const glm::vec3 eye = center + glm::vec3(r * std::cos(angle), height, r * std::sin(angle));
+        addKey(period * k / keyCount, eye, target);
+    }
+}
+
+void CameraPath::addKey(float time, const glm::vec3& eye, const glm::vec3& target) {
+    keys.push_back({time, eye, target});
+}
+
+float CameraPath::getDuration() const {
+    if (keys.size() < 2) return 0.0f;
+    const float span = keys.back().time - keys.front().time;
+    return span + span / (keys.size() - 1);
+}
+
+void CameraPath::sample(float time, glm::vec3& eye, glm::vec3& target) const {
+    if (keys.empty()) return;
+    if (keys.size() == 1) {
+        eye = keys[0].eye;
+        target = keys[0].target;
+        return;
+    }
+    const int n = static_cast<int>(keys.size());
+    const float duration = getDuration();
+    float t = std::fmod(time, duration);
+    if (t < 0.0f) t += duration;
+    t += keys.front().time;
+
+    // Segment [i, i + 1], the last one going back to the first key
+    int i = n - 1;
+    for (int k = 0; k + 1 < n; k++) {
+        if (t < keys[k + 1].time) {
+            i = k;
+            break;
+        }
+    }
+    const float t0 = keys[i].time;
+    const float t1 = (i + 1 < n) ? keys[i + 1].time : keys.front().time + duration;
+    const float u = (t1 > t0) ? glm::clamp((t - t0) / (t1 - t0), 0.0f, 1.0f) : 0.0f;
+    auto at = [&](int k) -> const Key& { return keys[((k % n) + n) % n]; };
+    eye = catmullRom(at(i - 1).eye, at(i).eye, at(i + 1).eye, at(i + 2).eye, u);
+    target = catmullRom(at(i - 1).target, at(i).target, at(i + 1).target, at(i + 2).target, u);
+}
+
+// ---------- BenchmarkRecorder ----------
+
+BenchmarkRecorder::BenchmarkRecorder(const BenchmarkOptions& options)
+    : options(options), lastFrame(Clock::now()), measureStart(lastFrame) {
+    frameMs.reserve(options.frames);
+}
+
+bool BenchmarkRecorder::frame() {
+    const Clock::time_point now = Clock::now();
+    if (frameIndex >= options.warmupFrames && !isDone()) {
+        frameMs.push_back(std::chrono::duration<double, std::milli>(now - lastFrame).count());
+    }
+    lastFrame = now;
+    frameIndex++;
+    if (frameIndex == options.warmupFrames) {
+        // Measuring starts: the profiler totals cover the same frames as the frame times
+        measureStart = now;
+#ifdef ENABLE_PROFILER
+        Profiler::get().resetTotals();
+#endif
+    }
+    return isDone();
+}
+
+int BenchmarkRecorder::writeReport(const std::string& mode) const {
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double ms : sorted) total += ms;
+    const double mean = sorted.empty() ? 0.0 : total / sorted.size();
+
+    nlohmann::json j;
+    j["benchmark"] = "village";
+    j["mode"] = mode;
+    j["frames"] = sorted.size();
+    j["warmup_frames"] = options.warmupFrames;
+    j["time_step"] = options.timeStep;
+    j["camera_path"] = options.cameraPath.empty() ? "orbit" : options.cameraPath;
+    if (options.mode == BenchmarkOptions::OFFSCREEN) {
+        j["resolution"] = {options.width, options.height};
+    }
+    j["elapsed_s"] = std::chrono::duration<double>(lastFrame - measureStart).count();
+    j["frame_ms"] = {
+        {"mean", mean},
+        {"min", sorted.empty() ? 0.0 : sorted.front()},
+        {"p50", percentile(sorted, 0.50)},
+        {"p90", percentile(sorted, 0.90)},
+        {"p95", percentile(sorted, 0.95)},
+        {"p99", percentile(sorted, 0.99)},
+        {"max", sorted.empty() ? 0.0 : sorted.back()}
+    };
+    j["fps_mean"] = mean > 0.0 ? 1000.0 / mean : 0.0;
+
+#ifdef ENABLE_PROFILER
+    nlohmann::json profile = nlohmann::json::array();
+    for (const Profiler::ScopeTotal& scope : Profiler::get().totals()) {
+        profile.push_back({{"scope", scope.name}, {"mean_ms", scope.meanMs}, {"worst_ms", scope.worstMs},
+                           {"calls_per_frame", scope.callsPerFrame}});
+    }
+    j["profile"] = profile;
+#else
+    j["profile"] = nullptr;     // built without ENABLE_PROFILER
+#endif
+    for (const auto& kv : info.items()) j[kv.key()] = kv.value();
+
+    std::ofstream out(options.outFile);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write >" << options.outFile << "<\n";
+        return -1;
+    }
+    out << j.dump(2) << "\n";
+    std::cout << "Benchmark: " << sorted.size() << " frames, p50 " << percentile(sorted, 0.50) << " ms, p99 "
+              << percentile(sorted, 0.99) << " ms, report written to " << options.outFile << "\n";
+    return out.good() ? 0 : -1;
+}
+
+// ---------- Simulation only ----------
+
+int runSimulationBenchmark(const BenchmarkOptions& options, const std::string& sceneFile, bool flyMode) {
+    PROFILE_THREAD("main");
+    std::ifstream ifs(sceneFile);
+    if (!ifs.is_open()) {
+        std::cout << "Error! Scene file >" << sceneFile << "< not found!\n";
+        return -1;
+    }
+    nlohmann::json sceneJson;
+    try {
+        ifs >> sceneJson;
+    } catch (const nlohmann::json::exception& e) {
+        std::cout << "Error! Invalid scene file >" << sceneFile << "<: " << e.what() << "\n";
+        return -1;
+    }
+
+    CameraPath path;
+    if (options.cameraPath.empty()) {
+        path.makeOrbit(glm::vec3(10.0f, 0.0f, 0.0f), 45.0f, 18.0f, 40.0f);
+    } else if (path.load(options.cameraPath) != 0) {
+        return -1;
+    }
+
+    // Physics inline (no physics thread), so that its whole cost is in the frame
+    PhysicsManager physics;
+    if (!physics.initialize(flyMode, sceneFile)) {
+        return -1;
+    }
+    physics.addCapsulePlayer();
+    std::cout << "Simulation benchmark: " << physics.getNumRigidBodies() << " rigid bodies "
+              << "(static meshes only from the physics cache of the scene)\n";
+
+    std::vector<AssetFile*> assets = loadAnimationAssets(sceneJson);
+    CharManager charManager;
+    AnimationSystem animSystem;
+    if (charManager.init(sceneFile, assets.data(), {}) != 0) {
+        std::cout << "Error! Cannot load the characters\n";
+        charManager.cleanup();
+        physics.cleanup();
+        freeAnimationAssets(assets);
+        return -1;
+    }
+    animSystem.init();
+
+    BenchmarkRecorder recorder(options);
+    const float dt = options.timeStep;
+    do {
+        PROFILE_FRAME();
+        PROFILE_SCOPE("simulationFrame");
+        // The player walks towards the point of the path below the camera
+        glm::vec3 eye, target;
+        path.sample(recorder.getTime(), eye, target);
+        glm::vec3 toEye = eye - physics.getPlayerPosition();
+        toEye.y = 0.0f;
+        const float distance = glm::length(toEye);
+        physics.movePlayer(distance > 0.5f ? toEye / distance * PlayerConfig::moveSpeed : glm::vec3(0.0f),
+                           false);
+        physics.update(dt);
+
+        charManager.update();
+        animSystem.evaluate(charManager.getCharacters(), dt);
+    } while (!recorder.frame());
+
+    recorder.addInfo("rigid_bodies", physics.getNumRigidBodies());
+    recorder.addInfo("characters", charManager.getCharacters().size());
+    const int status = recorder.writeReport("sim-only");
+
+    animSystem.cleanup();
+    charManager.cleanup();
+    physics.cleanup();
+    freeAnimationAssets(assets);
+    return status;
+}
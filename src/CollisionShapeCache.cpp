@@ -0,0 +1,725 @@
+#include "CollisionShapeCache.hpp"
+#include <BulletCollision/CollisionShapes/btShapeHull.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_set>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Scales closer than this are considered equal (and 1 is considered no scale)
+static const float SCALE_EPSILON = 1e-4f;
+
+namespace {
+    // Exact position, compared bitwise: welding only merges vertices duplicated by the other attributes
+    struct PositionKey {
+        uint32_t bits[3];
+        bool operator==(const PositionKey& o) const {
+            return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2];
+        }
+    };
+    struct PositionKeyHash {
+        size_t operator()(const PositionKey& k) const {
+            size_t h = k.bits[0];
+            h = h * 0x9E3779B1u ^ k.bits[1];
+            h = h * 0x9E3779B1u ^ k.bits[2];
+            return h;
+        }
+    };
+
+    bool sameScale(const glm::vec3& a, const glm::vec3& b) {
+        return glm::all(glm::lessThan(glm::abs(a - b), glm::vec3(SCALE_EPSILON)));
+    }
+
+    struct TriangleKeyHash {
+        size_t operator()(const std::array<int, 3>& t) const {
+            size_t h = static_cast<size_t>(t[0]);
+            h = h * 0x9E3779B1u ^ static_cast<size_t>(t[1]);
+            h = h * 0x9E3779B1u ^ static_cast<size_t>(t[2]);
+            return h;
+        }
+    };
+
+    /*
+     * Keeps the triangles with an area: not collapsed to an edge or a point (by index or by position),
+     * and not repeating a triangle already kept (same vertices, in any order or winding).
+     */
+    std::vector<int> dropDegenerateTriangles(const std::vector<btScalar>& vertices, const std::vector<int>& triangles) {
+        std::vector<int> kept;
+        kept.reserve(triangles.size());
+        std::unordered_set<std::array<int, 3>, TriangleKeyHash> seen;
+        seen.reserve(triangles.size() / 3);
+        for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+            const int a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+            if (a == b || b == c || a == c) continue;
+            const btVector3 pa(vertices[3 * a], vertices[3 * a + 1], vertices[3 * a + 2]);
+            const btVector3 pb(vertices[3 * b], vertices[3 * b + 1], vertices[3 * b + 2]);
+            const btVector3 pc(vertices[3 * c], vertices[3 * c + 1], vertices[3 * c + 2]);
+            if ((pb - pa).cross(pc - pa).length2() < 1e-12f) continue;
+            std::array<int, 3> key = {a, b, c};
+            std::sort(key.begin(), key.end());
+            if (!seen.insert(key).second) continue;
+            kept.push_back(a);
+            kept.push_back(b);
+            kept.push_back(c);
+        }
+        return kept;
+    }
+
+    /*
+     * Vertex clustering: all the vertices within the same grid cell become the first of them, then the
+     * triangles collapsed by the merge are dropped and the unused vertices removed. Details smaller than a
+     * cell (bevels, trims, carvings) disappear, while the shape at gameplay scale is kept.
+     */
+    void simplifyMesh(std::vector<btScalar>& vertices, std::vector<int>& indices, float cellSize) {
+        const size_t count = vertices.size() / 3;
+        std::vector<int> remap(count);
+        std::unordered_map<PositionKey, int, PositionKeyHash> cells;
+        cells.reserve(count);
+        for (size_t v = 0; v < count; v++) {
+            PositionKey key;
+            for (int k = 0; k < 3; k++) {
+                key.bits[k] = static_cast<uint32_t>(static_cast<int32_t>(std::floor(vertices[3 * v + k] / cellSize)));
+            }
+            remap[v] = cells.emplace(key, static_cast<int>(v)).first->second;
+        }
+        for (int& i : indices) i = remap[i];
+        indices = dropDegenerateTriangles(vertices, indices);
+
+        // Compaction
+        std::vector<int> newIndex(count, -1);
+        std::vector<btScalar> kept;
+        for (int& i : indices) {
+            if (newIndex[i] < 0) {
+                newIndex[i] = static_cast<int>(kept.size() / 3);
+                kept.insert(kept.end(), vertices.begin() + 3 * i, vertices.begin() + 3 * i + 3);
+            }
+            i = newIndex[i];
+        }
+        vertices.swap(kept);
+    }
+
+    /*
+     * ProxyAuto: nothing for small details, a primitive or a hull for props, a mesh for larger models.
+     */
+    CollisionShapeCache::ProxyType chooseProxy(const CollisionShapeCache::ProxyConfig& config,
+                                               const std::vector<btScalar>& vertices,
+                                               const glm::vec3& bMin, const glm::vec3& bMax) {
+        const glm::vec3 extent = bMax - bMin;
+        const float size = std::max(extent.x, std::max(extent.y, extent.z));
+        if (size < config.minExtent) return CollisionShapeCache::ProxyNone;
+        if (size > config.convexExtent) return CollisionShapeCache::ProxyMesh;
+
+        if (extent.y >= config.capsuleAspect * std::max(extent.x, extent.z)) return CollisionShapeCache::ProxyCapsule;
+        // A box, if no vertex is far from the faces of the bounds (crates, planks, blocks)
+        const float tolerance = config.boxTolerance * size;
+        for (size_t v = 0; v < vertices.size(); v += 3) {
+            const glm::vec3 p(vertices[v], vertices[v + 1], vertices[v + 2]);
+            const glm::vec3 d = glm::min(p - bMin, bMax - p);
+            if (std::min(d.x, std::min(d.y, d.z)) > tolerance) return CollisionShapeCache::ProxyHull;
+        }
+        return CollisionShapeCache::ProxyBox;
+    }
+}
+
+bool CollisionShapeCache::parseProxyType(const std::string& name, ProxyType& type) {
+    if (name == "auto") type = ProxyAuto;
+    else if (name == "none") type = ProxyNone;
+    else if (name == "box") type = ProxyBox;
+    else if (name == "capsule") type = ProxyCapsule;
+    else if (name == "hull") type = ProxyHull;
+    else if (name == "mesh") type = ProxyMesh;
+    else if (name == "full") type = ProxyFull;
+    else return false;
+    return true;
+}
+
+const char* CollisionShapeCache::proxyTypeName(ProxyType type) {
+    switch (type) {
+        case ProxyAuto: return "auto";
+        case ProxyNone: return "none";
+        case ProxyBox: return "box";
+        case ProxyCapsule: return "capsule";
+        case ProxyHull: return "hull";
+        case ProxyMesh: return "mesh";
+        case ProxyFull: return "full";
+    }
+    return "?";
+}
+
+btCollisionShape* CollisionShapeCache::getShape(int Mid, const Model* model, const glm::vec3& scale) {
+    stats.requests++;
+
+    auto it = entries.find(Mid);
+    MeshEntry* entry;
+    if (it == entries.end()) {
+        if (model == nullptr) return nullptr;
+        entry = buildEntry(Mid, model);
+        entries[Mid].reset(entry);
+    } else {
+        entry = it->second.get();
+    }
+    if (entry == nullptr) return nullptr;
+    stats.instanceTriangles += entry->numTriangles;
+
+    if (sameScale(scale, glm::vec3(1.0f))) {
+        return entry->shape ? static_cast<btCollisionShape*>(entry->shape.get()) : entry->proxyShape.get();
+    }
+    for (auto& s : entry->scaled) {
+        if (sameScale(s.first, scale)) return s.second.get();
+    }
+    std::unique_ptr<btCollisionShape> shape;
+    if (entry->shape) {
+        shape = std::make_unique<btScaledBvhTriangleMeshShape>(entry->shape.get(), btVector3(scale.x, scale.y, scale.z));
+    } else {
+        shape.reset(createProxyShape(entry, scale));
+    }
+    entry->scaled.emplace_back(scale, std::move(shape));
+    stats.scaledShapes++;
+    return entry->scaled.back().second.get();
+}
+
+btCollisionShape* CollisionShapeCache::createProxyShape(MeshEntry* entry, const glm::vec3& scale) {
+    const glm::vec3 absScale = glm::abs(scale);
+    const glm::vec3 half = entry->halfExtents * absScale;
+    btConvexShape* convex = nullptr;
+    switch (entry->type) {
+        case ProxyHull: {
+            // Hull points are in model space: scaled (and mirrored) as they are, without an offset
+            auto* hull = new btConvexHullShape();
+            for (int v = 0; v < entry->numVertices; v++) {
+                const btScalar* p = entry->vertexData + 3 * v;
+                hull->addPoint(btVector3(p[0] * scale.x, p[1] * scale.y, p[2] * scale.z), false);
+            }
+            hull->recalcLocalAabb();
+            return hull;
+        }
+        case ProxyBox:
+            convex = new btBoxShape(btVector3(half.x, half.y, half.z));
+            break;
+        case ProxyCapsule: {
+            const float radius = std::max(half.x, half.z);
+            convex = new btCapsuleShape(radius, std::max(0.0f, 2.0f * (half.y - radius)));
+            break;
+        }
+        default:
+            return nullptr;
+    }
+
+    // Primitives are centered on their origin: off-center bounds need a compound to move them
+    const glm::vec3 center = entry->center * scale;
+    if (glm::all(glm::lessThan(glm::abs(center), glm::vec3(SCALE_EPSILON)))) {
+        return convex;
+    }
+    entry->parts.emplace_back(convex);
+    auto* compound = new btCompoundShape(false, 1);
+    btTransform offset;
+    offset.setIdentity();
+    offset.setOrigin(btVector3(center.x, center.y, center.z));
+    compound->addChildShape(offset, convex);
+    return compound;
+}
+
+void CollisionShapeCache::createMeshShape(MeshEntry* entry) {
+    entry->mesh = std::make_unique<btTriangleIndexVertexArray>(
+            entry->numTriangles, entry->indexData, 3 * sizeof(int),
+            entry->numVertices, entry->vertexData, 3 * sizeof(btScalar));
+    entry->shape = std::make_unique<btBvhTriangleMeshShape>(entry->mesh.get(), true);
+}
+
+CollisionShapeCache::MeshEntry* CollisionShapeCache::buildEntry(int Mid, const Model* model) {
+    auto start = std::chrono::steady_clock::now();
+
+    const std::vector<unsigned char>& vertices = model->vertices;
+    const std::vector<uint32_t>& indices = model->indices;
+    const uint32_t stride = model->VD->Bindings[0].stride;
+    const uint32_t posOffset = model->VD->Position.offset;
+    const size_t vertexCount = stride > 0 ? vertices.size() / stride : 0;
+    const size_t triangleCount = indices.size() / 3;
+    if (vertexCount == 0 || triangleCount == 0) {
+        std::cout << "Collision shape skipped: model has no triangles\n";
+        return nullptr;
+    }
+    stats.sourceTriangles += triangleCount;
+
+    auto entry = std::make_unique<MeshEntry>();
+    entry->sourceTriangles = static_cast<int>(triangleCount);
+
+    // Welding: remap every source vertex to the first one with the same position
+    std::vector<int> remap(vertexCount);
+    std::unordered_map<PositionKey, int, PositionKeyHash> unique;
+    unique.reserve(vertexCount);
+    entry->vertices.reserve(vertexCount * 3);
+    for (size_t v = 0; v < vertexCount; v++) {
+        float p[3];
+        std::memcpy(p, &vertices[v * stride + posOffset], sizeof(p));
+        PositionKey key;
+        std::memcpy(key.bits, p, sizeof(key.bits));
+        auto res = unique.emplace(key, static_cast<int>(entry->vertices.size() / 3));
+        if (res.second) {
+            entry->vertices.push_back(p[0]);
+            entry->vertices.push_back(p[1]);
+            entry->vertices.push_back(p[2]);
+        }
+        remap[v] = res.first->second;
+    }
+
+    std::vector<int> triangles;
+    triangles.reserve(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangles.push_back(remap[indices[3 * t]]);
+        triangles.push_back(remap[indices[3 * t + 1]]);
+        triangles.push_back(remap[indices[3 * t + 2]]);
+    }
+    entry->indices = dropDegenerateTriangles(entry->vertices, triangles);
+    if (entry->indices.empty()) {
+        std::cout << "Collision shape skipped: model has only degenerate triangles\n";
+        stats.removedTriangles += triangleCount;
+        return nullptr;
+    }
+
+    // Bounds of the welded vertices
+    glm::vec3 bMin(std::numeric_limits<float>::max()), bMax(-std::numeric_limits<float>::max());
+    for (size_t v = 0; v < entry->vertices.size(); v += 3) {
+        const glm::vec3 p(entry->vertices[v], entry->vertices[v + 1], entry->vertices[v + 2]);
+        bMin = glm::min(bMin, p);
+        bMax = glm::max(bMax, p);
+    }
+    entry->center = 0.5f * (bMin + bMax);
+    entry->halfExtents = glm::max(0.5f * (bMax - bMin), glm::vec3(0.01f));
+
+    auto overrideIt = proxyOverrides.find(Mid);
+    ProxyType type = overrideIt != proxyOverrides.end() ? overrideIt->second : ProxyAuto;
+    if (type == ProxyAuto) {
+        type = chooseProxy(proxyConfig, entry->vertices, bMin, bMax);
+    }
+    entry->type = type;
+
+    switch (type) {
+        case ProxyNone:
+            stats.droppedModels++;
+            stats.removedTriangles += triangleCount;
+            reports.push_back({Mid, type, static_cast<int>(triangleCount), 0});
+            return nullptr;
+
+        case ProxyHull: {
+            // btShapeHull samples the support of the full hull in 42 directions
+            btConvexHullShape source(entry->vertices.data(), static_cast<int>(entry->vertices.size() / 3), 3 * sizeof(btScalar));
+            btShapeHull reduced(&source);
+            reduced.buildHull(source.getMargin());
+            entry->vertices.clear();
+            for (int v = 0; v < reduced.numVertices(); v++) {
+                const btVector3& p = reduced.getVertexPointer()[v];
+                entry->vertices.push_back(p.x());
+                entry->vertices.push_back(p.y());
+                entry->vertices.push_back(p.z());
+            }
+            entry->indices.clear();
+            break;
+        }
+        case ProxyBox:
+        case ProxyCapsule:
+            entry->vertices.clear();
+            entry->indices.clear();
+            break;
+
+        case ProxyMesh:
+            if (proxyConfig.meshCellSize > 0.0f && static_cast<int>(entry->indices.size() / 3) > proxyConfig.simplifyMinTriangles) {
+                simplifyMesh(entry->vertices, entry->indices, proxyConfig.meshCellSize);
+                stats.simplifiedMeshes++;
+            } else {
+                entry->type = ProxyFull;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    entry->numTriangles = static_cast<int>(entry->indices.size() / 3);
+    entry->numVertices = static_cast<int>(entry->vertices.size() / 3);
+    entry->vertexData = entry->vertices.data();
+    entry->indexData = entry->indices.data();
+    stats.sourceVertices += vertexCount;
+    stats.removedTriangles += triangleCount - entry->numTriangles;
+    reports.push_back({Mid, entry->type, static_cast<int>(triangleCount), entry->numTriangles});
+
+    if (entry->numTriangles > 0) {
+        createMeshShape(entry.get());
+        size_t bvhBytes = entry->shape->getOptimizedBvh()->calculateSerializeBufferSize();
+        stats.meshes++;
+        stats.weldedVertices += entry->numVertices;
+        stats.triangles += entry->numTriangles;
+        stats.bvhBytes += bvhBytes;
+        stats.bytes += entry->vertices.size() * sizeof(btScalar) + entry->indices.size() * sizeof(int) + bvhBytes;
+    } else {
+        entry->proxyShape.reset(createProxyShape(entry.get(), glm::vec3(1.0f)));
+        stats.convexProxies++;
+        stats.bytes += entry->vertices.size() * sizeof(btScalar);
+    }
+    stats.buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return entry.release();
+}
+
+void CollisionShapeCache::clear() {
+    // Shapes first: loaded ones point into the baked data
+    entries.clear();
+    releaseBaked();
+    stats = Stats();
+    reports.clear();
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// Baked world file.
+// Layout: FileHeader, MeshRecord table, BodyRecord table, then the data blocks referenced by the mesh
+// records (vertices, indices and serialized BVH of each mesh; hull points of the hull proxies), each one
+// starting at a 16 bytes aligned offset as required by btQuantizedBvh::deSerializeInPlace().
+// Native endianness: the file is a local cache.
+
+namespace {
+    const char BAKED_MAGIC[8] = {'C', 'G', 'P', 'H', 'Y', 'S', '0', '1'};
+    const uint32_t BAKED_VERSION = 3;     // 2: terrain excluded (it becomes a heightfield), 3: collision proxies
+
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t scalarSize;        // sizeof(btScalar): float and double builds of Bullet are not compatible
+        uint64_t hash;
+        uint32_t meshCount;
+        uint32_t bodyCount;
+    };
+
+    struct MeshRecord {
+        int32_t Mid;
+        int32_t type;               // CollisionShapeCache::ProxyType
+        int32_t sourceTriangles;
+        int32_t numVertices;        // of the mesh, or hull points
+        int32_t numTriangles;
+        uint32_t bvhSize;
+        uint64_t verticesOffset;
+        uint64_t indicesOffset;
+        uint64_t bvhOffset;
+        float aabbMin[3];
+        float aabbMax[3];
+        float center[3];            // bounds of the model, for box and capsule proxies
+        float halfExtents[3];
+    };
+
+    uint64_t alignTo16(uint64_t offset) {
+        return (offset + 15) & ~static_cast<uint64_t>(15);
+    }
+
+    // Whether [offset, offset + size) lies within a file of fileSize bytes
+    bool inFile(uint64_t offset, uint64_t size, size_t fileSize) {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+
+    /*
+     * Checks a mesh record of a baked file before anything reads its data: type and counts, the ranges and
+     * alignment of its arrays within the file, and that every index refers to one of its vertices.
+     */
+    bool validMeshRecord(const MeshRecord& r, const char* base, size_t fileSize) {
+        if (r.type < CollisionShapeCache::ProxyAuto || r.type > CollisionShapeCache::ProxyFull ||
+            r.numVertices < 0 || r.numTriangles < 0 || r.sourceTriangles < r.numTriangles) {
+            return false;
+        }
+        const uint64_t vertexBytes = static_cast<uint64_t>(r.numVertices) * 3 * sizeof(btScalar);
+        const uint64_t indexBytes = static_cast<uint64_t>(r.numTriangles) * 3 * sizeof(int);
+        if (r.verticesOffset % 16 != 0 || r.indicesOffset % 16 != 0 || r.bvhOffset % 16 != 0 ||
+            !inFile(r.verticesOffset, vertexBytes, fileSize) || !inFile(r.indicesOffset, indexBytes, fileSize)) {
+            return false;
+        }
+        if (r.numTriangles > 0 && (r.bvhSize < sizeof(btOptimizedBvh) || !inFile(r.bvhOffset, r.bvhSize, fileSize))) {
+            return false;
+        }
+        const int* indices = reinterpret_cast<const int*>(base + r.indicesOffset);
+        const size_t indexCount = static_cast<size_t>(r.numTriangles) * 3;
+        for (size_t i = 0; i < indexCount; i++) {
+            if (indices[i] < 0 || indices[i] >= r.numVertices) return false;
+        }
+        return true;
+    }
+
+    /*
+     * Checks a BVH deserialized in place, whose nodes Bullet trusts while traversing it: every leaf must
+     * refer to a triangle of the mesh, every escape index and subtree must stay within the nodes.
+     */
+    bool validBvh(btOptimizedBvh* bvh, int numTriangles) {
+        if (!bvh->isQuantized()) return false;
+        QuantizedNodeArray& nodes = bvh->getQuantizedNodeArray();
+        const int count = nodes.size();
+        for (int i = 0; i < count; i++) {
+            const btQuantizedBvhNode& node = nodes[i];
+            if (node.isLeafNode()) {
+                if (node.getPartId() != 0 || node.getTriangleIndex() >= numTriangles) return false;
+            } else if (node.getEscapeIndex() <= 0 || node.getEscapeIndex() > count - i) {
+                return false;
+            }
+        }
+        BvhSubtreeInfoArray& subtrees = bvh->getSubtreeInfoArray();
+        for (int i = 0; i < subtrees.size(); i++) {
+            const btBvhSubtreeInfo& subtree = subtrees[i];
+            if (subtree.m_rootNodeIndex < 0 || subtree.m_subtreeSize < 0 ||
+                subtree.m_subtreeSize > count - subtree.m_rootNodeIndex) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool CollisionShapeCache::save(const std::string& file, uint64_t hash, const std::vector<BodyRecord>& bodies) const {
+    std::vector<MeshRecord> meshes;
+    std::vector<const MeshEntry*> meshEntries;
+    for (const auto& kv : entries) {
+        if (kv.second == nullptr) continue;
+        const MeshEntry* e = kv.second.get();
+        MeshRecord r{};
+        r.Mid = kv.first;
+        r.type = e->type;
+        r.sourceTriangles = e->sourceTriangles;
+        r.numVertices = e->numVertices;
+        r.numTriangles = e->numTriangles;
+        for (int k = 0; k < 3; k++) {
+            r.center[k] = e->center[k];
+            r.halfExtents[k] = e->halfExtents[k];
+        }
+        if (e->shape) {
+            r.bvhSize = e->shape->getOptimizedBvh()->calculateSerializeBufferSize();
+            // Bounds the BVH was quantized with, needed to recreate the shape without building it
+            const btVector3& aabbMin = e->shape->getLocalAabbMin();
+            const btVector3& aabbMax = e->shape->getLocalAabbMax();
+            for (int k = 0; k < 3; k++) {
+                r.aabbMin[k] = static_cast<float>(aabbMin[k]);
+                r.aabbMax[k] = static_cast<float>(aabbMax[k]);
+            }
+        }
+        meshes.push_back(r);
+        meshEntries.push_back(kv.second.get());
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, BAKED_MAGIC, sizeof(BAKED_MAGIC));
+    header.version = BAKED_VERSION;
+    header.scalarSize = sizeof(btScalar);
+    header.hash = hash;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.bodyCount = static_cast<uint32_t>(bodies.size());
+
+    uint64_t offset = sizeof(FileHeader) + meshes.size() * sizeof(MeshRecord) + bodies.size() * sizeof(BodyRecord);
+    for (MeshRecord& r : meshes) {
+        r.verticesOffset = offset = alignTo16(offset);
+        offset += static_cast<uint64_t>(r.numVertices) * 3 * sizeof(btScalar);
+        r.indicesOffset = offset = alignTo16(offset);
+        offset += static_cast<uint64_t>(r.numTriangles) * 3 * sizeof(int);
+        r.bvhOffset = offset = alignTo16(offset);
+        offset += r.bvhSize;
+    }
+
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write the collision world cache >" << file << "<\n";
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(meshes.data()), meshes.size() * sizeof(MeshRecord));
+    out.write(reinterpret_cast<const char*>(bodies.data()), bodies.size() * sizeof(BodyRecord));
+
+    auto padTo = [&out](uint64_t target) {
+        static const char zeros[16] = {};
+        uint64_t pos = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<std::streamsize>(target - pos));
+    };
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const MeshRecord& r = meshes[m];
+        const MeshEntry* e = meshEntries[m];
+        padTo(r.verticesOffset);
+        out.write(reinterpret_cast<const char*>(e->vertexData), static_cast<std::streamsize>(r.numVertices) * 3 * sizeof(btScalar));
+        padTo(r.indicesOffset);
+        out.write(reinterpret_cast<const char*>(e->indexData), static_cast<std::streamsize>(r.numTriangles) * 3 * sizeof(int));
+        if (r.bvhSize == 0) continue;
+
+        // serializeInPlace() writes into an aligned buffer, which is then copied to the file
+        void* bvhBuffer = btAlignedAlloc(r.bvhSize, 16);
+        e->shape->getOptimizedBvh()->serializeInPlace(bvhBuffer, r.bvhSize, false);
+        padTo(r.bvhOffset);
+        out.write(static_cast<const char*>(bvhBuffer), r.bvhSize);
+        btAlignedFree(bvhBuffer);
+    }
+    if (!out.good()) {
+        std::cout << "Error! Failed writing the collision world cache >" << file << "<\n";
+        return false;
+    }
+    std::cout << "Collision world baked into " << file << " (" << offset / 1024 << " KB)\n";
+    return true;
+}
+
+bool CollisionShapeCache::load(const std::string& file, uint64_t hash, std::vector<BodyRecord>& bodies) {
+    clear();
+    auto start = std::chrono::steady_clock::now();
+
+#ifndef _WIN32
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+        close(fd);
+        return false;
+    }
+    bakedSize = static_cast<size_t>(st.st_size);
+    // Private writable mapping: deSerializeInPlace() fixes up the pointers of the BVHs in place (copy on write)
+    baked = mmap(nullptr, bakedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (baked == MAP_FAILED) {
+        baked = nullptr;
+        bakedSize = 0;
+        return false;
+    }
+    bakedMapped = true;
+#else
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    bakedSize = static_cast<size_t>(in.tellg());
+    if (bakedSize < sizeof(FileHeader)) {
+        bakedSize = 0;
+        return false;
+    }
+    baked = btAlignedAlloc(bakedSize, 16);
+    in.seekg(0);
+    in.read(static_cast<char*>(baked), static_cast<std::streamsize>(bakedSize));
+    bakedMapped = false;
+#endif
+
+    char* base = static_cast<char*>(baked);
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+    size_t tablesEnd = sizeof(FileHeader) + header->meshCount * sizeof(MeshRecord) + header->bodyCount * sizeof(BodyRecord);
+    if (std::memcmp(header->magic, BAKED_MAGIC, sizeof(BAKED_MAGIC)) != 0 || header->version != BAKED_VERSION ||
+        header->scalarSize != sizeof(btScalar) || header->hash != hash || tablesEnd > bakedSize) {
+        releaseBaked();
+        return false;
+    }
+
+    const MeshRecord* meshes = reinterpret_cast<const MeshRecord*>(base + sizeof(FileHeader));
+    const BodyRecord* bodyTable = reinterpret_cast<const BodyRecord*>(meshes + header->meshCount);
+    // The whole file is checked before Bullet reads any of it: a damaged cache is rebuilt, not trusted
+    for (uint32_t m = 0; m < header->meshCount; m++) {
+        if (!validMeshRecord(meshes[m], base, bakedSize)) {
+            std::cout << "Collision world cache >" << file << "< is damaged (mesh " << m << ")\n";
+            releaseBaked();
+            return false;
+        }
+    }
+    for (uint32_t m = 0; m < header->meshCount; m++) {
+        const MeshRecord& r = meshes[m];
+        auto entry = std::make_unique<MeshEntry>();
+        entry->type = static_cast<ProxyType>(r.type);
+        entry->sourceTriangles = r.sourceTriangles;
+        entry->vertexData = reinterpret_cast<btScalar*>(base + r.verticesOffset);
+        entry->indexData = reinterpret_cast<int*>(base + r.indicesOffset);
+        entry->numVertices = r.numVertices;
+        entry->numTriangles = r.numTriangles;
+        entry->center = glm::vec3(r.center[0], r.center[1], r.center[2]);
+        entry->halfExtents = glm::vec3(r.halfExtents[0], r.halfExtents[1], r.halfExtents[2]);
+        stats.sourceTriangles += r.sourceTriangles;
+        stats.removedTriangles += r.sourceTriangles - r.numTriangles;
+        reports.push_back({r.Mid, entry->type, r.sourceTriangles, r.numTriangles});
+        if (entry->numTriangles == 0) {
+            // Convex proxy: rebuilt from its few parameters (hull points are read in place)
+            entry->proxyShape.reset(createProxyShape(entry.get(), glm::vec3(1.0f)));
+            stats.convexProxies++;
+            stats.bytes += static_cast<size_t>(r.numVertices) * 3 * sizeof(btScalar);
+            entries[r.Mid] = std::move(entry);
+            continue;
+        }
+        if (entry->type == ProxyMesh) stats.simplifiedMeshes++;
+        entry->mesh = std::make_unique<btTriangleIndexVertexArray>(
+                r.numTriangles, entry->indexData, 3 * sizeof(int),
+                r.numVertices, entry->vertexData, 3 * sizeof(btScalar));
+
+        // The BVH is used where it lies in the baked data, without building it
+        btVector3 aabbMin(r.aabbMin[0], r.aabbMin[1], r.aabbMin[2]);
+        btVector3 aabbMax(r.aabbMax[0], r.aabbMax[1], r.aabbMax[2]);
+        entry->shape = std::make_unique<btBvhTriangleMeshShape>(entry->mesh.get(), true, aabbMin, aabbMax, false);
+        btOptimizedBvh* bvh = static_cast<btOptimizedBvh*>(btOptimizedBvh::deSerializeInPlace(base + r.bvhOffset, r.bvhSize, false));
+        if (bvh == nullptr || !validBvh(bvh, r.numTriangles)) {
+            std::cout << "Collision world cache >" << file << "< has an invalid BVH\n";
+            entry.reset();
+            clear();
+            return false;
+        }
+        entry->shape->setOptimizedBvh(bvh);
+
+        stats.meshes++;
+        stats.weldedVertices += r.numVertices;
+        stats.triangles += r.numTriangles;
+        stats.bvhBytes += r.bvhSize;
+        stats.bytes += static_cast<size_t>(r.numVertices) * 3 * sizeof(btScalar) + static_cast<size_t>(r.numTriangles) * 3 * sizeof(int) + r.bvhSize;
+        entries[r.Mid] = std::move(entry);
+    }
+    bodies.assign(bodyTable, bodyTable + header->bodyCount);
+
+    stats.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Collision world loaded from " << file << ": " << stats.meshes << " meshes, "
+              << stats.convexProxies << " convex proxies, " << bodies.size()
+              << " bodies in " << stats.loadMs << " ms\n";
+    return true;
+}
+
+void CollisionShapeCache::releaseBaked() {
+    if (baked == nullptr) return;
+#ifndef _WIN32
+    if (bakedMapped) {
+        munmap(baked, bakedSize);
+    } else {
+        btAlignedFree(baked);
+    }
+#else
+    btAlignedFree(baked);
+#endif
+    baked = nullptr;
+    bakedSize = 0;
+    bakedMapped = false;
+}
+
+void CollisionShapeCache::printReport() const {
+    if (stats.meshes == 0 && stats.convexProxies == 0) return;
+    // Per-instance soups: a btTriangleMesh keeps 3 padded vertices (4 floats) and 3 indices per triangle,
+    // and each instance builds its own BVH, of about the same size per triangle as the shared ones
+    const double bvhPerTriangle = stats.triangles > 0 ? static_cast<double>(stats.bvhBytes) / stats.triangles : 0.0;
+    const double soupBytes = stats.instanceTriangles * (3 * 4 * sizeof(float) + 3 * sizeof(int) + bvhPerTriangle);
+    const double soupBuildMs = stats.triangles > 0 ? stats.buildMs * stats.instanceTriangles / stats.triangles : 0.0;
+
+    std::cout << "Static collision shapes: " << stats.requests << " instances, " << stats.meshes << " meshes, "
+              << stats.convexProxies << " convex proxies, " << stats.scaledShapes << " scaled variants\n";
+    std::cout << "\tproxies: " << stats.simplifiedMeshes << " simplified meshes, " << stats.droppedModels
+              << " models without collision; triangles removed: " << stats.removedTriangles << " of "
+              << stats.sourceTriangles << "\n";
+    std::cout << "\tvertices welded: " << stats.sourceVertices << " -> " << stats.weldedVertices
+              << ", triangles built: " << stats.triangles << " (referenced: " << stats.instanceTriangles << ")\n";
+    std::cout << "\tmemory: " << stats.bytes / 1024 << " KB (per-instance soups: ~" << static_cast<size_t>(soupBytes) / 1024 << " KB)\n";
+    std::cout << "\tbuild time: " << stats.buildMs << " ms (per-instance soups: ~" << soupBuildMs << " ms)\n";
+
+    // Models whose proxy removed triangles, most removed first
+    std::vector<ModelReport> sorted;
+    for (const ModelReport& r : reports) {
+        if (r.sourceTriangles > r.triangles) sorted.push_back(r);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const ModelReport& a, const ModelReport& b) {
+        return a.sourceTriangles - a.triangles > b.sourceTriangles - b.triangles;
+    });
+    for (const ModelReport& r : sorted) {
+        auto name = modelNames.find(r.Mid);
+        std::cout << "\t\t" << (name != modelNames.end() ? name->second : std::to_string(r.Mid)) << ": "
+                  << proxyTypeName(r.type) << ", " << r.sourceTriangles << " -> " << r.triangles << " triangles\n";
+    }
+}
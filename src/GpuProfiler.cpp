@@ -0,0 +1,98 @@
+#include "GpuProfiler.hpp"
+
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+#include <iostream>
+
+int GpuProfiler::init(VkPhysicalDevice physicalDevice, VkDevice device, int imageCount,
+                      const std::vector<const char*>& regions) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (!properties.limits.timestampComputeAndGraphics || properties.limits.timestampPeriod <= 0.0f) {
+        std::cout << "Error! Timestamp queries not supported: GPU times are not profiled\n";
+        return -1;
+    }
+
+    // Bits of the timestamps written by the graphics queue
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    for (const auto& family : families) {
+        if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if (family.timestampValidBits < 64) validMask = (1ull << family.timestampValidBits) - 1;
+            break;
+        }
+    }
+
+    this->device = device;
+    regionNames = regions;
+    nsPerTick = properties.limits.timestampPeriod;
+    pending.assign(imageCount, false);
+    submitNs.assign(imageCount, 0);
+    results.assign(regions.size() * 2, 0);
+
+    VkQueryPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = static_cast<uint32_t>(imageCount * regions.size() * 2);
+    if (vkCreateQueryPool(device, &info, nullptr, &pool) != VK_SUCCESS) {
+        std::cout << "Error! Cannot create the timestamp query pool\n";
+        pool = VK_NULL_HANDLE;
+        return -1;
+    }
+    return 0;
+}
+
+void GpuProfiler::cleanup() {
+    if (pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, pool, nullptr);
+        pool = VK_NULL_HANDLE;
+    }
+}
+
+void GpuProfiler::reset(VkCommandBuffer commandBuffer, int image) {
+    if (pool == VK_NULL_HANDLE || image >= static_cast<int>(pending.size())) return;
+    vkCmdResetQueryPool(commandBuffer, pool, query(image, 0, 0), static_cast<uint32_t>(regionNames.size() * 2));
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, int image, int region) {
+    if (pool == VK_NULL_HANDLE || image >= static_cast<int>(pending.size())) return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, query(image, region, 0));
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, int image, int region) {
+    if (pool == VK_NULL_HANDLE || image >= static_cast<int>(pending.size())) return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, query(image, region, 1));
+}
+
+void GpuProfiler::collect(int image) {
+    if (pool == VK_NULL_HANDLE || image >= static_cast<int>(pending.size())) return;
+    if (pending[image]) {
+        // Not waiting: results not available yet (VK_NOT_READY) are skipped
+        VkResult result = vkGetQueryPoolResults(device, pool, query(image, 0, 0), static_cast<uint32_t>(results.size()),
+                                                results.size() * sizeof(uint64_t), results.data(), sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS) {
+            // Ticks from the earliest timestamp of the frame, whatever the order of the regions (masked, in case
+            // the counter wrapped around meanwhile)
+            uint64_t first = results[0] & validMask;
+            for (size_t r = 1; r < regionNames.size(); r++) {
+                first = std::min(first, results[2 * r] & validMask);
+            }
+            for (size_t r = 0; r < regionNames.size(); r++) {
+                const uint64_t begin = (results[2 * r] - first) & validMask;
+                const uint64_t end = (results[2 * r + 1] - first) & validMask;
+                Profiler::get().record(regionNames[r],
+                                       submitNs[image] + static_cast<uint64_t>(begin * nsPerTick),
+                                       submitNs[image] + static_cast<uint64_t>(end * nsPerTick), Profiler::Gpu);
+            }
+        }
+    }
+    // The command buffer of the image is submitted again in this frame
+    pending[image] = true;
+    submitNs[image] = Profiler::nowNs();
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "GroundProbe.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Radius of the swept sphere, relative to the capsule radius
+static const float FOOT_SHRINK = 0.9f;
+
+namespace {
+    // Collects the collision objects overlapping an aabb, except the probing one
+    struct CandidateCollector : public btBroadphaseAabbCallback {
+        const btCollisionObject* self;
+        std::vector<btCollisionObject*>& out;
+
+        CandidateCollector(const btCollisionObject* self_, std::vector<btCollisionObject*>& out_) : self(self_), out(out_) {}
+
+        bool process(const btBroadphaseProxy* proxy) override {
+            btCollisionObject* obj = static_cast<btCollisionObject*>(proxy->m_clientObject);
+            if (obj != self && obj->hasContactResponse()) {
+                out.push_back(obj);
+            }
+            return true;
+        }
+    };
+}
+
+void GroundProbe::init(btCollisionWorld* world_, const Config& config_) {
+    world = world_;
+    config = config_;
+    footShape = std::make_unique<btSphereShape>(config.radius * FOOT_SHRINK);
+    candidates.reserve(64);
+    stats = Stats();
+}
+
+btScalar GroundProbe::sweep(const btVector3& from, const btVector3& to, btVector3& hitNormal, btVector3& hitPoint) {
+    btTransform fromTransform, toTransform;
+    fromTransform.setIdentity();
+    fromTransform.setOrigin(from);
+    toTransform.setIdentity();
+    toTransform.setOrigin(to);
+
+    btCollisionWorld::ClosestConvexResultCallback callback(from, to);
+    const btScalar allowedPenetration = world->getDispatchInfo().m_allowedCcdPenetration;
+    for (btCollisionObject* obj : candidates) {
+        btCollisionWorld::objectQuerySingle(footShape.get(), fromTransform, toTransform, obj, obj->getCollisionShape(),
+                                            obj->getWorldTransform(), callback, allowedPenetration);
+        stats.sweeps++;
+    }
+    if (!callback.hasHit()) return 1.0f;
+    hitNormal = callback.m_hitNormalWorld;
+    hitPoint = callback.m_hitPointWorld;
+    return callback.m_closestHitFraction;
+}
+
+GroundProbeResult GroundProbe::probe(const btCollisionObject* self, const btVector3& position, const btVector3& motion) {
+    auto start = std::chrono::steady_clock::now();
+    GroundProbeResult result;
+    if (!world || !footShape) return result;
+    stats.probes++;
+
+    const btVector3 up(0, 1, 0);
+    const btScalar sphereRadius = footShape->getRadius();
+    const btScalar skin = config.radius - sphereRadius;     // gap between the swept sphere and the capsule bottom
+
+    // Ground sweep: from the bottom sphere of the capsule down to the probe distance
+    const btVector3 foot = position - up * config.footOffset;
+    const btVector3 groundTo = foot - up * (skin + config.probeDistance);
+
+    // Step sweep: from one step height above, in front of the capsule, down to the level of its bottom
+    const bool moving = motion.length2() > 1e-6f;
+    btVector3 stepFrom = foot, stepTo = foot;
+    if (moving) {
+        btVector3 ahead = foot + motion.normalized() * config.stepCheckDistance;
+        stepFrom = ahead + up * config.maxStepHeight;
+        stepTo = ahead - up * skin;
+    }
+
+    // A single broadphase query for both sweeps
+    btVector3 aabbMin = foot, aabbMax = foot;
+    for (const btVector3& p : {groundTo, stepFrom, stepTo}) {
+        aabbMin.setMin(p);
+        aabbMax.setMax(p);
+    }
+    const btVector3 extent(sphereRadius, sphereRadius, sphereRadius);
+    candidates.clear();
+    CandidateCollector collector(self, candidates);
+    world->getBroadphase()->aabbTest(aabbMin - extent, aabbMax + extent, collector);
+    stats.broadphaseQueries++;
+    stats.candidates += static_cast<int>(candidates.size());
+
+    if (!candidates.empty()) {
+        btVector3 normal, point;
+        btScalar fraction = sweep(foot, groundTo, normal, point);
+        if (fraction < 1.0f) {
+            result.hit = true;
+            result.normal = glm::vec3(normal.getX(), normal.getY(), normal.getZ());
+            result.point = glm::vec3(point.getX(), point.getY(), point.getZ());
+            result.slopeAngle = std::acos(std::clamp(static_cast<float>(normal.dot(up)), -1.0f, 1.0f));
+            result.distance = std::max(0.0f, static_cast<float>(fraction * (skin + config.probeDistance) - skin));
+            result.walkable = result.slopeAngle <= config.maxSlopeAngle;
+        }
+
+        // A fraction of 0 means the sweep started inside an obstacle higher than a step
+        if (moving && result.walkable) {
+            fraction = sweep(stepFrom, stepTo, normal, point);
+            if (fraction > 0.0f && fraction < 1.0f) {
+                btScalar landing = stepFrom.getY() - fraction * (stepFrom.getY() - stepTo.getY());
+                float height = static_cast<float>(landing - foot.getY() + skin);
+                float slope = std::acos(std::clamp(static_cast<float>(normal.dot(up)), -1.0f, 1.0f));
+                if (height >= config.minStepHeight && height <= config.maxStepHeight && slope <= config.maxSlopeAngle) {
+                    result.step = true;
+                    result.stepHeight = height;
+                }
+            }
+        }
+    }
+
+    stats.totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,236 @@
+#include "InputRecorder.hpp"
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char MAGIC[4] = {'M', 'V', 'I', 'N'};
+
+// Every key the game reads: a bit each in the log (at most 32)
+const int KEYS[] = {
+    GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_Q, GLFW_KEY_E,
+    GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_S, GLFW_KEY_W, GLFW_KEY_R, GLFW_KEY_F,
+    GLFW_KEY_LEFT_SHIFT, GLFW_KEY_SPACE, GLFW_KEY_Z,
+    GLFW_KEY_0, GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_4,
+    GLFW_KEY_5, GLFW_KEY_6, GLFW_KEY_7, GLFW_KEY_8, GLFW_KEY_9,
+};
+constexpr uint32_t KEY_COUNT = sizeof(KEYS) / sizeof(KEYS[0]);
+static_assert(KEY_COUNT <= 32, "The key bits of a frame are a uint32");
+
+int keyIndex(int key) {
+    for (uint32_t k = 0; k < KEY_COUNT; k++) {
+        if (KEYS[k] == key) return static_cast<int>(k);
+    }
+    return -1;
+}
+
+template <typename T>
+void write(std::ofstream& ofs, const T& value) {
+    ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool read(std::ifstream& ifs, T& value) {
+    return static_cast<bool>(ifs.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+}
+
+int InputRecorder::startRecording(const std::string& file) {
+    stop();
+    log.open(file, std::ios::binary);
+    if (!log.is_open()) {
+        std::cout << "Error! Cannot write >" << file << "<\n";
+        return -1;
+    }
+    log.write(MAGIC, sizeof(MAGIC));
+    write(log, VERSION);
+    write(log, KEY_COUNT);
+    for (int key : KEYS) write(log, static_cast<int32_t>(key));
+
+    mode = RECORD;
+    logFile = file;
+    recordedFrames = 0;
+    hasFrame = false;
+    std::cout << "Recording input to " << file << "\n";
+    return 0;
+}
+
+int InputRecorder::startReplay(const std::string& file) {
+    stop();
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) {
+        std::cout << "Error! Input log >" << file << "< not found!\n";
+        return -1;
+    }
+
+    char magic[sizeof(MAGIC)];
+    uint32_t version = 0, keyCount = 0;
+    if (!ifs.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !read(ifs, version) || version != VERSION || !read(ifs, keyCount) || keyCount > 32) {
+        std::cout << "Error! >" << file << "< is not an input log of this version\n";
+        return -1;
+    }
+
+    // Bits of the log to bits of KEYS (a log may have been recorded with another key set)
+    uint32_t bitOf[32];
+    for (uint32_t k = 0; k < keyCount; k++) {
+        int32_t key = 0;
+        if (!read(ifs, key)) {
+            std::cout << "Error! Input log >" << file << "< is truncated\n";
+            return -1;
+        }
+        const int index = keyIndex(key);
+        bitOf[k] = index >= 0 ? (1u << index) : 0u;
+    }
+
+    frames.clear();
+    Frame previous;
+    Frame frame;
+    while (read(ifs, frame.deltaT)) {
+        uint32_t keys = 0;
+        if (!read(ifs, keys) || !read(ifs, frame.flags) || !read(ifs, frame.stateHash)) break;
+        if (frame.flags & CURSOR_MOVED) {
+            if (!read(ifs, frame.cursorX) || !read(ifs, frame.cursorY)) break;
+        } else {
+            frame.cursorX = previous.cursorX;
+            frame.cursorY = previous.cursorY;
+        }
+        frame.keys = 0;
+        for (uint32_t k = 0; k < keyCount; k++) {
+            if (keys & (1u << k)) frame.keys |= bitOf[k];
+        }
+        frames.push_back(frame);
+        previous = frame;
+    }
+    if (!ifs.eof()) {
+        std::cout << "Error! Cannot read input log >" << file << "<\n";
+        frames.clear();
+        return -1;
+    }
+    if (frames.empty()) {
+        std::cout << "Error! Input log >" << file << "< has no frames\n";
+        return -1;
+    }
+
+    mode = REPLAY;
+    logFile = file;
+    nextFrame = 0;
+    firstMismatch = SIZE_MAX;
+    mismatches = 0;
+    hasFrame = false;
+    std::cout << "Replaying " << frames.size() << " frames of input from " << file << "\n";
+    return 0;
+}
+
+void InputRecorder::stop() {
+    if (mode == RECORD) {
+        if (hasFrame) {
+            current.stateHash = stateHash;
+            writeFrame(current);
+        }
+        log.close();
+        std::cout << "Recorded " << recordedFrames << " frames of input to " << logFile << "\n";
+    } else if (mode == REPLAY) {
+        if (hasFrame) checkReplayedHash();
+        if (mismatches == 0) {
+            std::cout << "Replayed " << nextFrame << " frames: same state as the recording\n";
+        } else {
+            std::cout << "Replayed " << nextFrame << " frames: " << mismatches << " differ from the recording,"
+                      << " the first is frame " << firstMismatch << "\n";
+        }
+        frames.clear();
+    }
+    mode = LIVE;
+    hasFrame = false;
+}
+
+bool InputRecorder::newFrame(GLFWwindow* window) {
+    this->window = window;
+
+    if (mode == REPLAY) {
+        if (hasFrame) checkReplayedHash();
+        stateHash = HASH_SEED;
+        if (nextFrame >= frames.size()) {
+            // Over: nothing pressed, and time keeps flowing as in the last frame
+            current.keys = 0;
+            current.flags = 0;
+            hasFrame = false;
+            return false;
+        }
+        current = frames[nextFrame++];
+        hasFrame = true;
+        return true;
+    }
+
+    if (mode == RECORD && hasFrame) {
+        current.stateHash = stateHash;
+        writeFrame(current);
+    }
+    sampleLive(window);
+    stateHash = HASH_SEED;
+    hasFrame = true;
+    return true;
+}
+
+bool InputRecorder::isKeyPressed(int key) const {
+    const int index = keyIndex(key);
+    if (index >= 0) return current.keys & (1u << index);
+    if (mode == REPLAY || window == nullptr) return false;
+    return glfwGetKey(window, key) == GLFW_PRESS;
+}
+
+void InputRecorder::hashState(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        stateHash = (stateHash ^ bytes[i]) * 16777619u;
+    }
+}
+
+void InputRecorder::sampleLive(GLFWwindow* window) {
+    auto now = std::chrono::steady_clock::now();
+    if (!clockStarted) {
+        startTime = now;
+        clockStarted = true;
+    }
+    const float time = std::chrono::duration<float>(now - startTime).count();
+    current.deltaT = time - lastTime;
+    lastTime = time;
+
+    current.keys = 0;
+    for (uint32_t k = 0; k < KEY_COUNT; k++) {
+        if (glfwGetKey(window, KEYS[k]) == GLFW_PRESS) current.keys |= 1u << k;
+    }
+
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    const bool moved = !hasFrame || x != current.cursorX || y != current.cursorY;
+    current.cursorX = x;
+    current.cursorY = y;
+
+    glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GLFW_TRUE);
+    current.flags = (moved ? CURSOR_MOVED : 0) |
+                    (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS ? MOUSE_LEFT : 0);
+}
+
+void InputRecorder::writeFrame(const Frame& frame) {
+    write(log, frame.deltaT);
+    write(log, frame.keys);
+    write(log, frame.flags);
+    write(log, frame.stateHash);
+    if (frame.flags & CURSOR_MOVED) {
+        write(log, frame.cursorX);
+        write(log, frame.cursorY);
+    }
+    recordedFrames++;
+}
+
+void InputRecorder::checkReplayedHash() {
+    const size_t frame = nextFrame - 1;
+    if (stateHash == frames[frame].stateHash) return;
+    if (mismatches++ == 0) {
+        firstMismatch = frame;
+        std::cout << "Replay differs from the recording from frame " << frame
+                  << " (was the recording made with PHYSICS_THREAD?)\n";
+    }
+}
@@ -1,4 +1,5 @@
 #include "InteractionsManager.hpp"
+#include "Utils.hpp"
 #include <json.hpp>
 
 /**
@@ -35,6 +36,17 @@ int InteractionsManager::init(std::string file) {
             for (const auto& id : instanceIds)
                 interaction.instaceIds.push_back(id.get<std::string>());
 
+        // Resolves the kind and the state index once, interact() only switches on them
+        if (interaction.id.find("torch_fire") != std::string::npos) interaction.kind = InteractionKind::Torch;
+        else if (interaction.id.find("crane_wheel") != std::string::npos) interaction.kind = InteractionKind::CraneWheel;
+        if (interaction.kind != InteractionKind::Other) {
+            interaction.stateIdx = parseIdIndex(interaction.id);
+            if (interaction.stateIdx < 0) {
+                std::cout << "Invalid index in the id of interactable: " << interaction.id << "\n";
+                return -1;
+            }
+        }
+        grid.insert(interaction.position, tagOf(interaction.kind));
         interactionPoints.push_back(interaction);
     }
 
@@ -47,15 +59,18 @@ int InteractionsManager::init(std::string file) {
  * @param playerPos The current position of the player.
  */
 void InteractionsManager::updateNearInteractable(const glm::vec3& playerPos) {
-    interactableIdx = -1;
-    float minDist = maxDistance;
-    for (size_t i = 0; i < interactionPoints.size(); ++i) {
-        float distance = glm::length(playerPos - interactionPoints[i].position);
-        if (distance <= minDist) {
-            minDist = distance;
-            interactableIdx = static_cast<int>(i);
-        }
-    }
+    interactableIdx = findNearest(playerPos, maxDistance);
+}
+
+/**
+ * Finds the nearest interaction point of the given kinds, without changing the internal state.
+ * @param position Center of the search.
+ * @param maxDist Maximum distance from position.
+ * @param tags Kinds of points to consider (TAG_* values, or-ed).
+ * @return Index of the point in interactionPoints, or -1 if none within maxDist.
+ */
+int InteractionsManager::findNearest(const glm::vec3& position, float maxDist, uint32_t tags) const {
+    return grid.nearest(position, maxDist, tags);
 }
 
 /**
@@ -72,12 +87,39 @@ bool InteractionsManager::isNearInteractable() const {
  * It checks internal state (no recomputation).
  * @return The nearest InteractionPoint.
  */
-InteractionPoint InteractionsManager::getNearInteractable() const {
+const InteractionPoint& InteractionsManager::getNearInteractable() const {
+    static const InteractionPoint none{};
     if (interactableIdx >= 0 && interactableIdx < static_cast<int>(interactionPoints.size())) {
         return interactionPoints[interactableIdx];
     } else {
         std::cout << "No interactable point found.\n";
-        return InteractionPoint{};
+        return none;
+    }
+}
+
+/**
+ * Counts the interaction points of a kind.
+ * @param kind Kind of the points to count.
+ * @return Number of points of that kind.
+ */
+int InteractionsManager::countInteractions(InteractionKind kind) const {
+    int count = 0;
+    for (const auto& interaction : interactionPoints) {
+        if (interaction.kind == kind) count++;
+    }
+    return count;
+}
+
+/**
+ * Tag of the spatial index for the points of a kind.
+ * @param kind Kind of the points.
+ * @return One of the TAG_* values.
+ */
+uint32_t InteractionsManager::tagOf(InteractionKind kind) {
+    switch (kind) {
+        case InteractionKind::Torch: return TAG_TORCH;
+        case InteractionKind::CraneWheel: return TAG_CRANE_WHEEL;
+        default: return TAG_OTHER;
     }
 }
 
@@ -89,27 +131,27 @@ InteractionPoint InteractionsManager::getNearInteractable() const {
 void InteractionsManager::interact(InteractableState& state) const {
     if (!isNearInteractable())
         return;
-    InteractionPoint interaction = getNearInteractable();
-    // Cases of interactions handled simply through list of ifs, recognized by querying the id of interactable point
+    const InteractionPoint& interaction = getNearInteractable();
+    // Kind and state index were resolved at load time: no string handling here
 
-    std::string id = interaction.id;
-    if (id.find("torch_fire") != std::string::npos) {
-        // *** Interaction with TORCHES ***
-        int torchIdx = std::stoi(id.substr(id.find_last_of('.') + 1));
-        if (torchIdx >= 0 && torchIdx < static_cast<int>(state.torchesOn.size())) {
-            state.torchesOn[torchIdx] = !state.torchesOn[torchIdx];
-        } else {
-            std::cout << "Invalid torch index: " << torchIdx << "\n";
-        }
-    } else if (id.find("crane_wheel") != std::string::npos) {
-        // *** Interaction with CRANE WHEELS ***
-        int craneWheelIdx = std::stoi(id.substr(id.find_last_of('.') + 1));
-        if (craneWheelIdx >= 0 && craneWheelIdx < static_cast<int>(state.craneWheelsRotating.size())) {
-            state.craneWheelsRotating[craneWheelIdx] = !state.craneWheelsRotating[craneWheelIdx];
-        } else {
-            std::cout << "Invalid crane wheel index: " << craneWheelIdx << "\n";
-        }
-    } else {
-        std::cout << "Interaction ID not recognized\n";
+    switch (interaction.kind) {
+        case InteractionKind::Torch:
+            // *** Interaction with TORCHES ***
+            if (interaction.stateIdx < static_cast<int>(state.torchesOn.size())) {
+                state.torchesOn[interaction.stateIdx] = !state.torchesOn[interaction.stateIdx];
+            } else {
+                std::cout << "Invalid torch index: " << interaction.stateIdx << "\n";
+            }
+            break;
+        case InteractionKind::CraneWheel:
+            // *** Interaction with CRANE WHEELS ***
+            if (interaction.stateIdx < static_cast<int>(state.craneWheelsRotating.size())) {
+                state.craneWheelsRotating[interaction.stateIdx] = !state.craneWheelsRotating[interaction.stateIdx];
+            } else {
+                std::cout << "Invalid crane wheel index: " << interaction.stateIdx << "\n";
+            }
+            break;
+        default:
+            std::cout << "Interaction ID not recognized\n";
     }
 }
\ No newline at end of file
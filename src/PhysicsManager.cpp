@@ -1,6 +1,20 @@
 #include <PhysicsManager.hpp>
+#include "Profiler.hpp"
+#include <cassert>
 #include <iostream>
 #include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <json.hpp>
+#include <stdexcept>
+#include <cstring>
+#include <limits>
+#include <glm/gtc/type_ptr.hpp>
+#if BT_THREADSAFE
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#endif
 
 struct VertexDescriptor;
 // Utility functions for GLM <-> Bullet conversion
@@ -18,30 +32,109 @@ PhysicsObject::~PhysicsObject() {
         delete body->getMotionState();
     }
     delete body;
-    delete shape;
+    if (ownsShape) {
+        delete shape;
+    }
 }
 
 // PhysicsManager implementation
 PhysicsManager::PhysicsManager()
     : broadphase(nullptr), collisionConfig(nullptr), dispatcher(nullptr),
-      solver(nullptr), dynamicsWorld(nullptr), isGrounded(false),
+      solver(nullptr), dynamicsWorld(nullptr), solverPool(nullptr), isGrounded(false),
       groundCheckDistance(0.1f), slopeAngle(0.0f), canClimbStep(false),
       groundNormal(0, 1, 0), lastGroundedTime(0.0f), coyoteTime(0.1f),
-      velocitySmoothing(0.0f), lastVelocity(0, 0, 0) {
+      velocitySmoothing(0.0f), lastVelocity(0, 0, 0), sceneHash(0), staticWorldLoaded(false),
+      fixedTimeStep(1.0f / 60.0f), maxSubSteps(4), lastStepCount(0),
+      moveInput(0.0f), runInput(false), jumpRequested(false), threadRunning(false), deferredCommands(0),
+      timingsThreaded(false),
+      rayQueries{0} {
 }
 
 PhysicsManager::~PhysicsManager() {
     cleanup();
 }
 
+// FNV-1a, 64 bits
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+ * Key of the static world of a scene: the content of the scene file, plus size and modification time of
+ * every model file it references (hashing their content would cost as much as building the world).
+ * Returns 0 if the scene file cannot be read.
+ */
+static uint64_t hashScene(const std::string& sceneFile) {
+    std::ifstream in(sceneFile, std::ios::binary);
+    if (!in.is_open()) return 0;
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint64_t hash = hashBytes(14695981039346656037ull, content.data(), content.size());
+
+    std::vector<std::string> files;
+    try {
+        nlohmann::json js = nlohmann::json::parse(content);
+        for (const auto& a : js.value("assetfiles", nlohmann::json::array())) {
+            files.push_back(a.value("file", ""));
+        }
+        for (const auto& m : js.value("models", nlohmann::json::array())) {
+            if (m.value("format", "") != "ASSET") files.push_back(m.value("model", ""));
+        }
+    } catch (const nlohmann::json::exception& e) {
+        std::cout << "Cannot parse >" << sceneFile << "< for the collision world cache: " << e.what() << "\n";
+        return 0;
+    }
+
+    for (const std::string& file : files) {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(file, ec);
+        if (ec) size = 0;
+        auto time = std::filesystem::last_write_time(file, ec);
+        int64_t ticks = ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+        hash = hashBytes(hash, file.data(), file.size());
+        hash = hashBytes(hash, &size, sizeof(size));
+        hash = hashBytes(hash, &ticks, sizeof(ticks));
+    }
+    return hash;
+}
+
 bool PhysicsManager::initialize(bool flyMode_, const PlayerConfig& playerCfg, const BackgroundTerrainConfig& terrainCfg) {
+    return initialize(flyMode_, std::string(), playerCfg, terrainCfg);
+}
+
+bool PhysicsManager::initialize(bool flyMode_, const std::string& sceneFile, const PlayerConfig& playerCfg,
+                                const BackgroundTerrainConfig& terrainCfg) {
     playerConfig = playerCfg;
     terrainConfig = terrainCfg;
     flyMode = flyMode_;
+    staticWorldLoaded = false;
+    bakedWorldFile.clear();
+    sceneHash = sceneFile.empty() ? 0 : hashScene(sceneFile);
+    if (sceneHash != 0) {
+        // Proxies built with other rules are not valid either, nor a world whose terrain went through the
+        // mesh path (or not) or was partitioned otherwise. Field by field, the padding being undefined
+        const CollisionShapeCache::ProxyConfig& proxyConfig = shapeCache.getProxyConfig();
+        sceneHash = hashBytes(sceneHash, &proxyConfig, sizeof(proxyConfig));
+        sceneHash = hashBytes(sceneHash, &terrainCollisionConfig.cellSize, sizeof(terrainCollisionConfig.cellSize));
+        sceneHash = hashBytes(sceneHash, &terrainCollisionConfig.chunkSamples, sizeof(terrainCollisionConfig.chunkSamples));
+        const uint8_t quantize = terrainCollisionConfig.quantize ? 1 : 0;
+        sceneHash = hashBytes(sceneHash, &quantize, sizeof(quantize));
+        sceneHash = hashBytes(sceneHash, &staticPartitionConfig.cellSize, sizeof(staticPartitionConfig.cellSize));
+        sceneHash = hashBytes(sceneHash, &staticPartitionConfig.minChildren, sizeof(staticPartitionConfig.minChildren));
+        bakedWorldFile = sceneFile + ".physcache";
+    }
 
     try {
+        if (!sceneFile.empty()) {
+            loadCollisionProxies(sceneFile);
+        }
         initializePhysicsWorld();
         createTerrain();
+        staticWorldLoaded = loadBakedWorld();
 
         std::cout << "PhysicsManager initialized successfully" << std::endl;
         return true;
@@ -53,14 +146,120 @@ bool PhysicsManager::initialize(bool flyMode_, const PlayerConfig& playerCfg, co
     }
 }
 
+/*
+ * Gives the model names to the shape cache (for its report) and the proxies forced by the scene file.
+ * Model ids are not unique: an entry applies to all the models with that id.
+ */
+void PhysicsManager::loadCollisionProxies(const std::string& sceneFile) {
+    nlohmann::json js;
+    std::ifstream in(sceneFile);
+    if (!in.is_open()) {
+        throw std::runtime_error("cannot open " + sceneFile);
+    }
+    try {
+        in >> js;
+    } catch (const nlohmann::json::exception& e) {
+        throw std::runtime_error("cannot parse " + sceneFile + ": " + e.what());
+    }
+
+    std::unordered_map<std::string, std::vector<int>> modelIds;
+    if (js.contains("models")) {
+        for (int k = 0; k < static_cast<int>(js["models"].size()); k++) {
+            std::string id = js["models"][k].value("id", "");
+            shapeCache.setModelName(k, id);
+            modelIds[id].push_back(k);
+        }
+    }
+    if (!js.contains("collisionProxies")) return;
+
+    for (const auto& pJson : js["collisionProxies"]) {
+        std::string modelId = pJson.value("model", "");
+        std::string proxyName = pJson.value("proxy", "auto");
+        auto mIt = modelIds.find(modelId);
+        CollisionShapeCache::ProxyType type;
+        if (mIt == modelIds.end()) {
+            throw std::runtime_error("collision proxy for the unknown model " + modelId);
+        }
+        if (!CollisionShapeCache::parseProxyType(proxyName, type)) {
+            throw std::runtime_error("unknown collision proxy " + proxyName);
+        }
+        for (int Mid : mIt->second) {
+            shapeCache.setProxyOverride(Mid, type);
+        }
+    }
+}
+
+/*
+ * Creates the static bodies from the baked world, if there is one for the current scene.
+ */
+bool PhysicsManager::loadBakedWorld() {
+    if (bakedWorldFile.empty()) return false;
+
+    std::vector<CollisionShapeCache::BodyRecord> bodies;
+    if (!shapeCache.load(bakedWorldFile, sceneHash, bodies)) {
+        std::cout << "No valid collision world cache, the static world will be built from the models\n";
+        return false;
+    }
+    std::vector<StaticWorldPartition::Entry> entries;
+    entries.reserve(bodies.size());
+    for (const auto& b : bodies) {
+        btCollisionShape* shape = shapeCache.getShape(b.Mid, nullptr, glm::vec3(b.scale[0], b.scale[1], b.scale[2]));
+        if (!shape) continue;
+        btTransform transform;
+        transform.setBasis(btMatrix3x3(
+                b.basis[0], b.basis[1], b.basis[2],
+                b.basis[3], b.basis[4], b.basis[5],
+                b.basis[6], b.basis[7], b.basis[8]));
+        transform.setOrigin(btVector3(b.origin[0], b.origin[1], b.origin[2]));
+        entries.push_back({shape, transform});
+    }
+    addStaticWorld(entries);
+    return true;
+}
+
 void PhysicsManager::initializePhysicsWorld() {
     // Initialize Bullet Physics
     broadphase = new btDbvtBroadphase();
     collisionConfig = new btDefaultCollisionConfiguration();
-    dispatcher = new btCollisionDispatcher(collisionConfig);
-    solver = new btSequentialImpulseConstraintSolver();
 
-    dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfig);
+#if BT_THREADSAFE
+    if (worldConfig.solverThreads > 0) {
+        // The scheduler is global in Bullet, created once and shared by all the worlds
+        static btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+        if (scheduler) {
+            scheduler->setNumThreads(std::min(worldConfig.solverThreads, scheduler->getMaxNumThreads()));
+            btSetTaskScheduler(scheduler);
+
+            dispatcher = new btCollisionDispatcherMt(collisionConfig, 40);
+            auto* pool = new btConstraintSolverPoolMt(scheduler->getNumThreads());
+            solverPool = pool;
+            solver = new btSequentialImpulseConstraintSolverMt();
+            dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, pool, solver, collisionConfig);
+            std::cout << "Multithreaded physics world, " << scheduler->getNumThreads() << " threads\n";
+        }
+    }
+#else
+    if (worldConfig.solverThreads > 0) {
+        std::cout << "Bullet was built without BT_THREADSAFE: the physics world stays single threaded\n";
+    }
+#endif
+    if (!dynamicsWorld) {
+        dispatcher = new btCollisionDispatcher(collisionConfig);
+        solver = new btSequentialImpulseConstraintSolver();
+        dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfig);
+    }
+    dynamicsWorld->setInternalTickCallback(preTickCallback, this, true);
+#if BT_BULLET_VERSION >= 283
+    // Motion states interpolate between the previous and the last tick, instead of extrapolating past it
+    dynamicsWorld->setLatencyMotionStateInterpolation(true);
+#endif
+
+    GroundProbe::Config probeConfig;
+    probeConfig.radius = playerConfig.capsuleRadius;
+    probeConfig.footOffset = playerConfig.capsuleHeight * 0.5f;
+    probeConfig.probeDistance = groundCheckDistance;
+    probeConfig.stepCheckDistance = playerConfig.capsuleRadius + 0.1f;
+    groundProbe.init(dynamicsWorld, probeConfig);
     if(!flyMode)
         dynamicsWorld->setGravity(btVector3(0, -9.81f, 0));
     else
@@ -164,11 +363,247 @@ void PhysicsManager::addPlayerFromModel(const Model* modelRef) {
     dynamicsWorld->addRigidBody(player->body);
 }
 
+void PhysicsManager::setFixedTimestep(float tickRate, int maxSubSteps_) {
+    fixedTimeStep = 1.0f / std::max(tickRate, 1.0f);
+    maxSubSteps = std::max(maxSubSteps_, 1);
+}
+
 void PhysicsManager::update(float deltaTime) {
+    PROFILE_SCOPE("PhysicsManager::update");
     if (!dynamicsWorld) return;
+    auto start = std::chrono::steady_clock::now();
+
+    if (isThreaded()) {
+        // The physics thread ticks on its own: take its latest state, and the counters of its ticks
+        if (!pendingCommands.empty()) flushCommands();
+        snapshots.update();
+        drainTickStats();
+    } else {
+        // Bullet accumulates the frame time and runs as many fixed ticks as it covers, at most maxSubSteps:
+        // the rest is dropped, so a slow frame cannot make the next one slower. The controller logic runs
+        // in fixedTick(), and the motion states are interpolated between the last two ticks for rendering.
+        const GroundProbe::Stats probeBefore = groundProbe.getStats();
+        auto stepStart = std::chrono::steady_clock::now();
+        lastStepCount = dynamicsWorld->stepSimulation(deltaTime, maxSubSteps, fixedTimeStep);
+        double stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+        timings.ticks += lastStepCount;
+        physicsStats.record(collectStepStats(stepMs, lastStepCount, probeBefore));
+    }
+    updateDynamicInstances();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    timings.renderThreadMs += ms;
+    timings.updates++;
+    if (!isThreaded()) timings.tickMs += ms;
+}
+
+void PhysicsManager::startThread() {
+    if (isThreaded() || !dynamicsWorld || !player || !player->body) return;
+
+    // First snapshot, so that the render thread has a valid state before the first tick
+    PhysicsSnapshot& first = snapshots.back();
+    first.playerPosition = first.previousPosition = btToGlm(player->body->getWorldTransform().getOrigin());
+    first.tickTime = std::chrono::steady_clock::now();
+    first.props.assign(dynamicProps.size(), glm::mat4(1.0f));
+    first.propsMovedTick.assign(dynamicProps.size(), 0);
+    snapshots.publish();
+    snapshots.update();
+
+    timings = PhysicsTimings();
+    timingsThreaded = true;
+    threadRunning.store(true, std::memory_order_release);
+    physicsThread = std::thread(&PhysicsManager::physicsThreadLoop, this);
+    std::cout << "Physics running on its own thread at " << 1.0f / fixedTimeStep << " Hz\n";
+}
+
+void PhysicsManager::stopThread() {
+    if (!isThreaded()) return;
+    threadRunning.store(false, std::memory_order_release);
+    physicsThread.join();
+    drainTickStats();
+    // Commands the thread did not get to are applied here, in order, for the next update()
+    PhysicsCommand command;
+    while (commands.pop(command)) {
+        applyCommand(command);
+    }
+    for (const PhysicsCommand& pending : pendingCommands) {
+        applyCommand(pending);
+    }
+    pendingCommands.clear();
+    if (unqueuedTickStats.substeps > 0) {
+        physicsStats.record(unqueuedTickStats);
+        unqueuedTickStats = PhysicsStepStats();
+    }
+    printTimings();
+}
 
-    // Step the simulation
-    dynamicsWorld->stepSimulation(deltaTime, 10);
+void PhysicsManager::physicsThreadLoop() {
+    using clock = std::chrono::steady_clock;
+    const auto tickDuration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(fixedTimeStep));
+    auto next = clock::now();
+    PROFILE_THREAD("physics");
+
+    while (threadRunning.load(std::memory_order_acquire)) {
+        // Catch up with the ticks due, at most maxSubSteps at once; if still late, the time is dropped
+        int steps = 0;
+        while (clock::now() >= next && steps < maxSubSteps) {
+            runThreadTick();
+            next += tickDuration;
+            steps++;
+        }
+        if (clock::now() >= next + tickDuration) {
+            next = clock::now();
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void PhysicsManager::applyCommand(const PhysicsCommand& command) {
+    switch (command.type) {
+        case PhysicsCommand::Move:
+            moveInput = command.vec;
+            runInput = command.running;
+            break;
+        case PhysicsCommand::Jump:
+            jumpRequested = true;
+            break;
+        case PhysicsCommand::SetPosition:
+            applyPlayerPosition(command.vec);
+            break;
+    }
+}
+
+/*
+ * Queues a command to the physics thread. The queue is full only while the physics thread stalls: then the
+ * command waits on the render side, in order, and a move replaces the move waiting last (the physics thread
+ * would keep only the newest one anyway), so that nothing is lost and the latest input gets through.
+ */
+void PhysicsManager::sendCommand(const PhysicsCommand& command) {
+    if (command.type == PhysicsCommand::Move && !pendingCommands.empty() &&
+        pendingCommands.back().type == PhysicsCommand::Move) {
+        pendingCommands.back() = command;
+    } else {
+        pendingCommands.push_back(command);
+    }
+    flushCommands();
+}
+
+void PhysicsManager::flushCommands() {
+    while (!pendingCommands.empty() && commands.push(pendingCommands.front())) {
+        pendingCommands.pop_front();
+    }
+    if (!pendingCommands.empty()) deferredCommands++;
+}
+
+void PhysicsManager::runThreadTick() {
+    PROFILE_SCOPE("PhysicsManager::tick");
+    auto start = std::chrono::steady_clock::now();
+
+    // Commands received since the last tick: moves replace each other, jumps and teleports add up
+    PhysicsCommand command;
+    while (commands.pop(command)) {
+        applyCommand(command);
+    }
+
+    // Exactly one tick of fixed length (maxSubSteps = 0: no accumulation nor interpolation by Bullet)
+    const glm::vec3 previous = btToGlm(player->body->getWorldTransform().getOrigin());
+    const GroundProbe::Stats probeBefore = groundProbe.getStats();
+    auto stepStart = std::chrono::steady_clock::now();
+    dynamicsWorld->stepSimulation(fixedTimeStep, 0);
+    double stepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+
+    PhysicsSnapshot& out = snapshots.back();
+    out.previousPosition = previous;
+    out.playerPosition = btToGlm(player->body->getWorldTransform().getOrigin());
+    out.playerVelocity = btToGlm(player->body->getLinearVelocity());
+    out.grounded = isGrounded;
+
+    // Every prop is written, since this buffer may hold a state of a few ticks ago; the render thread
+    // copies to the instances only those that moved since it last looked
+    const uint64_t tick = static_cast<uint64_t>(timings.ticks) + 1;
+    out.props.resize(dynamicProps.size());
+    out.propsMovedTick.resize(dynamicProps.size());
+    for (size_t i = 0; i < dynamicProps.size(); i++) {
+        DynamicProp& prop = dynamicProps[i];
+        const btRigidBody* body = prop.object->body;
+        const bool active = body->isActive();
+        if (active || prop.wasActive) {
+            body->getWorldTransform().getOpenGLMatrix(glm::value_ptr(out.props[i]));
+            prop.movedTick = tick;
+        } else if (out.propsMovedTick[i] != prop.movedTick) {
+            body->getWorldTransform().getOpenGLMatrix(glm::value_ptr(out.props[i]));
+        }
+        out.propsMovedTick[i] = prop.movedTick;
+        prop.wasActive = active;
+    }
+    out.tick = tick;
+    out.tickTime = std::chrono::steady_clock::now();
+    snapshots.publish();
+
+    // Counters of every tick reach the render thread; if it lags behind, they wait merged for a free slot
+    unqueuedTickStats.add(collectStepStats(stepMs, 1, probeBefore));
+    if (tickStats.push(unqueuedTickStats)) {
+        unqueuedTickStats = PhysicsStepStats();
+    }
+
+    timings.tickMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    timings.ticks++;
+}
+
+/*
+ * Counters of the step just run, read from the world (pairs and manifolds are those left by its last tick).
+ */
+PhysicsStepStats PhysicsManager::collectStepStats(double stepMs, int substeps, const GroundProbe::Stats& probeBefore) {
+    PhysicsStepStats step;
+    step.stepMs = stepMs;
+    step.maxTickMs = stepMs;
+    step.substeps = substeps;
+    step.overlappingPairs = broadphase->getOverlappingPairCache()->getNumOverlappingPairs();
+    step.manifolds = dispatcher->getNumManifolds();
+    for (int m = 0; m < step.manifolds; m++) {
+        step.contacts += dispatcher->getManifoldByIndexInternal(m)->getNumContacts();
+    }
+    step.solverIterations = dynamicsWorld->getSolverInfo().m_numIterations * substeps;
+
+    const GroundProbe::Stats& probe = groundProbe.getStats();
+    step.groundProbes = probe.probes - probeBefore.probes;
+    step.broadphaseQueries = probe.broadphaseQueries - probeBefore.broadphaseQueries;
+    step.sweeps = probe.sweeps - probeBefore.sweeps;
+    step.rayQueries = rayQueries.exchange(0, std::memory_order_relaxed);
+    return step;
+}
+
+/*
+ * Records, as one step, the ticks the physics thread has queued since the last call (none: nothing recorded).
+ */
+void PhysicsManager::drainTickStats() {
+    PhysicsStepStats step;
+    PhysicsStepStats tick;
+    while (tickStats.pop(tick)) {
+        step.add(tick);
+    }
+    if (step.substeps > 0) {
+        physicsStats.record(step);
+    }
+}
+
+void PhysicsManager::printTimings() const {
+    if (timings.updates == 0) return;
+    std::cout << "Physics timings (" << (timingsThreaded ? "threaded" : "inline") << "): "
+              << timings.renderThreadMs / timings.updates << " ms per frame on the render thread, "
+              << (timings.ticks > 0 ? timings.tickMs / timings.ticks : 0.0) << " ms per tick, "
+              << timings.ticks << " ticks in " << timings.updates << " frames\n";
+    if (deferredCommands > 0) {
+        std::cout << "Physics commands queue full " << deferredCommands << " times: commands waited for the thread\n";
+    }
+}
+
+void PhysicsManager::preTickCallback(btDynamicsWorld* world, btScalar timeStep) {
+    static_cast<PhysicsManager*>(world->getWorldUserInfo())->fixedTick(timeStep);
+}
+
+void PhysicsManager::fixedTick(float timeStep) {
+    if (!player || !player->body) return;
 
     // Update grounded state and terrain analysis
     isGrounded = flyMode || checkGrounded();
@@ -177,73 +612,42 @@ void PhysicsManager::update(float deltaTime) {
     if (isGrounded) {
         lastGroundedTime = 0.0f;
     } else {
-        lastGroundedTime += deltaTime;
+        lastGroundedTime += timeStep;
+    }
+
+    // Input received since the previous tick
+    applyPlayerMovement(timeStep);
+    if (jumpRequested) {
+        jumpRequested = false;
+        applyJump();
     }
 
     // Apply additional forces for better movement feel
     if (!flyMode) {
-        applyMovementCorrections(deltaTime);
-        handleSlopeMovement(deltaTime);
-        handleStepClimbing(deltaTime);
+        applyMovementCorrections(timeStep);
+        handleSlopeMovement(timeStep);
+        handleStepClimbing(timeStep);
     }
 }
 
 bool PhysicsManager::checkGrounded() {
     if (!player || !player->body) return false;
 
-    btTransform playerTransform;
-    player->body->getMotionState()->getWorldTransform(playerTransform);
-    btVector3 playerPos = playerTransform.getOrigin();
-
-    // Multiple ray casts for better ground detection
-    std::vector<btVector3> rayOffsets = {
-        btVector3(0, 0, 0),                                    // Center
-        btVector3(playerConfig.capsuleRadius * 0.7f, 0, 0),   // Right
-        btVector3(-playerConfig.capsuleRadius * 0.7f, 0, 0),  // Left
-        btVector3(0, 0, playerConfig.capsuleRadius * 0.7f),   // Forward
-        btVector3(0, 0, -playerConfig.capsuleRadius * 0.7f)   // Backward
-    };
-
-    float rayLength = playerConfig.capsuleHeight * 0.5f + groundCheckDistance;
-    bool groundFound = false;
-    float closestHitDistance = rayLength;
-    btVector3 avgNormal(0, 0, 0);
-    int hitCount = 0;
-
-    for (const btVector3& offset : rayOffsets) {
-        btVector3 rayStart = playerPos + offset;
-        btVector3 rayEnd = rayStart + btVector3(0, -rayLength, 0);
-
-        btCollisionWorld::ClosestRayResultCallback rayCallback(rayStart, rayEnd);
-        dynamicsWorld->rayTest(rayStart, rayEnd, rayCallback);
-
-        if (rayCallback.hasHit()) {
-            groundFound = true;
-            float hitDistance = rayStart.distance(rayCallback.m_hitPointWorld);
-            if (hitDistance < closestHitDistance) {
-                closestHitDistance = hitDistance;
-            }
-            avgNormal += rayCallback.m_hitNormalWorld;
-            hitCount++;
-        }
-    }
+    // Simulated transform, not the interpolated one of the motion state
+    const btTransform& playerTransform = player->body->getWorldTransform();
 
-    if (groundFound && hitCount > 0) {
-        avgNormal /= static_cast<float>(hitCount);
-        avgNormal.normalize();
-        groundNormal = btToGlm(avgNormal);
-
-        // Calculate slope angle
-        slopeAngle = acos(std::clamp(avgNormal.dot(btVector3(0, 1, 0)), -1.0f, 1.0f));
-
-        // Check if slope is too steep (configurable max slope angle)
-        float maxSlopeAngle = 45.0f * (M_PI / 180.0f); // 45 degrees in radians
-        return slopeAngle <= maxSlopeAngle;
+    // Steps are searched only while moving horizontally
+    btVector3 currentVel = player->body->getLinearVelocity();
+    btVector3 motion(0, 0, 0);
+    if (abs(currentVel.getX()) >= 0.1f || abs(currentVel.getZ()) >= 0.1f) {
+        motion = btVector3(currentVel.getX(), 0, currentVel.getZ());
     }
 
-    groundNormal = glm::vec3(0, 1, 0);
-    slopeAngle = 0.0f;
-    return false;
+    // One query gives ground normal, slope, distance and the step ahead (used by handleStepClimbing)
+    ground = groundProbe.probe(player->body, playerTransform.getOrigin(), motion);
+    groundNormal = ground.normal;
+    slopeAngle = ground.slopeAngle;
+    return ground.walkable;
 }
 
 bool PhysicsManager::canJump() const {
@@ -251,7 +655,18 @@ bool PhysicsManager::canJump() const {
 }
 
 void PhysicsManager::movePlayer(const glm::vec3& moveDirection, bool isRunning) {
-    if (!player || !player->body) return;
+    // Applied at every fixed tick, until the next call
+    if (isThreaded()) {
+        sendCommand({PhysicsCommand::Move, moveDirection, isRunning});
+        return;
+    }
+    moveInput = moveDirection;
+    runInput = isRunning;
+}
+
+void PhysicsManager::applyPlayerMovement(float timeStep) {
+    const glm::vec3& moveDirection = moveInput;
+    const bool isRunning = runInput;
 
     float speed = isRunning ? playerConfig.runSpeed : playerConfig.moveSpeed;
     if (flyMode)
@@ -307,7 +722,7 @@ void PhysicsManager::movePlayer(const glm::vec3& moveDirection, bool isRunning)
             float lerpFactor = isGrounded ? 10.0f : 2.0f;
             if (isRunning && isGrounded) lerpFactor *= 1.3f;
 
-            btVector3 newVel = currentVel.lerp(desiredVel, lerpFactor * (1.0f/60.0f));
+            btVector3 newVel = currentVel.lerp(desiredVel, lerpFactor * timeStep);
             player->body->setLinearVelocity(newVel);
             player->body->activate(true);
 
@@ -358,57 +773,22 @@ void PhysicsManager::handleSlopeMovement(float deltaTime) {
 
     // Prevent sliding down slopes when not moving
     if (abs(currentVel.getX()) < 0.1f && abs(currentVel.getZ()) < 0.1f) {
-        // Apply counter-force to gravity on slopes
+        // Apply counter-force to gravity on slopes, as the impulse of one tick (forces are cleared only
+        // once per frame, so a force would add up over the ticks of the frame)
         float antiSlideForce = sin(slopeAngle) * 9.81f * playerConfig.mass;
         btVector3 slopeUp = glmToBt(groundNormal) * antiSlideForce;
-        player->body->applyCentralForce(slopeUp);
+        player->body->applyCentralImpulse(slopeUp * deltaTime);
     }
 }
 
 void PhysicsManager::handleStepClimbing(float deltaTime) {
-    if (!isGrounded) return;
-
-    btTransform playerTransform;
-    player->body->getMotionState()->getWorldTransform(playerTransform);
-    btVector3 playerPos = playerTransform.getOrigin();
-    btVector3 currentVel = player->body->getLinearVelocity();
-
-    // Only check for steps if moving horizontally
-    if (abs(currentVel.getX()) < 0.1f && abs(currentVel.getZ()) < 0.1f) return;
-
-    // Cast forward to detect steps
-    glm::vec3 horizontalVel = glm::normalize(glm::vec3(currentVel.getX(), 0, currentVel.getZ()));
-    btVector3 forwardDir = glmToBt(horizontalVel);
-
-    float maxStepHeight = 0.3f; // Configurable step height
-    float stepCheckDistance = playerConfig.capsuleRadius + 0.1f;
-
-    // Check for obstacle ahead
-    btVector3 rayStart = playerPos + btVector3(0, maxStepHeight * 0.5f, 0);
-    btVector3 rayEnd = rayStart + forwardDir * stepCheckDistance;
-
-    btCollisionWorld::ClosestRayResultCallback forwardRay(rayStart, rayEnd);
-    dynamicsWorld->rayTest(rayStart, rayEnd, forwardRay);
+    // The step in front of the player was found by the ground probe of this tick
+    if (!isGrounded || !ground.step) return;
 
-    if (forwardRay.hasHit()) {
-        // Check if there's a valid step surface above
-        btVector3 stepCheckStart = forwardRay.m_hitPointWorld + btVector3(0, maxStepHeight, 0);
-        btVector3 stepCheckEnd = stepCheckStart + btVector3(0, -maxStepHeight * 1.5f, 0);
-
-        btCollisionWorld::ClosestRayResultCallback stepRay(stepCheckStart, stepCheckEnd);
-        dynamicsWorld->rayTest(stepCheckStart, stepCheckEnd, stepRay);
-
-        if (stepRay.hasHit()) {
-            float stepHeight = stepRay.m_hitPointWorld.getY() - (playerPos.getY() - playerConfig.capsuleHeight * 0.5f);
-
-            if (stepHeight > 0.05f && stepHeight <= maxStepHeight) {
-                // Apply upward impulse to climb the step
-                float stepForce = stepHeight * playerConfig.mass * 15.0f;
-                player->body->applyCentralImpulse(btVector3(0, stepForce, 0));
-                canClimbStep = true;
-            }
-        }
-    }
+    // Apply upward impulse to climb the step
+    float stepForce = ground.stepHeight * playerConfig.mass * 15.0f;
+    player->body->applyCentralImpulse(btVector3(0, stepForce, 0));
+    canClimbStep = true;
 }
 
 void PhysicsManager::applyMovementCorrections(float deltaTime) {
@@ -431,7 +811,16 @@ void PhysicsManager::applyMovementCorrections(float deltaTime) {
 }
 
 void PhysicsManager::jumpPlayer() {
-    if (!player || !player->body || !canJump()) return;
+    // Performed at the next fixed tick
+    if (isThreaded()) {
+        sendCommand({PhysicsCommand::Jump, glm::vec3(0.0f), false});
+        return;
+    }
+    jumpRequested = true;
+}
+
+void PhysicsManager::applyJump() {
+    if (!canJump()) return;
 
     // Enhanced jump with slope consideration
     btVector3 jumpDirection(0, 1, 0);
@@ -459,6 +848,14 @@ void PhysicsManager::jumpPlayer() {
 glm::vec3 PhysicsManager::getPlayerPosition() const {
     if (!player || !player->body) return glm::vec3(0);
 
+    if (isThreaded()) {
+        // Interpolated between the last two ticks, as the motion state does in the inline mode
+        const PhysicsSnapshot& snapshot = snapshots.front();
+        float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - snapshot.tickTime).count();
+        float alpha = std::clamp(elapsed / fixedTimeStep, 0.0f, 1.0f);
+        return glm::mix(snapshot.previousPosition, snapshot.playerPosition, alpha);
+    }
+
     btTransform transform;
     player->body->getMotionState()->getWorldTransform(transform);
     return btToGlm(transform.getOrigin());
@@ -466,6 +863,7 @@ glm::vec3 PhysicsManager::getPlayerPosition() const {
 
 glm::vec3 PhysicsManager::getPlayerVelocity() const {
     if (!player || !player->body) return glm::vec3(0);
+    if (isThreaded()) return snapshots.front().playerVelocity;
 
     return btToGlm(player->body->getLinearVelocity());
 }
@@ -522,17 +920,36 @@ PhysicsObject* PhysicsManager::addStaticSphere(const glm::vec3& position, float
     return result;
 }
 
-btTransform glmMat4ToBtTransform(const glm::mat4& mat) {
+/*
+ * Splits a world matrix (translation * rotation * scale) into a rigid Bullet transform and the scale,
+ * which Bullet expects on the shape instead (a btTransform basis must be a pure rotation).
+ * A mirroring matrix gets a negative x scale.
+ * Returns false, leaving transform untouched, when an axis has (almost) zero scale: there is no rotation
+ * to recover, and the NaNs of the division would end up in the broadphase.
+ */
+bool glmMat4ToBtRigidTransform(const glm::mat4& mat, btTransform& transform, glm::vec3& scale) {
+    constexpr float minScale = 1e-6f;
+    glm::vec3 c0(mat[0]), c1(mat[1]), c2(mat[2]);
+    scale = glm::vec3(glm::length(c0), glm::length(c1), glm::length(c2));
+    if (!(scale.x > minScale && scale.y > minScale && scale.z > minScale)) {
+        return false;
+    }
+    if (glm::dot(glm::cross(c0, c1), c2) < 0.0f) {
+        scale.x = -scale.x;
+    }
+    c0 /= scale.x;
+    c1 /= scale.y;
+    c2 /= scale.z;
+
+    // glm is column-major, btMatrix3x3 takes the rows
     btMatrix3x3 basis(
-            mat[0][0], mat[0][1], mat[0][2],
-            mat[1][0], mat[1][1], mat[1][2],
-            mat[2][0], mat[2][1], mat[2][2]
+            c0.x, c1.x, c2.x,
+            c0.y, c1.y, c2.y,
+            c0.z, c1.z, c2.z
     );
-    btVector3 origin(mat[3][0], mat[3][1], mat[3][2]);
-    btTransform transform;
     transform.setBasis(basis);
-    transform.setOrigin(origin);
-    return transform;
+    transform.setOrigin(btVector3(mat[3][0], mat[3][1], mat[3][2]));
+    return true;
 }
 
 btCollisionShape * PhysicsManager::getShapeFromModel(const Model* modelRef) {
@@ -578,13 +995,94 @@ btCollisionShape * PhysicsManager::getShapeFromModel(const Model* modelRef) {
     return nullptr; // No valid shape created
 }
 
+void PhysicsManager::addStaticBody(btCollisionShape* shape, const btTransform& transform) {
+    auto obj = std::make_unique<PhysicsObject>();
+    obj->shape = shape;
+    obj->ownsShape = false;
+    obj->motionState = new btDefaultMotionState(transform);
+    btRigidBody::btRigidBodyConstructionInfo info(0.0f, obj->motionState, obj->shape);
+    obj->body = new btRigidBody(info);
+
+    obj->body->setFriction(0.5f);
+    obj->body->setRollingFriction(0.1f);
+    obj->body->setRestitution(0.0f);
+
+    dynamicsWorld->addRigidBody(obj->body);
+    staticObjects.push_back(std::move(obj));
+}
+
+/*
+ * Adds static shapes to the world: merged by cell, if the partition is enabled, or one body each.
+ */
+void PhysicsManager::addStaticWorld(const std::vector<StaticWorldPartition::Entry>& entries) {
+    if (entries.empty()) return;
+    if (staticPartitionConfig.cellSize <= 0.0f) {
+        for (const auto& entry : entries) {
+            addStaticBody(entry.shape, entry.transform);
+        }
+        return;
+    }
+    const size_t first = staticPartition.getCells().size();
+    staticPartition.add(entries, staticPartitionConfig);
+    const auto& cells = staticPartition.getCells();
+    for (size_t c = first; c < cells.size(); c++) {
+        addStaticBody(cells[c].shape, cells[c].transform);
+    }
+    staticPartition.printReport();
+}
+
+// Instances drawn with this technique are the terrain
+static const char* TERRAIN_TECHNIQUE = "Terrain";
+
+static bool isTerrainInstance(const Instance* instanceRef) {
+    return instanceRef->TIp != nullptr && instanceRef->TIp->T != nullptr && instanceRef->TIp->T->id != nullptr &&
+           *instanceRef->TIp->T->id == TERRAIN_TECHNIQUE;
+}
+
+bool PhysicsManager::addTerrainHeightfield(Model **modelRefs, Instance **instanceRefs, int instanceCount) {
+    std::vector<const Model*> models;
+    std::vector<glm::mat4> transforms;
+    for (int instanceIdx = 0; instanceIdx < instanceCount; instanceIdx++) {
+        const Instance* instanceRef = instanceRefs[instanceIdx];
+        if (!instanceRef->usedForPhysics || !isTerrainInstance(instanceRef)) continue;
+        models.push_back(modelRefs[instanceRef->Mid]);
+        transforms.push_back(instanceRef->Wm);
+    }
+    if (models.empty() || terrainCollision.build(models, transforms, terrainCollisionConfig) != 0) {
+        return false;
+    }
+    for (const auto& chunk : terrainCollision.getChunks()) {
+        addStaticBody(chunk.shape.get(), chunk.transform);
+    }
+    terrainCollision.printReport();
+    return true;
+}
+
 void PhysicsManager::addStaticMeshes(Model **modelRefs, Instance **instanceRefs, int instanceCount) {
+    // The terrain is not part of the baked world: it is always resampled into a heightfield
+    const bool heightfield = terrainCollisionConfig.cellSize > 0.0f &&
+                             addTerrainHeightfield(modelRefs, instanceRefs, instanceCount);
+
+    if (staticWorldLoaded) {
+        std::cout << "Static world loaded from " << bakedWorldFile << ": " << staticObjects.size() << " bodies\n";
+        return;
+    }
+
+    std::vector<CollisionShapeCache::BodyRecord> bodies;
+    std::vector<StaticWorldPartition::Entry> entries;
     for (int instanceIdx=0; instanceIdx<instanceCount; instanceIdx++) {
 
         // Skip instances that are not used for physics
         if(!instanceRefs[instanceIdx]->usedForPhysics) {
             continue;
         }
+        // ...and the terrain, if already in the heightfield, and the dynamic props
+        if (heightfield && isTerrainInstance(instanceRefs[instanceIdx])) {
+            continue;
+        }
+        if (dynamicInstances.count(instanceRefs[instanceIdx]) > 0) {
+            continue;
+        }
 
         // retrieve instance and model references
         int modelIdx = instanceRefs[instanceIdx]->Mid;
@@ -595,23 +1093,239 @@ void PhysicsManager::addStaticMeshes(Model **modelRefs, Instance **instanceRefs,
         const Instance* instanceRef = instanceRefs[instanceIdx];
         const Model* modelRef = modelRefs[modelIdx];
 
-        auto obj = std::make_unique<PhysicsObject>();
+        glm::vec3 scale;
+        btTransform transform;
+        if (!glmMat4ToBtRigidTransform(instanceRef->Wm, transform, scale)) {
+            std::cerr << "Skipping instance " << instanceIdx << " with a zero scale" << std::endl;
+            continue;
+        }
+        btCollisionShape* shape = shapeCache.getShape(modelIdx, modelRef, scale);
+        if (!shape) {
+            continue;
+        }
 
-        obj->shape = getShapeFromModel(modelRef);
-        btTransform transform = glmMat4ToBtTransform(instanceRef->Wm);
-        obj->motionState = new btDefaultMotionState(transform);
-        btRigidBody::btRigidBodyConstructionInfo info(0.0f, obj->motionState, obj->shape);
-        obj->body = new btRigidBody(info);
+        entries.push_back({shape, transform});
 
-        obj->body->setFriction(0.5f);
-        obj->body->setRollingFriction(0.1f);
-        obj->body->setRestitution(0.0f);
+        CollisionShapeCache::BodyRecord record{};
+        record.Mid = modelIdx;
+        for (int k = 0; k < 3; k++) {
+            record.scale[k] = scale[k];
+            record.origin[k] = transform.getOrigin()[k];
+            for (int c = 0; c < 3; c++) {
+                record.basis[3 * k + c] = transform.getBasis()[k][c];
+            }
+        }
+        bodies.push_back(record);
+    }
+    addStaticWorld(entries);
+    shapeCache.printReport();
 
-        dynamicsWorld->addRigidBody(obj->body);
-        staticObjects.push_back(std::move(obj));
+    if (!bakedWorldFile.empty()) {
+        shapeCache.save(bakedWorldFile, sceneHash, bodies);
     }
 }
 
+/*
+ * Bounds of the vertices of a model, in model space.
+ */
+static bool getModelBounds(const Model* model, glm::vec3& bMin, glm::vec3& bMax) {
+    const uint32_t stride = model->VD->Bindings[0].stride;
+    const uint32_t posOffset = model->VD->Position.offset;
+    const size_t vertexCount = stride > 0 ? model->vertices.size() / stride : 0;
+    if (vertexCount == 0) return false;
+    bMin = glm::vec3(std::numeric_limits<float>::max());
+    bMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (size_t v = 0; v < vertexCount; v++) {
+        glm::vec3 p;
+        std::memcpy(&p, &model->vertices[v * stride + posOffset], sizeof(p));
+        bMin = glm::min(bMin, p);
+        bMax = glm::max(bMax, p);
+    }
+    return true;
+}
+
+/*
+ * Shape of a dynamic prop, fitted to the bounds of its model (scaled) and centered on them.
+ */
+static btCollisionShape* createPropShape(DynamicPropConfig::Shape type, const Model* model, const glm::vec3& scale,
+                                         const glm::vec3& center, const glm::vec3& halfExtents) {
+    const btVector3 half(halfExtents.x, halfExtents.y, halfExtents.z);
+    switch (type) {
+        case DynamicPropConfig::Box:
+            return new btBoxShape(half);
+        case DynamicPropConfig::Sphere:
+            return new btSphereShape(std::max(halfExtents.x, std::max(halfExtents.y, halfExtents.z)));
+        case DynamicPropConfig::Cylinder:
+            return new btCylinderShape(half);
+        case DynamicPropConfig::Capsule: {
+            float radius = std::max(halfExtents.x, halfExtents.z);
+            return new btCapsuleShape(radius, std::max(0.0f, 2.0f * (halfExtents.y - radius)));
+        }
+        case DynamicPropConfig::Hull: {
+            auto* hull = new btConvexHullShape();
+            const uint32_t stride = model->VD->Bindings[0].stride;
+            const uint32_t posOffset = model->VD->Position.offset;
+            for (size_t v = 0; (v + 1) * stride <= model->vertices.size(); v++) {
+                glm::vec3 p;
+                std::memcpy(&p, &model->vertices[v * stride + posOffset], sizeof(p));
+                p = (p - center) * scale;
+                hull->addPoint(btVector3(p.x, p.y, p.z), false);
+            }
+            hull->recalcLocalAabb();
+#if BT_BULLET_VERSION >= 283
+            hull->optimizeConvexHull();
+#endif
+            return hull;
+        }
+    }
+    return nullptr;
+}
+
+static bool parsePropShape(const std::string& name, DynamicPropConfig::Shape& shape) {
+    if (name == "box") shape = DynamicPropConfig::Box;
+    else if (name == "sphere") shape = DynamicPropConfig::Sphere;
+    else if (name == "cylinder") shape = DynamicPropConfig::Cylinder;
+    else if (name == "capsule") shape = DynamicPropConfig::Capsule;
+    else if (name == "hull") shape = DynamicPropConfig::Hull;
+    else return false;
+    return true;
+}
+
+PhysicsObject* PhysicsManager::addDynamicBody(btCollisionShape* shape, const btTransform& transform, const DynamicPropConfig& config) {
+    DynamicProp prop;
+    prop.object = std::make_unique<PhysicsObject>();
+    PhysicsObject* obj = prop.object.get();
+    obj->shape = shape;
+    obj->motionState = new btDefaultMotionState(transform);
+    obj->initialPosition = btToGlm(transform.getOrigin());
+
+    btVector3 inertia(0, 0, 0);
+    shape->calculateLocalInertia(config.mass, inertia);
+    btRigidBody::btRigidBodyConstructionInfo info(config.mass, obj->motionState, shape, inertia);
+    info.m_friction = config.friction;
+    info.m_restitution = config.restitution;
+    info.m_linearSleepingThreshold = config.linearSleepThreshold;
+    info.m_angularSleepingThreshold = config.angularSleepThreshold;
+    obj->body = new btRigidBody(info);
+
+    dynamicsWorld->addRigidBody(obj->body);
+    if (config.startAsleep) {
+        obj->body->setActivationState(ISLAND_SLEEPING);
+    }
+    prop.wasActive = true;      // the first update copies the initial pose to the instance
+    dynamicProps.push_back(std::move(prop));
+    return obj;
+}
+
+int PhysicsManager::addDynamicProps(const std::string& sceneFile, const Scene& scene) {
+    nlohmann::json js;
+    std::ifstream in(sceneFile);
+    if (!in.is_open()) {
+        std::cout << "Error! Cannot open >" << sceneFile << "<\n";
+        return -1;
+    }
+    try {
+        in >> js;
+    } catch (const nlohmann::json::exception& e) {
+        std::cout << "Error! Cannot parse >" << sceneFile << "<: " << e.what() << "\n";
+        return -1;
+    }
+    if (!js.contains("dynamicProps")) return 0;
+
+    for (const auto& pJson : js["dynamicProps"]) {
+        std::string modelId = pJson.value("model", "");
+        auto mIt = scene.MeshIds.find(modelId);
+        if (mIt == scene.MeshIds.end()) {
+            std::cout << "Error! Dynamic prop refers to the unknown model >" << modelId << "<\n";
+            return -1;
+        }
+        DynamicPropConfig config;
+        std::string shapeName = pJson.value("shape", "box");
+        if (!parsePropShape(shapeName, config.shape)) {
+            std::cout << "Error! Unknown dynamic prop shape >" << shapeName << "<\n";
+            return -1;
+        }
+        config.mass = pJson.value("mass", config.mass);
+        config.friction = pJson.value("friction", config.friction);
+        config.restitution = pJson.value("restitution", config.restitution);
+        config.linearSleepThreshold = pJson.value("linearSleep", config.linearSleepThreshold);
+        config.angularSleepThreshold = pJson.value("angularSleep", config.angularSleepThreshold);
+        config.startAsleep = pJson.value("startAsleep", config.startAsleep);
+
+        const int Mid = mIt->second;
+        const Model* model = scene.M[Mid];
+        glm::vec3 bMin, bMax;
+        if (!getModelBounds(model, bMin, bMax)) continue;
+        const glm::vec3 center = 0.5f * (bMin + bMax);
+
+        int count = 0;
+        for (int i = 0; i < scene.InstanceCount; i++) {
+            Instance* instance = scene.I[i];
+            if (instance->Mid != Mid) continue;
+
+            // The body sits at the center of the bounds, with the rotation of the instance; the scale
+            // goes to the shape and to the matrix bringing the body frame back to the instance Wm
+            glm::vec3 scale;
+            btTransform transform;
+            if (!glmMat4ToBtRigidTransform(instance->Wm, transform, scale)) {
+                std::cout << "Error! Dynamic prop >" << modelId << "< instance " << i << " has a zero scale, skipped\n";
+                continue;
+            }
+            const glm::vec3 scaledCenter = center * scale;
+            transform.setOrigin(transform * btVector3(scaledCenter.x, scaledCenter.y, scaledCenter.z));
+            const glm::vec3 halfExtents = glm::max(0.5f * (bMax - bMin) * glm::abs(scale), glm::vec3(0.01f));
+
+            btCollisionShape* shape = createPropShape(config.shape, model, scale, center, halfExtents);
+            addDynamicBody(shape, transform, config);
+            DynamicProp& prop = dynamicProps.back();
+            prop.instance = instance;
+            prop.bodyToInstance = glm::translate(glm::mat4(1.0f), -scaledCenter) * glm::scale(glm::mat4(1.0f), scale);
+            dynamicInstances.insert(instance);
+            count++;
+        }
+        std::cout << "Dynamic props: " << count << " instances of " << modelId << " (" << shapeName << ", "
+                  << config.mass << " kg)\n";
+    }
+    return 0;
+}
+
+void PhysicsManager::updateDynamicInstances() {
+    if (isThreaded()) {
+        // Props that moved since the snapshot last copied (the physics thread keeps their last tick)
+        const PhysicsSnapshot& snapshot = snapshots.front();
+        const size_t count = std::min(dynamicProps.size(), snapshot.props.size());
+        for (size_t i = 0; i < count; i++) {
+            DynamicProp& prop = dynamicProps[i];
+            if (!prop.instance || snapshot.propsMovedTick[i] == prop.appliedTick) continue;
+            prop.instance->Wm = snapshot.props[i] * prop.bodyToInstance;
+            prop.appliedTick = snapshot.propsMovedTick[i];
+        }
+        return;
+    }
+
+    // Inline: awake bodies, plus those that fell asleep in the last step (to get their final pose);
+    // the motion state holds the transform interpolated between the last two ticks
+    for (DynamicProp& prop : dynamicProps) {
+        const bool active = prop.object->body->isActive();
+        if (prop.instance && (active || prop.wasActive)) {
+            btTransform transform;
+            prop.object->motionState->getWorldTransform(transform);
+            glm::mat4 bodyMatrix;
+            transform.getOpenGLMatrix(glm::value_ptr(bodyMatrix));
+            prop.instance->Wm = bodyMatrix * prop.bodyToInstance;
+        }
+        prop.wasActive = active;
+    }
+}
+
+int PhysicsManager::getAwakeDynamicCount() const {
+    int awake = 0;
+    for (const DynamicProp& prop : dynamicProps) {
+        if (prop.object->body->isActive()) awake++;
+    }
+    return awake;
+}
+
 void PhysicsManager::setGravity(const glm::vec3& gravity) {
     if (dynamicsWorld) {
         dynamicsWorld->setGravity(glmToBt(gravity));
@@ -619,6 +1333,36 @@ void PhysicsManager::setGravity(const glm::vec3& gravity) {
 }
 
 void PhysicsManager::setPlayerPosition(const glm::vec3& position) {
+    if (isThreaded()) {
+        sendCommand({PhysicsCommand::SetPosition, position, false});
+        return;
+    }
+    applyPlayerPosition(position);
+}
+
+bool PhysicsManager::rayCast(const glm::vec3& from, const glm::vec3& to, glm::vec3& hitPoint) const {
+    // The world belongs to the physics thread while it runs: a query from here would race with its ticks
+    assert(!isThreaded() && "rayCast() reads the world: inline mode only");
+    if (!dynamicsWorld || isThreaded()) return false;
+    const btVector3 rayFrom = glmToBt(from), rayTo = glmToBt(to);
+    // Closest hit, skipping the player capsule
+    struct IgnoreObjectCallback : public btCollisionWorld::ClosestRayResultCallback {
+        const btCollisionObject* ignored;
+        IgnoreObjectCallback(const btVector3& f, const btVector3& t, const btCollisionObject* ignored_)
+            : ClosestRayResultCallback(f, t), ignored(ignored_) {}
+        bool needsCollision(btBroadphaseProxy* proxy) const override {
+            return proxy->m_clientObject != ignored && ClosestRayResultCallback::needsCollision(proxy);
+        }
+    };
+    IgnoreObjectCallback callback(rayFrom, rayTo, player ? player->body : nullptr);
+    rayQueries.fetch_add(1, std::memory_order_relaxed);
+    dynamicsWorld->rayTest(rayFrom, rayTo, callback);
+    if (!callback.hasHit()) return false;
+    hitPoint = btToGlm(callback.m_hitPointWorld);
+    return true;
+}
+
+void PhysicsManager::applyPlayerPosition(const glm::vec3& position) {
     if (!player || !player->body) return;
 
     btTransform transform;
@@ -637,10 +1381,36 @@ void PhysicsManager::setPlayerPosition(const glm::vec3& position) {
 }
 
 void PhysicsManager::cleanup() {
+    if (isThreaded()) {
+        stopThread();
+    } else {
+        printTimings();
+    }
+    timings = PhysicsTimings();
+    // Bodies owned by the physics objects leave the world before being deleted
+    if (dynamicsWorld) {
+        for (auto& obj : staticObjects) {
+            dynamicsWorld->removeRigidBody(obj->body);
+        }
+        if (player && player->body) dynamicsWorld->removeRigidBody(player->body);
+        if (terrain && terrain->body) dynamicsWorld->removeRigidBody(terrain->body);
+    }
+
     // Clean up physics objects
+    if (dynamicsWorld) {
+        for (auto& prop : dynamicProps) {
+            dynamicsWorld->removeRigidBody(prop.object->body);
+        }
+    }
+    dynamicProps.clear();
+    dynamicInstances.clear();
     staticObjects.clear();
     player.reset();
     terrain.reset();
+    staticPartition.clear();
+    shapeCache.clear();
+    terrainCollision.clear();
+    staticWorldLoaded = false;
 
     // Clean up Bullet Physics
     if (dynamicsWorld) {
@@ -660,17 +1430,32 @@ void PhysicsManager::cleanup() {
     }
 
     delete solver;
+    delete solverPool;
     delete dispatcher;
     delete collisionConfig;
     delete broadphase;
 
     solver = nullptr;
+    solverPool = nullptr;
     dispatcher = nullptr;
     collisionConfig = nullptr;
     broadphase = nullptr;
 }
 
 int PhysicsManager::getNumRigidBodies() const {
-    int numRigidBodies = dynamicsWorld->getCollisionObjectArray().size();
-    return dynamicsWorld ? numRigidBodies : 0;
+    return dynamicsWorld ? dynamicsWorld->getCollisionObjectArray().size() : 0;
+}
+
+bool PhysicsManager::getStaticWorldBounds(glm::vec3& bMin, glm::vec3& bMax) const {
+    if (staticObjects.empty()) return false;
+    btVector3 lo(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT), hi(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    for (const auto& obj : staticObjects) {
+        btVector3 aabbMin, aabbMax;
+        obj->body->getAabb(aabbMin, aabbMax);
+        lo.setMin(aabbMin);
+        hi.setMax(aabbMax);
+    }
+    bMin = btToGlm(lo);
+    bMax = btToGlm(hi);
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "PhysicsStats.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+RollingHistogram::RollingHistogram(size_t capacity) : values(std::max<size_t>(capacity, 1), 0.0) {
+}
+
+void RollingHistogram::add(double value) {
+    values[next] = value;
+    next = (next + 1) % values.size();
+    if (next == 0) full = true;
+}
+
+void RollingHistogram::clear() {
+    next = 0;
+    full = false;
+}
+
+double RollingHistogram::mean() const {
+    const size_t n = count();
+    if (n == 0) return 0.0;
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++) total += values[i];
+    return total / n;
+}
+
+double RollingHistogram::max() const {
+    const size_t n = count();
+    if (n == 0) return 0.0;
+    return *std::max_element(values.begin(), values.begin() + n);
+}
+
+double RollingHistogram::percentile(double p) const {
+    const size_t n = count();
+    if (n == 0) return 0.0;
+    std::vector<double> sorted(values.begin(), values.begin() + n);
+    const size_t k = std::min(n - 1, static_cast<size_t>(std::clamp(p, 0.0, 1.0) * (n - 1) + 0.5));
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+nlohmann::json RollingHistogram::toJson(int bins) const {
+    const size_t n = count();
+    nlohmann::json j;
+    j["count"] = n;
+    j["mean"] = mean();
+    j["p50"] = percentile(0.5);
+    j["p95"] = percentile(0.95);
+    j["p99"] = percentile(0.99);
+    j["max"] = max();
+    j["bins"] = nlohmann::json::array();
+    if (n == 0 || bins <= 0) return j;
+
+    // Equal width bins between the smallest and the largest value of the window
+    const double lo = *std::min_element(values.begin(), values.begin() + n);
+    const double hi = max();
+    const double width = hi > lo ? (hi - lo) / bins : 1.0;
+    std::vector<int> counts(bins, 0);
+    for (size_t i = 0; i < n; i++) {
+        int b = static_cast<int>((values[i] - lo) / width);
+        counts[std::min(std::max(b, 0), bins - 1)]++;
+    }
+    for (int b = 0; b < bins; b++) {
+        j["bins"].push_back({{"lo", lo + b * width}, {"hi", lo + (b + 1) * width}, {"count", counts[b]}});
+    }
+    return j;
+}
+
+void PhysicsStepStats::add(const PhysicsStepStats& tick) {
+    if (substeps == 0) {
+        *this = tick;
+        return;
+    }
+    stepMs += tick.stepMs;
+    maxTickMs = std::max(maxTickMs, tick.maxTickMs);
+    substeps += tick.substeps;
+    overlappingPairs = tick.overlappingPairs;
+    manifolds = tick.manifolds;
+    contacts = tick.contacts;
+    solverIterations += tick.solverIterations;
+    groundProbes += tick.groundProbes;
+    broadphaseQueries += tick.broadphaseQueries;
+    sweeps += tick.sweeps;
+    rayQueries += tick.rayQueries;
+}
+
+PhysicsStats::PhysicsStats(size_t window)
+    : stepMs(window), maxTickMs(window), substeps(window), overlappingPairs(window), manifolds(window), contacts(window),
+      solverIterations(window), queries(window) {
+}
+
+void PhysicsStats::record(const PhysicsStepStats& step) {
+    lastStep = step;
+    steps++;
+    worstStepMs = std::max(worstStepMs, step.stepMs);
+    worstTickMs = std::max(worstTickMs, step.maxTickMs);
+    stepMs.add(step.stepMs);
+    maxTickMs.add(step.maxTickMs);
+    substeps.add(step.substeps);
+    overlappingPairs.add(step.overlappingPairs);
+    manifolds.add(step.manifolds);
+    contacts.add(step.contacts);
+    solverIterations.add(step.solverIterations);
+    queries.add(step.broadphaseQueries + step.sweeps + step.rayQueries);
+}
+
+void PhysicsStats::reset() {
+    lastStep = PhysicsStepStats();
+    steps = 0;
+    worstStepMs = 0.0;
+    worstTickMs = 0.0;
+    stepMs.clear();
+    maxTickMs.clear();
+    substeps.clear();
+    overlappingPairs.clear();
+    manifolds.clear();
+    contacts.clear();
+    solverIterations.clear();
+    queries.clear();
+}
+
+nlohmann::json PhysicsStats::toJson() const {
+    nlohmann::json j;
+    j["steps"] = steps;
+    j["worst_step_ms"] = worstStepMs;
+    j["worst_tick_ms"] = worstTickMs;
+    j["last"] = {
+        {"step_ms", lastStep.stepMs},
+        {"max_tick_ms", lastStep.maxTickMs},
+        {"substeps", lastStep.substeps},
+        {"overlapping_pairs", lastStep.overlappingPairs},
+        {"manifolds", lastStep.manifolds},
+        {"contacts", lastStep.contacts},
+        {"solver_iterations", lastStep.solverIterations},
+        {"ground_probes", lastStep.groundProbes},
+        {"broadphase_queries", lastStep.broadphaseQueries},
+        {"sweeps", lastStep.sweeps},
+        {"ray_queries", lastStep.rayQueries}
+    };
+    j["histograms"] = {
+        {"step_ms", stepMs.toJson()},
+        {"max_tick_ms", maxTickMs.toJson()},
+        {"substeps", substeps.toJson()},
+        {"overlapping_pairs", overlappingPairs.toJson()},
+        {"manifolds", manifolds.toJson()},
+        {"contacts", contacts.toJson()},
+        {"solver_iterations", solverIterations.toJson()},
+        {"queries", queries.toJson()}
+    };
+    return j;
+}
+
+bool PhysicsStats::writeJson(const std::string& file) const {
+    std::ofstream out(file);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write >" << file << "<\n";
+        return false;
+    }
+    out << toJson().dump(2) << "\n";
+    return out.good();
+}
+
+std::string PhysicsStats::summary() const {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "Physics: " << lastStep.stepMs << " ms, " << lastStep.substeps << " ticks\n";
+    oss << "step p50/p95/max: " << stepMs.percentile(0.5) << " / " << stepMs.percentile(0.95) << " / " << stepMs.max() << " ms\n";
+    oss << "worst tick: " << lastStep.maxTickMs << " ms (" << worstTickMs << " ms since reset)\n";
+    oss << "pairs: " << lastStep.overlappingPairs << ", manifolds: " << lastStep.manifolds
+        << ", contacts: " << lastStep.contacts << "\n";
+    oss << "probes: " << lastStep.groundProbes << ", queries: " << lastStep.broadphaseQueries + lastStep.sweeps
+        << ", rays: " << lastStep.rayQueries << "\n";
+    return oss.str();
+}
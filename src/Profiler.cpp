@@ -0,0 +1,184 @@
+#include "Profiler.hpp"
+
+#ifdef ENABLE_PROFILER
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <json.hpp>
+
+namespace {
+
+const std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+
+// Lane of the GPU events in the trace
+const uint32_t GPU_THREAD = 1000;
+
+}
+
+Profiler& Profiler::get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+uint64_t Profiler::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - profilerEpoch).count());
+}
+
+uint32_t Profiler::threadIndex() {
+    thread_local uint32_t index = threadCount.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+void Profiler::record(const char* name, uint64_t startNs, uint64_t endNs, EventKind kind) {
+    const uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = ring[index & (CAPACITY - 1)];
+    // Sequence lock: the readers see 0, or a different index, while the slot is being written
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.thread.store(kind == Gpu ? GPU_THREAD : threadIndex(), std::memory_order_relaxed);
+    slot.kind.store(kind, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool Profiler::read(uint64_t index, Event& event) const {
+    const Slot& slot = ring[index & (CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1) return false;
+    event.name = slot.name.load(std::memory_order_relaxed);
+    event.startNs = slot.startNs.load(std::memory_order_relaxed);
+    event.endNs = slot.endNs.load(std::memory_order_relaxed);
+    event.thread = slot.thread.load(std::memory_order_relaxed);
+    event.kind = slot.kind.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Overwritten meanwhile by a writer that went around the ring
+    return slot.sequence.load(std::memory_order_relaxed) == index + 1;
+}
+
+void Profiler::setThreadName(const char* name) {
+    const uint32_t index = threadIndex();
+    std::lock_guard<std::mutex> lock(namesMutex);
+    threadNames[index] = name;
+}
+
+void Profiler::newFrame() {
+    const uint64_t end = head.load(std::memory_order_acquire);
+    if (end - readCursor > CAPACITY) readCursor = end - CAPACITY;
+    Event event;
+    for (; readCursor < end; readCursor++) {
+        if (!read(readCursor, event)) {
+            // The last events may still be being written: they are read at the next frame
+            if (end - readCursor < 256) break;
+            continue;
+        }
+        ScopeStats& stats = scopes[event.name];
+        stats.frameNs += event.endNs - event.startNs;
+        stats.calls++;
+        stats.runCalls++;
+    }
+    for (auto& kv : scopes) {
+        ScopeStats& stats = kv.second;
+        stats.totalNs += stats.frameNs;
+        stats.worstFrameNs = std::max(stats.worstFrameNs, stats.frameNs);
+        stats.runNs += stats.frameNs;
+        stats.runWorstFrameNs = std::max(stats.runWorstFrameNs, stats.frameNs);
+        stats.frameNs = 0;
+    }
+    windowFrames++;
+    runFrames++;
+}
+
+std::string Profiler::overlayText() {
+    std::map<std::string, ScopeStats> sorted;
+    for (const auto& kv : scopes) sorted[kv.first] = kv.second;
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "Profile (ms/frame, mean / worst, calls/frame)\n";
+    const double frames = std::max<uint32_t>(windowFrames, 1);
+    for (const auto& kv : sorted) {
+        const ScopeStats& stats = kv.second;
+        if (stats.calls == 0) continue;
+        oss << kv.first << ": " << stats.totalNs / frames * 1e-6 << " / " << stats.worstFrameNs * 1e-6
+            << "  x" << stats.calls / frames << "\n";
+    }
+
+    // New window
+    for (auto& kv : scopes) {
+        kv.second.totalNs = 0;
+        kv.second.worstFrameNs = 0;
+        kv.second.calls = 0;
+    }
+    windowFrames = 0;
+    return oss.str();
+}
+
+std::vector<Profiler::ScopeTotal> Profiler::totals() const {
+    std::vector<ScopeTotal> result;
+    const double frames = static_cast<double>(std::max<uint64_t>(runFrames, 1));
+    for (const auto& kv : scopes) {
+        const ScopeStats& stats = kv.second;
+        if (stats.runCalls == 0) continue;
+        result.push_back({kv.first, stats.runNs / frames * 1e-6, stats.runWorstFrameNs * 1e-6,
+                          stats.runCalls / frames});
+    }
+    std::sort(result.begin(), result.end(),
+              [](const ScopeTotal& a, const ScopeTotal& b) { return a.name < b.name; });
+    return result;
+}
+
+void Profiler::resetTotals() {
+    for (auto& kv : scopes) {
+        kv.second.runNs = 0;
+        kv.second.runWorstFrameNs = 0;
+        kv.second.runCalls = 0;
+    }
+    runFrames = 0;
+}
+
+bool Profiler::writeChromeTrace(const std::string& file) const {
+    nlohmann::json events = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(namesMutex);
+        for (const auto& kv : threadNames) {
+            events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", kv.first},
+                              {"args", {{"name", kv.second}}}});
+        }
+    }
+    events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", GPU_THREAD},
+                      {"args", {{"name", "GPU"}}}});
+
+    const uint64_t end = head.load(std::memory_order_acquire);
+    const uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+    Event event;
+    for (uint64_t i = begin; i < end; i++) {
+        if (!read(i, event)) continue;
+        events.push_back({
+            {"name", event.name},
+            {"cat", event.kind == Gpu ? "gpu" : "cpu"},
+            {"ph", "X"},
+            {"ts", event.startNs * 1e-3},
+            {"dur", (event.endNs - event.startNs) * 1e-3},
+            {"pid", 1},
+            {"tid", event.thread}
+        });
+    }
+
+    std::ofstream out(file);
+    if (!out.is_open()) {
+        std::cout << "Error! Cannot write >" << file << "<\n";
+        return false;
+    }
+    out << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump() << "\n";
+    std::cout << "Profile trace written to " << file << " (" << events.size() << " events)\n";
+    return out.good();
+}
+
+#endif
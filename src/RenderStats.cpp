@@ -0,0 +1,76 @@
+#include "RenderStats.hpp"
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+const char* passName(int pass) {
+    static const char* names[] = {"pass0", "pass1", "pass2", "pass3", "other"};
+    return names[pass];
+}
+
+}
+
+void RenderStats::submitted(const void* commandBuffer) {
+    frame.commandBuffers++;
+    auto it = recorded.find(commandBuffer);
+    if (it == recorded.end()) return;
+    for (size_t p = 0; p < frame.passes.size(); p++) frame.passes[p] += it->second.passes[p];
+}
+
+void RenderStats::endFrame() {
+    frame.frame = frameCount++;
+    last = frame;
+    frame = FrameStats();
+
+    if (!csv.is_open()) return;
+    auto line = [&](const char* pass, const PassStats& p) {
+        csv << last.frame << "," << pass << "," << p.drawCalls << "," << p.triangles << "," << p.pipelineBinds << ","
+            << p.descriptorBinds << "," << p.vertexBufferBinds << "," << p.drawnInstances << "," << p.culledInstances
+            << "," << last.mapCalls << "," << last.uboBytes << "," << last.storageBytes << "," << last.textGlyphs << "\n";
+    };
+    for (int p = 0; p < static_cast<int>(last.passes.size()); p++) {
+        const PassStats& stats = last.passes[p];
+        if (stats.drawCalls == 0 && stats.pipelineBinds == 0 && stats.culledInstances == 0) continue;
+        line(passName(p), stats);
+    }
+    line("total", last.total());
+}
+
+std::string RenderStats::summary() const {
+    const PassStats t = last.total();
+    std::ostringstream oss;
+    oss << "Frame " << last.frame << ": " << last.commandBuffers << " command buffers\n";
+    oss << "draws: " << t.drawCalls << ", triangles: " << t.triangles << "\n";
+    oss << "binds: " << t.pipelineBinds << " pipelines, " << t.descriptorBinds << " sets, "
+        << t.vertexBufferBinds << " vertex buffers\n";
+    for (int p = 0; p < FrameStats::MAX_PASSES; p++) {
+        const PassStats& stats = last.passes[p];
+        if (stats.drawnInstances == 0 && stats.culledInstances == 0) continue;
+        oss << passName(p) << ": " << stats.drawnInstances << " drawn, " << stats.culledInstances << " skipped, "
+            << stats.triangles << " triangles\n";
+    }
+    oss << std::fixed << std::setprecision(1);
+    oss << "uploads: " << last.mapCalls << " maps, " << last.uboBytes / 1024.0 << " KB UBO, "
+        << last.storageBytes / 1024.0 << " KB storage\n";
+    oss << "text: " << last.textGlyphs << " glyphs\n";
+    return oss.str();
+}
+
+bool RenderStats::startCsv(const std::string& file) {
+    stopCsv();
+    csv.open(file);
+    if (!csv.is_open()) {
+        std::cout << "Error! Cannot write >" << file << "<\n";
+        return false;
+    }
+    csv << "frame,pass,draw_calls,triangles,pipeline_binds,descriptor_binds,vertex_buffer_binds,"
+           "drawn_instances,culled_instances,map_calls,ubo_bytes,storage_bytes,text_glyphs\n";
+    std::cout << "Writing render statistics to " << file << "\n";
+    return true;
+}
+
+void RenderStats::stopCsv() {
+    if (csv.is_open()) csv.close();
+}
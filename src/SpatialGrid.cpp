@@ -0,0 +1,71 @@
+#include "SpatialGrid.hpp"
+
+SpatialGrid::SpatialGrid(float cellSize_)
+    : cellSize(cellSize_ > 0.0f ? cellSize_ : 1.0f), invCellSize(1.0f / (cellSize_ > 0.0f ? cellSize_ : 1.0f)) {
+}
+
+int SpatialGrid::insert(const glm::vec3& position, uint32_t tags) {
+    int handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = static_cast<int>(slots.size());
+        slots.push_back({0, -1});
+    }
+    const uint64_t key = cellKey(cellCoord(position.x), cellCoord(position.z));
+    std::vector<Item>& items = cells[key];
+    slots[handle] = {key, static_cast<int>(items.size())};
+    items.push_back({position, tags, handle});
+    count++;
+    return handle;
+}
+
+void SpatialGrid::update(int handle, const glm::vec3& position) {
+    Slot& slot = slots[handle];
+    const uint64_t key = cellKey(cellCoord(position.x), cellCoord(position.z));
+    if (key == slot.cell) {
+        cells[key][slot.index].position = position;
+        return;
+    }
+    const uint32_t tags = item(handle).tags;
+    unlink(handle);
+    std::vector<Item>& items = cells[key];
+    slot = {key, static_cast<int>(items.size())};
+    items.push_back({position, tags, handle});
+}
+
+void SpatialGrid::setTags(int handle, uint32_t tags) {
+    cells[slots[handle].cell][slots[handle].index].tags = tags;
+}
+
+void SpatialGrid::remove(int handle) {
+    if (handle < 0 || handle >= static_cast<int>(slots.size()) || slots[handle].index < 0) return;
+    unlink(handle);
+    slots[handle].index = -1;
+    freeHandles.push_back(handle);
+    count--;
+}
+
+void SpatialGrid::clear() {
+    cells.clear();
+    slots.clear();
+    freeHandles.clear();
+    count = 0;
+}
+
+/*
+ * Takes the point out of its cell (swapping the last point of the cell into its place), dropping the cell
+ * if it becomes empty. The slot still refers to the old cell.
+ */
+void SpatialGrid::unlink(int handle) {
+    const Slot slot = slots[handle];
+    auto it = cells.find(slot.cell);
+    std::vector<Item>& items = it->second;
+    if (slot.index != static_cast<int>(items.size()) - 1) {
+        items[slot.index] = items.back();
+        slots[items[slot.index].handle].index = slot.index;
+    }
+    items.pop_back();
+    if (items.empty()) cells.erase(it);
+}
@@ -0,0 +1,75 @@
+#include "StaticWorldPartition.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+void StaticWorldPartition::add(const std::vector<Entry>& entries, const Config& config) {
+    auto start = std::chrono::steady_clock::now();
+    stats.sourceShapes += static_cast<int>(entries.size());
+
+    // Entries of each cell, keyed by the packed cell coordinates
+    const float cellSize = config.cellSize > 0.0f ? config.cellSize : 1.0f;
+    std::unordered_map<uint64_t, std::vector<size_t>> grid;
+    std::vector<uint64_t> order;        // cells in order of first use, so the result does not depend on hashing
+    for (size_t e = 0; e < entries.size(); e++) {
+        btVector3 aabbMin, aabbMax;
+        entries[e].shape->getAabb(entries[e].transform, aabbMin, aabbMax);
+        const btVector3 center = (aabbMin + aabbMax) * 0.5f;
+        const int32_t cx = static_cast<int32_t>(std::floor(center.x() / cellSize));
+        const int32_t cz = static_cast<int32_t>(std::floor(center.z() / cellSize));
+        const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cz);
+        auto& cell = grid[key];
+        if (cell.empty()) order.push_back(key);
+        cell.push_back(e);
+    }
+
+    const int minChildren = std::max(config.minChildren, 1);
+    for (uint64_t key : order) {
+        const std::vector<size_t>& members = grid[key];
+        stats.cells++;
+        stats.largestCell = std::max(stats.largestCell, static_cast<int>(members.size()));
+
+        if (static_cast<int>(members.size()) < minChildren) {
+            for (size_t e : members) {
+                Cell single;
+                single.shape = entries[e].shape;
+                single.transform = entries[e].transform;
+                cells.push_back(std::move(single));
+            }
+            continue;
+        }
+
+        // The compound sits at the center of the cell, so that the children keep small local offsets
+        const int32_t cx = static_cast<int32_t>(static_cast<uint32_t>(key >> 32));
+        const int32_t cz = static_cast<int32_t>(static_cast<uint32_t>(key & 0xffffffffu));
+        Cell cell;
+        cell.transform.setIdentity();
+        cell.transform.setOrigin(btVector3((cx + 0.5f) * cellSize, 0.0f, (cz + 0.5f) * cellSize));
+        const btTransform toCell = cell.transform.inverse();
+
+        cell.compound = std::make_unique<btCompoundShape>(true, static_cast<int>(members.size()));
+        for (size_t e : members) {
+            cell.compound->addChildShape(toCell * entries[e].transform, entries[e].shape);
+        }
+        cell.shape = cell.compound.get();
+        cells.push_back(std::move(cell));
+        stats.compounds++;
+    }
+    stats.objects = static_cast<int>(cells.size());
+    stats.buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void StaticWorldPartition::clear() {
+    cells.clear();
+    stats = Stats();
+}
+
+void StaticWorldPartition::printReport() const {
+    std::cout << "Static world partition: " << stats.sourceShapes << " shapes in " << stats.cells << " cells\n";
+    std::cout << "\tcollision objects: " << stats.objects << " (compounds: " << stats.compounds << ")"
+              << ", largest cell: " << stats.largestCell << " shapes"
+              << ", build time: " << stats.buildMs << " ms\n";
+}
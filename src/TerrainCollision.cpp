@@ -0,0 +1,196 @@
+#include "TerrainCollision.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+    struct Triangle {
+        glm::vec3 v[3];
+    };
+
+    /*
+     * Rasterizes a world space triangle on the grid: every sample whose XZ position falls inside the
+     * projection of the triangle gets the height of the triangle there, if it is the highest so far.
+     */
+    void rasterize(const Triangle& t, const glm::vec2& origin, float cellSize, int width, int length,
+                   std::vector<float>& grid, std::vector<uint8_t>& covered) {
+        const glm::vec2 a(t.v[0].x, t.v[0].z), b(t.v[1].x, t.v[1].z), c(t.v[2].x, t.v[2].z);
+        const float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+        if (std::abs(area) < 1e-8f) return;     // vertical: its edges are covered by the neighbours
+        const float invArea = 1.0f / area;
+
+        const glm::vec2 lo = (glm::min(a, glm::min(b, c)) - origin) / cellSize;
+        const glm::vec2 hi = (glm::max(a, glm::max(b, c)) - origin) / cellSize;
+        const int i0 = std::max(0, static_cast<int>(std::ceil(lo.x))), i1 = std::min(width - 1, static_cast<int>(std::floor(hi.x)));
+        const int j0 = std::max(0, static_cast<int>(std::ceil(lo.y))), j1 = std::min(length - 1, static_cast<int>(std::floor(hi.y)));
+
+        // Samples exactly on a shared edge belong to both triangles
+        const float eps = -1e-5f;
+        for (int j = j0; j <= j1; j++) {
+            for (int i = i0; i <= i1; i++) {
+                const glm::vec2 p = origin + glm::vec2(i, j) * cellSize;
+                float w0 = ((b.x - p.x) * (c.y - p.y) - (c.x - p.x) * (b.y - p.y)) * invArea;
+                float w1 = ((c.x - p.x) * (a.y - p.y) - (a.x - p.x) * (c.y - p.y)) * invArea;
+                float w2 = 1.0f - w0 - w1;
+                if (w0 < eps || w1 < eps || w2 < eps) continue;
+                float h = w0 * t.v[0].y + w1 * t.v[1].y + w2 * t.v[2].y;
+                size_t s = static_cast<size_t>(j) * width + i;
+                if (!covered[s] || h > grid[s]) {
+                    grid[s] = h;
+                    covered[s] = 1;
+                }
+            }
+        }
+    }
+}
+
+int TerrainCollision::build(const std::vector<const Model*>& models, const std::vector<glm::mat4>& transforms, const Config& config) {
+    auto start = std::chrono::steady_clock::now();
+    clear();
+
+    // World space triangles of all the terrain instances
+    std::vector<Triangle> triangles;
+    glm::vec3 bMin(std::numeric_limits<float>::max()), bMax(-std::numeric_limits<float>::max());
+    for (size_t m = 0; m < models.size(); m++) {
+        const Model* model = models[m];
+        const uint32_t stride = model->VD->Bindings[0].stride;
+        const uint32_t posOffset = model->VD->Position.offset;
+        const size_t vertexCount = stride > 0 ? model->vertices.size() / stride : 0;
+        for (size_t k = 0; k + 2 < model->indices.size(); k += 3) {
+            Triangle t;
+            bool valid = true;
+            for (int v = 0; v < 3; v++) {
+                uint32_t idx = model->indices[k + v];
+                if (idx >= vertexCount) {
+                    valid = false;
+                    break;
+                }
+                glm::vec3 p;
+                std::memcpy(&p, &model->vertices[idx * stride + posOffset], sizeof(p));
+                t.v[v] = glm::vec3(transforms[m] * glm::vec4(p, 1.0f));
+                bMin = glm::min(bMin, t.v[v]);
+                bMax = glm::max(bMax, t.v[v]);
+            }
+            if (valid) triangles.push_back(t);
+        }
+    }
+    stats.sourceTriangles = triangles.size();
+    if (triangles.empty()) {
+        std::cout << "Terrain collision skipped: the terrain has no triangles\n";
+        return -1;
+    }
+
+    // Global grid, aligned to the cell size so that the samples do not move if the extent changes a bit
+    const float cellSize = std::max(config.cellSize, 0.01f);
+    const glm::vec2 origin(std::floor(bMin.x / cellSize) * cellSize, std::floor(bMin.z / cellSize) * cellSize);
+    const int width = static_cast<int>(std::ceil((bMax.x - origin.x) / cellSize)) + 1;
+    const int length = static_cast<int>(std::ceil((bMax.z - origin.y) / cellSize)) + 1;
+    stats.gridWidth = width;
+    stats.gridLength = length;
+
+    std::vector<float> grid(static_cast<size_t>(width) * length, 0.0f);
+    std::vector<uint8_t> covered(grid.size(), 0);
+    for (const Triangle& t : triangles) {
+        rasterize(t, origin, cellSize, width, length, grid, covered);
+    }
+
+    // Holes (samples under no triangle, inside a kept chunk) are pushed to the lowest terrain height
+    const float holeHeight = bMin.y;
+
+    const int chunkCells = config.chunkSamples > 0 ? config.chunkSamples : std::max(width, length) - 1;
+    const int chunksX = std::max(1, (width - 1 + chunkCells - 1) / chunkCells);
+    const int chunksZ = std::max(1, (length - 1 + chunkCells - 1) / chunkCells);
+    for (int cz = 0; cz < chunksZ; cz++) {
+        for (int cx = 0; cx < chunksX; cx++) {
+            // Samples of the chunk: its cells plus the border shared with the next chunk
+            const int i0 = cx * chunkCells, j0 = cz * chunkCells;
+            const int w = std::min(chunkCells, width - 1 - i0) + 1;
+            const int l = std::min(chunkCells, length - 1 - j0) + 1;
+
+            bool any = false;
+            float hMin = std::numeric_limits<float>::max(), hMax = -std::numeric_limits<float>::max();
+            for (int j = j0; j < j0 + l; j++) {
+                for (int i = i0; i < i0 + w; i++) {
+                    size_t s = static_cast<size_t>(j) * width + i;
+                    if (!covered[s]) continue;
+                    any = true;
+                    hMin = std::min(hMin, grid[s]);
+                    hMax = std::max(hMax, grid[s]);
+                }
+            }
+            if (!any || w < 2 || l < 2) {
+                stats.emptyChunks++;
+                continue;
+            }
+            hMin = std::min(hMin, holeHeight);
+            if (hMax - hMin < 1e-3f) hMax = hMin + 1e-3f;      // a flat chunk still needs a non-empty aabb
+
+            Chunk chunk;
+            const size_t count = static_cast<size_t>(w) * l;
+            const void* data;
+            btScalar heightScale = 1.0f;
+            PHY_ScalarType type;
+            if (config.quantize) {
+                // Heights are stored as value * heightScale, so the range must fit in a short around zero
+                heightScale = std::max(std::abs(hMin), std::abs(hMax)) / 32767.0f;
+                if (heightScale <= 0.0f) heightScale = 1.0f;
+                chunk.quantized.resize(count);
+                for (int j = 0; j < l; j++) {
+                    for (int i = 0; i < w; i++) {
+                        size_t s = static_cast<size_t>(j0 + j) * width + (i0 + i);
+                        float h = covered[s] ? grid[s] : holeHeight;
+                        chunk.quantized[static_cast<size_t>(j) * w + i] = static_cast<int16_t>(std::lround(h / heightScale));
+                    }
+                }
+                data = chunk.quantized.data();
+                type = PHY_SHORT;
+                stats.bytes += count * sizeof(int16_t);
+            } else {
+                chunk.heights.resize(count);
+                for (int j = 0; j < l; j++) {
+                    for (int i = 0; i < w; i++) {
+                        size_t s = static_cast<size_t>(j0 + j) * width + (i0 + i);
+                        chunk.heights[static_cast<size_t>(j) * w + i] = covered[s] ? grid[s] : holeHeight;
+                    }
+                }
+                data = chunk.heights.data();
+                type = PHY_FLOAT;
+                stats.bytes += count * sizeof(float);
+            }
+
+            // The shape is centered on its aabb: x and z in [-(w-1)/2, (w-1)/2] cells, heights around (min+max)/2
+            chunk.shape = std::make_unique<btHeightfieldTerrainShape>(w, l, data, heightScale, hMin, hMax, 1, type, false);
+            chunk.shape->setLocalScaling(btVector3(cellSize, 1.0f, cellSize));
+#if BT_BULLET_VERSION >= 289
+            chunk.shape->buildAccelerator();
+#endif
+            chunk.transform.setIdentity();
+            chunk.transform.setOrigin(btVector3(
+                    origin.x + (i0 + 0.5f * (w - 1)) * cellSize,
+                    0.5f * (hMin + hMax),
+                    origin.y + (j0 + 0.5f * (l - 1)) * cellSize));
+
+            stats.samples += count;
+            chunks.push_back(std::move(chunk));
+        }
+    }
+    stats.chunks = static_cast<int>(chunks.size());
+    stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return 0;
+}
+
+void TerrainCollision::clear() {
+    chunks.clear();
+    stats = Stats();
+}
+
+void TerrainCollision::printReport() const {
+    std::cout << "Terrain collision: " << stats.sourceTriangles << " triangles resampled into a "
+              << stats.gridWidth << "x" << stats.gridLength << " grid\n";
+    std::cout << "\tchunks: " << stats.chunks << " (empty, dropped: " << stats.emptyChunks << ")"
+              << ", samples: " << stats.samples << ", memory: " << stats.bytes / 1024 << " KB"
+              << ", build time: " << stats.buildMs << " ms\n";
+}
@@ -1,5 +1,8 @@
 #include "Utils.hpp"
-#include <sstream>
+#include "InputRecorder.hpp"
+#include <cctype>
+#include <climits>
+#include <unordered_map>
 
 /**
  * Handles key toggle events with debounce logic.
@@ -14,7 +17,7 @@
  * This prevents multiple triggers from a single key press.
  */
 void handleKeyToggle(GLFWwindow* window, int key, bool& debounce, int& curDebounce, const std::function<void()>& action) {
-    if (glfwGetKey(window, key)) {
+    if (InputRecorder::get().isKeyPressed(key)) {
         if (!debounce) {
             debounce = true;
             curDebounce = key;
@@ -37,7 +40,7 @@ void handleKeyToggle(GLFWwindow* window, int key, bool& debounce, int& curDeboun
  *
  */
 void handleKeyStateChange(GLFWwindow* window, int key, bool& prevState, std::function<void()> onPress, std::function<void()> onRelease) {
-    bool currentState = glfwGetKey(window, key) == GLFW_PRESS;
+    bool currentState = InputRecorder::get().isKeyPressed(key);
     if (currentState && !prevState) {
         onPress();
     } else if (!currentState && prevState) {
@@ -96,25 +99,67 @@ float shortestAngularDiff(float from, float to) {
     return diff;
 }
 
+namespace {
+	// Wrapped texts by width and text: dialogues are wrapped again each time they are loaded
+	const size_t WRAP_TEXT_MEMO_SIZE = 256;
+	thread_local std::unordered_map<size_t, std::unordered_map<std::string, std::string>> wrapTextMemo;
+}
+
 std::string wrapText(const std::string &text, size_t maxWidth) {
-	std::istringstream iss(text);
-	std::string word;
-	std::string result;
-	std::string line;
+	std::unordered_map<std::string, std::string> &byText = wrapTextMemo[maxWidth];
+	auto found = byText.find(text);
+	if (found != byText.end())
+		return found->second;
 
-	while (iss >> word) {
-		if (line.empty()) {
-			line = word;
-		} else if (line.size() + 1 + word.size() <= maxWidth) {
-			line += " " + word;
+	std::string result;
+	result.reserve(text.size());
+	size_t lineLen = 0;
+	size_t i = 0, n = text.size();
+	while (i < n) {
+		// Words are separated by any whitespace, as for operator>>
+		while (i < n && std::isspace(static_cast<unsigned char>(text[i])))
+			i++;
+		size_t begin = i;
+		while (i < n && !std::isspace(static_cast<unsigned char>(text[i])))
+			i++;
+		size_t len = i - begin;
+		if (len == 0)
+			break;
+		if (lineLen == 0) {
+			lineLen = len;
+		} else if (lineLen + 1 + len <= maxWidth) {
+			result += ' ';
+			lineLen += 1 + len;
 		} else {
-			result += line + "\n";
-			line = word;
+			result += '\n';
+			lineLen = len;
 		}
+		result.append(text, begin, len);
 	}
-	if (!line.empty())
-		result += line;
 
+	if (byText.size() >= WRAP_TEXT_MEMO_SIZE)
+		byText.clear();
+	byText.emplace(text, result);
 	return result;
 }
 
+void clearWrapTextMemo() {
+	wrapTextMemo.clear();
+}
+
+
+int parseIdIndex(const std::string &id) {
+	size_t dot = id.find_last_of('.');
+	if (dot == std::string::npos || dot + 1 >= id.size())
+		return -1;
+	int index = 0;
+	for (size_t i = dot + 1; i < id.size(); i++) {
+		if (id[i] < '0' || id[i] > '9')
+			return -1;
+		const int digit = id[i] - '0';
+		if (index > (INT_MAX - digit) / 10)
+			return -1;
+		index = index * 10 + digit;
+	}
+	return index;
+}
@@ -45,6 +45,21 @@ void ViewControls::updateFrame(float deltaT, glm::vec3 moveInput, glm::vec3 rotI
     updateViewPrj();
 }
 
+/**
+ * Updates the camera from a scripted position (e.g. a benchmark camera path) instead of the input:
+ * perspective projection from eye towards target, whatever the view mode. The player does not move.
+ */
+void ViewControls::updateScripted(const glm::vec3& eye, const glm::vec3& target) {
+    playerPos = physicsMgr.getPlayerPosition();
+    moveDir = glm::vec3(0.0f);
+
+    glm::mat4 Prj = glm::perspective(FOVy, ar, prospNearPlane, prospFarPlane);
+    Prj[1][1] *= -1;
+    cameraPos = eye;
+    dampedCamPos = eye;
+    ViewPrj = Prj * glm::lookAt(eye, target, glm::vec3(0,1,0));
+}
+
 /**
  * Computes the camera's view-projection matrix based on
  * current position, orientation, and view mode.
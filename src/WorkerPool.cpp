@@ -0,0 +1,89 @@
+#include "WorkerPool.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int workerCount) {
+    if (workerCount < 0) {
+        int hw = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = std::max(0, hw - 1);
+    }
+    workers.reserve(workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCv.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+void WorkerPool::dispatch(int count, std::function<void(int, int)> fn, int grain) {
+    wait();
+    if (count <= 0) return;
+
+    if (workers.empty()) {
+        // No background threads: simply run the job here
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = std::move(fn);
+        jobCount = count;
+        jobGrain = std::max(1, grain);
+        nextIndex.store(0, std::memory_order_relaxed);
+        busyWorkers = static_cast<int>(workers.size());
+        generation++;
+    }
+    wakeCv.notify_all();
+}
+
+void WorkerPool::parallelFor(int count, std::function<void(int, int)> fn, int grain) {
+    dispatch(count, std::move(fn), grain);
+    if (!workers.empty()) {
+        runChunks();
+    }
+    wait();
+}
+
+void WorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [this]() { return busyWorkers == 0; });
+}
+
+void WorkerPool::runChunks() {
+    while (true) {
+        int begin = nextIndex.fetch_add(jobGrain, std::memory_order_relaxed);
+        if (begin >= jobCount) break;
+        job(begin, std::min(begin + jobGrain, jobCount));
+    }
+}
+
+void WorkerPool::workerLoop() {
+    PROFILE_THREAD("worker");
+    unsigned int seenGeneration = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeCv.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+        if (stopping) return;
+        seenGeneration = generation;
+        lock.unlock();
+
+        runChunks();
+
+        lock.lock();
+        if (--busyWorkers == 0) {
+            doneCv.notify_all();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#include "character/anim_system.hpp"
+#include "Profiler.hpp"
+#include <iostream>
+
+void AnimationSystem::init(int workerCount) {
+    pool = std::make_unique<WorkerPool>(workerCount);
+    std::cout << "Animation system started with " << getThreadCount() << " threads\n";
+}
+
+void AnimationSystem::cleanup() {
+    wait();
+    pool.reset();
+}
+
+void AnimationSystem::prepare(const std::vector<std::shared_ptr<Character>>& chars) {
+    wait();
+    pending.clear();
+    for (const auto& c : chars) {
+        pending.push_back(c.get());
+    }
+}
+
+void AnimationSystem::publish() {
+    for (Character* c : pending) {
+        c->publishPalette();
+    }
+    pending.clear();
+    inFlight = false;
+}
+
+void AnimationSystem::dispatch(const std::vector<std::shared_ptr<Character>>& chars, float dt) {
+    prepare(chars);
+    inFlight = true;
+    pool->dispatch(static_cast<int>(pending.size()), [this, dt](int begin, int end) {
+        PROFILE_SCOPE("AnimationSystem::evaluate");
+        for (int i = begin; i < end; i++) {
+            pending[i]->evaluateAnimation(dt);
+        }
+    });
+}
+
+void AnimationSystem::wait() {
+    if (!inFlight) return;
+    PROFILE_SCOPE("AnimationSystem::wait");
+    pool->wait();
+    publish();
+}
+
+void AnimationSystem::evaluate(const std::vector<std::shared_ptr<Character>>& chars, float dt) {
+    prepare(chars);
+    inFlight = true;
+    pool->parallelFor(static_cast<int>(pending.size()), [this, dt](int begin, int end) {
+        PROFILE_SCOPE("AnimationSystem::evaluate");
+        for (int i = begin; i < end; i++) {
+            pending[i]->evaluateAnimation(dt);
+        }
+    });
+    publish();
+}
@@ -0,0 +1,76 @@
+#include "character/char_state_machine.hpp"
+#include <iostream>
+
+static const int EVENT_COUNT = static_cast<int>(CharEvent::Count);
+
+static bool parseEvent(const std::string& name, CharEvent& event) {
+    if (name == "interact") event = CharEvent::Interact;
+    else if (name == "reset") event = CharEvent::Reset;
+    else if (name == "animationEnd") event = CharEvent::AnimationEnd;
+    else return false;
+    return true;
+}
+
+int CharStateMachine::init(const std::vector<std::string>& stateNames, const nlohmann::json& transitionsJson) {
+    names = stateNames;
+    table.assign(names.size() * EVENT_COUNT, Transition{});
+    idle = getStateId("Idle");
+
+    // Default transitions
+    if (idle != NO_STATE) {
+        if (getStateCount() > 1 && idle != 1) {
+            at(idle, CharEvent::Interact).to = 1;
+        }
+        for (int s = 0; s < getStateCount(); s++) {
+            if (s != idle) at(s, CharEvent::Reset).to = idle;
+        }
+    }
+
+    if (!transitionsJson.is_array()) return 0;
+    for (const auto& tJson : transitionsJson) {
+        std::string from = tJson.value("from", "*");
+        std::string eventName = tJson.value("event", "");
+        std::string to = tJson.value("to", "");
+
+        CharEvent event;
+        if (!parseEvent(eventName, event)) {
+            std::cout << "Error! Unknown character event >" << eventName << "<\n";
+            return -1;
+        }
+        int toId = getStateId(to);
+        int fromId = (from == "*") ? NO_STATE : getStateId(from);
+        if (toId == NO_STATE || (from != "*" && fromId == NO_STATE)) {
+            std::cout << "Error! Transition " << from << " -> " << to << " refers to an unknown state\n";
+            return -1;
+        }
+
+        Transition t{toId, tJson.value("blend", 0.5f)};
+        for (int s = 0; s < getStateCount(); s++) {
+            if ((fromId == NO_STATE || s == fromId) && s != toId) at(s, event) = t;
+        }
+    }
+    return 0;
+}
+
+int CharStateMachine::getStateId(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == name) return static_cast<int>(i);
+    }
+    return NO_STATE;
+}
+
+const std::string& CharStateMachine::getStateName(int state) const {
+    static const std::string unknown = "Unknown";
+    if (state >= 0 && state < getStateCount()) return names[state];
+    return unknown;
+}
+
+const CharStateMachine::Transition& CharStateMachine::getTransition(int state, CharEvent event) const {
+    static const Transition none{};
+    if (state < 0 || state >= getStateCount()) return none;
+    return table[state * EVENT_COUNT + static_cast<int>(event)];
+}
+
+CharStateMachine::Transition& CharStateMachine::at(int state, CharEvent event) {
+    return table[state * EVENT_COUNT + static_cast<int>(event)];
+}
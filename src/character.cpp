@@ -1,7 +1,18 @@
 #include "character/character.hpp"
 
+// Builds a state machine with the default transitions only
+static std::shared_ptr<const CharStateMachine> makeDefaultStateMachine(const std::vector<std::string>& stateNames) {
+    auto machine = std::make_shared<CharStateMachine>();
+    machine->init(stateNames);
+    return machine;
+}
+
 Character::Character(const std::string& name, const glm::vec3& pos, std::shared_ptr<AnimBlender> AB, std::shared_ptr<SkeletalAnimation> SKA, const std::vector<std::string>& stateNames)
-    : name(name), position(pos), stateNames(stateNames), currentStateIdx(getStateIndex("Idle")), currentDialogue(0), AB(AB), SKA(SKA) {
+    : Character(name, pos, AB, SKA, makeDefaultStateMachine(stateNames)) {
+}
+
+Character::Character(const std::string& name, const glm::vec3& pos, std::shared_ptr<AnimBlender> AB, std::shared_ptr<SkeletalAnimation> SKA, std::shared_ptr<const CharStateMachine> stateMachine)
+    : name(name), position(pos), stateMachine(stateMachine), currentStateIdx(stateMachine->getIdleState()), currentDialogue(0), AB(AB), SKA(SKA) {
     
     // Initilize default dialogues if none are provided
     dialogues = {"Hello there!",
@@ -20,33 +31,45 @@ glm::vec3 Character::getPosition() const {
 }
 
 void Character::setState(const std::string& stateName) {
-    auto it = std::find(stateNames.begin(), stateNames.end(), stateName);
-    if (it != stateNames.end()) {
-        currentStateIdx = static_cast<int>(std::distance(stateNames.begin(), it));
+    setState(stateMachine->getStateId(stateName));
+}
+
+void Character::setState(int stateId) {
+    if (stateId >= 0 && stateId < stateMachine->getStateCount()) {
+        currentStateIdx = stateId;
     }
 }
 
-std::string Character::getCurrentState() const {
-    if (currentStateIdx >= 0 && currentStateIdx < (int)stateNames.size())
-        return stateNames[currentStateIdx];
-    return "Unknown";
+const std::string& Character::getCurrentState() const {
+    return stateMachine->getStateName(currentStateIdx);
 }
 
 int Character::getStateIndex(const std::string& stateName) const {
-    for (size_t i = 0; i < stateNames.size(); ++i) {
-        if (stateNames[i] == stateName) {
-            return static_cast<int>(i);
-        }
-    }
-    return -1; // State not found
+    return stateMachine->getStateId(stateName);
 }
 
 int Character::getStateIndex() const {
     return currentStateIdx;
 }
 
-std::vector<std::string> Character::getStateNames() const {
-    return stateNames;
+const std::vector<std::string>& Character::getStateNames() const {
+    return stateMachine->getStateNames();
+}
+
+// The id of a state is also the index of its animation segment
+bool Character::handleEvent(CharEvent event) {
+    const CharStateMachine::Transition& t = stateMachine->getTransition(currentStateIdx, event);
+    if (t.to == CharStateMachine::NO_STATE || t.to == currentStateIdx) return false;
+    currentStateIdx = t.to;
+    AB->Start(t.to, t.blend);
+    return true;
+}
+
+void Character::pollAnimationEvents() {
+    int seg;
+    if (AB->PollSegmentEnd(seg) && seg == currentStateIdx) {
+        handleEvent(CharEvent::AnimationEnd);
+    }
 }
 
 void Character::setDialogues(const std::vector<std::string>& d) {
@@ -64,15 +87,9 @@ void Character::nextDialogue() {
         ++currentDialogue;
 }
 
-// Simple interaction logic: if in "Idle" state, switch to the next state and start corresponding animation
+// Interaction logic: follows the Interact transition of the current state (by default Idle -> second state)
 void Character::interact() {
-    if (getCurrentState() == "Idle") {
-        setState(stateNames[1]); // Change to the next state (e.g., "Running")
-        // Find the corresponding animation index and start the animation
-        int nextAnimId = getStateIndex(getCurrentState());
-        if (nextAnimId >= 0)
-            AB->Start(nextAnimId, 0.5);
-    }
+    handleEvent(CharEvent::Interact);
 }
 
 std::string Character::getName() const {
@@ -89,10 +106,26 @@ std::vector<glm::mat4>* Character::getTransformMatrices() {
     return SKA->getTransformMatrices();
 }
 
-// Sets the character state to "Idle", resets dialogue index, and starts the "Idle" animation
+// Evaluates the animation of the character into the back palette
+void Character::evaluateAnimation(float dt) {
+    AB->Advance(dt);
+    SKA->Sample(*AB.get());
+    palettes[1 - frontPalette] = *SKA->getTransformMatrices();
+}
+
+// Swaps the palettes, so that the last evaluated one becomes readable
+void Character::publishPalette() {
+    frontPalette = 1 - frontPalette;
+}
+
+// Sets the character state to "Idle", resets dialogue index, and (re)starts the "Idle" animation.
+// A direct transition, not the Reset one of the table: it also restarts Idle when already idle
 void Character::setIdle() {
-    setState("Idle");
-    AB->Start(getStateIndex("Idle"), 0.5);
+    const int idle = stateMachine->getIdleState();
+    if (idle != CharStateMachine::NO_STATE) {
+        currentStateIdx = idle;
+        AB->Start(idle, 0.5);
+    }
     currentDialogue = 0;
     return;
 }
\ No newline at end of file
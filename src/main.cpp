@@ -1,4 +1,5 @@
 // This has been adapted from the Vulkan tutorial
+#include <memory>
 #include <sstream>
 
 #include <json.hpp>
@@ -10,17 +11,46 @@
 #include "modules/Animations.hpp"
 #include "character/char_manager.hpp"
 #include "character/character.hpp"
+#include "character/anim_system.hpp"
+#include "character/joint_palette.hpp"
 #include "PhysicsManager.hpp"
 #include "Player.hpp"
 #include "Utils.hpp"
 #include "sun_light.hpp"
 #include "InteractionsManager.hpp"
 #include "ViewControls.hpp"
+#include "GpuProfiler.hpp"
+#include "Benchmark.hpp"
+#include "InputRecorder.hpp"
 
 /** If true, gravity and inertia are disabled
  And vertical movement (along y, thus actual fly) is enabled.
  */
 const bool FLY_MODE = false;
+/** If true, physics ticks on its own thread (see PhysicsManager::startThread), instead of inside GameLogic().
+ * The time spent on the render thread in both modes is printed at exit. Ignored while the input is recorded or
+ * replayed (see InputRecorder): the thread ticks by the wall clock, so a replay could not reproduce the session.
+ */
+const bool PHYSICS_THREAD = true;
+/** Threads of Bullet's multithreaded world, used for the dynamic props; 0 keeps the single threaded one.
+ * Effective only if Bullet is built with BT_THREADSAFE (CMake option PHYSICS_MULTITHREADING).
+ */
+const int PHYSICS_SOLVER_THREADS = 0;
+/** If not empty, the physics step counters and histograms (see PhysicsStats) are written here at exit
+ * (e.g. "physics_stats.json"). Key 3 shows a summary of them on screen.
+ */
+const std::string PHYSICS_STATS_FILE = "";
+/** Key 4 shows the frame profiler (CPU scopes and GPU passes) on screen, key 5 writes its events here as a
+ * Chrome trace. Only if built with the CMake option ENABLE_PROFILER.
+ */
+const std::string PROFILE_TRACE_FILE = "profile_trace.json";
+/** Key 6 shows the render statistics of the last frame (see RenderStats) on screen, key 7 starts and stops
+ * writing them here, one line per frame and pass.
+ */
+const std::string RENDER_STATS_FILE = "render_stats.csv";
+/** Key 8 starts and stops recording the camera here, as a path for the benchmark mode (--camera-path).
+ */
+const std::string CAMERA_PATH_FILE = "camera_path.json";
 const std::string SCENE_FILEPATH = "assets/scene.json";
 
 
@@ -73,11 +103,10 @@ struct LightModelUBO {
 // NOTE: Up to now, the point light calculations are present only in terrain and buidlings pipelines.
 // If you want the torches to enlight also other meshes, add those calculations in the corresponding pipelines, too
 
-#define MAX_JOINTS 100
+// The joints are not here: they are in the joint palette storage buffer of the character (see JointAffine)
 struct GeomCharUBO {
-	alignas(16) glm::mat4 mvpMat[MAX_JOINTS];
-	alignas(16) glm::mat4 mMat[MAX_JOINTS];
-	alignas(16) glm::mat4 nMat[MAX_JOINTS];
+	alignas(16) glm::mat4 vpMat;
+	alignas(16) glm::mat4 mMat;
     alignas(4) int jointsCount;
 };
 
@@ -93,8 +122,14 @@ struct ShadowMapUBO {
 };
 struct ShadowMapUBOChar {
 	alignas(16) glm::mat4 lightVP;
-	alignas(16) glm::mat4 model[MAX_JOINTS];
+	alignas(16) glm::mat4 model;
+};
+// Push constants of CharacterSkinning.comp
+struct SkinningPushConstants {
+	uint32_t vertexCount;
+	uint32_t jointsCount;
 };
+
 struct ShadowClipUBO {
 	alignas(16) glm::mat4 lightVP;
 	alignas(16) glm::vec4 debug;
@@ -163,16 +198,45 @@ class CGProject : public BaseProject {
 
 	// to provide textual feedback
 	TextMaker txt;
+	bool showPhysicsStats = false;				// physics counters on screen (key 3)
+	bool showProfiler = false;					// profiler overlay (key 4)
+	bool showRenderStats = false;				// render counters on screen (key 6)
+	bool recordingCamera = false;				// camera path being recorded (key 8)
+	float cameraRecordTime = 0.0f;
+	CameraPath cameraPath;						// recorded (key 8), or followed in benchmark mode
+	GpuProfiler gpuProfiler;					// GPU time of the render passes
 
 	// Controller classes
 	PhysicsManager physicsMgr;					// Physics manager
     ViewControls* viewControls;					// Camera and view controls
     SunLightManager sunLightManager;			// Sunlight manager
 	CharManager charManager;					// Character manager for animations
+	AnimationSystem animSystem;					// Parallel evaluation of the characters animations
+	std::vector<StorageBuffer> charPalettes;	// Joint palette of each character, shared by all its instances and passes
+	std::vector<StorageBuffer *> charPalettesRefs;
+
+	/** If true (--preskin), the characters are skinned once per frame by a compute shader (CharacterSkinning.comp)
+	 * into a transient buffer, which both the shadow and the main pass draw as static geometry.
+	 * Otherwise each pass skins the vertices again in its own vertex shader.
+	 */
+	bool preskinCharacters = false;
+	struct SkinnedInstance {
+		Instance *I;
+		uint32_t vertexCount;
+		uint32_t jointsCount;
+		StorageBuffer source;					// Vertex buffer of the model (VDchar), not owned
+		StorageBuffer skinned;					// Skinned vertices (VDtan), drawn by both passes
+		std::vector<StorageBuffer *> links;		// palette, source, skinned
+		DescriptorSet DS;
+	};
+	DescriptorSetLayout DSLskinning;
+	ComputePipeline PCskinning;
+	std::vector<SkinnedInstance> skinnedInstances;
 	Player* player;								// Player manger
     InteractionsManager interactionsManager;	// Interactions manager
     InteractableState interactableState;		// State of the interactions
 	AnimatedProps* animatedProps;				// Animated props manager
+	std::vector<int> torchPinIdx;				// Torch (point light) index of each instance of the "Torches" technique
 
 	// Other application parameters / objects
 	float ar;					// Aspect ratio
@@ -185,6 +249,33 @@ class CGProject : public BaseProject {
      */
     glm::vec4 debugLightView = glm::vec4(0.0);
 
+	// Benchmark mode (see setBenchmark())
+	BenchmarkOptions benchmarkOptions;
+	std::unique_ptr<BenchmarkRecorder> benchmark;
+	int benchmarkStatus = 0;					// -1 until the report is written, or if it cannot be
+
+	public:
+	/** Renders offscreen along a camera path, or replays an input log, and writes a report (see BenchmarkOptions).
+	 * Before run(). */
+	void setBenchmark(const BenchmarkOptions& options) {
+		benchmarkOptions = options;
+		preskinCharacters = options.preskinCharacters;
+		if (options.mode == BenchmarkOptions::OFFSCREEN) {
+			setHeadless(options.preferCpuDevice);
+		}
+	}
+
+	/** Selects compute pre-skinning of the characters (see preskinCharacters). Before run(). */
+	void setPreskinCharacters(bool preskin) {
+		preskinCharacters = preskin;
+	}
+
+	/** Status code of the benchmark run (0 for success, -1 if it ended without writing its report). */
+	int getBenchmarkStatus() const {
+		return benchmarkStatus;
+	}
+
+	protected:
     // Here you set the main application parameters
 	void setWindowParameters() {
 		// window size, title
@@ -192,6 +283,10 @@ class CGProject : public BaseProject {
 		windowHeight = 1000;
 		windowTitle = "CGProject - Medieval Village Sim";
     	windowResizable = GLFW_FALSE;
+		if (benchmarkOptions.mode == BenchmarkOptions::OFFSCREEN) {
+			windowWidth = benchmarkOptions.width;
+			windowHeight = benchmarkOptions.height;
+		}
 
 		// Initial aspect ratio
 		ar = (float)windowWidth / (float)windowHeight;
@@ -220,7 +315,8 @@ class CGProject : public BaseProject {
         });
         DSLshadowMapChar.init(this, {
             {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, sizeof(ShadowMapUBOChar), 1},
-            {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1}
+            {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1},
+            {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0, 1}      // joint palette
         });
 		DSLlightModel.init(this, {
             {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(LightModelUBO), 1}
@@ -237,6 +333,7 @@ class CGProject : public BaseProject {
 		DSLgeomShadow4Char.init(this, {
             {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, sizeof(GeomCharUBO),   1},
             {1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, sizeof(ShadowClipUBO), 1},
+            {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0, 1},     // joint palette
         });
 		DSLskybox.init(this, {
 			{0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, sizeof(GeomSkyboxUBO), 1},
@@ -293,6 +390,13 @@ class CGProject : public BaseProject {
             {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(IndexUBO),1},
             {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0,1},
         });
+        if(preskinCharacters) {
+            DSLskinning.init(this, {
+                {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1},    // joint palette
+                {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1, 1},    // source vertices
+                {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2, 1},    // skinned vertices
+            });
+        }
 
 
         // --------- VERTEX DESCRIPTORS INITIALIZATION ---------
@@ -350,6 +454,10 @@ class CGProject : public BaseProject {
         /* Actual creation of the Render Pass for shadow mapping.
             It is done here to be sure the attachment of RPshadow is created and can be linked as input in RP */
         RPshadow.create();
+        // Every region must be written in every frame, or its queries are never available: skinning only if it runs
+        std::vector<const char*> gpuRegions = {"GPU RPshadow", "GPU RP"};
+        if(preskinCharacters) gpuRegions.push_back("GPU Skinning");
+        gpuProfiler.init(physicalDevice, device, swapChainImages.size(), gpuRegions);
 
 
         PshadowMap.init(this, &VDtan, "shaders/shadowMapShader.vert.spv", "shaders/shadowMapShader.frag.spv", {&DSLshadowMap});
@@ -357,7 +465,17 @@ class CGProject : public BaseProject {
         PshadowMap.setCullMode(VK_CULL_MODE_BACK_BIT);
         PshadowMap.setPolygonMode(VK_POLYGON_MODE_FILL);
 
-        PshadowMapChar.init(this, &VDchar, "shaders/shadowMapShaderChar.vert.spv", "shaders/shadowMapShader.frag.spv", {&DSLshadowMapChar});
+        // With pre-skinning the character pipelines read the VDtan vertices written by the compute pass,
+        // while the models keep the VDchar format (with joints and weights) used as its input
+        VertexDescriptor *VDcharPass = preskinCharacters ? &VDtan : &VDchar;
+        const std::string charShadowVert = preskinCharacters ? "shaders/shadowMapShaderPreskinned.vert.spv" : "shaders/shadowMapShaderChar.vert.spv";
+        const std::string charVert = preskinCharacters ? "shaders/CharacterPreskinned.vert.spv" : "shaders/CharacterVertex.vert.spv";
+        if(preskinCharacters) {
+            PCskinning.init(this, "shaders/CharacterSkinning.comp.spv", {&DSLskinning},
+                            {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SkinningPushConstants)}});
+        }
+
+        PshadowMapChar.init(this, VDcharPass, charShadowVert, "shaders/shadowMapShader.frag.spv", {&DSLshadowMapChar});
         PshadowMapChar.setCompareOp(VK_COMPARE_OP_LESS_OR_EQUAL);  // or VK_COMPARE_OP_LESS
         PshadowMapChar.setCullMode(VK_CULL_MODE_BACK_BIT);
         PshadowMapChar.setPolygonMode(VK_POLYGON_MODE_FILL);
@@ -370,8 +488,8 @@ class CGProject : public BaseProject {
 		Pskybox.setCullMode(VK_CULL_MODE_BACK_BIT);
 		Pskybox.setPolygonMode(VK_POLYGON_MODE_FILL);
 
-		Pchar.init(this, &VDchar, "shaders/CharacterVertex.vert.spv", "shaders/CharacterCookTorrance.frag.spv", {&DSLlightModel, &DSLgeomShadow4Char, &DSLchar});
-		PcharPbr.init(this, &VDchar, "shaders/CharacterVertex.vert.spv", "shaders/CharacterPBR_MR.frag.spv", {&DSLlightModel, &DSLgeomShadow4Char, &DSLcharPbr});
+		Pchar.init(this, VDcharPass, charVert, "shaders/CharacterCookTorrance.frag.spv", {&DSLlightModel, &DSLgeomShadow4Char, &DSLchar});
+		PcharPbr.init(this, VDcharPass, charVert, "shaders/CharacterPBR_MR.frag.spv", {&DSLlightModel, &DSLgeomShadow4Char, &DSLcharPbr});
 		Pbuildings.init(this, &VDtan, "shaders/GeneralPBR.vert.spv", "shaders/BuildingPBR.frag.spv", {&DSLlightModel, &DSLgeomShadow, &DSLpbrShadow});
 		Pprops.init(this, &VDtan, "shaders/GeneralPBR.vert.spv", "shaders/PropsPBR.frag.spv", {&DSLlightModel, &DSLgeomShadow, &DSLpbr});
         Pterrain.init(this, &VDtan, "shaders/TerrainShader.vert.spv", "shaders/TerrainShader.frag.spv", {&DSLlightModel, &DSLgeomShadow, &DSLterrain});
@@ -519,6 +637,7 @@ class CGProject : public BaseProject {
 		// sets the size of the Descriptor Set Pool --> Overprovisioned!
 		DPSZs.uniformBlocksInPool = 1000;
 		DPSZs.texturesInPool = 1000;
+		DPSZs.storageBuffersInPool = 100;
 		DPSZs.setsInPool = 1000;
 		
         std::cout << "\nLoading the scene\n\n";
@@ -532,6 +651,7 @@ class CGProject : public BaseProject {
 			std::cout << "ERROR LOADING CHARACTERs\n";
 			exit(0);
 		}
+		animSystem.init();
 
         if (interactionsManager.init(SCENE_FILEPATH) != 0) {
 			std::cout << "ERROR LOADING INTERACTION POINTS\n";
@@ -546,7 +666,10 @@ class CGProject : public BaseProject {
 		submitCommandBuffer("main", 0, populateCommandBufferAccess, this);
 
 		// Initialize PhysicsManager
-		if(!physicsMgr.initialize(FLY_MODE)) {
+		PhysicsWorldConfig physicsWorldConfig;
+		physicsWorldConfig.solverThreads = PHYSICS_SOLVER_THREADS;
+		physicsMgr.setWorldConfig(physicsWorldConfig);
+		if(!physicsMgr.initialize(FLY_MODE, SCENE_FILEPATH)) {
 			exit(0);
 		}
 
@@ -558,8 +681,17 @@ class CGProject : public BaseProject {
 		 */
 		physicsMgr.addCapsulePlayer();
 
+		// Dynamic props first: the static meshes skip their instances
+		if (physicsMgr.addDynamicProps(SCENE_FILEPATH, SC) != 0) {
+			std::cout << "ERROR LOADING DYNAMIC PROPS\n";
+			exit(0);
+		}
+
 		// Add static meshes to the PhysicsManager for collision detection
 		physicsMgr.addStaticMeshes(SC.M, SC.I, SC.InstanceCount);
+		if (PHYSICS_THREAD && InputRecorder::get().getMode() == InputRecorder::LIVE) {
+			physicsMgr.startThread();
+		}
 
 		// Initializes the player Character reference
 		// NOTE: the first character in scene.json is supposed to be the player character
@@ -567,7 +699,7 @@ class CGProject : public BaseProject {
 
         lightUbo.nPointLights = 0;
         for (const auto& interaction : interactionsManager.getAllInteractions()) {
-            if (interaction.id.find("torch_fire") != std::string::npos) {
+            if (interaction.kind == InteractionKind::Torch) {
                 interactableState.torchesOn.push_back(false);
                 if (lightUbo.nPointLights > MAX_POINT_LIGHTS) {
                     std::cout << "ERROR: Too many point lights in the scene.\n";
@@ -581,9 +713,47 @@ class CGProject : public BaseProject {
 
 		// Initialize animated props
 		animatedProps = new AnimatedProps(&interactionsManager, &interactableState, &SC);
+		if (animatedProps->init(SCENE_FILEPATH) != 0) {
+			std::cout << "ERROR LOADING ANIMATED PROPS\n";
+			exit(0);
+		}
+
+		// Resolves the torch index of the torch pins from their ids (in form "<name>.NN"), once.
+		// A pin whose id names no torch is skipped: index -1, which TorchPinShader leaves unlit
+		for (int t = 0; t < SC.TechniqueInstanceCount; t++) {
+			if (*SC.TI[t].T->id != "Torches") continue;
+			torchPinIdx.resize(SC.TI[t].InstanceCount);
+			for (int i = 0; i < SC.TI[t].InstanceCount; i++) {
+				const std::string& id = *SC.TI[t].I[i].id;
+				torchPinIdx[i] = parseIdIndex(id);
+				if (torchPinIdx[i] < 0 || torchPinIdx[i] >= lightUbo.nPointLights) {
+					std::cout << "Error! Torch pin >" << id << "< does not name one of the " << lightUbo.nPointLights
+							  << " torches (expected \"<name>.NN\"), skipped\n";
+					torchPinIdx[i] = -1;
+				}
+			}
+		}
 
 		// Initialize view controls
         viewControls = new ViewControls(FLY_MODE, window, ar, physicsMgr, sunLightManager);
+
+		if (InputRecorder::get().getMode() == InputRecorder::REPLAY) {
+			// The run lasts as the log, warmup included
+			BenchmarkOptions replay = benchmarkOptions;
+			const int frames = static_cast<int>(InputRecorder::get().getFrameCount());
+			replay.warmupFrames = std::min(replay.warmupFrames, frames / 2);
+			replay.frames = frames - replay.warmupFrames;
+			benchmark = std::make_unique<BenchmarkRecorder>(replay);
+			benchmarkStatus = -1;
+		} else if (benchmarkOptions.mode == BenchmarkOptions::OFFSCREEN) {
+			if (benchmarkOptions.cameraPath.empty()) {
+				cameraPath.makeOrbit(glm::vec3(10.0f, 0.0f, 0.0f), 45.0f, 18.0f, 40.0f);
+			} else if (cameraPath.load(benchmarkOptions.cameraPath) != 0) {
+				exit(EXIT_FAILURE);
+			}
+			benchmark = std::make_unique<BenchmarkRecorder>(benchmarkOptions);
+			benchmarkStatus = -1;
+		}
 	}
 	
 	// Here you create your pipelines and Descriptor Sets!
@@ -622,8 +792,26 @@ class CGProject : public BaseProject {
         PshadowMapSky.create(&RPshadow);
         std::cout << "\t13: Creating PshadowMapWater\n";
         PshadowMapWater.create(&RPshadow);
+        if(preskinCharacters) {
+            std::cout << "\t14: Creating PCskinning\n";
+            PCskinning.create();
+        }
 
         std::cout << "Creating descriptor sets\n";
+        // Joint palettes must exist before the descriptor sets of the characters instances that link them
+        const auto& chars = charManager.getCharacters();
+        charPalettes.resize(chars.size());
+        charPalettesRefs.resize(chars.size());
+        for(int c = 0; c < chars.size(); c++) {
+            charPalettes[c].init(this, MAX_JOINTS * sizeof(JointAffine));
+            charPalettesRefs[c] = &charPalettes[c];
+            for(Instance *I : chars[c]->getInstances()) {
+                I->SBs = &charPalettesRefs[c];
+                I->NSBs = 1;
+            }
+        }
+        if(preskinCharacters)
+            skinningInit();
 		SC.pipelinesAndDescriptorSetsInit();
 		txt.pipelinesAndDescriptorSetsInit();
 
@@ -649,10 +837,85 @@ class CGProject : public BaseProject {
 
 		SC.pipelinesAndDescriptorSetsCleanup();
 		txt.pipelinesAndDescriptorSetsCleanup();
+		for(StorageBuffer &SB : charPalettes)
+			SB.cleanup();
+		if(preskinCharacters) {
+			PCskinning.cleanup();
+			skinningCleanup();
+		}
+	}
+
+	/**
+	 * Creates, for each instance of the characters, the transient buffer of its skinned vertices
+	 * and the descriptor set of the compute pass that fills it.
+	 * The instance is then drawn from that buffer in every pass (see Instance::VBoverride).
+	 */
+	void skinningInit() {
+		const auto& chars = charManager.getCharacters();
+		int count = 0;
+		for(const auto& C : chars)
+			count += C->getInstances().size();
+		// Resized once: the links point to the buffers of the elements
+		skinnedInstances.resize(count);
+
+		int k = 0;
+		for(int c = 0; c < chars.size(); c++) {
+			uint32_t jointsCount = std::min(chars[c]->getSkeletalAnimation()->getNTMs(), MAX_JOINTS);
+			for(Instance *I : chars[c]->getInstances()) {
+				SkinnedInstance &S = skinnedInstances[k++];
+				Model *M = SC.M[I->Mid];
+				S.I = I;
+				S.vertexCount = M->vertices.size() / sizeof(VertexChar);
+				S.jointsCount = jointsCount;
+				S.source.initFromBuffer(this, M->getVertexBufferInfo().buffer, M->vertices.size());
+				S.skinned.init(this, S.vertexCount * sizeof(VertexTan), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, false);
+				S.links = {&charPalettes[c], &S.source, &S.skinned};
+				S.DS.init(this, &DSLskinning, {}, S.links);
+				I->VBoverride = &S.skinned;
+			}
+		}
+	}
+
+	void skinningCleanup() {
+		for(SkinnedInstance &S : skinnedInstances) {
+			S.I->VBoverride = nullptr;
+			S.DS.cleanup();
+			S.skinned.cleanup();
+			S.source.cleanup();
+		}
+		skinnedInstances.clear();
+	}
+
+	/**
+	 * Records the compute pass that skins all the characters instances, followed by the barrier
+	 * that makes the skinned vertices visible to the vertex input of the following render passes.
+	 */
+	void populateSkinningCommands(VkCommandBuffer commandBuffer, int currentImage) {
+		PCskinning.bind(commandBuffer);
+		for(SkinnedInstance &S : skinnedInstances) {
+			SkinningPushConstants pc{S.vertexCount, S.jointsCount};
+			S.DS.bind(commandBuffer, PCskinning, 0, currentImage);
+			vkCmdPushConstants(commandBuffer, PCskinning.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+							   0, sizeof(SkinningPushConstants), &pc);
+			vkCmdDispatch(commandBuffer, (S.vertexCount + 63) / 64, 1, 1);
+		}
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+							 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+							 0, 1, &barrier, 0, nullptr, 0, nullptr);
 	}
 
 	void localCleanup() {
+		if (!PHYSICS_STATS_FILE.empty() && physicsMgr.getPhysicsStats().getSteps() > 0) {
+			physicsMgr.getPhysicsStats().writeJson(PHYSICS_STATS_FILE);
+		}
 		Tvoid.cleanup();
+		gpuProfiler.cleanup();
+		animSystem.cleanup();
 		charManager.cleanup();
 
 		DSLlightModel.cleanup();
@@ -675,6 +938,10 @@ class CGProject : public BaseProject {
 		VDpos.cleanup();
 		VDnormUV.cleanup();
 		VDchar.cleanup();
+		if(preskinCharacters) {
+			DSLskinning.cleanup();
+			PCskinning.destroy();
+		}
 
 		Pchar.destroy();
 		PcharPbr.destroy();
@@ -704,14 +971,26 @@ class CGProject : public BaseProject {
 		T->populateCommandBuffer(commandBuffer, currentImage);
 	}
 	void populateCommandBuffer(VkCommandBuffer commandBuffer, int currentImage) {
+        gpuProfiler.reset(commandBuffer, currentImage);
+        // Characters are skinned once, before both the passes that draw them
+        if(preskinCharacters) {
+            gpuProfiler.begin(commandBuffer, currentImage, 2);
+            populateSkinningCommands(commandBuffer, currentImage);
+            gpuProfiler.end(commandBuffer, currentImage, 2);
+        }
+
         //NOTE: shadow render pass has equal swap chain size of main pass, hence the same currentImage
+        gpuProfiler.begin(commandBuffer, currentImage, 0);
         RPshadow.begin(commandBuffer, currentImage);
         SC.populateCommandBuffer(commandBuffer, 0, currentImage);
         RPshadow.end(commandBuffer);
+        gpuProfiler.end(commandBuffer, currentImage, 0);
 
+        gpuProfiler.begin(commandBuffer, currentImage, 1);
 		RP.begin(commandBuffer, currentImage);
 		SC.populateCommandBuffer(commandBuffer, 1, currentImage);
         RP.end(commandBuffer);
+        gpuProfiler.end(commandBuffer, currentImage, 1);
 	}
 
 	void updateUniformBuffer(uint32_t currentImage) {
@@ -720,6 +999,15 @@ class CGProject : public BaseProject {
         
         static bool firstTime = true;
 
+        // GPU times of the previous use of this image (its fence has just been waited)
+        gpuProfiler.collect(currentImage);
+
+        // Waits for the character poses sampled in background during the previous frame.
+        // Must come before anything that can change the animation blenders (keys, interactions, player)
+        animSystem.wait();
+        // Animation ends detected by that evaluation may trigger state transitions
+        charManager.update();
+
         // Handle of command keys
         interactionsManager.updateNearInteractable(physicsMgr.getPlayerPosition());
 		static std::shared_ptr<Character> lastCharInteracted = nullptr;
@@ -734,9 +1022,45 @@ class CGProject : public BaseProject {
             handleKeyToggle(window, GLFW_KEY_2, debounce, curDebounce, [&]() {
 				viewControls->nextViewMode();
             });
+            handleKeyToggle(window, GLFW_KEY_3, debounce, curDebounce, [&]() {
+                showPhysicsStats = !showPhysicsStats;
+                if (!showPhysicsStats) txt.removeText(6);
+            });
+#ifdef ENABLE_PROFILER
+            handleKeyToggle(window, GLFW_KEY_4, debounce, curDebounce, [&]() {
+                showProfiler = !showProfiler;
+                if (!showProfiler) txt.removeText(7);
+            });
+            handleKeyToggle(window, GLFW_KEY_5, debounce, curDebounce, [&]() {
+                Profiler::get().writeChromeTrace(PROFILE_TRACE_FILE);
+            });
+#endif
+            handleKeyToggle(window, GLFW_KEY_6, debounce, curDebounce, [&]() {
+                showRenderStats = !showRenderStats;
+                if (!showRenderStats) txt.removeText(8);
+            });
+            handleKeyToggle(window, GLFW_KEY_7, debounce, curDebounce, [&]() {
+                if (RenderStats::get().isWritingCsv()) {
+                    RenderStats::get().stopCsv();
+                    std::cout << "Render statistics written to " << RENDER_STATS_FILE << "\n";
+                } else {
+                    RenderStats::get().startCsv(RENDER_STATS_FILE);
+                }
+            });
 
             static int curAnim = 0;
             static AnimBlender *AB = charManager.getCharacters()[0]->getAnimBlender();
+            handleKeyToggle(window, GLFW_KEY_8, debounce, curDebounce, [&]() {
+                if (recordingCamera) {
+                    if (cameraPath.save(CAMERA_PATH_FILE))
+                        std::cout << "Camera path written to " << CAMERA_PATH_FILE << " (" << cameraPath.size() << " keys)\n";
+                } else {
+                    cameraPath.clear();
+                    cameraRecordTime = 0.0f;
+                    std::cout << "Recording the camera path\n";
+                }
+                recordingCamera = !recordingCamera;
+            });
             handleKeyToggle(window, GLFW_KEY_9, debounce, curDebounce, [&]() {
                 curAnim = (curAnim + 1) % 5;
                 AB->Start(curAnim, 0.5);
@@ -776,6 +1100,8 @@ class CGProject : public BaseProject {
 		player->handleKeyActions(window, deltaT);
 
         // ----- UPDATE UNIFORMS -----
+        // (timed up to the end of the function, text included)
+        PROFILE_SCOPE("uniforms");
         //NOTE on code style: write all uniform variables in the following section
         // and assign the constant values across the different model during initialization
 
@@ -803,6 +1129,7 @@ class CGProject : public BaseProject {
         ShadowMapUBOChar shadowMapUboChar{
             .lightVP = sunLightManager.getLightVP()
         };
+        JointAffine jointPalette[MAX_JOINTS];
         ShadowClipUBO shadowClipUbo{
             .lightVP = sunLightManager.getLightVP(),
             .debug = debugLightView
@@ -824,50 +1151,41 @@ class CGProject : public BaseProject {
 
 		// TECHNIQUE Character
         const float SpeedUpAnimFact = 0.85f;
-        for (std::shared_ptr<Character> C : charManager.getCharacters()) {
+        // The poses are normally sampled in background during the previous frame:
+        // at the very first frame there is nothing yet, so they are evaluated here
+        if(firstTime)
+            animSystem.evaluate(charManager.getCharacters(), deltaT * SpeedUpAnimFact);
+        for (int c = 0; c < charManager.getCharacters().size(); c++) {
+            const std::shared_ptr<Character> &C = charManager.getCharacters()[c];
             if(firstTime) std::cout << "Updating character: " << C->getName() << "\n";
 
-			SkeletalAnimation* SKA = C->getSkeletalAnimation();
-			AnimBlender* AB = C->getAnimBlender();
-			// updated the animation
-			AB->Advance(deltaT * SpeedUpAnimFact);
+			// Joint palette published by the animation system, packed once per character
+			// in the storage buffer read by both the shadow and the main pass
+			const std::vector<glm::mat4> &TMs = C->getPalette();
+			int jointsCount = std::min(static_cast<int>(TMs.size()), MAX_JOINTS);
+			packJointPalette(TMs, AdaptMat, jointPalette, jointsCount);
+			charPalettes[c].map(currentImage, jointPalette, jointsCount * sizeof(JointAffine));
 
-			// Skeletal Sampling
-			SKA->Sample(*AB);
-			std::vector<glm::mat4> *TMsp = SKA->getTransformMatrices();
 			for (Instance* I : C->getInstances()) {
                 if(firstTime) std::cout << "\tInstance: " << *(I->id) << "\n";
 				std::string techniqueName = *(I->TIp->T->id);
-				if (techniqueName == "CharCookTorrance") {
-					// CookTorrance technique ubo update
-					for(int im = 0; im < TMsp->size(); im++) {
-						geomCharUbo.mMat[im]   = I->Wm * AdaptMat * (*TMsp)[im];
-						geomCharUbo.mvpMat[im] = viewControls->getViewPrj() * geomCharUbo.mMat[im];
-						geomCharUbo.nMat[im] = glm::inverse(glm::transpose(geomCharUbo.mMat[im]));
-                        shadowMapUboChar.model[im] = geomCharUbo.mMat[im];
-					}
-					geomCharUbo.jointsCount = TMsp->size();
+				geomCharUbo.mMat = I->Wm;
+				if(*(I->id) == "player" && viewControls->getViewMode()==ViewMode::FIRST_PERSON)
+					// If view mode is "first person", the player is moved underground to make it invisible
+					// Note: For it to work, the player must be rendered with exact id "player"
+					// Theoretical Note: the translation changing the word matrix must be applied to the left
+						// as is must be the last transform to be applied in the world matrix
+					geomCharUbo.mMat = glm::translate(glm::mat4(1), glm::vec3(0.0f, -100.0f, 0.0f)) * geomCharUbo.mMat;
+				geomCharUbo.vpMat = viewControls->getViewPrj();
+				geomCharUbo.jointsCount = jointsCount;
+				shadowMapUboChar.model = geomCharUbo.mMat;
 
+				if (techniqueName == "CharCookTorrance") {
                     I->DS[0][0]->map(currentImage, &shadowMapUboChar, 0);
                     I->DS[1][0]->map(currentImage, &lightUbo, 0);
                     I->DS[1][1]->map(currentImage, &geomCharUbo, 0);
                     I->DS[1][1]->map(currentImage, &shadowClipUbo, 1);
 				} else if(techniqueName == "CharPBR") {
-					for(int im = 0; im < TMsp->size(); im++) {
-						geomCharUbo.mMat[im]   = I->Wm * AdaptMat * (*TMsp)[im];
-						if(*(I->id) == "player" && viewControls->getViewMode()==ViewMode::FIRST_PERSON)
-							// If view mode is "first person", the player is moved underground to make it invisible
-							// Note: For it to work, the player must be rendered with PBR with exact id "player"
-							// Theoretical Note: the translation changing the word matrix must be applied to the left
-							    // as is must be the last transform to be applied in the world matrix
-							geomCharUbo.mMat[im] = glm::translate(glm::mat4(1), glm::vec3(0.0f, -100.0f, 0.0f))
-													* geomCharUbo.mMat[im];
-						geomCharUbo.mvpMat[im] = viewControls->getViewPrj() * geomCharUbo.mMat[im];
-						geomCharUbo.nMat[im] = glm::inverse(glm::transpose(geomCharUbo.mMat[im]));
-                        shadowMapUboChar.model[im] = geomCharUbo.mMat[im];
-					}
-					geomCharUbo.jointsCount = TMsp->size();
-
 					pbrMRUbo.metallicFactor = I->factor1;
 					pbrMRUbo.roughnessFactor = I->factor2;
 
@@ -881,6 +1199,8 @@ class CGProject : public BaseProject {
 				}
 			}
 		}
+        // Starts sampling the poses of the next frame, overlapping with the rest of this one
+        animSystem.dispatch(charManager.getCharacters(), deltaT * SpeedUpAnimFact);
 
 		// TECHNIQUE Skybox
         techniqueId++;
@@ -992,8 +1312,7 @@ class CGProject : public BaseProject {
 
             shadowUbo.model = SC.TI[techniqueId].I[instanceId].Wm;
 
-            std::string torchId = *SC.TI[techniqueId].I[instanceId].id;
-            indexUbo.idx = std::stoi(torchId.substr(torchId.find_last_of('.') + 1)); // expects torch id in form "torch_#"
+            indexUbo.idx = torchPinIdx[instanceId];
 
             SC.TI[techniqueId].I[instanceId].DS[0][0]->map(currentImage, &shadowUbo, 0);
             SC.TI[techniqueId].I[instanceId].DS[1][0]->map(currentImage, &lightUbo, 0);
@@ -1017,6 +1336,26 @@ class CGProject : public BaseProject {
 			oss << "FPS: " << Fps << "\n";
 
 			txt.print(1.0f, 1.0f, oss.str(), 1, "CO", false, false, true,TAL_RIGHT,TRH_RIGHT,TRV_BOTTOM,{1.0f,0.0f,0.0f,1.0f},{0.8f,0.8f,0.0f,1.0f});
+			if (showPhysicsStats) {
+				txt.print(-0.98f, -0.9f, physicsMgr.getPhysicsStats().summary(), 6, "SS",
+						  false, false, true, TAL_LEFT, TRH_LEFT, TRV_TOP,
+						  {1,1,1,1}, {0,0,0,1}, {0.5f, 0.5f, 0.5f, 0.2f}, 1,1);
+			}
+#ifdef ENABLE_PROFILER
+			// One window of profiler statistics per second, shown or not
+			std::string profile = Profiler::get().overlayText();
+			if (showProfiler) {
+				txt.print(0.98f, -0.8f, profile, 7, "SS",
+						  false, false, true, TAL_LEFT, TRH_RIGHT, TRV_TOP,
+						  {1,1,1,1}, {0,0,0,1}, {0.5f, 0.5f, 0.5f, 0.2f}, 1,1);
+			}
+#endif
+			
+			if (showRenderStats) {
+				txt.print(-0.98f, -0.45f, RenderStats::get().summary(), 8, "SS",
+						  false, false, true, TAL_LEFT, TRH_LEFT, TRV_TOP,
+						  {1,1,1,1}, {0,0,0,1}, {0.5f, 0.5f, 0.5f, 0.2f}, 1,1);
+			}
 			
 			elapsedT = 0.0f;
 		    countedFrames = 0;
@@ -1028,8 +1367,8 @@ class CGProject : public BaseProject {
 				  {1,1,1,1}, {0,0,0,1}, {0.5f, 0.5f, 0.5f, 0.2f}, 1,1);
 
 		// Update message for interaction with idle Characters nearby
-		if(charManager.getNearestCharacter(physicsMgr.getPlayerPosition()) != nullptr) {
-			auto character = charManager.getNearestCharacter(physicsMgr.getPlayerPosition());
+		auto character = charManager.getNearestCharacter(physicsMgr.getPlayerPosition());
+		if(character != nullptr) {
 			txt.print(0.5f, -0.2f, "Press E to talk\nwith "+character->getName(), 2, "CO",
 					  false, true, true, TAL_CENTER, TRH_CENTER, TRV_MIDDLE,
 					  {1,1,1,1}, {0.5,0,0,1},{0.5,0,0,0.5}, 1.2, 1.2);
@@ -1040,7 +1379,7 @@ class CGProject : public BaseProject {
 
         // Update message for interaction point in the nearby
         if(interactionsManager.isNearInteractable()) {
-            auto interaction = interactionsManager.getNearInteractable();
+            const auto& interaction = interactionsManager.getNearInteractable();
             txt.print(0.96f, -0.97f, "Press Z to interact\nwith "+interaction.label, 4, "SS",
 					  false, false, true,TAL_RIGHT, TRH_RIGHT, TRV_TOP,
 					  {1,1,1,1}, {0.5,0,0,1},{0.5,0,0,0.5}, 1.2, 1.2);
@@ -1049,19 +1388,61 @@ class CGProject : public BaseProject {
 			txt.removeText(4);		// remove the text if no interaction point is nearby
 
 
-        txt.updateCommandBuffer();
+        txt.update(currentImage);
         firstTime = false;
+
+        if (benchmark != nullptr && !benchmark->isDone() && benchmark->frame()) {
+            writeBenchmarkReport();
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
     }
 
+	void writeBenchmarkReport() {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		benchmark->addInfo("device", properties.deviceName);
+		benchmark->addInfo("software_device", properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU);
+		const PassStats render = RenderStats::get().getLastFrame().total();
+		benchmark->addInfo("draw_calls", render.drawCalls);
+		benchmark->addInfo("triangles", render.triangles);
+		benchmark->addInfo("preskin_characters", preskinCharacters);
+		const bool offscreen = benchmarkOptions.mode == BenchmarkOptions::OFFSCREEN;
+		if (benchmarkOptions.replayInput.empty()) {
+			benchmarkStatus = benchmark->writeReport("offscreen");
+		} else {
+			benchmark->addInfo("input_log", benchmarkOptions.replayInput);
+			benchmarkStatus = benchmark->writeReport(offscreen ? "offscreen-replay" : "replay");
+		}
+	}
+
 	float GameLogic() {
+		PROFILE_SCOPE("GameLogic");
 		// Integration with the timers and the controllers
 		float deltaT;
 		glm::vec3 m = glm::vec3(0.0f), r = glm::vec3(0.0f);
 		bool fire = false;
-		getSixAxis(deltaT, m, r, fire);
+		if (benchmark != nullptr && InputRecorder::get().getMode() != InputRecorder::REPLAY) {
+			// Same simulated time per frame, whatever the device, and the camera on its path
+			deltaT = benchmarkOptions.timeStep;
+			glm::vec3 eye, target;
+			cameraPath.sample(benchmark->getTime(), eye, target);
+			physicsMgr.update(deltaT);
+			viewControls->updateScripted(eye, target);
+		} else {
+			getSixAxis(deltaT, m, r, fire);
+			physicsMgr.update(deltaT);
+			viewControls->updateFrame(deltaT, m, r, fire);
+		}
 
-		physicsMgr.update(deltaT);
-        viewControls->updateFrame(deltaT, m, r, fire);
+		if (recordingCamera) {
+			// A key every quarter of a second, looking where the third person camera looks
+			const float KEY_INTERVAL = 0.25f;
+			if (cameraPath.empty() || cameraRecordTime >= cameraPath.size() * KEY_INTERVAL) {
+				cameraPath.addKey(cameraRecordTime, viewControls->getCameraPos(),
+								  physicsMgr.getPlayerPosition() + glm::vec3(0.0f, 2.0f, 0.0f));
+			}
+			cameraRecordTime += deltaT;
+		}
 
 		// Move the player in the correct position (physics + model update)
         // Note: + 180 degrees to rotate so that he sees in direction of movement
@@ -1070,20 +1451,48 @@ class CGProject : public BaseProject {
 		// Update animated props
 		animatedProps->update(deltaT);
 
+		// State of the frame, checked against the recorded session while replaying the input
+		const glm::vec3 playerPos = physicsMgr.getPlayerPosition();
+		const float playerYaw = viewControls->getPlayerYaw();
+		InputRecorder::get().hashState(&playerPos, sizeof(playerPos));
+		InputRecorder::get().hashState(&playerYaw, sizeof(playerYaw));
+
 		return deltaT;
 	}
 };
 
 // This is the main: probably you do not need to touch this!
-int main() {
+// Without arguments it runs interactively; see parseBenchmarkArgs() for the benchmark mode and the input logs.
+int main(int argc, char* argv[]) {
+    BenchmarkOptions benchmarkOptions;
+    if (parseBenchmarkArgs(argc, argv, benchmarkOptions) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (benchmarkOptions.mode == BenchmarkOptions::SIM_ONLY) {
+        return runSimulationBenchmark(benchmarkOptions, SCENE_FILEPATH, FLY_MODE) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (!benchmarkOptions.recordInput.empty() && InputRecorder::get().startRecording(benchmarkOptions.recordInput) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (!benchmarkOptions.replayInput.empty() && InputRecorder::get().startReplay(benchmarkOptions.replayInput) != 0) {
+        return EXIT_FAILURE;
+    }
+
     CGProject app;
+    app.setPreskinCharacters(benchmarkOptions.preskinCharacters);
+    if (benchmarkOptions.mode == BenchmarkOptions::OFFSCREEN || !benchmarkOptions.replayInput.empty()) {
+        app.setBenchmark(benchmarkOptions);
+    }
 
     try {
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
+        InputRecorder::get().stop();
         return EXIT_FAILURE;
     }
+    InputRecorder::get().stop();
 
-    return EXIT_SUCCESS;
+    return app.getBenchmarkStatus() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file